@@ -2,20 +2,240 @@
 #define _Q_WS_ALLOC_
 
 #include <stdlib.h>
+#include <stdatomic.h>
 
 /**
  * This functions will help us have more control over memory allocation
  * and using them we might be able to provide snapshots :)
  */
 
+typedef struct _val ws_val;
+typedef struct _obj ws_obj;
+typedef struct _scope ws_scope;
+typedef struct _ds_entity ws_ds_entity;
+typedef struct _context_list ws_context_list;
+struct _table_slot;
+
+typedef struct _context ws_context;
+typedef struct _pool ws_pool;
+typedef struct _memory_stats ws_memory_stats;
+
+/**
+ * What the memory is used for, each allocation is attributed to a category
+ * and to the current context of the thread.
+ */
+enum WS_MEMORY_CATEGORY
+{
+  WS_MEMORY_VALUES,
+  WS_MEMORY_TABLES,
+  WS_MEMORY_SCOPES,
+  WS_MEMORY_STACK,
+  WS_MEMORY_CODE,
+  WS_MEMORY_OTHER,
+  WS_MEMORY_CATEGORIES
+};
+
+/**
+ * A report of the memory used by a context (or a fork tree).
+ */
+struct _memory_stats
+{
+  /**
+   * Live bytes in each category.
+   */
+  long live[WS_MEMORY_CATEGORIES];
+
+  /**
+   * Sum of the live bytes.
+   */
+  long total;
+
+  /**
+   * The highest `total` observed, for a subtree this is the sum of the peaks
+   * so it's an upper bound.
+   */
+  long peak;
+
+  /**
+   * Number of table overlays (struct _table_ctx) stored on the context.
+   */
+  unsigned long overlays;
+};
+
 /**
- * Allocate the memory and dies if it fails.
+ * The counters that the allocations are attributed to, every context has
+ * one of these.
+ */
+struct _memory_counters
+{
+  /**
+   * Live bytes in each category.
+   */
+  atomic_long live[WS_MEMORY_CATEGORIES];
+
+  /**
+   * Sum of the live bytes.
+   */
+  atomic_long total;
+
+  /**
+   * The highest `total` so far.
+   */
+  atomic_long peak;
+};
+
+/**
+ * Allocate the memory and dies if it fails, it's counted as WS_MEMORY_OTHER.
  */
 void *ws_alloc(size_t size);
 
 /**
- * Free the allocated memory.
+ * Allocate the memory for the given category and dies if it fails.
+ */
+void *ws_alloc_as(enum WS_MEMORY_CATEGORY category, size_t size);
+
+/**
+ * Free the memory allocated by ws_alloc or ws_alloc_as.
+ */
+void ws_free(void *ptr);
+
+/**
+ * Set the context that the allocations of the current thread are attributed
+ * to, returns the previous one. NULL means the global counters.
+ */
+ws_context *ws_set_current_context(ws_context *ctx);
+
+/**
+ * Get the memory that is not attributed to any context.
+ */
+void memory_global_stats(ws_memory_stats *stats);
+
+//==============================================================================
+// Pools for the small fixed-size structs of the VM.
+
+/**
+ * Number of blocks moved between a thread cache and the global depot at once.
+ */
+#define WS_POOL_BATCH 64
+
+/**
+ * A pool of fixed-size blocks. Each thread has its own cache of free blocks
+ * so most allocations do not need any synchronization, when a cache is empty
+ * (or too large) a whole batch of blocks is taken from (or returned to) the
+ * global depot of the pool.
+ *
+ * The memory is allocated in slabs of WS_POOL_BATCH blocks and it's never
+ * given back to the system, a block in use is counted as live memory of the
+ * context it was allocated in.
+ */
+struct _pool
+{
+  /**
+   * Index of this pool in the thread caches.
+   */
+  unsigned int id;
+
+  /**
+   * Size of each block in bytes.
+   */
+  size_t size;
+
+  /**
+   * Category that the blocks are counted in.
+   */
+  enum WS_MEMORY_CATEGORY category;
+
+  /**
+   * Protects the depot.
+   */
+  atomic_flag lock;
+
+  /**
+   * A stack of full batches of free blocks.
+   */
+  void *depot;
+};
+
+/**
+ * Allocate a block from the pool, dies if there is no memory.
+ */
+void *pool_alloc(ws_pool *pool);
+
+/**
+ * Return a block to the pool it was allocated from.
+ */
+void pool_free(ws_pool *pool, void *ptr);
+
+/**
+ * Make sure the thread cache of the pool has at least `n` free blocks, so the
+ * next `n` allocations do not touch the depot.
+ */
+void pool_reserve(ws_pool *pool, unsigned int n);
+
+/**
+ * Allocate a ws_val.
+ */
+ws_val *ws_alloc_val();
+
+/**
+ * Free a ws_val allocated by ws_alloc_val.
+ */
+void ws_free_val(ws_val *ptr);
+
+/**
+ * Allocate a ws_obj.
+ */
+ws_obj *ws_alloc_obj();
+
+/**
+ * Free a ws_obj allocated by ws_alloc_obj.
+ */
+void ws_free_obj(ws_obj *ptr);
+
+/**
+ * Allocate a ws_scope.
+ */
+ws_scope *ws_alloc_scope();
+
+/**
+ * Free a ws_scope allocated by ws_alloc_scope.
+ */
+void ws_free_scope(ws_scope *ptr);
+
+/**
+ * Allocate a ws_ds_entity.
+ */
+ws_ds_entity *ws_alloc_ds_entity();
+
+/**
+ * Free a ws_ds_entity allocated by ws_alloc_ds_entity.
+ */
+void ws_free_ds_entity(ws_ds_entity *ptr);
+
+/**
+ * Reserve `n` ws_ds_entity blocks in the cache of the current thread, see
+ * pool_reserve.
+ */
+void ws_reserve_ds_entities(unsigned int n);
+
+/**
+ * Allocate a ws_context_list.
+ */
+ws_context_list *ws_alloc_context_list();
+
+/**
+ * Free a ws_context_list allocated by ws_alloc_context_list.
+ */
+void ws_free_context_list(ws_context_list *ptr);
+
+/**
+ * Allocate a table slot.
+ */
+struct _table_slot *ws_alloc_table_slot();
+
+/**
+ * Free a table slot allocated by ws_alloc_table_slot.
  */
-#define ws_free(ptr) free(ptr)
+void ws_free_table_slot(struct _table_slot *ptr);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,115 @@
+#ifndef _Q_WS_ARRAY_
+#define _Q_WS_ARRAY_
+
+#include <stddef.h>
+#include "wval.h"
+
+/**
+ * What the element storage of an array can hold, an array only moves down
+ * this list: once it has a non-number it is never packed doubles again and
+ * once it has a hole it stays holey.
+ */
+enum WS_ELEMENTS_KIND
+{
+  /**
+   * All of the elements are numbers, stored unboxed in `data.doubles`.
+   */
+  WS_ELEMENTS_PACKED_DOUBLES,
+
+  /**
+   * Any values in `data.values`, there is no hole.
+   */
+  WS_ELEMENTS_PACKED,
+
+  /**
+   * Any values in `data.values`, a hole is a NULL.
+   */
+  WS_ELEMENTS_HOLEY
+};
+
+/**
+ * Contiguous storage for the elements of an array, the indices that are
+ * smaller than `length` live here instead of the properties table.
+ *
+ * The storage of a context is written in place, a forked child makes a copy
+ * the first time it writes to the array and keeps it in `copies` of
+ * the object (a table overlay, so the descendants of the child see it). So
+ * the elements are copied once per context that writes, not once per write.
+ */
+struct _elements
+{
+  enum WS_ELEMENTS_KIND kind;
+
+  /**
+   * Id of the context that can write to this storage.
+   */
+  unsigned int owner;
+
+  /**
+   * Number of elements and the number of slots that are allocated.
+   */
+  size_t length;
+  size_t capacity;
+
+  union {
+    double *doubles;
+    ws_val **values;
+  } data;
+
+  /**
+   * The copies of an array are linked from the storage it was created with,
+   * so they can be freed together.
+   */
+  ws_elements *_Atomic next;
+};
+
+/**
+ * Create a new empty array in the context.
+ */
+ws_val *ws_array(ws_context *ctx);
+
+/**
+ * Returns the elements of the array as the context sees them, don't write to
+ * them, use array_set or array_push.
+ */
+ws_elements *array_elements(ws_context *ctx, ws_obj *array);
+
+/**
+ * Returns true and sets `index` if the key is an array index: an integral
+ * number or its canonical string (like "12", but not "012").
+ */
+int array_index(ws_val *key, size_t *index);
+
+/**
+ * Returns the canonical string of an index, the key that for-in reports.  The
+ * keys of the small indices are shared, they are never freed.
+ */
+ws_val *array_index_key(size_t index);
+
+/**
+ * Returns the element at the index or NULL if it's a hole or out of bounds.
+ */
+ws_val *array_get(ws_context *ctx, ws_obj *array, size_t index);
+
+/**
+ * Returns the element for an index key or the length for "length", NULL for
+ * the other keys and the holes.
+ */
+ws_val *array_get_own(ws_context *ctx, ws_obj *array, ws_val *key);
+
+/**
+ * Set the element at the index, indices after the end leave holes.
+ */
+void array_set(ws_context *ctx, ws_obj *array, size_t index, ws_val *value);
+
+/**
+ * Append a value to the array.
+ */
+void array_push(ws_context *ctx, ws_obj *array, ws_val *value);
+
+/**
+ * Free the element storage of the array and all of its copies.
+ */
+void array_free(ws_obj *array);
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef _Q_WS_BUFFER_
+#define _Q_WS_BUFFER_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "wval.h"
+
+/**
+ * Size of a page of an ArrayBuffer, it's a multiple of the largest element
+ * so an aligned element never spans two pages.
+ */
+#define WS_BUFFER_PAGE_BITS 12
+#define WS_BUFFER_PAGE_SIZE (1 << WS_BUFFER_PAGE_BITS)
+#define WS_BUFFER_PAGE_MASK (WS_BUFFER_PAGE_SIZE - 1)
+
+/**
+ * The largest ArrayBuffer, it's only allocated when it's written to.
+ */
+#define WS_BUFFER_MAX_LENGTH 0x80000000ul
+
+typedef struct _buffer_page ws_buffer_page;
+
+struct _buffer_page
+{
+  /**
+   * Id of the context that can write to this page.
+   */
+  unsigned int owner;
+
+  /**
+   * All of the pages of a buffer are linked from the storage it was created
+   * with, so they can be freed together.
+   */
+  ws_buffer_page *next;
+
+  uint8_t data[WS_BUFFER_PAGE_SIZE];
+};
+
+/**
+ * Storage of an ArrayBuffer: a table of pages, a NULL page is all zeros and
+ * is only allocated once it's written to.
+ *
+ * The table of a context is written in place.  A forked child copies the
+ * table it sees (only the pointers) the first time it writes and keeps it in
+ * `copies` of the object (a table overlay, like the elements of an array,
+ * see array.h), then it copies only the page that it writes to.  So a child
+ * that changes one byte of a large buffer copies one page.
+ */
+struct _buffer
+{
+  /**
+   * Id of the context that can write to this table.
+   */
+  unsigned int owner;
+
+  size_t byte_length;
+  ws_buffer_page **pages;
+
+  /**
+   * The copies of the table are linked from the one the buffer was created
+   * with, and so are all of the pages in `page_list`.
+   */
+  ws_buffer *_Atomic next;
+  ws_buffer_page *_Atomic page_list;
+};
+
+/**
+ * Element type of a typed array.
+ */
+enum WS_TYPED_KIND
+{
+  WS_TYPED_INT8,
+  WS_TYPED_UINT8,
+  WS_TYPED_UINT8_CLAMPED,
+  WS_TYPED_INT16,
+  WS_TYPED_UINT16,
+  WS_TYPED_INT32,
+  WS_TYPED_UINT32,
+  WS_TYPED_FLOAT32,
+  WS_TYPED_FLOAT64
+};
+
+/**
+ * Log2 of the element size of each kind.
+ */
+extern const unsigned char WS_TYPED_SHIFT[];
+
+/**
+ * A view of `length` elements of an ArrayBuffer, starting at `byte_offset`
+ * which is a multiple of the element size.  Buffers can't be resized so a
+ * view is never changed after it's made.
+ */
+struct _typed_array
+{
+  enum WS_TYPED_KIND kind;
+  ws_val *buffer;
+  size_t byte_offset;
+  size_t length;
+};
+
+/**
+ * Create a new ArrayBuffer of `byte_length` zeros.
+ */
+ws_val *ws_array_buffer(ws_context *ctx, size_t byte_length);
+
+/**
+ * Returns the page table of the buffer as the context sees it, don't write
+ * to it.
+ */
+ws_buffer *buffer_view(ws_context *ctx, ws_obj *object);
+
+/**
+ * Copy `size` bytes of the buffer from `offset` to `data`, or from `data` to
+ * the buffer.  The range must be in the buffer.
+ */
+void buffer_read(ws_context *ctx, ws_obj *object, size_t offset, void *data, size_t size);
+void buffer_write(ws_context *ctx, ws_obj *object, size_t offset, const void *data, size_t size);
+
+/**
+ * Returns the `byteLength` of an ArrayBuffer for the key, NULL for the other
+ * keys.
+ */
+ws_val *buffer_get_own(ws_context *ctx, ws_obj *object, ws_val *key);
+
+/**
+ * Free the pages and the page tables of the buffer.
+ */
+void buffer_free(ws_obj *object);
+
+/**
+ * Create a typed array over `length` elements of the buffer, starting from
+ * `byte_offset`.  The buffer must have the range and the offset must be
+ * aligned.
+ */
+ws_val *ws_typed_array_object(ws_context *ctx,
+                              enum WS_TYPED_KIND kind,
+                              ws_val *buffer,
+                              size_t byte_offset,
+                              size_t length);
+
+/**
+ * Returns the element at the index or NULL if it's out of the bounds.
+ */
+ws_val *typed_array_get(ws_context *ctx, ws_obj *array, size_t index);
+
+/**
+ * Convert the value to the element type and store it at the index, it's
+ * ignored if the index is out of the bounds.
+ */
+void typed_array_set(ws_context *ctx, ws_obj *array, size_t index, ws_val *value);
+
+/**
+ * Returns an element (for an index) or one of `length`, `byteLength`,
+ * `byteOffset` and `buffer` of the typed array, NULL for the other keys.
+ */
+ws_val *typed_array_get_own(ws_context *ctx, ws_obj *array, ws_val *key);
+
+/**
+ * Free the view, the buffer is freed on its own.
+ */
+void typed_array_free(ws_obj *array);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef _Q_WS_BUILTINS_
+#define _Q_WS_BUILTINS_
+
+#include "wval.h"
+
+/**
+ * Define the global builtins (`Map`, `Set`, `ArrayBuffer`, the typed arrays,
+ * `RegExp`, `JSON`, `ws` and `q`) in the current scope of the context, it's
+ * done for every script before it runs.
+ *
+ * `q.FloatRange(min, max)`, `q.Union(...)` (up to three members) and
+ * `q.String()` return the abstract values of domain.h, `q.Callable({
+ * returnType })` returns a function that always returns `returnType`.
+ *
+ * Builtins are native functions (ws_native), `Call0`-`Call3` and
+ * `New0`-`New3` run them right away instead of entering a frame.  There is
+ * no `this` in calls yet, so reading a method of a builtin object makes a
+ * native function that is bound to the object.
+ */
+void builtins_define(ws_context *ctx);
+
+/**
+ * Returns the method or the `size` of a Map or a Set for the key, NULL for
+ * the other keys.
+ */
+ws_val *builtins_collection_get(ws_context *ctx, ws_val *collection, ws_val *key);
+
+/**
+ * Returns the method of a typed array for the key (`fill` or `subarray`),
+ * NULL for the other keys.
+ */
+ws_val *builtins_typed_array_get(ws_context *ctx, ws_val *array, ws_val *key);
+
+/**
+ * Returns the method of an ArrayBuffer for the key (`slice`), NULL for the
+ * other keys.
+ */
+ws_val *builtins_buffer_get(ws_context *ctx, ws_val *buffer, ws_val *key);
+
+/**
+ * Returns the method (`test` or `exec`), the `source`, the `flags` or a flag
+ * (like `global`) of a RegExp for the key, NULL for the other keys.
+ */
+ws_val *builtins_regexp_get(ws_context *ctx, ws_val *object, ws_val *key);
+
+#endif
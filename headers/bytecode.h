@@ -78,6 +78,8 @@ enum WS_BYTECODE {
   WB_JMP_FALSE_PEEK = 0x74,
   WB_JMP_TRUE_THEN_POP = 0x75,
   WB_JMP_FALSE_THEN_POP = 0x76,
+  WB_SWITCH = 0x77,
+  WB_DIAMOND = 0x78,
   WB_LD_SCOPE = 0x90,
   WB_RET = 0x91,
   WB_FUNCTION_IN = 0x92,
@@ -0,0 +1,111 @@
+#ifndef _Q_WS_COLLECTION_
+#define _Q_WS_COLLECTION_
+
+#include <stddef.h>
+#include "wval.h"
+
+typedef struct _collection_entry ws_collection_entry;
+
+/**
+ * An entry of a Map or a Set, the value of a Set entry is its key.
+ */
+struct _collection_entry
+{
+  /**
+   * The key, NULL if the entry was deleted.
+   */
+  ws_val *key;
+  ws_val *value;
+
+  /**
+   * ws_hash of the key, so the index can be rebuilt without hashing again.
+   */
+  unsigned long hash;
+};
+
+/**
+ * Storage of a Map or a Set: the entries in insertion order and an open
+ * addressing index into them.  A deleted entry stays in place with a NULL
+ * key (the index slot that points to it works as a tombstone) until the
+ * entries are full, then the live ones are moved together and the index is
+ * rebuilt.
+ *
+ * Keys are compared with SameValueZero, any value but the abstract ones can
+ * be a key.
+ *
+ * Forks work like the elements of an array (see array.h): a fork doesn't
+ * copy anything, a child copies the storage that it sees on its first write
+ * and keeps the copy in `copies` of the object.
+ */
+struct _collection
+{
+  /**
+   * Whatever it's a Set, the methods are picked by this.
+   */
+  int is_set;
+
+  /**
+   * Id of the context that can write to this storage.
+   */
+  unsigned int owner;
+
+  /**
+   * Number of live entries, number of used entries (deleted ones included)
+   * and number of allocated entries.
+   */
+  size_t size;
+  size_t used;
+  size_t capacity;
+
+  ws_collection_entry *entries;
+
+  /**
+   * Twice as many slots as `capacity`, zero is an empty slot and any other
+   * value is an entry index plus one.
+   */
+  size_t *index;
+
+  /**
+   * The copies of a collection are linked from the storage it was created
+   * with, so they can be freed together.
+   */
+  ws_collection *_Atomic next;
+};
+
+/**
+ * Create a new empty Map or Set in the context.
+ */
+ws_val *ws_collection_object(ws_context *ctx, int is_set);
+
+/**
+ * Returns the storage of the collection as the context sees it, don't write
+ * to it.
+ */
+ws_collection *collection_view(ws_context *ctx, ws_obj *object);
+
+/**
+ * Returns the value of the key or NULL if the collection doesn't have it.
+ */
+ws_val *collection_get(ws_context *ctx, ws_obj *object, ws_val *key);
+
+/**
+ * Add the key or change its value, an existing key keeps its position.
+ */
+void collection_set(ws_context *ctx, ws_obj *object, ws_val *key, ws_val *value);
+
+/**
+ * Remove the key, returns false if the collection didn't have it.
+ */
+int collection_delete(ws_context *ctx, ws_obj *object, ws_val *key);
+
+/**
+ * Remove all of the entries.
+ */
+void collection_clear(ws_context *ctx, ws_obj *object);
+
+/**
+ * Free the storage of the collection and all of its copies.
+ */
+void collection_free(ws_obj *object);
+
+#endif
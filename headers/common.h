@@ -1,20 +1,46 @@
 #ifndef _Q_WS_COMMON_
 #define _Q_WS_COMMON_
 
+#include <stddef.h>
+#include <uchar.h>
+
 typedef struct _val ws_val;
 typedef struct _function_compiled_data ws_function_compiled_data;
+typedef struct _table_stats ws_table_stats;
 
 /**
  * Exit the process with a non-zero code and write the message
  * to stderr.
  */
-void die(char *msg);
+void die(char *msg) __attribute__((noreturn));
 
 /**
  * Hash WaterScript value - mostly to be used in the hash table.
  */
 unsigned long ws_hash(ws_val *value);
 
+/**
+ * Returns the number of code units at the start of the data that can be
+ * written in a string literal as they are: for JS (`json` is false) all but
+ * the controls, the quotes and the backslash, for JSON all but the controls,
+ * the double quote, the backslash and the surrogates.  It reads four code
+ * units at a time.
+ */
+size_t escape_span(const char16_t *data, size_t length, int json);
+
+/**
+ * Write the code units escaped for a string literal (without the quotes) to
+ * `out` and return the number of code units that are written, nothing is
+ * written if `out` is NULL.  JSON escapes the other controls and the lone
+ * surrogates as `\uXXXX`.
+ */
+size_t escape_chars(const char16_t *data, size_t length, char16_t *out, int json);
+
+/**
+ * Returns a new string of the value escaped for a JS string literal.
+ */
+ws_val *escape_string(ws_val *value);
+
 /**
  * Dump a compiled code to the stdout.
  */
@@ -25,4 +51,9 @@ void dump_code(ws_function_compiled_data *data);
  */
 void dump_value(ws_val *value);
 
+/**
+ * Dump the statistics of the tables to the stdout.
+ */
+void dump_table_stats(ws_table_stats *stats);
+
 #endif
\ No newline at end of file
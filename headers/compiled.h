@@ -3,7 +3,9 @@
 #include "compiler.h"
 
 /**
- * Return compiled data of a pre compiled function.
+ * Return a function that is closed over `scope` with the compiled data of a
+ * pre compiled function, or NULL if there is no function with the id.  The
+ * functions are the ones of the last bundle that was loaded, see loader.h.
  */
 ws_function *get_function(int id, ws_scope *scope);
 
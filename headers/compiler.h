@@ -12,10 +12,18 @@ typedef struct _function_compiled_data ws_function_compiled_data;
 struct _function_compiled_data
 {
   /**
-   * Starting offset of the constant pool. (inclusive)
+   * Starting offset of the constant pool (inclusive), it's also the end of
+   * the bytecodes.
    */
   size_t constant_pool_offset;
 
+  /**
+   * The constant pool, it's either a part of `data` (at constant_pool_offset)
+   * or shared by all the functions of a bundle, see `loader.h`.
+   */
+  uint8_t *constant_pool;
+  size_t constant_pool_size;
+
   /**
    * Start of the scope data. (inclusive)
    */
@@ -26,6 +34,33 @@ struct _function_compiled_data
    */
   size_t map_offset;
 
+  /**
+   * Whatever the function has passed verify_function, the interpreter skips
+   * the stack checks of a verified function.
+   */
+  int verified;
+
+  /**
+   * Maximum depth of the data stack, set by verify_function.
+   */
+  unsigned int max_stack;
+
+  /**
+   * Values of the constant pool that the bytecodes use, decoded once by the
+   * loader.  The operand of `LdStr`, `Named` and the other bytecodes with a
+   * netstring operand is an index in this array instead of an offset in the
+   * pool after the function is loaded.  The values are never freed.
+   */
+  ws_val **constants;
+  unsigned int constants_size;
+
+  /**
+   * Keys of the parameters in the order of the declaration, read from the
+   * scope section by the loader.
+   */
+  ws_val **params;
+  unsigned int params_size;
+
   /**
    * A variable length array containing all the buffers data.
    * Starts with the bytecodes.
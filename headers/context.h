@@ -2,7 +2,9 @@
 #define _Q_WS_CONTEXT_
 
 #include <stdatomic.h>
+#include <setjmp.h>
 #include <uchar.h>
+#include "alloc.h"
 
 typedef struct _val ws_val;
 typedef struct _function ws_function;
@@ -12,8 +14,216 @@ typedef struct _context ws_context;
 typedef struct _context_list ws_context_list;
 typedef struct _scope ws_scope;
 typedef struct _table ws_table;
+typedef struct _table_iter ws_table_iter;
 typedef struct _ds_entity ws_ds_entity;
 
+typedef struct _table_stats ws_table_stats;
+typedef struct _trace ws_trace;
+typedef struct _output_chunk ws_output_chunk;
+typedef struct _frame ws_frame;
+
+/**
+ * Number of buckets in a table statistics histogram, bucket 0 counts zeros
+ * and bucket i counts the values in [2^(i-1), 2^i), the last one also counts
+ * everything larger.
+ */
+#define WS_HISTOGRAM_BUCKETS 16
+
+/**
+ * Opt-in statistics of the tables, enabled by compiling with WS_TABLE_STATS
+ * (`cmake -DTABLE_STATS=ON`). A context counts the work done on the overlays
+ * that are stored on it, except `ancestors` which is counted on the context
+ * that did the lookup.
+ */
+struct _table_stats
+{
+  /**
+   * Histogram of the probe lengths when looking for an overlay in a context.
+   */
+  atomic_ulong probes[WS_HISTOGRAM_BUCKETS];
+
+  /**
+   * Histogram of the number of slots compared in a bucket chain per lookup.
+   */
+  atomic_ulong chains[WS_HISTOGRAM_BUCKETS];
+
+  /**
+   * Histogram of the number of contexts visited by table_get.
+   */
+  atomic_ulong ancestors[WS_HISTOGRAM_BUCKETS];
+
+  /**
+   * Number of times a context did not have an overlay for a table.
+   */
+  atomic_ulong find_misses;
+
+  /**
+   * Number of times the overlays array or a bucket array had to grow.
+   */
+  atomic_ulong grows;
+
+  /**
+   * Number of slots in the overlays.
+   */
+  atomic_long slots;
+
+  /**
+   * Number of slots that are a deleted key (is_delete).
+   */
+  atomic_long tombstones;
+};
+
+/**
+ * Value of `context.fuel` for a context that never runs out of budget.
+ */
+#define WS_FUEL_UNLIMITED -1
+
+/**
+ * Maximum number of nested diamonds that a context evaluates in place, the
+ * deeper ones are forked as usual.
+ */
+#define WS_DIAMOND_MAX_DEPTH 8
+
+/**
+ * Default value of `context.widen_after`.
+ */
+#define WS_WIDEN_AFTER 3
+
+/**
+ * Default value of `context.loop_limit`.
+ */
+#define WS_LOOP_LIMIT 64
+
+/**
+ * Maximum number of loops that a context keeps track of, and the maximum
+ * number of values in the state of each one.
+ */
+#define WS_LOOP_MAX 8
+#define WS_LOOP_MAX_STATE 16
+
+typedef struct _diamond ws_diamond;
+typedef struct _loop ws_loop;
+
+/**
+ * A branch whose arms are evaluated in place one after the other, see the
+ * `Diamond` instruction in VM.md.
+ */
+struct _diamond
+{
+  /**
+   * Offset of the instruction after both arms.
+   */
+  unsigned long join;
+
+  /**
+   * Offset of the second arm.
+   */
+  unsigned long alternate;
+
+  /**
+   * Whatever the first arm is done and the second one is running.
+   */
+  int second;
+
+  /**
+   * Head of the data stack before the arms, used to tell if an arm left a
+   * value on the stack.
+   */
+  ws_ds_entity *ds_head;
+
+  /**
+   * Value that the first arm left on the stack or NULL.
+   */
+  ws_val *value;
+};
+
+/**
+ * State of the variables of a loop the last time a context reached its header
+ * with a backward jump, see exec_loop.
+ */
+struct _loop
+{
+  /**
+   * Offset of the loop header, the target of the backward jump.
+   */
+  unsigned long header;
+
+  /**
+   * Frame of the call that runs the loop (NULL for the main function), the
+   * loops of a call are forgotten when it returns.
+   */
+  ws_frame *frame;
+
+  /**
+   * Fork depth of the context that recorded the state, the iterations that
+   * did not fork are not counted.
+   */
+  unsigned int depth;
+
+  /**
+   * Number of iterations that forked.
+   */
+  unsigned int iterations;
+
+  /**
+   * Number of values in `state`, the first `stack` ones are the top of the
+   * data stack and the rest are the variables with the names in `keys`.
+   */
+  unsigned int size;
+  unsigned int stack;
+
+  ws_val *keys[WS_LOOP_MAX_STATE];
+  ws_val *state[WS_LOOP_MAX_STATE];
+
+  /**
+   * Size and hash of the output of the context when the state was read (zero
+   * if it didn't write anything), a branch that wrote something else is not
+   * subsumed by this state.
+   */
+  size_t output_total;
+  unsigned long output_hash;
+};
+
+/**
+ * A call that has not returned yet, see "Calling Convention" in VM.md.  The
+ * frames form a linked list from the current call to the main function and
+ * they are never changed after the call, so the children of a fork share the
+ * frames of their parent.
+ */
+struct _frame
+{
+  /**
+   * Frame of the caller, NULL if the caller is the main function.
+   */
+  ws_frame *prev;
+
+  /**
+   * Number of contexts (and frames) that point to this frame.
+   */
+  atomic_uint ref_count;
+
+  /**
+   * Code of the caller.
+   */
+  ws_function_compiled_data *function;
+
+  /**
+   * Offset of the instruction after the call in the caller.
+   */
+  unsigned long cursor;
+
+  /**
+   * Scope of the caller.
+   */
+  ws_scope *scope;
+
+  /**
+   * The data stack of the caller under the callee and the arguments, the
+   * return value replaces them.
+   */
+  ws_ds_entity *base;
+};
+
 /**
  * Context provides an execution environment for the JavaScript scripts.
  * It is the heart of VM and each context can only be accessed thought one
@@ -49,6 +259,28 @@ struct _context
    */
   ws_context_list *childs;
 
+  /**
+   * Number of forks between the root context and this one, a replayed
+   * context counts the forks that it replayed.
+   */
+  unsigned int depth;
+
+  /**
+   * The trace that is being replayed or NULL, see exec_replay.
+   */
+  ws_trace *replay;
+
+  /**
+   * Index of the branch that the last replayed fork took.
+   */
+  unsigned int replay_branch;
+
+  /**
+   * Last chunk of the output of this context, the chunks written before a
+   * fork are shared with the children, see output.h.
+   */
+  ws_output_chunk *output;
+
   /**
    * Part of the GC.
    */
@@ -64,6 +296,118 @@ struct _context
    */
   ws_scope *scope;
 
+  /**
+   * The function that is being executed on this context, NULL before the
+   * first call to `exec`.
+   */
+  ws_function_compiled_data *function;
+
+  /**
+   * The current call, NULL while the main function is running.
+   */
+  ws_frame *frame;
+
+  /**
+   * Frames that were returned from, reused by the next calls of this
+   * context instead of allocating.
+   */
+  ws_frame *frame_pool;
+
+  /**
+   * Offset of the next instruction in the function, a forked child starts
+   * from here when it's resumed by `exec_resume`.
+   */
+  unsigned long cursor;
+
+  /**
+   * Remaining instruction budget, it's only charged at backward jumps and
+   * calls.  When it reaches zero `exec_resume` returns to the caller, the
+   * default is WS_FUEL_UNLIMITED.
+   */
+  long fuel;
+
+  /**
+   * Stack of the diamonds that are being evaluated.
+   */
+  ws_diamond diamonds[WS_DIAMOND_MAX_DEPTH];
+
+  /**
+   * Number of items in `diamonds`.
+   */
+  unsigned int diamonds_size;
+
+  /**
+   * The loops that this context and its ancestors went through, the array
+   * is copied on fork.
+   */
+  ws_loop *loops;
+
+  /**
+   * Number of items in `loops`.
+   */
+  unsigned int loops_size;
+
+  /**
+   * Number of iterations of a loop that fork before the loop state is
+   * widened, defaults to WS_WIDEN_AFTER.
+   */
+  unsigned int widen_after;
+
+  /**
+   * A branch that forked in this many iterations of a loop without
+   * converging is dropped, defaults to WS_LOOP_LIMIT.
+   */
+  unsigned int loop_limit;
+
+  /**
+   * Whatever this branch reached a loop header in a state that an ancestor
+   * already went through, then it has nothing left to do.
+   */
+  int subsumed;
+
+  /**
+   * Set by the tracing collector on the live contexts and their ancestors
+   * during a collection, only their overlays are traced, see gc.h.
+   */
+  int gc_reachable;
+
+  /**
+   * Message of the error that a builtin threw on this branch or NULL, the
+   * branch ended there, see context_throw.
+   */
+  char *error;
+
+  /**
+   * Where context_throw jumps to, set by the outermost exec_resume while it
+   * runs the context.
+   */
+  jmp_buf *handler;
+
+  /**
+   * Number of writes to prototypes in this context and its ancestors, see
+   * object.h.
+   */
+  unsigned long proto_version;
+
+  /**
+   * Number of instructions executed on this context, the instructions that
+   * were executed on its ancestors are not included.
+   */
+  unsigned long instructions;
+
+  /**
+   * Memory allocated while this context was the current context, see
+   * ws_set_current_context.
+   */
+  struct _memory_counters memory;
+
+#ifdef WS_TABLE_STATS
+  /**
+   * Statistics of the tables in this context.
+   */
+  ws_table_stats table_stats;
+#endif
+
   /**
    * List of all the tables in the context.
    */
@@ -190,6 +534,15 @@ struct _table_ctx
    * Array of slots.
    */
   struct _table_slot **buckets;
+
+  /**
+   * The slots in the order they were added to this overlay, linked by
+   * `order`. Slots are never removed before the overlay is destroyed, when a
+   * deleted key is set again it gets a new slot at the end and the old one is
+   * only left in this list.
+   */
+  struct _table_slot *first;
+  struct _table_slot *last;
 };
 
 /**
@@ -210,6 +563,12 @@ struct _table_slot
    */
   int is_delete;
 
+  /**
+   * The key was deleted from this overlay and then set again, it's a new key
+   * for the order of the keys even if an ancestor has it.
+   */
+  int readded;
+
   /**
    * A pointer to the value, can be anything.
    */
@@ -219,6 +578,40 @@ struct _table_slot
    * To handle collision for keys with the same hash.
    */
   struct _table_slot *next;
+
+  /**
+   * The slot that was added to the overlay after this one.
+   */
+  struct _table_slot *order;
+};
+
+/**
+ * A cursor over the keys of a table in the order they were added, as a
+ * context sees them, see table_next.
+ *
+ * The overlays are walked from the root context down to the context, a key
+ * is reported in the overlay where it was added last time after it didn't
+ * exist (it was never set or it was deleted) and only if it's not deleted in
+ * the context.  So setting an existing key in a child doesn't move it and no
+ * list of keys is ever built.
+ *
+ * The cursor only points into the overlays, it can be copied to a forked
+ * child and used there.
+ */
+struct _table_iter
+{
+  ws_table *table;
+
+  /**
+   * Distance of the overlay that is walked from the root context, or -1
+   * before the first step.
+   */
+  int layer;
+
+  /**
+   * The next slot of the overlay to look at.
+   */
+  struct _table_slot *slot;
 };
 
 // Methods
@@ -249,11 +642,30 @@ void context_release(ws_context *ctx);
  */
 ws_val *context_exec(ws_function_compiled_data *data);
 
+/**
+ * Report the memory used by the context itself.
+ */
+void context_memory_stats(ws_context *ctx, ws_memory_stats *stats);
+
+/**
+ * Report the memory used by the context and all of its descendants.
+ */
+void context_memory_stats_tree(ws_context *ctx, ws_memory_stats *stats);
+
 /**
  * Check if base is deeply parent of ctx.
  */
 int context_is_parent_of(ws_context *base, ws_context *ctx);
 
+/**
+ * Throw an error from a builtin, like the SyntaxError of JSON.parse.  There
+ * are no exceptions in the VM yet, so the error ends the branch: exec_resume
+ * returns NULL with `ctx->error` set and the other branches keep running.
+ * What the builtin allocated is not freed.  Outside of exec_resume it dies
+ * with the message.
+ */
+void context_throw(ws_context *ctx, char *message) __attribute__((noreturn));
+
 /**
  * Fork the context to n branches, returns on success ends the process
  * with a non-zero exit code otherwise.
@@ -335,6 +747,13 @@ ws_val *context_ds_peek(ws_context *ctx);
  */
 ws_val *context_ds_pop(ws_context *ctx);
 
+/**
+ * Like context_ds_push and context_ds_pop without any checks, only for the
+ * code of a verified function (see verifier.h).
+ */
+void context_ds_push_unchecked(ws_context *ctx, ws_val *value);
+ws_val *context_ds_pop_unchecked(ws_context *ctx);
+
 /**
  * Initialize a new table on the allocated memory.
  */
@@ -365,4 +784,47 @@ void table_del(ws_context *ctx, ws_table *table, ws_val *key);
  */
 void *table_get(ws_context *ctx, ws_table *table, ws_val *key);
 
+#ifdef WS_TABLE_STATS
+/**
+ * Statistics of all the contexts together.
+ */
+extern ws_table_stats table_stats_global;
+
+/**
+ * Returns the table statistics of the context.
+ */
+ws_table_stats *table_stats(ws_context *ctx);
+#endif
+
+/**
+ * Start iterating over the keys of the table.
+ */
+void table_iter_init(ws_table_iter *iter, ws_table *table);
+
+/**
+ * Returns the next key that is in the table, or NULL when there is none. A
+ * key that is added during the iteration might be skipped.
+ */
+ws_val *table_next(ws_context *ctx, ws_table_iter *iter);
+
+/**
+ * Call `fn` for every slot of the table in the context and all of its
+ * ancestors, shadowed slots and deleted keys (with a NULL value) included.
+ */
+void table_each(ws_context *ctx,
+                ws_table *table,
+                void (*fn)(ws_val *key, void *value, void *data),
+                void *data);
+
+/**
+ * Call `fn` for every slot of the overlays of the table in the contexts that
+ * have `gc_reachable` set, starting from the one it was created in, shadowed
+ * slots and deleted keys included.  Every context that can see the table
+ * through a reachable context is covered, the overlays of the other branches
+ * are skipped.
+ */
+void table_each_reachable(ws_table *table,
+                          void (*fn)(ws_val *key, void *value, void *data),
+                          void *data);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef _Q_WS_DOMAIN_
+#define _Q_WS_DOMAIN_
+
+typedef struct _val ws_val;
+typedef struct _context ws_context;
+
+/**
+ * Operations on both concrete and abstract values (ranges, unions and any
+ * string), the result is as precise as the abstract domains allow so that the
+ * VM does not have to fork on every use of an abstract value.
+ *
+ * All of these functions return NULL when the result can not be described,
+ * in that case the VM has to split a union operand into its members.
+ */
+
+/**
+ * Kind of a relational comparison.
+ */
+enum DOMAIN_COMPARE
+{
+  DOMAIN_LT,
+  DOMAIN_LTE,
+  DOMAIN_GT,
+  DOMAIN_GTE
+};
+
+/**
+ * $1 + $2
+ */
+ws_val *domain_add(ws_val *a, ws_val *b);
+
+/**
+ * $1 - $2
+ */
+ws_val *domain_sub(ws_val *a, ws_val *b);
+
+/**
+ * $1 * $2
+ */
+ws_val *domain_mul(ws_val *a, ws_val *b);
+
+/**
+ * -$1
+ */
+ws_val *domain_neg(ws_val *a);
+
+/**
+ * !$1
+ */
+ws_val *domain_not(ws_context *ctx, ws_val *a);
+
+/**
+ * Relational comparison of two numeric values.
+ */
+ws_val *domain_compare(enum DOMAIN_COMPARE op, ws_val *a, ws_val *b);
+
+/**
+ * $1 === $2
+ */
+ws_val *domain_strict_equal(ws_val *a, ws_val *b);
+
+/**
+ * Narrow the value to the members that are truthy (or falsy), used after a
+ * conditional jump on an ambiguous value.
+ */
+ws_val *domain_refine(ws_context *ctx, ws_val *value, int truthy);
+
+/**
+ * Returns true if every value that `b` describes is also described by `a`.
+ */
+int domain_includes(ws_val *a, ws_val *b);
+
+/**
+ * The widening operator, returns a value that includes both `previous` and
+ * `next`.  Bounds of a numeric value that keep growing jump to infinity and
+ * different strings become any string, so a chain of widened values is
+ * always finite.  Returns NULL if the two can not be joined.
+ */
+ws_val *domain_widen(ws_val *previous, ws_val *next);
+
+#endif
@@ -5,12 +5,54 @@ typedef struct _val ws_val;
 typedef struct _function_compiled_data ws_function_compiled_data;
 typedef struct _function ws_function;
 typedef struct _context ws_context;
+typedef struct _trace ws_trace;
 
 /**
  * Execute the code on a context.
  */
 ws_val *exec(ws_context *ctx, ws_function_compiled_data *function);
 
+/**
+ * Continue the execution of `ctx->function` from `ctx->cursor`.
+ *
+ * When the outcome of a conditional jump is ambiguous the context is forked
+ * and NULL is returned, each child has its own cursor and should be resumed
+ * separately.
+ *
+ * NULL is also returned when the context runs out of fuel, in that case the
+ * context is not forked and it can be resumed after refilling `ctx->fuel`.
+ *
+ * And when the branch is subsumed by another one at a loop header
+ * (`ctx->subsumed`), or a builtin threw an error (`ctx->error`), such a
+ * context should not be resumed.
+ */
+ws_val *exec_resume(ws_context *ctx);
+
+/**
+ * Execute the code on a context and follow the branch decisions of a trace
+ * (see trace.h) instead of forking, so a single branch of a fork tree costs
+ * one linear execution.  The context must be in the same state as the root
+ * context of the trace was.
+ *
+ * If the branch forks after the end of the trace the context is forked as
+ * usual and NULL is returned.
+ */
+ws_val *exec_replay(ws_context *ctx,
+                    ws_function_compiled_data *function,
+                    ws_trace *trace);
+
+/**
+ * Returns true if exec_run has a case for the opcode.  The other ones only
+ * print a `TODO` and leave the data stack as it is, so a function that uses
+ * one of them can not skip the stack checks.
+ *
+ * A listed opcode must pop and push what the verifier expects on every
+ * path, or die: a verified function pops without checking, so one value too
+ * few reads a NULL entity.  Leaving more values (a `New` that is not native)
+ * is safe.
+ */
+int exec_implemented(unsigned int bytecode);
+
 /**
  * Call a WS function on the context.
  */
@@ -0,0 +1,47 @@
+#ifndef _Q_WS_GC_
+#define _Q_WS_GC_
+
+typedef struct _val ws_val;
+typedef struct _context_list ws_context_list;
+
+/**
+ * An optional tracing mark-sweep collector, it's enabled by compiling with
+ * WS_TRACING_GC (`cmake -DTRACING_GC=ON`) and replaces the reference counts,
+ * so unlike them it can reclaim cycles.
+ *
+ * The roots are the live contexts: their data stacks and scope chains.  The
+ * mark bit is shared, so a table (a scope, the properties of an object or
+ * the storage copies of an array or a collection) is traced once through the
+ * overlays of every live context and every ancestor of one, whichever
+ * context reaches it first (table_each_reachable).  The overlays of the
+ * finished and dropped branches are never traced, so the values only they
+ * hold are swept and never reached again.  Only values are collected,
+ * contexts, scopes and data stack entities are still owned by the fork tree.
+ *
+ * A collection must only happen at a safepoint: when no context is being
+ * executed, like between two slices of the scheduler.
+ */
+
+/**
+ * Number of allocations between two collections.
+ */
+#define WS_GC_THRESHOLD 65536
+
+/**
+ * Add a newly allocated value to the heap, it's thread-safe.
+ */
+void gc_register(ws_val *value);
+
+/**
+ * Returns true if enough values have been allocated since the last
+ * collection.
+ */
+int gc_should_collect();
+
+/**
+ * Collect all of the values that are not reachable from the given contexts,
+ * returns the number of freed values.
+ */
+unsigned long gc_collect(ws_context_list *live);
+
+#endif
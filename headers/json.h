@@ -0,0 +1,104 @@
+#ifndef _Q_WS_JSON_
+#define _Q_WS_JSON_
+
+#include <stddef.h>
+#include "wval.h"
+
+typedef struct _json_parser ws_json_parser;
+typedef struct _json_frame ws_json_frame;
+typedef struct _json_writer ws_json_writer;
+typedef struct _json_stringifier ws_json_stringifier;
+
+/**
+ * Upper bound of the nesting of arrays and objects for stringify, which
+ * recurses on the C stack.  Parse has no limit.
+ */
+#define WS_JSON_MAX_DEPTH 10000
+
+/**
+ * A growable buffer of code units, stringify writes the text to it and the
+ * parser uses it for the strings that have escapes.
+ */
+struct _json_writer
+{
+  char16_t *data;
+  size_t length;
+  size_t capacity;
+};
+
+/**
+ * An array or object that the parser is in, `key` is the name of the member
+ * that is read next, NULL for an array.
+ */
+struct _json_frame
+{
+  ws_val *container;
+  ws_val *key;
+};
+
+/**
+ * State of JSON.parse: the text, where it's read and the open containers.
+ */
+struct _json_parser
+{
+  ws_context *ctx;
+  const char16_t *data;
+  size_t length;
+  size_t cursor;
+  ws_json_frame *frames;
+  size_t depth;
+  size_t capacity;
+  ws_json_writer scratch;
+};
+
+/**
+ * State of JSON.stringify: the text, the indent and the objects that are
+ * being written (a cycle is an object that is already on the stack).
+ */
+struct _json_stringifier
+{
+  ws_context *ctx;
+  ws_json_writer out;
+  char16_t gap[10];
+  size_t gap_length;
+  unsigned int depth;
+  size_t capacity;
+  ws_obj **stack;
+
+  /**
+   * Write the abstract values and the cycles as strings instead of dying,
+   * see json_describe.
+   */
+  int describe;
+};
+
+/**
+ * JSON.parse: the objects are made right away in the context, arrays with
+ * dense elements.  Throws a syntax error, see context_throw.
+ */
+ws_val *json_parse(ws_context *ctx, ws_val *text);
+
+/**
+ * JSON.stringify: returns the text of the value or undefined if the value
+ * has no text (undefined, a function or a symbol).  `space` is the indent, a
+ * number of spaces or a string, undefined for none.  Throws on a cycle or
+ * a value nested deeper than WS_JSON_MAX_DEPTH.
+ */
+ws_val *json_stringify(ws_context *ctx, ws_val *value, ws_val *space);
+
+/**
+ * The text of JSON.stringify without an indent, but an abstract value is
+ * written as the string `"<abstract>"`, a cycle as `"<cycle>"` and an object
+ * that is nested too deep as `"<deep>"`.  It's how
+ * the result of a branch is printed (see vm/main.c), so it never dies on a
+ * value a script can make.
+ */
+ws_val *json_describe(ws_context *ctx, ws_val *value);
+
+/**
+ * Write the shortest text of the number that reads back to it, as Number's
+ * toString does, to `out` and return the number of code units (at most 25).
+ */
+size_t json_number(double number, char16_t *out);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef _Q_WS_LOADER_
+#define _Q_WS_LOADER_
+
+#include "compiler.h"
+
+typedef struct _bundle ws_bundle;
+
+/**
+ * A set of compiled functions that are written to a file by the compiler,
+ * see `jsc/diff.ts`. All the numbers are little-endian:
+ *
+ *   "WSC1"         Magic.
+ *   u32            Number of functions, the first one is the main function.
+ *   u32            Id of the second function, the rest are consecutive.
+ *   For each function:
+ *     u32 × 4      Sizes of the code, constant pool, scope and map sections.
+ *     ...          The sections.
+ *
+ * A batch of scripts (see `jsc/batch.ts`) shares one constant pool, so every
+ * string is stored once in the whole bundle:
+ *
+ *   "WSC2"         Magic.
+ *   u32            Number of functions, the first ones are the main functions
+ *                  of the scripts in order.
+ *   u32            Number of scripts.
+ *   u32            Id of the first function after the main functions, the rest
+ *                  are consecutive.
+ *   u32            Size of the constant pool.
+ *   ...            The constant pool.
+ *   For each function:
+ *     u32 × 3      Sizes of the code, scope and map sections.
+ *     ...          The sections.
+ */
+struct _bundle
+{
+  /**
+   * Number of functions.
+   */
+  unsigned int size;
+
+  /**
+   * Number of scripts, functions[0..scripts) are their main functions.
+   */
+  unsigned int scripts;
+
+  /**
+   * Compiler id of functions[scripts].
+   */
+  unsigned int base_id;
+
+  /**
+   * The constant pool that is shared by all the functions, only in version 2.
+   */
+  uint8_t *constant_pool;
+  size_t constant_pool_size;
+
+  /**
+   * The compiled functions.
+   */
+  ws_function_compiled_data **functions;
+};
+
+/**
+ * Load a bundle from the file, dies if the file is not a valid bundle or a
+ * function does not pass verify_function.
+ */
+ws_bundle *load_bundle(char *path);
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef _Q_WS_OBJECT_
+#define _Q_WS_OBJECT_
+
+#include "wval.h"
+
+typedef struct _proto_cache_entry ws_proto_cache_entry;
+
+/**
+ * Number of entries in the prototype lookup cache of each thread, it must be
+ * a power of two.
+ */
+#define WS_PROTO_CACHE_SIZE 1024
+
+/**
+ * Looking up a key that is not an own property walks the prototype chain and
+ * every hop is a table_get over the context chain.  The cache remembers where
+ * a lookup that started at a prototype found the key, so objects that share
+ * a prototype share the entry.
+ *
+ * Every context counts the writes to prototypes (`proto_version`) that were
+ * made in it and its ancestors, a child starts with the count of its parent.
+ * An entry is used by the context that made it and its descendants as long
+ * as their count is the same as the one in the entry, so a write to any
+ * prototype on the path invalidates it while writes in other branches don't.
+ */
+struct _proto_cache_entry
+{
+  /**
+   * Id of the properties table of the prototype the lookup started at.
+   */
+  unsigned int table;
+
+  /**
+   * The key, compared by its address.
+   */
+  ws_val *key;
+
+  /**
+   * The object on the chain that has the key and the value, both are NULL
+   * if none of them has the key.
+   */
+  ws_obj *holder;
+  ws_val *value;
+
+  /**
+   * Id of the context that did the lookup and its `proto_version` then.
+   */
+  unsigned int ctx;
+  unsigned long version;
+
+  /**
+   * Value of proto_cache_epoch when the entry was filled.
+   */
+  unsigned long epoch;
+};
+
+/**
+ * The state of a for-in loop over an object: the elements of an array come
+ * first, then the properties in the order they were added and then the same
+ * for each prototype.  A key that an object before it on the chain has is
+ * skipped.  Nothing is allocated per step except the keys of the elements
+ * past the shared ones (see array_index_key).
+ *
+ * Like the elements of an array, an iterator is advanced in place by the
+ * context that made it and a forked child copies it on its first step.
+ */
+struct _obj_iter
+{
+  /**
+   * Id of the context that can advance this iterator in place.
+   */
+  unsigned int owner;
+
+  /**
+   * The value that is enumerated.
+   */
+  ws_val *target;
+
+  /**
+   * The object on the prototype chain whose keys are walked, NULL once all
+   * of the keys are seen.
+   */
+  ws_obj *object;
+
+  /**
+   * The next element of the object if it's an array.
+   */
+  size_t index;
+
+  /**
+   * The next property of the object.
+   */
+  ws_table_iter keys;
+};
+
+/**
+ * Bumped to drop every entry of the caches, the collector does it as it may
+ * free the keys and the values.
+ */
+extern atomic_ulong proto_cache_epoch;
+
+/**
+ * [[Get]] of an own or inherited data property, returns NULL if the object
+ * and its prototypes don't have the key.
+ */
+ws_val *object_get(ws_context *ctx, ws_val *object, ws_val *key);
+
+/**
+ * Set an own property of the object.
+ */
+void object_set(ws_context *ctx, ws_val *object, ws_val *key, ws_val *value);
+
+/**
+ * Create an iterator over the enumerable keys of the value, a value that is
+ * not an object has no keys.
+ */
+ws_val *object_iterator(ws_context *ctx, ws_val *value);
+
+/**
+ * Returns an iterator with the same state that the context can advance, the
+ * given one if it was made by the context.
+ */
+ws_val *object_iterator_own(ws_context *ctx, ws_val *iterator);
+
+/**
+ * Returns the next key of the iterator or NULL when there is none.
+ */
+ws_val *object_next(ws_context *ctx, ws_obj_iter *iter);
+
+/**
+ * Drop all the entries of the prototype lookup caches.
+ */
+void object_cache_clear();
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef _Q_WS_OUTPUT_
+#define _Q_WS_OUTPUT_
+
+#include <stddef.h>
+
+typedef struct _val ws_val;
+typedef struct _context ws_context;
+typedef struct _context_list ws_context_list;
+
+typedef struct _output_chunk ws_output_chunk;
+
+/**
+ * Minimum capacity of a chunk, small writes of a context are appended to its
+ * last chunk as long as it has room.
+ */
+#define WS_OUTPUT_CHUNK_SIZE 256
+
+/**
+ * The output of a context is an append-only list of UTF-8 chunks, the list
+ * is linked backward so a forked child shares all the chunks of its
+ * ancestors and only owns the ones it writes after the fork.
+ *
+ * Nothing is shared between two contexts that are running, so writing does
+ * not take any lock.
+ */
+struct _output_chunk
+{
+  /**
+   * The previous chunk, NULL for the first one.
+   */
+  ws_output_chunk *prev;
+
+  /**
+   * The context that created this chunk, only this context can append to
+   * the chunk and only until it's forked.
+   */
+  ws_context *owner;
+
+  /**
+   * Number of chunks in the list up to and including this one.
+   */
+  unsigned int count;
+
+  /**
+   * Size of the data and the allocated capacity in bytes.
+   */
+  size_t size;
+  size_t capacity;
+
+  /**
+   * Size of the whole output up to and including this chunk.
+   */
+  size_t total;
+
+  /**
+   * FNV-1a hash of the whole output up to and including this chunk.
+   */
+  unsigned long hash;
+
+  /**
+   * The UTF-8 data.
+   */
+  char data[];
+};
+
+/**
+ * Append raw UTF-8 data to the output of the context.
+ */
+void output_write(ws_context *ctx, const char *data, size_t size);
+
+/**
+ * Append a string value to the output of the context, used by `ws.write`.
+ */
+void output_write_value(ws_context *ctx, ws_val *value);
+
+/**
+ * Returns true if the two contexts have written the same output.
+ */
+int output_equal(ws_context *a, ws_context *b);
+
+/**
+ * Returns the distinct outputs of the contexts in the order of their first
+ * appearance, identical ones (by hash and then by content) are kept once.
+ * The array is allocated with ws_alloc and `count` is set to its size.
+ */
+ws_output_chunk **output_distinct(ws_context_list *contexts, unsigned int *count);
+
+/**
+ * Number of bytes output_merge writes for the contexts.
+ */
+size_t output_merged_size(ws_context_list *contexts);
+
+/**
+ * Write the output of the contexts to a file descriptor with writev, the
+ * chunks are not copied.  Identical outputs (by hash and then by content)
+ * are written only once, in the order of their first appearance.  Returns
+ * the number of distinct non-empty outputs.
+ */
+unsigned int output_merge(ws_context_list *contexts, int fd);
+
+#endif
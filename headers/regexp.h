@@ -0,0 +1,222 @@
+#ifndef _Q_WS_REGEXP_
+#define _Q_WS_REGEXP_
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include "wval.h"
+
+typedef struct _regexp ws_regexp;
+typedef struct _regexp_inst ws_regexp_inst;
+typedef struct _regexp_class ws_regexp_class;
+typedef struct _regexp_dfa_state ws_regexp_dfa_state;
+
+/**
+ * Flags of a RegExp.
+ */
+enum WS_REGEXP_FLAG
+{
+  WS_REGEXP_GLOBAL = 1,
+  WS_REGEXP_IGNORE_CASE = 2,
+  WS_REGEXP_MULTILINE = 4,
+  WS_REGEXP_DOT_ALL = 8,
+  WS_REGEXP_UNICODE = 16,
+  WS_REGEXP_STICKY = 32
+};
+
+/**
+ * Instructions of a compiled pattern.
+ */
+enum WS_REGEXP_OP
+{
+  /**
+   * Match the code unit `x` (case folded with the `i` flag).
+   */
+  WS_REGEXP_CHAR,
+
+  /**
+   * Match any code unit, but a line terminator without the `s` flag.
+   */
+  WS_REGEXP_ANY,
+
+  /**
+   * Match a code unit of the class number `x`.
+   */
+  WS_REGEXP_CLASS,
+
+  /**
+   * Continue at `x`, and at `y` if that fails.
+   */
+  WS_REGEXP_SPLIT,
+  WS_REGEXP_JMP,
+
+  /**
+   * Store the position in the capture slot `x`: a group `n` has the slots
+   * `2n` and `2n + 1`.
+   */
+  WS_REGEXP_SAVE,
+
+  /**
+   * Clear the capture slots from `x` up to `y`, the groups of a quantified
+   * atom are undefined again at the start of each iteration.
+   */
+  WS_REGEXP_RESET,
+
+  /**
+   * Assertions: `^`, `$`, `\b` and `\B`.
+   */
+  WS_REGEXP_BOL,
+  WS_REGEXP_EOL,
+  WS_REGEXP_WORD,
+  WS_REGEXP_NOT_WORD,
+
+  /**
+   * Match the text of the group `x` again.
+   */
+  WS_REGEXP_BACKREF,
+
+  /**
+   * A lookahead: the pattern after this instruction up to its `MATCH` must
+   * (or with `x` set, must not) match here, then continue at `y`.
+   */
+  WS_REGEXP_LOOK,
+
+  /**
+   * Store the position in the register `x`, and fail if it didn't move
+   * since.  They wrap the body of a loop that can match the empty string,
+   * so it's not repeated forever.
+   */
+  WS_REGEXP_MARK,
+  WS_REGEXP_CHECK,
+
+  WS_REGEXP_MATCH
+};
+
+struct _regexp_inst
+{
+  enum WS_REGEXP_OP op;
+  unsigned int x;
+  unsigned int y;
+};
+
+/**
+ * A character class: sorted ranges of code units, both ends included.
+ */
+struct _regexp_class
+{
+  int negated;
+  size_t size;
+  char16_t (*ranges)[2];
+};
+
+/**
+ * The DFA states are made while the text is matched, the transitions on
+ * ASCII code units are cached in the state.
+ */
+#define WS_REGEXP_DFA_ALPHABET 128
+
+/**
+ * A state of the DFA: the instructions that the threads of the NFA are at
+ * and what there was before the current position (the assertions need it).
+ */
+struct _regexp_dfa_state
+{
+  unsigned int *pcs;
+  size_t size;
+  int context;
+  unsigned long hash;
+  ws_regexp_dfa_state *chain;
+  ws_regexp_dfa_state *_Atomic next[WS_REGEXP_DFA_ALPHABET];
+};
+
+/**
+ * A compiled pattern.  It's never changed after it's compiled (but for the
+ * DFA cache, which has a lock of its own) and never freed, so it's shared
+ * by all of the threads and all of the contexts.
+ *
+ * Patterns without backreferences and lookaheads are tested with a lazily
+ * built DFA, the others and the ones that need the captures (`exec`) run on
+ * a backtracking matcher.  `exec` still runs the DFA first when it can, so
+ * most of the texts that don't match never backtrack.
+ */
+struct _regexp
+{
+  /**
+   * The source and the flags it was compiled with.
+   */
+  char16_t *pattern;
+  size_t length;
+  int flags;
+
+  /**
+   * Number of groups, the whole match (group 0) included, and the number
+   * of loop registers.
+   */
+  unsigned int groups;
+  unsigned int registers;
+
+  ws_regexp_inst *code;
+  size_t code_size;
+
+  ws_regexp_class *classes;
+  size_t classes_size;
+
+  /**
+   * Whether the DFA can be used, it's cleared if the DFA grows too big.
+   */
+  atomic_int dfa;
+  atomic_flag dfa_lock;
+  ws_regexp_dfa_state **dfa_buckets;
+  size_t dfa_size;
+  ws_regexp_dfa_state *_Atomic dfa_start[8];
+
+  /**
+   * Next pattern in the same bucket of the cache.
+   */
+  ws_regexp *next;
+};
+
+/**
+ * The `lastIndex` key, a RegExp keeps it in its properties.
+ */
+ws_val WS_REGEXP_LAST_INDEX;
+
+/**
+ * Returns the flags of a RegExp for their source (like "gi"), or -1 if one
+ * is not known or is repeated.
+ */
+int regexp_flags(const char16_t *flags, size_t length);
+
+/**
+ * Returns the compiled pattern, a pattern is compiled once for all of the
+ * threads and is kept in a cache.  Dies on a syntax error.
+ */
+ws_regexp *regexp_compile(const char16_t *pattern, size_t length, int flags);
+
+/**
+ * Returns true if the pattern matches the input at or after `start` (only
+ * at `start` for a sticky one).
+ */
+int regexp_test(ws_regexp *regexp, const char16_t *input, size_t length, size_t start);
+
+/**
+ * Like regexp_test, but it also sets the `2 * groups` capture positions (-1
+ * for a group that didn't match), the first two are the bounds of the match.
+ */
+int regexp_exec(ws_regexp *regexp,
+                const char16_t *input,
+                size_t length,
+                size_t start,
+                long *captures);
+
+/**
+ * Create a RegExp object of the compiled pattern, it has a `lastIndex`.
+ */
+ws_val *ws_regexp_object(ws_context *ctx, ws_regexp *regexp);
+
+/**
+ * Create a RegExp object for the operand of `RegExp`: the literal as it is
+ * written, `/pattern/flags`.
+ */
+ws_val *ws_regexp_literal(ws_context *ctx, ws_val *literal);
+
+#endif
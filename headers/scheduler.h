@@ -0,0 +1,67 @@
+#ifndef _Q_WS_SCHEDULER_
+#define _Q_WS_SCHEDULER_
+
+typedef struct _val ws_val;
+typedef struct _context ws_context;
+typedef struct _context_list ws_context_list;
+
+typedef struct _scheduler ws_scheduler;
+
+/**
+ * Called when a branch finishes its execution with the returned value, with
+ * the tracing collector the value is only valid until the next step.  The
+ * value is NULL if the branch threw an error (`ctx->error`).
+ */
+typedef void (*ws_scheduler_callback)(ws_context *ctx, ws_val *value);
+
+/**
+ * A round-robin scheduler for the branches, each branch runs until it either
+ * forks, finishes or uses all of its fuel, so a branch in an infinite loop
+ * can not stall the others.
+ */
+struct _scheduler
+{
+  /**
+   * Amount of fuel given to a branch each time it's resumed.
+   */
+  long slice;
+
+  /**
+   * Head of the run queue.
+   */
+  ws_context_list *head;
+
+  /**
+   * Tail of the run queue, new branches are added here.
+   */
+  ws_context_list *tail;
+};
+
+/**
+ * Create a new scheduler with the given time slice.
+ */
+ws_scheduler *scheduler_create(long slice);
+
+/**
+ * Free the scheduler, the queued contexts are not released.
+ */
+void scheduler_destroy(ws_scheduler *scheduler);
+
+/**
+ * Add a context to the end of the run queue, the context must be ready to be
+ * resumed (`ctx->function` and `ctx->cursor` are set).
+ */
+void scheduler_add(ws_scheduler *scheduler, ws_context *ctx);
+
+/**
+ * Run one slice of the first branch in the queue, returns false if the queue
+ * is empty.
+ */
+int scheduler_step(ws_scheduler *scheduler, ws_scheduler_callback callback);
+
+/**
+ * Run all of the branches until the queue is empty.
+ */
+void scheduler_run(ws_scheduler *scheduler, ws_scheduler_callback callback);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef _Q_WS_TRACE_
+#define _Q_WS_TRACE_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct _context ws_context;
+
+typedef struct _trace ws_trace;
+
+/**
+ * The branch decisions that lead from the root context to a branch, one for
+ * each fork on the way.  A decision is the cursor of the context when it was
+ * forked and the index of the child that was taken, encoded as an unsigned
+ * LEB128 varint of `cursor << 2 | min(index, 3)` followed by another varint
+ * of `index - 3` when the index is larger than 2.  So a usual decision takes
+ * two bytes.
+ */
+struct _trace
+{
+  /**
+   * Number of decisions.
+   */
+  unsigned int length;
+
+  /**
+   * Size of the encoded data in bytes.
+   */
+  size_t size;
+
+  /**
+   * Read position of trace_next.
+   */
+  size_t position;
+
+  /**
+   * The encoded decisions.
+   */
+  uint8_t *data;
+};
+
+/**
+ * Create the trace of a context from the fork tree, the trace is computed on
+ * demand so recording a trace does not cost anything.
+ */
+ws_trace *trace_create(ws_context *ctx);
+
+/**
+ * Create a trace from encoded data, for example a trace that was saved to a
+ * file, the data is copied.
+ */
+ws_trace *trace_from_data(uint8_t *data, size_t size);
+
+/**
+ * Free the trace.
+ */
+void trace_destroy(ws_trace *trace);
+
+/**
+ * Read the next decision, returns false at the end of the trace.
+ */
+int trace_next(ws_trace *trace, unsigned long *cursor, unsigned int *index);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef _Q_WS_VERIFIER_
+#define _Q_WS_VERIFIER_
+
+#include <stddef.h>
+
+typedef struct _function_compiled_data ws_function_compiled_data;
+
+typedef struct _verify_result ws_verify_result;
+
+/**
+ * Outcome of verify_function.
+ */
+struct _verify_result
+{
+  /**
+   * NULL if the function is valid, otherwise what is wrong with it.
+   */
+  const char *error;
+
+  /**
+   * Offset of the instruction that is wrong.
+   */
+  size_t offset;
+
+  /**
+   * Maximum number of values the function has on the data stack.
+   */
+  unsigned int max_stack;
+};
+
+/**
+ * Check the compiled data of a function once, before it's executed:
+ *
+ *  - Every instruction is a known opcode and its argument is in the code.
+ *  - Jump targets (including the ones in switch tables and the join of a
+ *    diamond) are instruction boundaries.
+ *  - The strings and switch tables referenced by the code are in the
+ *    constant pool.
+ *  - The data stack never underflows and has the same depth on every path
+ *    that reaches an instruction, the function starts with an empty stack.
+ *
+ * On success `function->verified` and `function->max_stack` are set, so the
+ * interpreter can skip the checks it does on every instruction, unless the
+ * function reaches an opcode that exec_run doesn't implement (see
+ * exec_implemented).  Returns false if the function is invalid, see
+ * `result->error`.
+ */
+int verify_function(ws_function_compiled_data *function, ws_verify_result *result);
+
+#endif
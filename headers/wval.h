@@ -6,6 +6,18 @@
 typedef struct _obj ws_obj;
 typedef struct _property_descriptor ws_obj_property_descriptor;
 typedef struct _val ws_val;
+typedef struct _elements ws_elements;
+typedef struct _obj_iter ws_obj_iter;
+typedef struct _collection ws_collection;
+typedef struct _buffer ws_buffer;
+typedef struct _typed_array ws_typed_array;
+typedef struct _regexp ws_regexp;
+
+/**
+ * A function that is implemented in C, `self` is the object that the method
+ * was read from (NULL for a plain function) and there are `argc` arguments.
+ */
+typedef ws_val *(*ws_native)(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc);
 
 /**
  * An objects property descriptor.
@@ -55,22 +67,69 @@ struct _obj
   /**
    * [Call] internal slot.
    */
-  struct _wfunction *call;
+  ws_function *call;
 
   /**
    * [Construct] internal slot.
    */
-  struct _wfunction *construct;
+  ws_function *construct;
 
   /**
    * Object parent.
    */
   struct _obj *proto;
 
+  /**
+   * Whatever another object has this one as its prototype, writes to a
+   * prototype invalidate the lookup caches, see object.h.
+   */
+  int is_proto;
+
   /**
    * Maps property keys to property descriptors.
    */
   ws_table properties;
+
+  /**
+   * Element storage of an array in the context it was created in, NULL for
+   * the other objects, see array.h.
+   */
+  ws_elements *elements;
+
+  /**
+   * Entries of a Map or a Set in the context it was created in, NULL for the
+   * other objects, see collection.h.
+   */
+  ws_collection *collection;
+
+  /**
+   * Pages of an ArrayBuffer in the context it was created in, NULL for the
+   * other objects, see buffer.h.
+   */
+  ws_buffer *buffer;
+
+  /**
+   * The view of a typed array, NULL for the other objects.
+   */
+  ws_typed_array *typed;
+
+  /**
+   * The compiled pattern of a RegExp, NULL for the other objects, see
+   * regexp.h.
+   */
+  ws_regexp *regexp;
+
+  /**
+   * The storage of the forked contexts that wrote to the array, the
+   * collection or the buffer, only initialized for them.
+   */
+  ws_table copies;
+
+  /**
+   * A native function and the object it's bound to, see builtins.h.
+   */
+  ws_native native;
+  ws_val *self;
 };
 
 /**
@@ -111,9 +170,36 @@ enum WVAL_TYPE
   /**
    * A unique symbol.
    */
-  WVAL_TYPE_SYMBOL
+  WVAL_TYPE_SYMBOL,
+
+  /**
+   * An abstract value: any number in a closed interval.
+   */
+  WVAL_TYPE_RANGE,
+
+  /**
+   * An abstract value: one of a small set of values, which are never unions.
+   */
+  WVAL_TYPE_UNION,
+
+  /**
+   * An abstract value: any string.
+   */
+  WVAL_TYPE_ANY_STRING,
+
+  /**
+   * The state of a for-in loop, it only lives on the data stack and it's
+   * never visible to the scripts.
+   */
+  WVAL_TYPE_ITERATOR
 };
 
+/**
+ * Maximum number of members in a union, larger unions are widened to a range
+ * or to any string when possible.
+ */
+#define WS_UNION_MAX_SIZE 16
+
 /**
  * WVal is data type that can represent any JavaScript primitive value and
  * object.
@@ -132,6 +218,18 @@ struct _val
    */
   atomic_uint ref_count;
 
+#ifdef WS_TRACING_GC
+  /**
+   * Set by the tracing collector on the reachable values.
+   */
+  int marked;
+
+  /**
+   * Next value in the list of all the allocated values, see gc.h.
+   */
+  ws_val *gc_next;
+#endif
+
   /**
    * Internal data for this value.
    */
@@ -143,6 +241,10 @@ struct _val
 
     /**
      * A non zero-terminated string.
+     *
+     * A string might be a rope: a concatenation of two other strings that is
+     * only flattened to a buffer the first time the raw data is needed, see
+     * ws_string_flatten. Ropes are immutable and can be shared between forks.
      */
     struct
     {
@@ -152,9 +254,27 @@ struct _val
       size_t size;
 
       /**
-       * A pointer to the raw data.
+       * A pointer to the raw data, for a rope it is null until the rope is
+       * flattened. Use ws_string_flatten to read it.
+       */
+      char16_t *_Atomic data;
+
+      /**
+       * Left side of the concatenation if this string is a rope.
+       */
+      ws_val *left;
+
+      /**
+       * Right side of the concatenation if this string is a rope.
+       */
+      ws_val *right;
+
+      /**
+       * Whatever the value owns the buffer, only a flattened rope does.  A
+       * rope lets go of its sides once it's flattened, so this can't be
+       * told from them.
        */
-      char16_t *data;
+      int owns_data;
     } string;
 
     /**
@@ -182,6 +302,43 @@ struct _val
      * Pointer to a wval object.
      */
     ws_obj *object;
+
+    /**
+     * Bounds of a numeric range, both ends are inclusive.
+     */
+    struct
+    {
+      /**
+       * The lower bound.
+       */
+      double min;
+
+      /**
+       * The upper bound.
+       */
+      double max;
+    } range;
+
+    /**
+     * Members of a union.
+     */
+    struct
+    {
+      /**
+       * Number of members.
+       */
+      unsigned int size;
+
+      /**
+       * The members, all of them are retained by the union.
+       */
+      ws_val **values;
+    } set;
+
+    /**
+     * State of a for-in loop, see object.h.
+     */
+    ws_obj_iter *iterator;
   } data;
 };
 
@@ -220,6 +377,21 @@ ws_val WS_ONE;
  */
 ws_val WS_TWO;
 
+/**
+ * Either true or false, to be used in the VM.
+ */
+ws_val WS_ANY_BOOLEAN;
+
+/**
+ * Any string, to be used in the VM.
+ */
+ws_val WS_ANY_STRING;
+
+#ifdef WS_TRACING_GC
+// The tracing collector does not need the reference counts.
+#define wval_retain(value) ((void)(value))
+#define wval_release(value) ((void)(value))
+#else
 /**
  * Retain a wval - increment ref_count.
  */
@@ -229,6 +401,13 @@ void wval_retain(ws_val *value);
  * Release a wval - decrement ref_count.
  */
 void wval_release(ws_val *value);
+#endif
+
+/**
+ * Allocate a new value, all the values must be allocated using this function
+ * so the tracing collector knows about them.
+ */
+ws_val *wval_alloc();
 
 /**
  * Check if two WaterScript values are equal.
@@ -240,6 +419,17 @@ int wval_strict_equal(ws_val *v1, ws_val *v2);
  */
 ws_val *ws_string(char16_t *data, size_t size);
 
+/**
+ * Concatenate two WaterScript strings, the result is a rope unless it's short
+ * enough to be copied right away.
+ */
+ws_val *ws_string_concat(ws_val *left, ws_val *right);
+
+/**
+ * Return the raw data of a string, flattening it first if it's a rope.
+ */
+char16_t *ws_string_flatten(ws_val *string);
+
 /**
  * Create a WaterScript symbol.
  */
@@ -250,11 +440,39 @@ ws_val *ws_symbol(ws_val *description);
  */
 ws_val *ws_number(double value);
 
+/**
+ * Create a new numeric range, if min and max are equal a number is returned.
+ */
+ws_val *ws_range(double min, double max);
+
+/**
+ * Create a union of the given values, nested unions are flattened and
+ * duplicates are removed. If there is only one member, it is returned as is.
+ * Returns NULL if the union is larger than WS_UNION_MAX_SIZE and it can not be
+ * widened.
+ */
+ws_val *ws_union(ws_val **values, unsigned int size);
+
+/**
+ * Returns true if the value is abstract (a range, a union or any string).
+ */
+int wval_is_abstract(ws_val *value);
+
 /**
  * Create a new WaterScript object value in the context.
  */
 ws_val *ws_object(ws_context *ctx, ws_val *proto);
 
+/**
+ * Create a function object, an object with the [Call] internal slot.
+ */
+ws_val *ws_function_object(ws_context *ctx, ws_function *function);
+
+/**
+ * Create a native function object, `self` is passed to every call.
+ */
+ws_val *ws_native_object(ws_context *ctx, ws_native native, ws_val *self);
+
 /**
  * Convert a WaterScript value to a primitive value.
  */
@@ -0,0 +1,135 @@
+/**
+ *    ____ _   _ _____
+ *   /___ \ |_(_)___ /  ___
+ *  //  / / __| | |_ \ / _ \
+ * / \_/ /| |_| |___) |  __/
+ * \___,_\ \__|_|____/ \___|
+ */
+
+import "./src/buffer.polyfill";
+import * as fs from "fs";
+import * as os from "os";
+import { isMainThread, parentPort, Worker } from "worker_threads";
+import { Compiler } from "./src/compiler";
+import { CompiledBytes, fromBytes, linkScripts, toBytes } from "./src/link";
+
+// Run this file like:
+// TS_NODE_FILES=true node -r ts-node/register batch.ts [--jobs N] out.wsc a.js b.js ...
+// Parsing and code generation of the scripts are spread over worker threads,
+// then the main thread links them into one bundle (see `src/link.ts`).
+// Workers inherit the `-r ts-node/register` flag, so don't use the ts-node
+// binary.
+
+type Request = {
+  index: number;
+  file: string;
+};
+
+type Response = {
+  index: number;
+  functions?: CompiledBytes[];
+  error?: string;
+};
+
+function compileFile(file: string): CompiledBytes[] {
+  const compiler = new Compiler();
+  const functions = [compiler.compile(fs.readFileSync(file, "utf-8"))];
+  for (let i = 1; i <= compiler.lastFunctionId; ++i) {
+    functions.push(compiler.requestCompile(i));
+  }
+  return functions.map(toBytes);
+}
+
+function worker(): void {
+  parentPort!.on("message", (request: Request) => {
+    let functions: CompiledBytes[];
+    try {
+      functions = compileFile(request.file);
+    } catch (e) {
+      const response: Response = { index: request.index, error: String(e) };
+      parentPort!.postMessage(response);
+      return;
+    }
+
+    // Move the sections instead of copying them.
+    const transfer: ArrayBuffer[] = [];
+    for (const data of functions) {
+      transfer.push(
+        data.codeSection.buffer,
+        data.constantPool.buffer,
+        data.scope.buffer,
+        data.mapSection.buffer
+      );
+    }
+
+    const response: Response = { index: request.index, functions };
+    parentPort!.postMessage(response, transfer);
+  });
+}
+
+function main(): void {
+  const args = process.argv.slice(2);
+  let jobs = os.cpus().length;
+  if (args[0] === "--jobs") {
+    jobs = Number(args[1]);
+    args.splice(0, 2);
+  }
+
+  const [output, ...files] = args;
+  if (!output || files.length === 0 || !(jobs > 0)) {
+    console.error("Usage: batch.ts [--jobs N] <output> <files...>");
+    process.exit(1);
+  }
+
+  const start = Date.now();
+  const scripts: CompiledBytes[][] = new Array(files.length);
+  const workers: Worker[] = [];
+  let next = 0;
+  let done = 0;
+
+  // Every worker gets a new file when it's done with the previous one, so a
+  // few large files don't keep the other workers waiting.
+  const send = (worker: Worker) => {
+    if (next < files.length) {
+      const request: Request = { index: next, file: files[next++] };
+      worker.postMessage(request);
+    } else {
+      worker.terminate();
+    }
+  };
+
+  const finish = () => {
+    const bundle = linkScripts(scripts.map(script => script.map(fromBytes)));
+    const u8 = new Uint8Array(bundle.size);
+    for (let i = 0; i < bundle.size; ++i) u8[i] = bundle.get(i);
+    fs.writeFileSync(output, u8);
+
+    const functions = scripts.reduce((sum, script) => sum + script.length, 0);
+    console.log(
+      `${files.length} scripts, ${functions} functions, ${u8.length} bytes ` +
+        `in ${Date.now() - start}ms (${workers.length} workers).`
+    );
+  };
+
+  for (let i = 0; i < Math.min(jobs, files.length); ++i) {
+    const worker = new Worker(__filename);
+    worker.on("message", (response: Response) => {
+      if (response.error !== undefined) {
+        console.error(`${files[response.index]}: ${response.error}`);
+        process.exit(1);
+      }
+
+      scripts[response.index] = response.functions!;
+      if (++done === files.length) finish();
+      send(worker);
+    });
+    workers.push(worker);
+    send(worker);
+  }
+}
+
+if (isMainThread) {
+  main();
+} else {
+  worker();
+}
@@ -134,6 +134,10 @@ ws_function_compiled_data *get_compiled_data(int id)
   compiled_data->constant_pool_offset = info.constant_pool_offset - start;
   compiled_data->scope_offset = info.scope_offset - start;
   compiled_data->map_offset = info.map_offset - start;
+  compiled_data->constant_pool =
+      compiled_data->data + compiled_data->constant_pool_offset;
+  compiled_data->constant_pool_size =
+      compiled_data->scope_offset - compiled_data->constant_pool_offset;
 
   for (unsigned long i = 0; i < info.size; ++i)
     compiled_data->data[i] = data[i];
@@ -0,0 +1,267 @@
+/**
+ *    ____ _   _ _____
+ *   /___ \ |_(_)___ /  ___
+ *  //  / / __| | |_ \ / _ \
+ * / \_/ /| |_| |___) |  __/
+ * \___,_\ \__|_|____/ \___|
+ */
+
+import "./src/buffer.polyfill";
+import { spawnSync } from "child_process";
+import * as fs from "fs";
+import * as os from "os";
+import * as path from "path";
+import { CompiledData } from "./src/compiler";
+import { compiler } from "./vm/compiler";
+import { VM } from "./vm/vm";
+import { toJSValue } from "./vm/data";
+import { timer } from "./vm/timer";
+import { collectPrograms, TestProgram } from "./test/util";
+
+// Run this file like:
+// TS_NODE_FILES=true ts-node diff.ts ../build/bin/ws
+// Every program of the test suite is compiled once and then executed on both
+// the reference VM (./vm) and the C VM, the results are compared and a table
+// of the timings is printed.
+
+type Result = {
+  // Values of the finished branches, the reference VM never forks.
+  values: any[];
+  error?: string;
+  timeMs: number;
+  instructions: number;
+  peakBytes: number;
+};
+
+// Write the bundle format described in `headers/loader.h`.
+function writeBundle(file: string, functions: CompiledData[], baseId: number) {
+  const sections = (data: CompiledData) => [
+    data.codeSection,
+    data.constantPool,
+    data.scope,
+    data.mapSection
+  ];
+
+  let size = 12;
+  for (const data of functions) {
+    for (const section of sections(data)) size += 4 + section.size;
+  }
+
+  const u8 = new Uint8Array(size);
+  const view = new DataView(u8.buffer);
+  let cursor = 0;
+
+  const u32 = (n: number) => {
+    view.setUint32(cursor, n, true);
+    cursor += 4;
+  };
+
+  u8.set([0x57, 0x53, 0x43, 0x31]);
+  cursor = 4;
+  u32(functions.length);
+  u32(baseId);
+
+  for (const data of functions) {
+    for (const section of sections(data)) u32(section.size);
+    for (const section of sections(data)) {
+      for (let i = 0; i < section.size; ++i) u8[cursor++] = section.get(i);
+    }
+  }
+
+  fs.writeFileSync(file, u8);
+}
+
+async function runReference(
+  main: CompiledData,
+  timeout: number
+): Promise<Result> {
+  const vm = new VM({ timeout });
+  const start = process.hrtime.bigint();
+  let values: any[] = [];
+  let error: string | undefined;
+
+  try {
+    values = [toJSValue(await vm.exec(main))];
+  } catch (e) {
+    error = String(e && e.message ? e.message : e);
+  }
+
+  const end = process.hrtime.bigint();
+  timer.sampleHeap();
+
+  return {
+    values,
+    error,
+    timeMs: Number(end - start) / 1e6,
+    instructions: timer.instructions,
+    peakBytes: timer.peakHeap
+  };
+}
+
+function runNative(binary: string, file: string, timeout: number): Result {
+  const result: Result = {
+    values: [],
+    timeMs: 0,
+    instructions: 0,
+    peakBytes: 0
+  };
+
+  const child = spawnSync(binary, [file, String(timeout)], {
+    encoding: "utf8",
+    timeout: timeout + 5000
+  });
+
+  if (child.error) {
+    result.error = child.error.message;
+    return result;
+  }
+
+  // The output of the script follows the `output <bytes>` line, it's not
+  // parsed.
+  lines: for (const line of child.stdout.split("\n")) {
+    const [key, ...rest] = line.split(" ");
+    switch (key) {
+      case "output":
+        break lines;
+      case "branch":
+        result.values.push(parseValue(rest.slice(1).join(" ")));
+        break;
+      case "error":
+        result.error = rest.slice(1).join(" ");
+        break;
+      case "timeout":
+        result.error = "timeout";
+        break;
+      case "instructions":
+        result.instructions = Number(rest[0]);
+        break;
+      case "time_ns":
+        result.timeMs = Number(rest[0]) / 1e6;
+        break;
+      case "peak_bytes":
+        result.peakBytes = Number(rest[0]);
+        break;
+    }
+  }
+
+  if (child.status !== 0) {
+    const stderr = child.stderr.trim().split("\n").pop();
+    result.error = stderr || `exit code ${child.status}`;
+  }
+
+  return result;
+}
+
+// Inverse of `run_print_value` in `vm/main.c`.
+function parseValue(text: string): any {
+  if (text === "undefined") return undefined;
+  const value = JSON.parse(text);
+  switch (value) {
+    case "<NaN>":
+      return NaN;
+    case "<Infinity>":
+      return Infinity;
+    case "<-Infinity>":
+      return -Infinity;
+  }
+  return value;
+}
+
+function sameValue(a: any, b: any): boolean {
+  if (a !== a && b !== b) return true;
+  if (typeof a === "object" && typeof b === "object") {
+    return JSON.stringify(a) === JSON.stringify(b);
+  }
+  return a === b;
+}
+
+function status(ts: Result, c: Result): string {
+  if (ts.error && c.error) return "both failed";
+  if (c.error) return "C: " + c.error;
+  if (ts.error) return "TS: " + ts.error;
+  for (const value of c.values) {
+    if (!sameValue(ts.values[0], value)) return "MISMATCH";
+  }
+  return c.values.length ? "ok" : "no result";
+}
+
+const columns = [
+  "Program",
+  "TS ms",
+  "C ms",
+  "Speedup",
+  "TS instr",
+  "C instr",
+  "TS heap KB",
+  "C peak KB",
+  "Branches",
+  "Status"
+];
+
+function printRow(cells: string[]): void {
+  const row = cells.map((cell, i) => {
+    if (i === cells.length - 1) return cell;
+    return i === 0 ? cell.padEnd(24) : cell.padStart(10);
+  });
+  console.log(row.join(" | "));
+}
+
+async function main(): Promise<void> {
+  const binary = process.argv[2];
+  if (!binary) {
+    console.error("Usage: diff.ts <path to the ws binary>");
+    process.exit(1);
+  }
+
+  const programs: TestProgram[] = collectPrograms();
+  await import("./test/index");
+
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), "ws-diff-"));
+  const counts: Record<string, number> = {};
+
+  printRow(columns);
+  printRow(columns.map(() => "-".repeat(10)));
+
+  for (let index = 0; index < programs.length; ++index) {
+    const program = programs[index];
+    const firstId = compiler.lastFunctionId + 1;
+    const main = compiler.compile(program.code);
+    const functions = [main];
+    for (let i = firstId; i <= compiler.lastFunctionId; ++i) {
+      functions.push(compiler.requestCompile(i));
+    }
+
+    const file = path.join(dir, index + ".wsc");
+    writeBundle(file, functions, firstId);
+
+    const ts = await runReference(main, program.timeout);
+    const c = runNative(binary, file, program.timeout);
+    fs.unlinkSync(file);
+    const result = status(ts, c);
+    const kind = result === "ok" || result === "MISMATCH" ? result : "error";
+    counts[kind] = (counts[kind] || 0) + 1;
+
+    printRow([
+      program.name.slice(0, 24),
+      ts.timeMs.toFixed(2),
+      c.timeMs.toFixed(2),
+      c.timeMs > 0 ? (ts.timeMs / c.timeMs).toFixed(1) + "x" : "-",
+      String(ts.instructions),
+      String(c.instructions),
+      (ts.peakBytes / 1024).toFixed(0),
+      (c.peakBytes / 1024).toFixed(0),
+      String(c.values.length),
+      result
+    ]);
+  }
+
+  fs.rmdirSync(dir);
+
+  console.log();
+  console.log(
+    `${programs.length} programs: ${counts.ok || 0} ok, ` +
+      `${counts.MISMATCH || 0} mismatches, ${counts.error || 0} errors.`
+  );
+}
+
+main();
@@ -85,6 +85,8 @@ export enum ByteCode {
   JmpFalsePeek = 0x74,
   JmpTrueThenPop = 0x75,
   JmpFalseThenPop = 0x76,
+  Switch = 0x77,
+  Diamond = 0x78,
   // Hoisting and Scoping
   LdScope = 0x90,
   Ret = 0x91,
@@ -120,6 +122,8 @@ export const byteCodeArgSize: Partial<Record<ByteCode, number>> = {
   [ByteCode.JmpFalsePeek]: 2,
   [ByteCode.JmpTrueThenPop]: 2,
   [ByteCode.JmpFalseThenPop]: 2,
+  [ByteCode.Switch]: 4,
+  [ByteCode.Diamond]: 2,
 
   [ByteCode.LdStr]: 4,
   [ByteCode.NamedProp]: 4,
@@ -147,7 +151,8 @@ export type JumpByteCode =
   | ByteCode.JmpFalseThenPop
   | ByteCode.JmpTruePeek
   | ByteCode.JmpTruePop
-  | ByteCode.JmpTrueThenPop;
+  | ByteCode.JmpTrueThenPop
+  | ByteCode.Diamond;
 
 export function isJumpByteCode(bytecode: ByteCode): bytecode is JumpByteCode {
   return (
@@ -157,6 +162,7 @@ export function isJumpByteCode(bytecode: ByteCode): bytecode is JumpByteCode {
     bytecode === ByteCode.JmpFalseThenPop ||
     bytecode === ByteCode.JmpTruePeek ||
     bytecode === ByteCode.JmpTruePop ||
-    bytecode === ByteCode.JmpTrueThenPop
+    bytecode === ByteCode.JmpTrueThenPop ||
+    bytecode === ByteCode.Diamond
   );
 }
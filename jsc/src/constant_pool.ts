@@ -9,4 +9,8 @@ export class ConstantPool {
     this.map.set(data, index);
     return index;
   }
+
+  reserve(size: number): number {
+    return this.buffer.skip(size);
+  }
 }
@@ -8,6 +8,7 @@
 
 import { ByteCode, byteCodeArgSize, isJumpByteCode } from "./bytecode";
 import { CompiledData } from "./compiler";
+import { switchTableTargets } from "./switch_table";
 
 enum JumpDir {
   S2E,
@@ -114,13 +115,13 @@ export class Dumper {
 
     for (let i = 0; i < itemsCount; ++i) {
       let line = "";
-      const isFunction = scope.get(cursor);
+      const kind = scope.get(cursor);
       const name = scope.getNetString16(cursor + 1);
       cursor += 3 + name.length * 2;
 
-      line += "DEF " + name;
+      line += (kind === 2 ? "PARAM " : "DEF ") + name;
 
-      if (isFunction) {
+      if (kind === 1) {
         const fnId = scope.getUint16(cursor);
         line += " FUNCTION(" + hex2str(fnId) + ")";
         cursor += 2;
@@ -274,6 +275,12 @@ export class Dumper {
         const to = readUint16(args);
         this.addJump(pos, to);
       }
+
+      if (bc === ByteCode.Switch) {
+        const offset = this.data.codeSection.getUint32(pos + 1);
+        const targets = switchTableTargets(this.data.constantPool, offset);
+        for (const to of targets) this.addJump(pos, to);
+      }
     });
 
     // Sort jumps by their length. (How far the jumps are)
@@ -0,0 +1,143 @@
+/**
+ *    ____ _   _ _____
+ *   /___ \ |_(_)___ /  ___
+ *  //  / / __| | |_ \ / _ \
+ * / \_/ /| |_| |___) |  __/
+ * \___,_\ \__|_|____/ \___|
+ */
+
+import * as estree from "estree";
+
+/**
+ * Returns the blocks (block statements and `for` loops) of a function, or of
+ * the top level of a program, that don't need a scope of their own.  The
+ * compiler doesn't emit `BlockIn` and `BlockOut` for them so their bindings
+ * are defined in the scope of the enclosing block, or the function.
+ *
+ * A block is flattened when all of the uses of its bindings are inside it and
+ * none of them is in a nested function.  So no closure can capture a binding
+ * of the block, and moving the binding out can't change what any other name
+ * refers to (a declaration with the same name elsewhere is a use outside of
+ * the block).
+ */
+export function collectFlatBlocks(
+  node: estree.Function | estree.Program
+): Set<estree.Node> {
+  // Names that are declared with `let` or `const` in each block.
+  const blocks = new Map<estree.Node, string[]>();
+  // For each use of a name the blocks around it, or null if the use is in a
+  // nested function.
+  const uses = new Map<string, (estree.Node[] | null)[]>();
+  const stack: estree.Node[] = [];
+  let functions = 0;
+
+  const use = (name: string) => {
+    if (!uses.has(name)) uses.set(name, []);
+    uses.get(name)!.push(functions > 0 ? null : stack.slice());
+  };
+
+  const walk = (node: estree.Node | null | undefined): void => {
+    if (!node) return;
+
+    switch (node.type) {
+      case "Identifier":
+        use(node.name);
+        return;
+
+      case "MemberExpression":
+        walk(node.object);
+        if (node.computed) walk(node.property);
+        return;
+
+      case "Property":
+        if (node.computed) walk(node.key);
+        walk(node.value);
+        return;
+
+      case "LabeledStatement":
+        walk(node.body);
+        return;
+
+      case "BreakStatement":
+      case "ContinueStatement":
+        return;
+
+      case "FunctionDeclaration":
+      case "FunctionExpression":
+      case "ArrowFunctionExpression":
+        // The name of a function declaration belongs to this function.
+        if (node.type === "FunctionDeclaration") walk(node.id);
+        functions += 1;
+        node.params.forEach(walk);
+        walk(node.body);
+        functions -= 1;
+        return;
+
+      case "VariableDeclaration":
+        // A lexical binding is defined in the innermost block scope at runtime
+        // even in a switch case, as there is no scope for the switch.
+        if (functions === 0 && node.kind !== "var" && stack.length > 0) {
+          const names = blocks.get(stack[stack.length - 1])!;
+          for (const declaration of node.declarations) {
+            if (declaration.id.type === "Identifier") {
+              names.push(declaration.id.name);
+            }
+          }
+        }
+        break;
+
+      case "BlockStatement":
+      case "ForStatement":
+        if (functions > 0) break;
+        blocks.set(node, []);
+        stack.push(node);
+        forEachChild(node, walk);
+        stack.pop();
+        return;
+    }
+
+    forEachChild(node, walk);
+  };
+
+  if (node.type === "Program") {
+    node.body.forEach(walk);
+  } else {
+    node.params.forEach(walk);
+    // The body of a function is not a block, it uses the function scope.
+    if (node.body.type === "BlockStatement") {
+      node.body.body.forEach(walk);
+    } else {
+      walk(node.body);
+    }
+  }
+
+  const flat = new Set<estree.Node>();
+  for (const [block, names] of blocks) {
+    const local = names.every(name =>
+      uses.get(name)!.every(stack => stack !== null && stack.includes(block))
+    );
+    if (local) flat.add(block);
+  }
+
+  return flat;
+}
+
+function forEachChild(
+  node: estree.Node,
+  callback: (node: estree.Node) => void
+): void {
+  for (const key of Object.keys(node)) {
+    const value = (node as any)[key];
+    if (Array.isArray(value)) {
+      for (const item of value) {
+        if (isNode(item)) callback(item);
+      }
+    } else if (isNode(value)) {
+      callback(value);
+    }
+  }
+}
+
+function isNode(value: any): value is estree.Node {
+  return !!value && typeof value.type === "string";
+}
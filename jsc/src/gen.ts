@@ -8,6 +8,7 @@
 
 import * as estree from "estree";
 import { visit } from "./visitor";
+import { collectFlatBlocks } from "./escape";
 import { Writer } from "./writer";
 import { Compiler, CompiledData } from "./compiler";
 import { ByteCode } from "./bytecode";
@@ -18,6 +19,7 @@ export function compileMain(
 ): CompiledData {
   const writer = new Writer(compiler);
   const body = program.body;
+  writer.flatBlocks = collectFlatBlocks(program);
   const last = body.length - 1;
 
   for (let i = 0; i < body.length; ++i) {
@@ -33,6 +35,14 @@ export function compileFunction(
 ): CompiledData {
   const writer = new Writer(compiler);
   const body = functionNode.body;
+  writer.flatBlocks = collectFlatBlocks(functionNode);
+
+  for (const param of functionNode.params) {
+    if (param.type !== "Identifier") {
+      throw new Error("Advanced parameters are not implemented yet.");
+    }
+    writer.scope.addParameter(param.name);
+  }
 
   switch (body.type) {
     case "BlockStatement":
@@ -40,6 +50,11 @@ export function compileFunction(
         visit(writer, node);
       }
       break;
+
+    default:
+      // Arrow functions with an expression body.
+      visit(writer, body);
+      writer.write(functionNode, ByteCode.Ret);
   }
 
   writer.write(functionNode, ByteCode.LdUndef);
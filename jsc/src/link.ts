@@ -0,0 +1,163 @@
+/**
+ *    ____ _   _ _____
+ *   /___ \ |_(_)___ /  ___
+ *  //  / / __| | |_ \ / _ \
+ * / \_/ /| |_| |___) |  __/
+ * \___,_\ \__|_|____/ \___|
+ */
+
+import { ByteCode, byteCodeArgSize } from "./bytecode";
+import { CompiledData } from "./compiler";
+import { ConstantPool } from "./constant_pool";
+import { copySwitchTable } from "./switch_table";
+
+/**
+ * The sections of a compiled function as plain bytes, this is what workers
+ * send to the main thread (see `batch.ts`).
+ */
+export interface CompiledBytes {
+  codeSection: Uint8Array;
+  constantPool: Uint8Array;
+  scope: Uint8Array;
+  mapSection: Uint8Array;
+}
+
+export function toBytes(data: CompiledData): CompiledBytes {
+  return {
+    codeSection: bufferToBytes(data.codeSection),
+    constantPool: bufferToBytes(data.constantPool),
+    scope: bufferToBytes(data.scope),
+    mapSection: bufferToBytes(data.mapSection)
+  };
+}
+
+export function fromBytes(bytes: CompiledBytes): CompiledData {
+  return {
+    codeSection: bytesToBuffer(bytes.codeSection),
+    constantPool: bytesToBuffer(bytes.constantPool),
+    scope: bytesToBuffer(bytes.scope),
+    mapSection: bytesToBuffer(bytes.mapSection)
+  };
+}
+
+function bufferToBytes(buffer: WSBuffer): Uint8Array {
+  const bytes = new Uint8Array(buffer.size);
+  for (let i = 0; i < buffer.size; ++i) bytes[i] = buffer.get(i);
+  return bytes;
+}
+
+function bytesToBuffer(bytes: Uint8Array): WSBuffer {
+  const buffer = new WSBuffer(Math.max(bytes.length, 1));
+  for (let i = 0; i < bytes.length; ++i) buffer.put(bytes[i]);
+  return buffer;
+}
+
+/**
+ * Link the compiled scripts into a version 2 bundle (see `headers/loader.h`),
+ * every script is the list of functions of one `Compiler`: the main function
+ * and then the functions in the order of their id.
+ *
+ * Ids are assigned in the order of the scripts, starting from `baseId`, so
+ * the result doesn't depend on how the scripts were compiled.  All of the
+ * functions share one constant pool where each string is stored once.
+ */
+export function linkScripts(
+  scripts: CompiledData[][],
+  baseId = 1
+): WSBuffer {
+  const pool = new ConstantPool();
+  const mains: CompiledData[] = [];
+  const functions: CompiledData[] = [];
+  let nextId = baseId;
+
+  for (const script of scripts) {
+    // Id of the function with the local id 1.
+    const firstId = nextId;
+    nextId += script.length - 1;
+    if (nextId - 1 > 0xffff) {
+      throw new Error("Too many functions in a bundle, ids are 16 bits.");
+    }
+
+    const relocate = (id: number) => firstId + id - 1;
+    mains.push(relocateFunction(script[0], pool, relocate));
+    for (let i = 1; i < script.length; ++i) {
+      functions.push(relocateFunction(script[i], pool, relocate));
+    }
+  }
+
+  const bundle = new WSBuffer(1024);
+  for (const char of "WSC2") bundle.put(char.charCodeAt(0));
+  bundle.setUint32(mains.length + functions.length);
+  bundle.setUint32(mains.length);
+  bundle.setUint32(baseId);
+  bundle.setUint32(pool.buffer.size);
+  copy(pool.buffer, bundle);
+
+  for (const data of [...mains, ...functions]) {
+    bundle.setUint32(data.codeSection.size);
+    bundle.setUint32(data.scope.size);
+    bundle.setUint32(data.mapSection.size);
+    copy(data.codeSection, bundle);
+    copy(data.scope, bundle);
+    copy(data.mapSection, bundle);
+  }
+
+  return bundle;
+}
+
+function copy(from: WSBuffer, to: WSBuffer): void {
+  for (let i = 0; i < from.size; ++i) to.put(from.get(i));
+}
+
+/**
+ * Move the constants of the function to `pool` and change the function ids
+ * using `relocate`, the size of the code doesn't change so the jumps remain
+ * valid.  The returned function has an empty constant pool.
+ */
+function relocateFunction(
+  data: CompiledData,
+  pool: ConstantPool,
+  relocate: (id: number) => number
+): CompiledData {
+  const code = bytesToBuffer(bufferToBytes(data.codeSection));
+  const scope = bytesToBuffer(bufferToBytes(data.scope));
+
+  for (let cursor = 0; cursor < code.size; ) {
+    const bytecode: ByteCode = code.get(cursor);
+
+    if (bytecode >= ByteCode.LdStr && bytecode <= ByteCode.RegExp) {
+      const offset = code.getUint32(cursor + 1);
+      const string = data.constantPool.getNetString16(offset);
+      code.setUint32(pool.setNetString16(string), cursor + 1);
+    } else if (bytecode === ByteCode.Switch) {
+      const offset = code.getUint32(cursor + 1);
+      code.setUint32(
+        copySwitchTable(data.constantPool, offset, pool),
+        cursor + 1
+      );
+    } else if (bytecode === ByteCode.LdFunction) {
+      code.setUint16(relocate(code.getUint16(cursor + 1)), cursor + 1);
+    }
+
+    cursor += 1 + (byteCodeArgSize[bytecode] || 0);
+  }
+
+  // See `Scope.getBuffer`, only the functions have an id.
+  const count = scope.getUint16(0);
+  for (let i = 0, cursor = 2; i < count; ++i) {
+    const kind = scope.get(cursor);
+    cursor += 3 + scope.getUint16(cursor + 1) * 2;
+    if (kind === 1) {
+      scope.setUint16(relocate(scope.getUint16(cursor)), cursor);
+      cursor += 2;
+    }
+  }
+
+  return {
+    codeSection: code,
+    constantPool: new WSBuffer(),
+    scope,
+    mapSection: data.mapSection,
+    position: data.position
+  };
+}
@@ -8,7 +8,8 @@
 
 const enum Kind {
   Variable = 0,
-  Function = 1
+  Function = 1,
+  Parameter = 2
 }
 
 type ScopeEntity =
@@ -17,7 +18,7 @@ type ScopeEntity =
       id: number;
     }
   | {
-      kind: Kind.Variable;
+      kind: Kind.Variable | Kind.Parameter;
     };
 
 export class Scope {
@@ -30,6 +31,14 @@ export class Scope {
     });
   }
 
+  // Parameters are added before anything else, in the order of the
+  // declaration, the VM binds the arguments to them in the same order.
+  addParameter(name: string): void {
+    this.map.set(name, {
+      kind: Kind.Parameter
+    });
+  }
+
   addVariable(name: string): void {
     if (this.map.has(name)) return;
     this.map.set(name, {
@@ -0,0 +1,267 @@
+/**
+ *    ____ _   _ _____
+ *   /___ \ |_(_)___ /  ___
+ *  //  / / __| | |_ \ / _ \
+ * / \_/ /| |_| |___) |  __/
+ * \___,_\ \__|_|____/ \___|
+ */
+
+import { ConstantPool } from "./constant_pool";
+
+// Switch tables are stored in the constant pool, the layout is described in
+// VM.md (See `Switch`), all the numbers are little-endian.
+
+export const enum SwitchTableKind {
+  Dense = 0,
+  Hashed = 1
+}
+
+const enum SlotTag {
+  Empty = 0,
+  Number = 1,
+  String = 2
+}
+
+export type SwitchKey = number | string;
+
+const HEADER_SIZE = 3;
+const DENSE_HEADER_SIZE = HEADER_SIZE + 6;
+const HASHED_HEADER_SIZE = HEADER_SIZE + 2;
+const SLOT_SIZE = 7;
+
+/**
+ * Returns the key that should be used in a jump table for the given value or
+ * undefined if the value can not be a part of a switch table.
+ */
+export function toSwitchKey(value: any): SwitchKey | undefined {
+  if (typeof value === "string") return value;
+  if (typeof value === "number" && value === (value | 0)) return value;
+  return undefined;
+}
+
+function hashKey(key: SwitchKey): number {
+  if (typeof key === "number") return key >>> 0;
+  let hash = 0;
+  for (let i = 0; i < key.length; ++i) {
+    hash = ((hash << 5) - hash + key.charCodeAt(i)) | 0;
+  }
+  return hash >>> 0;
+}
+
+function isDense(keys: SwitchKey[]): boolean {
+  let min = Infinity;
+  let max = -Infinity;
+  for (const key of keys) {
+    if (typeof key !== "number") return false;
+    if (key < min) min = key;
+    if (key > max) max = key;
+  }
+  // Allow at most one hole per case, otherwise the table is mostly holes.
+  return max - min + 1 <= Math.max(keys.length * 2, 4);
+}
+
+export class SwitchTable {
+  private readonly offset: number;
+  private readonly pool: WSBuffer;
+  private readonly slots = new Map<SwitchKey, number>();
+  private readonly kind: SwitchTableKind;
+  private min = 0;
+  private count = 0;
+
+  /**
+   * Creates a new table for the given keys, keys must be unique and there
+   * must be at least one key.
+   */
+  constructor(constantPool: ConstantPool, keys: SwitchKey[]) {
+    this.pool = constantPool.buffer;
+    this.kind = isDense(keys) ? SwitchTableKind.Dense : SwitchTableKind.Hashed;
+
+    if (this.kind === SwitchTableKind.Dense) {
+      this.min = Infinity;
+      let max = -Infinity;
+      for (const key of keys as number[]) {
+        if (key < this.min) this.min = key;
+        if (key > max) max = key;
+      }
+      this.count = max - this.min + 1;
+      this.offset = constantPool.reserve(DENSE_HEADER_SIZE + this.count * 2);
+      this.pool.setInt32(this.min, this.offset + HEADER_SIZE);
+      this.pool.setUint16(this.count, this.offset + HEADER_SIZE + 4);
+      for (const key of keys as number[]) {
+        const index = key - this.min;
+        this.slots.set(key, this.offset + DENSE_HEADER_SIZE + index * 2);
+      }
+    } else {
+      // String keys are stored as a reference to a netstring in the pool.
+      const strings: Record<string, number> = Object.create(null);
+      for (const key of keys) {
+        if (typeof key === "string")
+          strings[key] = constantPool.setNetString16(key);
+      }
+
+      let capacity = 4;
+      while (capacity < keys.length * 2) capacity *= 2;
+      this.count = capacity;
+      this.offset = constantPool.reserve(
+        HASHED_HEADER_SIZE + capacity * SLOT_SIZE
+      );
+      this.pool.setUint16(capacity, this.offset + HEADER_SIZE);
+
+      const mask = capacity - 1;
+      for (const key of keys) {
+        let index = hashKey(key) & mask;
+        let slot = this.slotOffset(index);
+        while (this.pool.get(slot) !== SlotTag.Empty) {
+          index = (index + 1) & mask;
+          slot = this.slotOffset(index);
+        }
+        if (typeof key === "number") {
+          this.pool.put(SlotTag.Number, slot);
+          this.pool.setInt32(key, slot + 1);
+        } else {
+          this.pool.put(SlotTag.String, slot);
+          this.pool.setUint32(strings[key], slot + 1);
+        }
+        this.slots.set(key, slot + 5);
+      }
+    }
+
+    this.pool.put(this.kind, this.offset);
+  }
+
+  private slotOffset(index: number): number {
+    return this.offset + HASHED_HEADER_SIZE + index * SLOT_SIZE;
+  }
+
+  /**
+   * Offset of the table in the constant pool.
+   */
+  getOffset(): number {
+    return this.offset;
+  }
+
+  /**
+   * Set the jump target for the given key.
+   */
+  setTarget(key: SwitchKey, position: number): void {
+    this.pool.setUint16(position, this.slots.get(key)!);
+  }
+
+  /**
+   * Set the jump target that is used when no key matches the discriminant,
+   * it also fills the holes of a dense table.
+   */
+  setDefault(position: number): void {
+    this.pool.setUint16(position, this.offset + 1);
+    if (this.kind !== SwitchTableKind.Dense) return;
+    for (let i = 0; i < this.count; ++i) {
+      const key = this.min + i;
+      if (!this.slots.has(key)) {
+        this.pool.setUint16(position, this.offset + DENSE_HEADER_SIZE + i * 2);
+      }
+    }
+  }
+}
+
+/**
+ * Find the jump target for the given discriminant, `undefined` should be passed
+ * for the values that are neither a number nor a string.
+ */
+export function lookupSwitchTable(
+  pool: WSBuffer,
+  offset: number,
+  value: SwitchKey | undefined
+): number {
+  const fallback = pool.getUint16(offset + 1);
+
+  if (pool.get(offset) === SwitchTableKind.Dense) {
+    if (typeof value !== "number") return fallback;
+    const min = pool.getInt32(offset + HEADER_SIZE);
+    const count = pool.getUint16(offset + HEADER_SIZE + 4);
+    const index = value - min;
+    if (index !== Math.floor(index) || index < 0 || index >= count)
+      return fallback;
+    return pool.getUint16(offset + DENSE_HEADER_SIZE + index * 2);
+  }
+
+  if (value === undefined) return fallback;
+  if (typeof value === "number" && value !== (value | 0)) return fallback;
+
+  const capacity = pool.getUint16(offset + HEADER_SIZE);
+  const mask = capacity - 1;
+  let index = hashKey(value) & mask;
+
+  for (let i = 0; i < capacity; ++i, index = (index + 1) & mask) {
+    const slot = offset + HASHED_HEADER_SIZE + index * SLOT_SIZE;
+    const tag = pool.get(slot);
+    if (tag === SlotTag.Empty) break;
+    if (tag === SlotTag.Number) {
+      if (pool.getInt32(slot + 1) === value) return pool.getUint16(slot + 5);
+    } else if (pool.getNetString16(pool.getUint32(slot + 1)) === value) {
+      return pool.getUint16(slot + 5);
+    }
+  }
+
+  return fallback;
+}
+
+/**
+ * Returns all of the jump targets in a switch table (including the default).
+ */
+export function switchTableTargets(pool: WSBuffer, offset: number): number[] {
+  const targets: number[] = [pool.getUint16(offset + 1)];
+
+  if (pool.get(offset) === SwitchTableKind.Dense) {
+    const count = pool.getUint16(offset + HEADER_SIZE + 4);
+    for (let i = 0; i < count; ++i) {
+      targets.push(pool.getUint16(offset + DENSE_HEADER_SIZE + i * 2));
+    }
+  } else {
+    const capacity = pool.getUint16(offset + HEADER_SIZE);
+    for (let i = 0; i < capacity; ++i) {
+      const slot = offset + HASHED_HEADER_SIZE + i * SLOT_SIZE;
+      if (pool.get(slot) !== SlotTag.Empty)
+        targets.push(pool.getUint16(slot + 5));
+    }
+  }
+
+  return targets.filter((target, i) => targets.indexOf(target) === i);
+}
+
+/**
+ * Copy the switch table at `offset` of `pool` to the end of `constantPool`,
+ * the string keys are added to `constantPool` as well.  Returns the offset of
+ * the copy.
+ */
+export function copySwitchTable(
+  pool: WSBuffer,
+  offset: number,
+  constantPool: ConstantPool
+): number {
+  const dense = pool.get(offset) === SwitchTableKind.Dense;
+  const size = dense
+    ? DENSE_HEADER_SIZE + pool.getUint16(offset + HEADER_SIZE + 4) * 2
+    : HASHED_HEADER_SIZE + pool.getUint16(offset + HEADER_SIZE) * SLOT_SIZE;
+
+  // Strings must be added before the table is reserved.
+  const strings = new Map<number, number>();
+  if (!dense) {
+    const end = offset + size;
+    for (let i = offset + HASHED_HEADER_SIZE; i < end; i += SLOT_SIZE) {
+      if (pool.get(i) !== SlotTag.String) continue;
+      const key = pool.getUint32(i + 1);
+      strings.set(i, constantPool.setNetString16(pool.getNetString16(key)));
+    }
+  }
+
+  const target = constantPool.reserve(size);
+  for (let i = 0; i < size; ++i) {
+    constantPool.buffer.put(pool.get(offset + i), target + i);
+  }
+
+  for (const [slot, key] of strings) {
+    constantPool.buffer.setUint32(key, target + slot - offset + 1);
+  }
+
+  return target;
+}
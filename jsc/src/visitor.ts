@@ -9,6 +9,7 @@
 import * as estree from "estree";
 import { ByteCode } from "./bytecode";
 import { Writer, Jump } from "./writer";
+import { SwitchKey, toSwitchKey } from "./switch_table";
 
 export function visit(writer: Writer, node: estree.Node, pop = false): void {
   main: switch (node.type) {
@@ -210,7 +211,8 @@ export function visit(writer: Writer, node: estree.Node, pop = false): void {
       }
 
       if (node.value instanceof RegExp) {
-        writer.write(node, ByteCode.RegExp, node.value.source);
+        const { source, flags } = node.value;
+        writer.write(node, ByteCode.RegExp, `/${source}/${flags}`);
         break;
       }
 
@@ -421,6 +423,9 @@ export function visit(writer: Writer, node: estree.Node, pop = false): void {
       let jmp2: Jump;
 
       visit(writer, node.test);
+      const diamond = isDiamond(node.consequent, node.alternate)
+        ? writer.jmp(node, ByteCode.Diamond)
+        : undefined;
       const jmp1 = writer.jmp(node, ByteCode.JmpFalsePop);
       visit(writer, node.consequent, true);
 
@@ -435,6 +440,7 @@ export function visit(writer: Writer, node: estree.Node, pop = false): void {
         jmp2!.next();
       }
 
+      if (diamond) diamond.next();
       break;
     }
 
@@ -453,7 +459,8 @@ export function visit(writer: Writer, node: estree.Node, pop = false): void {
 
     case "ForStatement": {
       const label = writer.labels.create();
-      writer.write(node, ByteCode.BlockIn);
+      const block = !writer.flatBlocks.has(node);
+      if (block) writer.write(node, ByteCode.BlockIn);
 
       if (node.init) visit(writer, node.init, true);
 
@@ -473,7 +480,7 @@ export function visit(writer: Writer, node: estree.Node, pop = false): void {
       writer.jmpTo(node, ByteCode.Jmp, testPos);
       jmp.next();
 
-      writer.write(node, ByteCode.BlockOut);
+      if (block) writer.write(node, ByteCode.BlockOut);
       label.end();
       break;
     }
@@ -491,22 +498,27 @@ export function visit(writer: Writer, node: estree.Node, pop = false): void {
 
     case "ConditionalExpression": {
       visit(writer, node.test);
+      const diamond = isDiamond(node.consequent, node.alternate)
+        ? writer.jmp(node, ByteCode.Diamond)
+        : undefined;
       const jmp = writer.jmp(node.test, ByteCode.JmpFalsePop);
       visit(writer, node.consequent);
       const jmp2 = writer.jmp(node.consequent, ByteCode.Jmp);
       jmp.next();
       visit(writer, node.alternate);
       jmp2.next();
+      if (diamond) diamond.next();
       if (pop) writer.write(node, ByteCode.Pop);
       break;
     }
 
     case "BlockStatement": {
-      writer.write(node, ByteCode.BlockIn);
+      const block = !writer.flatBlocks.has(node);
+      if (block) writer.write(node, ByteCode.BlockIn);
       for (const stmt of node.body) {
         visit(writer, stmt, true);
       }
-      writer.write(node, ByteCode.BlockOut);
+      if (block) writer.write(node, ByteCode.BlockOut);
       break;
     }
 
@@ -662,6 +674,39 @@ export function visit(writer: Writer, node: estree.Node, pop = false): void {
         break;
       }
 
+      // When all of the cases are constant we can jump directly to the
+      // matching case using a jump table.
+      const keys = getSwitchKeys(node);
+      if (keys) {
+        visit(writer, node.discriminant);
+        const table = writer.switchTable(node.discriminant, keys);
+        let hasDefault = false;
+
+        for (const item of node.cases) {
+          const position = writer.getPosition();
+
+          if (item.test) {
+            // Only the first case with a given key is reachable.
+            const index = keys.indexOf(getSwitchKey(item.test)!);
+            if (index > -1) {
+              table.setTarget(keys[index], position);
+              keys.splice(index, 1);
+            }
+          } else {
+            table.setDefault(position);
+            hasDefault = true;
+          }
+
+          for (const stmt of item.consequent) {
+            visit(writer, stmt, true);
+          }
+        }
+
+        if (!hasDefault) table.setDefault(writer.getPosition());
+        label.end();
+        break;
+      }
+
       visit(writer, node.discriminant);
 
       let lastJump: Jump | undefined;
@@ -759,3 +804,168 @@ export function visit(writer: Writer, node: estree.Node, pop = false): void {
       break;
   }
 }
+
+/**
+ * Returns the key of a case test if it's a constant that can be used in a
+ * switch table.
+ */
+function getSwitchKey(test: estree.Expression): SwitchKey | undefined {
+  if (test.type === "Literal") {
+    return toSwitchKey(test.value);
+  }
+
+  if (
+    test.type === "UnaryExpression" &&
+    test.operator === "-" &&
+    test.argument.type === "Literal" &&
+    typeof test.argument.value === "number"
+  ) {
+    return toSwitchKey(-test.argument.value);
+  }
+
+  return undefined;
+}
+
+/**
+ * Returns the unique keys of a switch statement in order or undefined if at
+ * least one of the cases is not a constant.
+ */
+function getSwitchKeys(node: estree.SwitchStatement): SwitchKey[] | undefined {
+  const keys: SwitchKey[] = [];
+
+  for (const item of node.cases) {
+    if (!item.test) continue;
+    const key = getSwitchKey(item.test);
+    if (key === undefined) return undefined;
+    if (keys.indexOf(key) < 0) keys.push(key);
+  }
+
+  return keys.length > 0 ? keys : undefined;
+}
+
+/**
+ * Returns true if both arms of a branch are a pure region, in that case the
+ * VM can evaluate both of them in place and join the values they leave into
+ * a union instead of forking the context.
+ */
+function isDiamond(
+  consequent: estree.Node,
+  alternate: estree.Node | null | undefined
+): boolean {
+  return isPureRegion(consequent) && isPureRegion(alternate);
+}
+
+/**
+ * Returns true if the value of the expression is always a primitive, so
+ * using it as an operand never calls `valueOf` or `toString`.
+ */
+export function isPrimitive(node: estree.Node): boolean {
+  switch (node.type) {
+    case "Literal":
+      return !(node as estree.RegExpLiteral).regex;
+
+    case "BinaryExpression":
+    case "UpdateExpression":
+      return true;
+
+    case "UnaryExpression":
+      return node.operator !== "delete";
+
+    case "LogicalExpression":
+      return isPrimitive(node.left) && isPrimitive(node.right);
+
+    case "ConditionalExpression":
+      return isPrimitive(node.consequent) && isPrimitive(node.alternate);
+
+    case "SequenceExpression":
+      return isPrimitive(node.expressions[node.expressions.length - 1]);
+
+    default:
+      return false;
+  }
+}
+
+/**
+ * A pure region has no effect but the value it leaves on the stack: it
+ * doesn't write to any variable or property, never calls a function (a
+ * getter or a `valueOf` included) and can't leave the region with a jump
+ * (break, continue, return) or loop.
+ *
+ * The VM runs both arms of a diamond one after the other on the same scope
+ * and only joins the values they leave, so an arm that writes a local would
+ * be seen by the other arm and would win over it.
+ */
+export function isPureRegion(node: estree.Node | null | undefined): boolean {
+  const every = (nodes: (estree.Node | null)[]) =>
+    nodes.every(node => isPureRegion(node));
+
+  if (!node) return true;
+
+  switch (node.type) {
+    case "EmptyStatement":
+    case "Literal":
+    case "Identifier":
+    case "ThisExpression":
+      return true;
+
+    case "ExpressionStatement":
+      return isPureRegion(node.expression);
+
+    case "BlockStatement":
+      return every(node.body);
+
+    case "IfStatement":
+    case "ConditionalExpression":
+      return every([node.test, node.consequent, node.alternate || null]);
+
+    case "BinaryExpression":
+      // `instanceof` may call Symbol.hasInstance and `in` may hit a proxy,
+      // the other operators convert an object with `valueOf`, but for the
+      // strict comparisons.
+      if (node.operator === "instanceof" || node.operator === "in") {
+        return false;
+      }
+      if (
+        node.operator !== "===" &&
+        node.operator !== "!==" &&
+        !(isPrimitive(node.left) && isPrimitive(node.right))
+      ) {
+        return false;
+      }
+      return every([node.left, node.right]);
+
+    case "LogicalExpression":
+      return every([node.left, node.right]);
+
+    case "UnaryExpression":
+      // `-`, `+` and `~` convert an object with `valueOf`.
+      if (node.operator === "delete") return false;
+      if (
+        (node.operator === "-" ||
+          node.operator === "+" ||
+          node.operator === "~") &&
+        !isPrimitive(node.argument)
+      ) {
+        return false;
+      }
+      return isPureRegion(node.argument);
+
+    case "SequenceExpression":
+      return every(node.expressions);
+
+    case "ArrayExpression":
+      return every(node.elements as estree.Node[]);
+
+    case "ObjectExpression":
+      return node.properties.every(
+        property =>
+          property.kind === "init" &&
+          every([property.computed ? property.key : null, property.value])
+      );
+
+    // A property read may run a getter, the assignments, the updates and
+    // the declarations write a variable.
+    default:
+      return false;
+  }
+}
@@ -12,6 +12,7 @@ import { Compiler, CompiledData } from "./compiler";
 import { Scope } from "./scope";
 import { Labels } from "./labels";
 import { ConstantPool } from "./constant_pool";
+import { SwitchTable, SwitchKey } from "./switch_table";
 
 export type Pos = {
   start: number;
@@ -26,6 +27,11 @@ export class Writer {
   readonly labels: Labels = new Labels(this);
   varKind: "var" | "let" | "const" = "var";
 
+  /**
+   * Blocks that don't get a scope of their own, see `collectFlatBlocks`.
+   */
+  flatBlocks: Set<estree.Node> = new Set();
+
   constructor(readonly compiler: Compiler) {
     this.codeSection.put(ByteCode.LdScope);
     this.mapSection.setUint16(0);
@@ -73,6 +79,13 @@ export class Writer {
     return this.codeSection.getCursor();
   }
 
+  switchTable(node: estree.Node | Pos, keys: SwitchKey[]): SwitchTable {
+    const table = new SwitchTable(this.constantPool, keys);
+    this.write(node, ByteCode.Switch);
+    this.codeSection.setUint32(table.getOffset());
+    return table;
+  }
+
   jmpTo(node: estree.Node | Pos, type: JumpByteCode, pos: number): void {
     this.codeSection.put(type);
     this.mapSection.setUint16((node as Pos).start);
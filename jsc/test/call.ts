@@ -20,3 +20,21 @@ testCodeResult(
   i
   `
 );
+
+testCodeResult(
+  "Call 3",
+  `
+  let f = (a, b, c) => a * 100 + b * 10 + c;
+  f(1, 2, 3)
+  `
+);
+
+testCodeResult(
+  "Call with missing arguments",
+  `
+  let f = function(a, b) {
+    return b;
+  };
+  f(1)
+  `
+);
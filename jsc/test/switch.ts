@@ -219,3 +219,100 @@ testCodeResult(
   ret
   `
 );
+
+testCodeResult(
+  "Switch Table Dense",
+  `
+  let ret = {};
+  for (let i = -1; i < 8; i += 1) {
+    let r = "";
+    switch (i) {
+      case 0: r += "a";
+      case 1: r += "b"; break;
+      case 2: r += "c";
+      default: r += "d";
+      case 4: r += "e"; if (i === 4) break;
+      case 5: r += "f";
+    }
+    ret[i] = r;
+  }
+  ret
+  `
+);
+
+testCodeResult(
+  "Switch Table Sparse",
+  `
+  let ret = {};
+  for (let i = -2; i <= 10; i += 1) {
+    let v = i * i * i;
+    let r = 0;
+    switch (v) {
+      case -1: r = 1; break;
+      case 1: r = 2; break;
+      case 64: r = 3;
+      case 1000: r += 4; break;
+      case 1: r = 5; break;
+    }
+    if (r > 0) ret[v] = r;
+  }
+  ret
+  `
+);
+
+testCodeResult(
+  "Switch Table Strings",
+  `
+  let ret = {};
+  let s = "";
+  for (let i = 0; i < 6; i += 1) {
+    s += "a";
+    let r = "";
+    switch (s) {
+      case "a": r = "one"; break;
+      case "aa": r = "two";
+      case "aaaa": r += "four"; break;
+      default: r = "other";
+    }
+    ret[i] = r;
+  }
+  ret
+  `
+);
+
+testCodeResult(
+  "Switch Table Mixed Keys",
+  `
+  let ret = {};
+  for (let i = 0; i < 4; i += 1) {
+    let v = i;
+    if (i === 2) v = "1";
+    if (i === 3) v = true;
+    let r = "";
+    switch (v) {
+      case 1: r = "number"; break;
+      case "1": r = "string"; break;
+      case 0: r = "zero"; break;
+      default: r = "default";
+    }
+    ret[i] = r;
+  }
+  ret
+  `
+);
+
+testCodeResult(
+  "Switch Table Continue Loop",
+  `
+  let x = 1;
+  for (let i = 1; i <= 10; i += 1) {
+    switch (i) {
+      case 5: continue;
+      case 2: x *= 3; continue;
+      case 7:
+    }
+    x *= 2;
+  }
+  x
+  `
+);
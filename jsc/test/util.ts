@@ -2,11 +2,33 @@ import { test, assertEqual } from "liltest";
 import { VM } from "../vm/vm";
 import { toJSValue } from "../vm/data";
 
+export interface TestProgram {
+  name: string;
+  code: string;
+  timeout: number;
+}
+
+let programs: TestProgram[] | undefined;
+
+/**
+ * After calling this function `testCodeResult` collects the programs instead
+ * of registering them as tests, it's used by `diff.ts`.
+ */
+export function collectPrograms(): TestProgram[] {
+  programs = [];
+  return programs;
+}
+
 export function testCodeResult(
   name: string,
   code: string,
   timeout = 1500
 ): void {
+  if (programs) {
+    programs.push({ name, code, timeout });
+    return;
+  }
+
   const testFunction = async function() {
     const vm = new VM({
       timeout
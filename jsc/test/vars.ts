@@ -3,3 +3,16 @@ import { testCodeResult } from "./util";
 testCodeResult("Basic Let", "let x = 1; x");
 testCodeResult("Let without initializer", "let x; x");
 // testCodeResult("Assign to Let", "let x, y; y = (x = 5) + 1; x * y");
+
+testCodeResult("Let in a block", "let x = 2; { let y = 3; x *= y } x");
+testCodeResult(
+  "Let in a loop body",
+  `
+  let x = 0;
+  for (let i = 0; i < 4; i += 1) {
+    let y = i * 2;
+    x += y
+  }
+  x
+`
+);
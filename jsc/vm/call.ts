@@ -27,6 +27,7 @@ import { CompiledData } from "../src/compiler";
 import { DataStack } from "./ds";
 import { Scope } from "./scope";
 import { ByteCode, byteCodeArgSize } from "../src/bytecode";
+import { lookupSwitchTable } from "../src/switch_table";
 import { Obj } from "./obj";
 import { compiler } from "./compiler";
 import { timer } from "./timer";
@@ -45,7 +46,31 @@ export async function call(
     return callable.fn(env, ...args) || Undefined;
   }
 
-  return await exec(callable.compiledData, callable.scope, env, args);
+  const scope = new Scope(false, callable.scope);
+  bindParameters(callable.compiledData, scope, args);
+  return await exec(callable.compiledData, scope, env, args);
+}
+
+// Define the parameters that are listed in the scope section of the function
+// (see `Scope.getBuffer`), the missing arguments are undefined.
+function bindParameters(data: CompiledData, scope: Scope, args: Value[]) {
+  const section = data.scope;
+  const count = section.getUint16(0);
+  let cursor = 2;
+  let index = 0;
+
+  for (let i = 0; i < count; ++i) {
+    const kind = section.get(cursor);
+    const name = section.getNetString16(cursor + 1);
+    cursor += 3 + name.length * 2;
+
+    if (kind === 1) {
+      cursor += 2;
+    } else if (kind === 2) {
+      scope.def(name, true, index < args.length ? args[index] : Undefined);
+      index += 1;
+    }
+  }
 }
 
 export async function exec(
@@ -400,6 +425,23 @@ export async function exec(
         break;
       }
 
+      case ByteCode.Diamond: {
+        // Only a hint for VMs with abstract values, see VM.md.
+        break;
+      }
+
+      case ByteCode.Switch: {
+        const offset = codeSection.getUint32(cursor + 1);
+        const value = getValue(dataStack.pop());
+        const key =
+          value.type === DataType.NumberValue ||
+          value.type === DataType.StringValue
+            ? value.value
+            : undefined;
+        nextCursor = lookupSwitchTable(constantPool, offset, key);
+        break;
+      }
+
       case ByteCode.Let: {
         const value = getValue(dataStack.pop());
         const offset = codeSection.getUint32(cursor + 1);
@@ -466,9 +508,16 @@ export async function exec(
         return getValue(dataStack.pop());
       }
 
-      case ByteCode.Call0: {
+      case ByteCode.Call0:
+      case ByteCode.Call1:
+      case ByteCode.Call2:
+      case ByteCode.Call3: {
+        const args: Value[] = [];
+        for (let i = bytecode - ByteCode.Call0; i > 0; --i) {
+          args.unshift(getValue(dataStack.pop()));
+        }
         const callable = getValue(dataStack.pop());
-        const ret = await call(callable, env, []);
+        const ret = await call(callable, env, args);
         dataStack.push(ret);
         break;
       }
@@ -1,8 +1,22 @@
+// The heap usage is only sampled once in this many instructions.
+const HEAP_SAMPLE_INTERVAL = 1024;
+
 class Timer {
   private timeout = -1;
   private currentStart = 0;
 
+  /**
+   * Number of instructions executed since the last `start()`.
+   */
+  instructions = 0;
+
+  /**
+   * Highest sampled heap usage since the last `start()`, in bytes.
+   */
+  peakHeap = 0;
+
   check(): void {
+    if (++this.instructions % HEAP_SAMPLE_INTERVAL === 0) this.sampleHeap();
     if (this.timeout < 0) return;
 
     if (Date.now() - this.currentStart > this.timeout)
@@ -12,6 +26,14 @@ class Timer {
   start(timeout: number): void {
     this.currentStart = Date.now();
     this.timeout = timeout;
+    this.instructions = 0;
+    this.peakHeap = 0;
+    this.sampleHeap();
+  }
+
+  sampleHeap(): void {
+    const heap = process.memoryUsage().heapUsed;
+    if (heap > this.peakHeap) this.peakHeap = heap;
   }
 }
 
@@ -10,6 +10,7 @@ import { Scope } from "./scope";
 import { exec } from "./call";
 import { Value } from "./data";
 import { compiler } from "./compiler";
+import { CompiledData } from "../src/compiler";
 import { DataStack } from "./ds";
 import { timer } from "./timer";
 
@@ -32,7 +33,10 @@ export class VM {
   }
 
   compileAndExec(source: string): Promise<Value> {
-    const main = compiler.compile(source);
+    return this.exec(compiler.compile(source));
+  }
+
+  exec(main: CompiledData): Promise<Value> {
     timer.start(this.timeout);
     return exec(main, this.scope, this.scope.obj, [], this.dataStack);
   }
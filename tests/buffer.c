@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <math.h>
+#include "wval.h"
+#include "context.h"
+#include "object.h"
+#include "array.h"
+#include "builtins.h"
+#include "buffer.h"
+
+// ArrayBuffer and the typed arrays: the conversions of the elements, the
+// constructors and the pages that a forked child copies when it writes.
+
+int failed = 0;
+
+void check(int condition, const char *what)
+{
+  if (condition)
+    return;
+  printf("FAIL: %s\n", what);
+  failed = 1;
+}
+
+int is_number(ws_val *value, double number)
+{
+  return value != NULL && value->type == WVAL_TYPE_NUMBER && value->data.number == number;
+}
+
+/**
+ * Call a global constructor the way `new name(...args)` does.
+ */
+ws_val *construct(ws_context *ctx, const char16_t *name, size_t size, ws_val **args, unsigned int argc)
+{
+  ws_val *fn = context_resolve(ctx, ws_string((char16_t *)name, size));
+  return fn->data.object->native(ctx, fn->data.object->self, args, argc);
+}
+
+#define CONSTRUCT(ctx, name, args, argc) construct(ctx, name, sizeof(name), args, argc)
+
+void test_elements(ws_context *ctx)
+{
+  ws_val *buffer, *bytes, *clamped, *floats, *args[1];
+  uint8_t raw[4];
+
+  buffer = ws_array_buffer(ctx, 8);
+  bytes = ws_typed_array_object(ctx, WS_TYPED_INT8, buffer, 0, 8);
+  clamped = ws_typed_array_object(ctx, WS_TYPED_UINT8_CLAMPED, buffer, 0, 8);
+  floats = ws_typed_array_object(ctx, WS_TYPED_FLOAT32, buffer, 4, 1);
+
+  typed_array_set(ctx, bytes->data.object, 0, ws_number(200));
+  check(is_number(typed_array_get(ctx, bytes->data.object, 0), -56), "Int8 wraps around");
+  typed_array_set(ctx, clamped->data.object, 1, ws_number(300));
+  check(is_number(typed_array_get(ctx, clamped->data.object, 1), 255), "Uint8Clamped clamps");
+  typed_array_set(ctx, clamped->data.object, 2, ws_number(2.5));
+  check(is_number(typed_array_get(ctx, clamped->data.object, 2), 2), "Uint8Clamped rounds to even");
+  typed_array_set(ctx, bytes->data.object, 3, ws_number(NAN));
+  check(is_number(typed_array_get(ctx, bytes->data.object, 3), 0), "NaN is stored as 0");
+
+  typed_array_set(ctx, floats->data.object, 0, ws_number(0.1));
+  check(is_number(typed_array_get(ctx, floats->data.object, 0), (float)0.1), "Float32 rounds");
+  check(typed_array_get(ctx, floats->data.object, 1) == NULL, "an index out of the bounds");
+
+  // The views share the buffer.
+  buffer_read(ctx, buffer->data.object, 0, raw, 4);
+  check(raw[0] == 200 && raw[1] == 255 && raw[2] == 2 && raw[3] == 0, "the bytes of the buffer");
+
+  args[0] = bytes;
+  floats = CONSTRUCT(ctx, u"Int16Array", args, 1);
+  check(is_number(typed_array_get_own(ctx, floats->data.object, ws_string((char16_t *)u"length", sizeof(u"length"))), 8),
+        "a copied typed array has the length of the source");
+  check(is_number(typed_array_get(ctx, floats->data.object, 0), -56), "a copied element");
+
+  args[0] = ws_number(3);
+  floats = CONSTRUCT(ctx, u"Float64Array", args, 1);
+  check(floats->data.object->typed->length == 3 && is_number(typed_array_get(ctx, floats->data.object, 2), 0),
+        "new Float64Array(3)");
+}
+
+void test_pages()
+{
+  ws_context *ctx = context_create(), *first, *second;
+  ws_val *buffer;
+  ws_buffer *parent_view, *view;
+  uint8_t byte = 1, value;
+
+  context_new_scope(ctx, 0);
+  buffer = ws_array_buffer(ctx, 3 * WS_BUFFER_PAGE_SIZE);
+  buffer_write(ctx, buffer->data.object, 0, &byte, 1);
+  buffer_write(ctx, buffer->data.object, 2 * WS_BUFFER_PAGE_SIZE, &byte, 1);
+  parent_view = buffer_view(ctx, buffer->data.object);
+  check(parent_view->pages[1] == NULL, "a page that was never written is not allocated");
+
+  context_fork(ctx, 2);
+  first = ctx->childs->ctx;
+  second = ctx->childs->next->ctx;
+
+  byte = 2;
+  buffer_write(first, buffer->data.object, 1, &byte, 1);
+  view = buffer_view(first, buffer->data.object);
+  check(view != parent_view, "a child that writes has its own page table");
+  check(view->pages[0] != parent_view->pages[0], "the written page is copied");
+  check(view->pages[2] == parent_view->pages[2], "the other pages are shared");
+  check(view->pages[1] == NULL, "a zero page stays unallocated");
+
+  buffer_read(first, buffer->data.object, 0, &value, 1);
+  check(value == 1, "the copied page has the data of the parent");
+  buffer_read(first, buffer->data.object, 1, &value, 1);
+  check(value == 2, "the child reads what it wrote");
+  buffer_read(second, buffer->data.object, 1, &value, 1);
+  check(value == 0, "the other child doesn't see the write");
+  check(buffer_view(second, buffer->data.object) == parent_view, "a child that only reads copies nothing");
+
+  // A second write to the same page doesn't copy it again.
+  buffer_write(first, buffer->data.object, 2, &byte, 1);
+  check(buffer_view(first, buffer->data.object)->pages[0] == view->pages[0], "a page is copied once");
+}
+
+int main()
+{
+  ws_context *ctx = context_create();
+
+  context_new_scope(ctx, 0);
+  builtins_define(ctx);
+  test_elements(ctx);
+  test_pages();
+  return failed;
+}
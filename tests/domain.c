@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <math.h>
+#include "wval.h"
+#include "context.h"
+#include "object.h"
+#include "builtins.h"
+#include "domain.h"
+
+// The abstract values, through the operations of domain.h and through the
+// `q` natives a script uses to make them.
+
+int failed = 0;
+
+void check(int condition, const char *what)
+{
+  if (condition)
+    return;
+  printf("FAIL: %s\n", what);
+  failed = 1;
+}
+
+int is_range(ws_val *value, double min, double max)
+{
+  return value != NULL && value->type == WVAL_TYPE_RANGE &&
+         value->data.range.min == min && value->data.range.max == max;
+}
+
+int is_nan(ws_val *value)
+{
+  return value != NULL && value->type == WVAL_TYPE_NUMBER && isnan(value->data.number);
+}
+
+/**
+ * Call `q[name](...args)` the way a script does.
+ */
+ws_val *q_call(ws_context *ctx, const char16_t *name, size_t size, ws_val **args, unsigned int argc)
+{
+  ws_val *q, *method;
+
+  q = context_resolve(ctx, ws_string((char16_t *)u"q", sizeof(u"q")));
+  method = object_get(ctx, q, ws_string((char16_t *)name, size));
+  return method->data.object->native(ctx, method->data.object->self, args, argc);
+}
+
+#define Q_CALL(ctx, name, args, argc) q_call(ctx, name, sizeof(name), args, argc)
+
+void test_arithmetic()
+{
+  ws_val *unit = ws_range(-1, 1), *nan = ws_number(NAN), *inf = ws_number(INFINITY);
+  ws_val *whole = ws_range(-INFINITY, INFINITY), *result;
+
+  check(is_range(domain_add(unit, &WS_ONE), 0, 2), "range + 1");
+  check(is_range(domain_sub(unit, unit), -2, 2), "range - range");
+  check(is_range(domain_mul(unit, &WS_TWO), -2, 2), "range * 2");
+  check(is_range(domain_neg(ws_range(1, 2)), -2, -1), "-range");
+
+  // NaN is never dropped from the result.
+  check(is_nan(domain_add(unit, nan)), "range + NaN");
+  result = domain_add(whole, inf);
+  check(result != NULL && domain_includes(result, nan), "(-Infinity, Infinity) + Infinity has NaN");
+  check(domain_includes(result, inf), "(-Infinity, Infinity) + Infinity has Infinity");
+  result = domain_mul(ws_range(0, 1), inf);
+  check(result != NULL && domain_includes(result, nan), "[0, 1] * Infinity has NaN");
+  check(!domain_includes(whole, nan), "a range has no NaN");
+}
+
+void test_compare(ws_context *ctx)
+{
+  ws_val *unit = ws_range(-1, 1);
+  ws_val *members[2] = {&WS_ONE, ws_number(5)};
+
+  check(domain_compare(DOMAIN_LT, unit, &WS_TWO) == &WS_TRUE, "range < 2");
+  check(domain_compare(DOMAIN_GT, unit, &WS_TWO) == &WS_FALSE, "range > 2");
+  check(domain_compare(DOMAIN_LT, unit, &WS_ZERO) == &WS_ANY_BOOLEAN, "range < 0");
+  check(domain_compare(DOMAIN_LT, ws_union(members, 2), ws_number(10)) == &WS_TRUE, "union < 10");
+  check(domain_compare(DOMAIN_LT, ws_number(NAN), unit) == &WS_FALSE, "NaN < range");
+  check(domain_strict_equal(unit, ws_number(7)) == &WS_FALSE, "range === 7");
+  check(domain_strict_equal(unit, &WS_ZERO) == &WS_ANY_BOOLEAN, "range === 0");
+  check(domain_not(ctx, &WS_ANY_BOOLEAN) == &WS_ANY_BOOLEAN, "!boolean");
+}
+
+void test_strings()
+{
+  ws_val *hello = ws_string((char16_t *)u"hello", sizeof(u"hello"));
+
+  check(domain_add(&WS_ANY_STRING, hello) == &WS_ANY_STRING, "string + \"hello\"");
+  check(domain_strict_equal(&WS_ANY_STRING, hello) == &WS_ANY_BOOLEAN, "string === \"hello\"");
+  check(domain_strict_equal(&WS_ANY_STRING, &WS_ONE) == &WS_FALSE, "string === 1");
+  check(domain_widen(hello, ws_string((char16_t *)u"world", sizeof(u"world"))) == &WS_ANY_STRING,
+        "widen two strings");
+}
+
+void test_widen()
+{
+  ws_val *members[2] = {&WS_ZERO, ws_number(NAN)};
+  ws_val *result;
+
+  check(is_range(domain_widen(&WS_ZERO, &WS_ONE), 0, INFINITY), "widen 0, 1");
+  check(is_range(domain_widen(&WS_ONE, &WS_ZERO), -INFINITY, 1), "widen 1, 0");
+  check(domain_widen(ws_range(0, 5), &WS_TWO)->type == WVAL_TYPE_RANGE, "widen an included value");
+
+  result = domain_widen(ws_union(members, 2), &WS_ONE);
+  check(result != NULL && domain_includes(result, ws_number(NAN)), "widen keeps NaN");
+  check(domain_includes(result, ws_number(1000)), "widen grows the bounds");
+}
+
+void test_q(ws_context *ctx)
+{
+  ws_val *args[3], *value, *options, *fn;
+
+  args[0] = ws_number(-1);
+  args[1] = &WS_ONE;
+  check(is_range(Q_CALL(ctx, u"FloatRange", args, 2), -1, 1), "q.FloatRange(-1, 1)");
+
+  args[0] = &WS_TRUE;
+  args[1] = &WS_FALSE;
+  value = Q_CALL(ctx, u"Union", args, 2);
+  check(value->type == WVAL_TYPE_UNION && value->data.set.size == 2, "q.Union(true, false)");
+  check(ws_to_boolean(ctx, value)->type != WVAL_TYPE_BOOLEAN, "q.Union(true, false) is ambiguous");
+
+  check(Q_CALL(ctx, u"String", args, 0) == &WS_ANY_STRING, "q.String()");
+
+  options = ws_object(ctx, NULL);
+  object_set(ctx, options, ws_string((char16_t *)u"returnType", sizeof(u"returnType")), ws_range(0, 2));
+  args[0] = options;
+  fn = Q_CALL(ctx, u"Callable", args, 1);
+  value = fn->data.object->native(ctx, fn->data.object->self, args, 0);
+  check(is_range(value, 0, 2), "q.Callable({ returnType })()");
+}
+
+int main()
+{
+  ws_context *ctx = context_create();
+
+  context_new_scope(ctx, 0);
+  builtins_define(ctx);
+
+  test_arithmetic();
+  test_compare(ctx);
+  test_strings();
+  test_widen();
+  test_q(ctx);
+
+  return failed;
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdint.h>
+#include "wval.h"
+#include "context.h"
+#include "compiler.h"
+#include "alloc.h"
+#include "gc.h"
+
+// A closure that outlives a forked branch: the scope it was created in has
+// overlays in the finished branch, in the live one and in their parent.  Only
+// the ones that a live context can see must be traced, in every collection.
+
+#ifdef WS_TRACING_GC
+
+int main()
+{
+  ws_context *ctx, *finished, *live;
+  ws_context_list item;
+  ws_function *function;
+  ws_val *x, *parent_value, *finished_value, *live_value;
+  unsigned long freed;
+
+  ctx = context_create();
+  context_new_scope(ctx, 0);
+  x = ws_string((char16_t *)u"x", sizeof(u"x"));
+  parent_value = ws_number(1);
+  context_define(ctx, x, parent_value, 1);
+
+  context_fork(ctx, 2);
+  finished = ctx->childs->ctx;
+  live = ctx->childs->next->ctx;
+
+  // Both branches shadow `x` of the parent.
+  finished_value = ws_number(2);
+  live_value = ws_number(3);
+  table_set(finished, &ctx->scope->table, x, finished_value);
+  table_set(live, &ctx->scope->table, x, live_value);
+
+  // `finished` is done, only the value in its own overlay is garbage, the
+  // shadowed one of the parent is still seen by the overlays of the scope.
+  item.ctx = live;
+  item.next = NULL;
+  freed = gc_collect(&item);
+  if (freed != 1)
+  {
+    printf("first collection freed %lu values, expected 1.\n", freed);
+    return 1;
+  }
+
+  // The slot of the value that was freed is taken by some garbage, tracing
+  // the overlay of `finished` again would keep it alive.
+  ws_number(4);
+
+  // A closure over the scope is made after the collection, it reaches the
+  // scope through the same overlays.
+  function = (ws_function *)ws_alloc(sizeof(*function));
+  function->scope = ctx->scope;
+  function->ref_count = 1;
+  function->id = 0;
+  function->data = NULL;
+  context_ds_push(live, ws_function_object(live, function));
+
+  freed = gc_collect(&item);
+  if (freed != 1 || parent_value->data.number != 1 ||
+      context_resolve(live, x) != live_value)
+  {
+    printf("second collection freed %lu values, expected 1.\n", freed);
+    return 1;
+  }
+
+  return 0;
+}
+
+#else
+
+int main()
+{
+  // Reference counting, there is no collector to test.
+  return 0;
+}
+
+#endif
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "wval.h"
+#include "context.h"
+#include "object.h"
+#include "array.h"
+#include "json.h"
+
+// JSON.parse and JSON.stringify, and json_describe that prints the result of
+// a branch.  The errors are thrown on the context instead of ending the
+// process.
+
+int failed = 0;
+
+ws_val *string(const char16_t *data, size_t size)
+{
+  return ws_string((char16_t *)data, size);
+}
+
+#define STRING(text) string(text, sizeof(text))
+
+/**
+ * Returns true if the string value has the same text as the ASCII `text`.
+ */
+int same_text(ws_val *value, const char *text)
+{
+  char16_t *data;
+  size_t length = strlen(text);
+
+  if (value->type != WVAL_TYPE_STRING || value->data.string.size != (length + 1) * sizeof(char16_t))
+    return 0;
+  data = ws_string_flatten(value);
+  for (size_t i = 0; i < length; ++i)
+    if (data[i] != (unsigned char)text[i])
+      return 0;
+  return 1;
+}
+
+void check(int condition, const char *what)
+{
+  if (condition)
+    return;
+  printf("FAIL: %s\n", what);
+  failed = 1;
+}
+
+void check_text(ws_val *value, const char *expected, const char *what)
+{
+  check(same_text(value, expected), what);
+}
+
+/**
+ * Returns a string of the ASCII text.
+ */
+ws_val *ascii(const char *text)
+{
+  size_t length = strlen(text);
+  char16_t *data;
+
+  data = (char16_t *)malloc((length + 1) * sizeof(char16_t));
+  for (size_t i = 0; i <= length; ++i)
+    data[i] = (unsigned char)text[i];
+  return ws_string(data, (length + 1) * sizeof(char16_t));
+}
+
+/**
+ * Stringify what the text parses to, it must be the same text.
+ */
+void check_round_trip(ws_context *ctx, const char *text, const char *what)
+{
+  check_text(json_stringify(ctx, json_parse(ctx, ascii(text)), &WS_UNDEFINED), text, what);
+}
+
+/**
+ * Returns `[[...[0]...]]` or `{"a":{"a":...{"a":0}...}}` nested `depth` times.
+ */
+char *nested(unsigned int depth, int object)
+{
+  char *text, *cursor;
+
+  text = cursor = (char *)malloc(depth * 6 + 2);
+  for (unsigned int i = 0; i < depth; ++i)
+  {
+    memcpy(cursor, object ? "{\"a\":" : "[", object ? 5 : 1);
+    cursor += object ? 5 : 1;
+  }
+  *cursor++ = '0';
+  for (unsigned int i = 0; i < depth; ++i)
+    *cursor++ = object ? '}' : ']';
+  *cursor = 0;
+  return text;
+}
+
+/**
+ * Returns the error that the call to JSON.parse or JSON.stringify threw, or
+ * NULL, the way exec_resume catches it.
+ */
+char *thrown(ws_context *ctx, const char *text, ws_val *value)
+{
+  jmp_buf handler;
+
+  ctx->error = NULL;
+  ctx->handler = &handler;
+  if (setjmp(handler) == 0)
+  {
+    if (text != NULL)
+      json_parse(ctx, ascii(text));
+    else
+      json_stringify(ctx, value, &WS_UNDEFINED);
+  }
+  ctx->handler = NULL;
+  return ctx->error;
+}
+
+void test_round_trip(ws_context *ctx)
+{
+  ws_val *value;
+  char *text;
+
+  check_round_trip(ctx, "null", "null");
+  check_round_trip(ctx, "[true,false,null]", "literals");
+  check_round_trip(ctx, "[0,-1,1.5,1e+21,1e-7,-0.25]", "numbers");
+  check_round_trip(ctx, "\"a\\\"b\\\\c\\n\\u0001\"", "escapes");
+  check_round_trip(ctx, "{\"a\":[],\"b\":{},\"c\":[{\"d\":\"e\"}]}", "empty containers");
+  check_text(json_stringify(ctx, json_parse(ctx, ascii(" { \"a\" : [ 1 , 2 ] } ")), &WS_UNDEFINED),
+             "{\"a\":[1,2]}",
+             "white space");
+  check_text(json_stringify(ctx, json_parse(ctx, ascii("{\"a\":[1,{\"b\":2}]}")), ws_number(2)),
+             "{\n  \"a\": [\n    1,\n    {\n      \"b\": 2\n    }\n  ]\n}",
+             "indent");
+
+  // Deeper than the C stack could take when the parser recursed.
+  text = nested(100000, 0);
+  value = json_parse(ctx, ascii(text));
+  for (int i = 0; i < 100000 && value->type == WVAL_TYPE_OBJECT; ++i)
+    value = array_get(ctx, value->data.object, 0);
+  check(value->type == WVAL_TYPE_NUMBER && value->data.number == 0, "parse 100000 nested arrays");
+  free(text);
+
+  text = nested(WS_JSON_MAX_DEPTH, 0);
+  check_round_trip(ctx, text, "nested arrays");
+  free(text);
+  text = nested(WS_JSON_MAX_DEPTH, 1);
+  check_round_trip(ctx, text, "nested objects");
+  free(text);
+}
+
+void test_errors(ws_context *ctx)
+{
+  ws_val *object;
+  char *text, *error;
+
+  check(thrown(ctx, "[1,]", NULL) != NULL, "a trailing comma throws");
+  check(thrown(ctx, "{\"a\" 1}", NULL) != NULL, "a missing colon throws");
+  check(thrown(ctx, "[1}", NULL) != NULL, "a wrong closer throws");
+  check(thrown(ctx, "[[1]", NULL) != NULL, "an unterminated array throws");
+  check(thrown(ctx, "{1:2}", NULL) != NULL, "a key that is not a string throws");
+  check(thrown(ctx, "1 2", NULL) != NULL, "a second value throws");
+  check(thrown(ctx, "[1]", NULL) == NULL, "a valid text doesn't throw");
+
+  object = ws_object(ctx, NULL);
+  object_set(ctx, object, STRING(u"self"), object);
+  error = thrown(ctx, NULL, object);
+  check(error != NULL && strstr(error, "circular") != NULL, "a cycle throws");
+
+  text = nested(WS_JSON_MAX_DEPTH + 1, 0);
+  error = thrown(ctx, NULL, json_parse(ctx, ascii(text)));
+  check(error != NULL && strstr(error, "deeply") != NULL, "too deep to stringify throws");
+  free(text);
+}
+
+void test_describe(ws_context *ctx)
+{
+  ws_val *object, *array, *members[2] = {&WS_ONE, &WS_TWO};
+
+  object = ws_object(ctx, NULL);
+  array = ws_array(ctx);
+  array_push(ctx, array->data.object, &WS_TRUE);
+  array_push(ctx, array->data.object, ws_range(0, 1));
+  array_push(ctx, array->data.object, &WS_UNDEFINED);
+  object_set(ctx, object, STRING(u"a"), array);
+  object_set(ctx, object, STRING(u"b"), ws_union(members, 2));
+  object_set(ctx, object, STRING(u"c"), &WS_UNDEFINED);
+  object_set(ctx, object, STRING(u"self"), object);
+
+  check_text(json_describe(ctx, object),
+             "{\"a\":[true,\"<abstract>\",null],\"b\":\"<abstract>\",\"self\":\"<cycle>\"}",
+             "describe an object");
+  check_text(json_describe(ctx, ws_object(ctx, NULL)), "{}", "describe an empty object");
+}
+
+int main()
+{
+  ws_context *ctx = context_create();
+
+  context_new_scope(ctx, 0);
+  test_round_trip(ctx);
+  test_errors(ctx);
+  test_describe(ctx);
+  return failed;
+}
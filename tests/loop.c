@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include "wval.h"
+#include "context.h"
+#include "output.h"
+
+// Loop widening, a branch whose loop state is included in the recorded one is
+// only subsumed if it wrote the same output.
+
+int exec_loop(ws_context *ctx, unsigned long header);
+
+int failed = 0;
+
+void check(int condition, const char *what)
+{
+  if (condition)
+    return;
+  printf("FAIL: %s\n", what);
+  failed = 1;
+}
+
+int main()
+{
+  ws_context *ctx, *child;
+  ws_val *i;
+
+  ctx = context_create();
+  context_new_scope(ctx, 0);
+  i = ws_string((char16_t *)u"i", sizeof(u"i"));
+  context_define(ctx, i, ws_range(0, 10), 0);
+
+  context_fork(ctx, 2);
+  child = ctx->childs->ctx;
+
+  check(exec_loop(child, 7), "the first iteration records the state");
+  check(exec_loop(child, 7) == 0 && child->subsumed, "the same state is subsumed");
+
+  child->subsumed = 0;
+  output_write(child, "a", 1);
+  check(exec_loop(child, 7) && !child->subsumed, "a branch that wrote something else is kept");
+  check(exec_loop(child, 7) == 0 && child->subsumed, "the same state and output is subsumed");
+
+  return failed;
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <string.h>
+#include "wval.h"
+#include "context.h"
+#include "object.h"
+#include "array.h"
+
+// The order of the keys of for-in: a key that was deleted and set again comes
+// after the others, in the same context and in a forked child, and the keys of
+// the elements of an array are shared instead of being made on every step.
+
+int failed = 0;
+
+void check(int condition, const char *what)
+{
+  if (condition)
+    return;
+  printf("FAIL: %s\n", what);
+  failed = 1;
+}
+
+ws_val *key(const char *text)
+{
+  size_t length = strlen(text);
+  char16_t *data = (char16_t *)ws_alloc((length + 1) * sizeof(char16_t));
+
+  for (size_t i = 0; i <= length; ++i)
+    data[i] = (unsigned char)text[i];
+  return ws_string(data, (length + 1) * sizeof(char16_t));
+}
+
+/**
+ * Returns true if for-in over the object visits exactly the keys in `keys`,
+ * a space separated list.
+ */
+int keys_are(ws_context *ctx, ws_val *object, const char *keys)
+{
+  ws_val *iterator, *next;
+  char expected[64], *name;
+
+  strcpy(expected, keys);
+  iterator = object_iterator(ctx, object);
+  for (name = strtok(expected, " "); name != NULL; name = strtok(NULL, " "))
+  {
+    next = object_next(ctx, iterator->data.iterator);
+    if (next == NULL || !wval_strict_equal(next, key(name)))
+      return 0;
+  }
+  return object_next(ctx, iterator->data.iterator) == NULL;
+}
+
+void test_readded(ws_context *ctx)
+{
+  ws_val *object = ws_object(ctx, NULL), *iterator;
+  ws_obj *obj = object->data.object;
+
+  object_set(ctx, object, key("a"), &WS_ONE);
+  object_set(ctx, object, key("b"), &WS_ONE);
+  object_set(ctx, object, key("c"), &WS_ONE);
+  table_del(ctx, &obj->properties, key("a"));
+  check(keys_are(ctx, object, "b c"), "a deleted key is not visited");
+  object_set(ctx, object, key("a"), &WS_TWO);
+  check(keys_are(ctx, object, "b c a"), "a key set again comes last");
+  check(object_get(ctx, object, key("a")) == &WS_TWO, "a key set again has the new value");
+
+  // An iterator that stands on the old slot still sees the keys after it.
+  iterator = object_iterator(ctx, object);
+  check(wval_strict_equal(object_next(ctx, iterator->data.iterator), key("b")), "first key");
+  table_del(ctx, &obj->properties, key("c"));
+  object_set(ctx, object, key("c"), &WS_ONE);
+  check(wval_strict_equal(object_next(ctx, iterator->data.iterator), key("a")), "key after a deleted one");
+  check(wval_strict_equal(object_next(ctx, iterator->data.iterator), key("c")), "the key set again");
+  check(object_next(ctx, iterator->data.iterator) == NULL, "no more keys");
+}
+
+void test_readded_in_child()
+{
+  ws_context *ctx = context_create(), *child;
+  ws_val *object;
+
+  context_new_scope(ctx, 0);
+  object = ws_object(ctx, NULL);
+  object_set(ctx, object, key("a"), &WS_ONE);
+  object_set(ctx, object, key("b"), &WS_ONE);
+
+  context_fork(ctx, 2);
+  child = ctx->childs->ctx;
+  table_del(child, &object->data.object->properties, key("a"));
+  object_set(child, object, key("a"), &WS_TWO);
+
+  check(keys_are(child, object, "b a"), "a key set again in a child comes last");
+  check(keys_are(ctx->childs->next->ctx, object, "a b"), "the other child keeps the order");
+}
+
+void test_index_keys(ws_context *ctx)
+{
+  ws_val *array = ws_array(ctx), *iterator, *first;
+
+  array_push(ctx, array->data.object, &WS_ONE);
+  array_push(ctx, array->data.object, &WS_TWO);
+  check(keys_are(ctx, array, "0 1"), "the keys of an array");
+
+  iterator = object_iterator(ctx, array);
+  first = object_next(ctx, iterator->data.iterator);
+  iterator = object_iterator(ctx, array);
+  check(object_next(ctx, iterator->data.iterator) == first, "the index keys are shared");
+  check(array_index_key(1) == array_index_key(1), "array_index_key(1) is shared");
+  check(wval_strict_equal(array_index_key(123456), key("123456")), "a large index key");
+}
+
+int main()
+{
+  ws_context *ctx = context_create();
+
+  context_new_scope(ctx, 0);
+  test_readded(ctx);
+  test_readded_in_child();
+  test_index_keys(ctx);
+  return failed;
+}
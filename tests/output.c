@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "wval.h"
+#include "context.h"
+#include "object.h"
+#include "builtins.h"
+#include "output.h"
+
+// `ws.write` from a script and the merge of the outputs of many branches.
+
+#define BRANCHES 4096
+
+ws_val *string(const char16_t *data, size_t size)
+{
+  return ws_string((char16_t *)data, size);
+}
+
+/**
+ * Call `ws.write(text)` the way a script does.
+ */
+void write_text(ws_context *ctx, ws_val *text)
+{
+  ws_val *ws, *write;
+
+  ws = context_resolve(ctx, string(u"ws", sizeof(u"ws")));
+  write = object_get(ctx, ws, string(u"write", sizeof(u"write")));
+  write->data.object->native(ctx, write->data.object->self, &text, 1);
+}
+
+int main()
+{
+  static ws_context_list items[BRANCHES];
+  ws_val *texts[3] = {
+      string(u"even\n", sizeof(u"even\n")),
+      string(u"odd\n", sizeof(u"odd\n")),
+      string(u"third\n", sizeof(u"third\n")),
+  };
+  char buffer[64];
+  unsigned int unique;
+  int fds[2];
+  ssize_t size;
+
+  for (unsigned int i = 0; i < BRANCHES; ++i)
+  {
+    items[i].ctx = context_create();
+    items[i].next = i + 1 < BRANCHES ? &items[i + 1] : NULL;
+    context_new_scope(items[i].ctx, 0);
+    builtins_define(items[i].ctx);
+    if (i % 3 != 2)
+      write_text(items[i].ctx, texts[i % 2]);
+    if (i == 4)
+      write_text(items[i].ctx, texts[2]);
+  }
+
+  if (pipe(fds) != 0)
+    return 1;
+  unique = output_merge(items, fds[1]);
+  close(fds[1]);
+  size = read(fds[0], buffer, sizeof(buffer) - 1);
+  buffer[size < 0 ? 0 : size] = 0;
+
+  if (unique != 3 || strcmp(buffer, "even\nodd\neven\nthird\n") != 0)
+  {
+    printf("unique=%u output=%s", unique, buffer);
+    return 1;
+  }
+
+  // The runner prints the size before the output, it must be what was written.
+  if (output_merged_size(items) != (size_t)size)
+  {
+    printf("merged size=%zu written=%zd\n", output_merged_size(items), size);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <string.h>
+#include "wval.h"
+#include "alloc.h"
+#include "regexp.h"
+
+// The backtracking matcher through regexp_exec: the captures of quantified
+// groups, lookarounds and backreferences, and the cache of compiled patterns.
+
+int failed = 0;
+
+void check(int condition, const char *what)
+{
+  if (condition)
+    return;
+  printf("FAIL: %s\n", what);
+  failed = 1;
+}
+
+/**
+ * An ASCII string as UTF-16, it's never freed.
+ */
+char16_t *utf16(const char *text)
+{
+  size_t length = strlen(text);
+  char16_t *data = (char16_t *)ws_alloc((length + 1) * sizeof(char16_t));
+
+  for (size_t i = 0; i <= length; ++i)
+    data[i] = (unsigned char)text[i];
+  return data;
+}
+
+ws_regexp *compile(const char *pattern, int flags)
+{
+  return regexp_compile(utf16(pattern), strlen(pattern), flags);
+}
+
+/**
+ * Returns true if the pattern matches the input with the captures in
+ * `expected`, separated by `,` and `-` for an undefined group, like the
+ * array that `exec` returns.  NULL expects no match.
+ */
+int exec_is(const char *pattern, const char *input, const char *expected)
+{
+  ws_regexp *regexp = compile(pattern, 0);
+  long captures[32];
+  char actual[256];
+  size_t size = 0;
+
+  if (!regexp_exec(regexp, utf16(input), strlen(input), 0, captures))
+    return expected == NULL;
+  if (expected == NULL)
+    return 0;
+
+  for (unsigned int i = 0; i < regexp->groups; ++i)
+  {
+    if (i > 0)
+      actual[size++] = ',';
+    if (captures[i * 2] < 0)
+    {
+      actual[size++] = '-';
+      continue;
+    }
+    for (long j = captures[i * 2]; j < captures[i * 2 + 1]; ++j)
+      actual[size++] = input[j];
+  }
+  actual[size] = 0;
+
+  if (strcmp(actual, expected) == 0)
+    return 1;
+  printf("%s on \"%s\" gave [%s]\n", pattern, input, actual);
+  return 0;
+}
+
+void test_quantified_groups()
+{
+  check(exec_is("(?:(a)|b)*c", "abc", "abc,-"), "/(?:(a)|b)*c/ clears (a) on the second iteration");
+  check(exec_is("(?:(a)|(b))+", "ab", "ab,-,b"), "/(?:(a)|(b))+/ keeps only the last iteration");
+  check(exec_is("(z)((a+)?(b+)?(c))*", "zaacbbbcac", "zaacbbbcac,z,ac,a,-,c"),
+        "the example of the spec");
+  // An iteration that fails gives the captures of the one before it back.
+  check(exec_is("(?:(a)b)*a", "aba", "aba,a"), "a failed iteration restores the captures");
+  check(exec_is("(a)?b", "b", "b,-"), "an optional group that is skipped");
+  check(exec_is("(?:(a)|b){2}", "ab", "ab,-"), "a counted quantifier clears the groups");
+}
+
+void test_lookaround()
+{
+  check(exec_is("a(?=b)", "ab", "a"), "a lookahead doesn't consume");
+  check(exec_is("a(?!b)", "ab", NULL), "a negative lookahead");
+  check(exec_is("a(?!b)", "ac", "a"), "a negative lookahead that passes");
+  check(exec_is("(?=(a+))a*b\\1", "baaabac", "aba,a"), "a lookahead keeps its captures");
+  check(exec_is("(?!(a)b)\\w", "ab", "b,-"), "a negative lookahead drops its captures");
+}
+
+void test_backrefs()
+{
+  check(exec_is("(a+)b\\1", "aabaa", "aabaa,aa"), "a backreference");
+  check(exec_is("(a+)b\\1", "aaba", "aba,a"), "a backreference that backtracks");
+  check(exec_is("\\1(a)", "a", "a,a"), "a backreference before its group is empty");
+  check(exec_is("(?:(a)|b)\\1c", "bc", "bc,-"), "a backreference to a group that didn't match");
+}
+
+void test_cache()
+{
+  ws_regexp *regexp = compile("a+b", 0);
+
+  check(compile("a+b", 0) == regexp, "a pattern is compiled once");
+  check(compile("a+b", WS_REGEXP_IGNORE_CASE) != regexp, "the flags are part of the key");
+  check(compile("a+c", 0) != regexp, "another pattern");
+  check(regexp_test(compile("A+B", WS_REGEXP_IGNORE_CASE), utf16("xaab"), 4, 0), "the i flag");
+}
+
+int main()
+{
+  test_quantified_groups();
+  test_lookaround();
+  test_backrefs();
+  test_cache();
+  return failed;
+}
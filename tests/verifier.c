@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "wval.h"
+#include "context.h"
+#include "compiler.h"
+#include "loader.h"
+#include "exec.h"
+
+// A function with an opcode that the interpreter does not implement must
+// keep the checks of the data stack, `LdNaN` doesn't push anything so the
+// `Pop` after it runs on an empty stack.  The functions that jsc compiles
+// (they all start with `LdScope`) are verified and run without the checks.
+
+static const uint8_t unimplemented_data[] = {
+    'W', 'S', 'C', '1',
+    1, 0, 0, 0, // Functions.
+    0, 0, 0, 0, // Id of the first function after the main one.
+    3, 0, 0, 0, // Code.
+    0, 0, 0, 0, // Constant pool.
+    2, 0, 0, 0, // Scope.
+    0, 0, 0, 0, // Map.
+    0x25,       // LdNaN
+    0x1c,       // Pop
+    0x1f,       // LdUndef
+    0, 0,       // No names in the scope.
+};
+
+// `jsc` output for `1 + 2;`.
+static const uint8_t add_data[] = {
+    'W', 'S', 'C', '2',
+    1, 0, 0, 0,  // Functions.
+    1, 0, 0, 0,  // Scripts.
+    1, 0, 0, 0,  // Id of the first function after the scripts.
+    0, 0, 0, 0,  // Constant pool.
+    4, 0, 0, 0,  // Code.
+    2, 0, 0, 0,  // Scope.
+    16, 0, 0, 0, // Map.
+    0x90,        // LdScope
+    0x24,        // LdOne
+    0x30,        // LdTwo
+    0x01,        // Add
+    0, 0,        // No names in the scope.
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 4, 0, 5, 0, 0, 0,
+};
+
+// `jsc` output for `true + 1;`, the interpreter can't add them yet.
+static const uint8_t unsupported_data[] = {
+    'W', 'S', 'C', '2',
+    1, 0, 0, 0,
+    1, 0, 0, 0,
+    1, 0, 0, 0,
+    0, 0, 0, 0,
+    4, 0, 0, 0,
+    2, 0, 0, 0,
+    16, 0, 0, 0,
+    0x90, // LdScope
+    0x21, // LdTrue
+    0x24, // LdOne
+    0x01, // Add
+    0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 7, 0, 8, 0, 0, 0,
+};
+
+ws_bundle *load(const uint8_t *data, size_t size)
+{
+  char path[] = "/tmp/ws-verifier-XXXXXX";
+  ws_bundle *bundle;
+  int fd;
+
+  fd = mkstemp(path);
+  if (fd < 0 || write(fd, data, size) != (ssize_t)size)
+    exit(1);
+  close(fd);
+
+  bundle = load_bundle(path);
+  unlink(path);
+  return bundle;
+}
+
+/**
+ * Run the main function in a child process, returns false if it crashed.  An
+ * error of the VM exits the process, that's fine.
+ */
+int runs(ws_bundle *bundle)
+{
+  ws_context *ctx;
+  int status;
+  pid_t pid;
+
+  pid = fork();
+  if (pid == 0)
+  {
+    ctx = context_create();
+    context_new_scope(ctx, 0);
+    exec(ctx, bundle->functions[0]);
+    exit(0);
+  }
+
+  return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status);
+}
+
+int main()
+{
+  ws_bundle *bundle;
+  ws_context *ctx;
+  ws_val *result;
+
+  bundle = load(unimplemented_data, sizeof(unimplemented_data));
+  if (bundle->functions[0]->verified)
+  {
+    printf("LdNaN is not implemented, the function must keep the checks.\n");
+    return 1;
+  }
+
+  // The checked pop dies with an error instead of reading a NULL entity.
+  if (!runs(bundle))
+  {
+    printf("The execution crashed.\n");
+    return 1;
+  }
+
+  bundle = load(add_data, sizeof(add_data));
+  if (!bundle->functions[0]->verified || bundle->functions[0]->max_stack != 2)
+  {
+    printf("The function compiled by jsc must be verified.\n");
+    return 1;
+  }
+
+  ctx = context_create();
+  context_new_scope(ctx, 0);
+  result = exec(ctx, bundle->functions[0]);
+  if (result == NULL || result->type != WVAL_TYPE_NUMBER || result->data.number != 3)
+  {
+    printf("1 + 2 is not 3.\n");
+    return 1;
+  }
+
+  // Without an operation for the operands nothing would be pushed for the
+  // unchecked pop that follows, it must die instead.
+  bundle = load(unsupported_data, sizeof(unsupported_data));
+  if (!bundle->functions[0]->verified || !runs(bundle))
+  {
+    printf("The verified function crashed.\n");
+    return 1;
+  }
+
+  return 0;
+}
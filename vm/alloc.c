@@ -1,10 +1,296 @@
+#include <stdint.h>
 #include "common.h"
 #include "alloc.h"
+#include "wval.h"
+#include "context.h"
+
+//==============================================================================
+// Memory accounting.
+
+/**
+ * Counters for the memory that is allocated outside of any context.
+ */
+struct _memory_counters memory_global;
+
+/**
+ * The context that the allocations of this thread are attributed to.
+ */
+_Thread_local ws_context *memory_current = NULL;
+
+/**
+ * Header in front of every allocation, it's 16 bytes so the alignment that
+ * malloc gives is preserved.
+ */
+struct _alloc_header
+{
+  ws_context *owner;
+  uint32_t category;
+  uint32_t size;
+};
+
+struct _memory_counters *memory_counters(ws_context *owner)
+{
+  return owner == NULL ? &memory_global : &owner->memory;
+}
+
+void memory_add(ws_context *owner, enum WS_MEMORY_CATEGORY category, long size)
+{
+  struct _memory_counters *counters = memory_counters(owner);
+  long total, peak;
+
+  atomic_fetch_add_explicit(&counters->live[category], size, memory_order_relaxed);
+  total = atomic_fetch_add_explicit(&counters->total, size, memory_order_relaxed) + size;
+
+  peak = atomic_load_explicit(&counters->peak, memory_order_relaxed);
+  while (total > peak &&
+         !atomic_compare_exchange_weak_explicit(&counters->peak, &peak, total,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+    ;
+}
+
+void memory_stats(struct _memory_counters *counters, ws_memory_stats *stats)
+{
+  for (int i = 0; i < WS_MEMORY_CATEGORIES; ++i)
+    stats->live[i] = atomic_load_explicit(&counters->live[i], memory_order_relaxed);
+  stats->total = atomic_load_explicit(&counters->total, memory_order_relaxed);
+  stats->peak = atomic_load_explicit(&counters->peak, memory_order_relaxed);
+  stats->overlays = 0;
+}
+
+ws_context *ws_set_current_context(ws_context *ctx)
+{
+  ws_context *previous = memory_current;
+  memory_current = ctx;
+  return previous;
+}
+
+void memory_global_stats(ws_memory_stats *stats)
+{
+  memory_stats(&memory_global, stats);
+}
+
+//==============================================================================
 
 void *ws_alloc(size_t size)
 {
-  void *ptr = malloc(size);
-  if (ptr == NULL)
+  return ws_alloc_as(WS_MEMORY_OTHER, size);
+}
+
+void *ws_alloc_as(enum WS_MEMORY_CATEGORY category, size_t size)
+{
+  struct _alloc_header *header;
+
+  if (size > UINT32_MAX)
+    die("Memory allocation is too large.");
+
+  header = (struct _alloc_header *)malloc(sizeof(*header) + size);
+  if (header == NULL)
     die("Memory allocation failed.");
-  return ptr;
-}
\ No newline at end of file
+
+  header->owner = memory_current;
+  header->category = category;
+  header->size = size;
+  memory_add(header->owner, category, size);
+  return header + 1;
+}
+
+void ws_free(void *ptr)
+{
+  struct _alloc_header *header;
+
+  if (ptr == NULL)
+    return;
+
+  header = (struct _alloc_header *)ptr - 1;
+  memory_add(header->owner, header->category, -(long)header->size);
+  free(header);
+}
+
+//==============================================================================
+// Pools.
+//
+// A free block is a node in a singly linked list, the first word points to
+// the next block. In the depot each batch is a list of WS_POOL_BATCH blocks
+// and the second word of its first block points to the next batch, that's
+// why a block is at least two pointers large.
+//
+// A block in use starts with the owner context (for the accounting) and the
+// struct comes after it.
+
+#define POOL_BLOCK_SIZE(type) \
+  (sizeof(ws_context *) +     \
+   (sizeof(type) > sizeof(void *) ? sizeof(type) : sizeof(void *)))
+
+enum POOL_ID
+{
+  POOL_VAL,
+  POOL_OBJ,
+  POOL_SCOPE,
+  POOL_DS_ENTITY,
+  POOL_CONTEXT_LIST,
+  POOL_TABLE_SLOT,
+  POOL_COUNT
+};
+
+ws_pool pool_val = {POOL_VAL, POOL_BLOCK_SIZE(ws_val), WS_MEMORY_VALUES, ATOMIC_FLAG_INIT, NULL};
+ws_pool pool_obj = {POOL_OBJ, POOL_BLOCK_SIZE(ws_obj), WS_MEMORY_VALUES, ATOMIC_FLAG_INIT, NULL};
+ws_pool pool_scope = {POOL_SCOPE, POOL_BLOCK_SIZE(ws_scope), WS_MEMORY_SCOPES, ATOMIC_FLAG_INIT, NULL};
+ws_pool pool_ds_entity = {POOL_DS_ENTITY, POOL_BLOCK_SIZE(ws_ds_entity), WS_MEMORY_STACK, ATOMIC_FLAG_INIT, NULL};
+ws_pool pool_context_list = {POOL_CONTEXT_LIST, POOL_BLOCK_SIZE(ws_context_list), WS_MEMORY_OTHER, ATOMIC_FLAG_INIT, NULL};
+ws_pool pool_table_slot = {POOL_TABLE_SLOT, POOL_BLOCK_SIZE(struct _table_slot), WS_MEMORY_TABLES, ATOMIC_FLAG_INIT, NULL};
+
+/**
+ * Free blocks of the current thread for each pool.
+ */
+_Thread_local struct _pool_cache
+{
+  void *head;
+  unsigned int size;
+} pool_cache[POOL_COUNT];
+
+#define POOL_NEXT(block) (((void **)(block))[0])
+#define POOL_NEXT_BATCH(block) (((void **)(block))[1])
+
+void pool_lock(ws_pool *pool)
+{
+  while (atomic_flag_test_and_set_explicit(&pool->lock, memory_order_acquire))
+    ;
+}
+
+void pool_unlock(ws_pool *pool)
+{
+  atomic_flag_clear_explicit(&pool->lock, memory_order_release);
+}
+
+/**
+ * Fill the empty thread cache with a batch from the depot or a new slab.
+ */
+void pool_refill(ws_pool *pool, struct _pool_cache *cache)
+{
+  char *slab;
+  void *batch;
+
+  pool_lock(pool);
+  batch = pool->depot;
+  if (batch != NULL)
+    pool->depot = POOL_NEXT_BATCH(batch);
+  pool_unlock(pool);
+
+  if (batch == NULL)
+  {
+    // Slabs are not accounted, only the blocks that are in use.
+    slab = (char *)malloc(pool->size * WS_POOL_BATCH);
+    if (slab == NULL)
+      die("Memory allocation failed.");
+    for (unsigned int i = 0; i < WS_POOL_BATCH - 1; ++i)
+      POOL_NEXT(slab + i * pool->size) = slab + (i + 1) * pool->size;
+    POOL_NEXT(slab + (WS_POOL_BATCH - 1) * pool->size) = NULL;
+    batch = slab;
+  }
+
+  cache->head = batch;
+  cache->size = WS_POOL_BATCH;
+}
+
+/**
+ * Move one batch from the thread cache to the depot.
+ */
+void pool_flush(ws_pool *pool, struct _pool_cache *cache)
+{
+  void *batch, *last;
+
+  batch = cache->head;
+  last = batch;
+  for (unsigned int i = 1; i < WS_POOL_BATCH; ++i)
+    last = POOL_NEXT(last);
+
+  cache->head = POOL_NEXT(last);
+  cache->size -= WS_POOL_BATCH;
+  POOL_NEXT(last) = NULL;
+
+  pool_lock(pool);
+  POOL_NEXT_BATCH(batch) = pool->depot;
+  pool->depot = batch;
+  pool_unlock(pool);
+}
+
+void *pool_alloc(ws_pool *pool)
+{
+  struct _pool_cache *cache = &pool_cache[pool->id];
+  void *block;
+
+  if (cache->size == 0)
+    pool_refill(pool, cache);
+
+  block = cache->head;
+  cache->head = POOL_NEXT(block);
+  --cache->size;
+
+  *(ws_context **)block = memory_current;
+  memory_add(memory_current, pool->category, pool->size);
+  return (ws_context **)block + 1;
+}
+
+void pool_free(ws_pool *pool, void *ptr)
+{
+  struct _pool_cache *cache = &pool_cache[pool->id];
+
+  if (ptr == NULL)
+    return;
+
+  ptr = (ws_context **)ptr - 1;
+  memory_add(*(ws_context **)ptr, pool->category, -(long)pool->size);
+
+  POOL_NEXT(ptr) = cache->head;
+  cache->head = ptr;
+  ++cache->size;
+
+  // Keep one batch around so alloc/free at the edge does not hit the depot.
+  if (cache->size >= 2 * WS_POOL_BATCH)
+    pool_flush(pool, cache);
+}
+
+void pool_reserve(ws_pool *pool, unsigned int n)
+{
+  struct _pool_cache *cache = &pool_cache[pool->id];
+  struct _pool_cache batch;
+  void *last;
+
+  while (cache->size < n)
+  {
+    batch.size = 0;
+    pool_refill(pool, &batch);
+
+    last = batch.head;
+    while (POOL_NEXT(last) != NULL)
+      last = POOL_NEXT(last);
+
+    POOL_NEXT(last) = cache->head;
+    cache->head = batch.head;
+    cache->size += batch.size;
+  }
+}
+
+#define POOL_HELPERS(name, type)               \
+  type *ws_alloc_##name()                      \
+  {                                            \
+    return (type *)pool_alloc(&pool_##name);   \
+  }                                            \
+                                               \
+  void ws_free_##name(type *ptr)               \
+  {                                            \
+    pool_free(&pool_##name, ptr);              \
+  }
+
+POOL_HELPERS(val, ws_val)
+POOL_HELPERS(obj, ws_obj)
+POOL_HELPERS(scope, ws_scope)
+POOL_HELPERS(ds_entity, ws_ds_entity)
+POOL_HELPERS(context_list, ws_context_list)
+POOL_HELPERS(table_slot, struct _table_slot)
+
+void ws_reserve_ds_entities(unsigned int n)
+{
+  pool_reserve(&pool_ds_entity, n);
+}
@@ -0,0 +1,350 @@
+#include <string.h>
+#include <math.h>
+#include "array.h"
+#include "context.h"
+#include "alloc.h"
+#include "common.h"
+
+// For documentation and comments see array.h :)
+
+/**
+ * Key of the copies in `copies`, ws_symbol never uses the id 0.
+ */
+ws_val WS_ELEMENTS_KEY = {.type = WVAL_TYPE_SYMBOL, .data.symbol = {.description = NULL, .id = 0}, .ref_count = 2727};
+
+/**
+ * Arrays don't grow more than this many holes at once, real engines switch
+ * to a dictionary for sparse arrays and we don't have one.
+ */
+#define WS_ELEMENTS_MAX_GAP 1024
+
+/**
+ * The keys of the smaller indices are made once and shared, so for-in over an
+ * array doesn't make a string for every element.
+ */
+#define WS_INDEX_KEYS 1024
+
+ws_val *_Atomic array_index_keys[WS_INDEX_KEYS];
+
+size_t elements_slot_size(enum WS_ELEMENTS_KIND kind)
+{
+  return kind == WS_ELEMENTS_PACKED_DOUBLES ? sizeof(double) : sizeof(ws_val *);
+}
+
+ws_elements *elements_alloc(unsigned int owner,
+                            enum WS_ELEMENTS_KIND kind,
+                            size_t capacity)
+{
+  ws_elements *elements;
+
+  elements = (ws_elements *)ws_alloc_as(WS_MEMORY_VALUES, sizeof(ws_elements));
+  elements->kind = kind;
+  elements->owner = owner;
+  elements->length = 0;
+  elements->capacity = capacity;
+  elements->data.values = capacity == 0
+                              ? NULL
+                              : ws_alloc_as(WS_MEMORY_VALUES,
+                                            capacity * elements_slot_size(kind));
+  elements->next = NULL;
+  return elements;
+}
+
+/**
+ * Make room for at least `capacity` elements.
+ */
+void elements_reserve(ws_elements *elements, size_t capacity)
+{
+  void *data;
+  size_t size;
+
+  if (capacity <= elements->capacity)
+    return;
+
+  if (capacity < elements->capacity * 2)
+    capacity = elements->capacity * 2;
+  if (capacity < 4)
+    capacity = 4;
+
+  size = elements_slot_size(elements->kind);
+  data = ws_alloc_as(WS_MEMORY_VALUES, capacity * size);
+  if (elements->length > 0)
+    memcpy(data, elements->data.values, elements->length * size);
+  ws_free(elements->data.values);
+  elements->data.values = data;
+  elements->capacity = capacity;
+}
+
+/**
+ * Box the doubles, so the storage can hold any value.
+ */
+void elements_box(ws_elements *elements)
+{
+  ws_val **values;
+
+  if (elements->kind != WS_ELEMENTS_PACKED_DOUBLES)
+    return;
+
+  values = NULL;
+  if (elements->capacity > 0)
+    values = (ws_val **)ws_alloc_as(WS_MEMORY_VALUES,
+                                    elements->capacity * sizeof(ws_val *));
+
+  for (size_t i = 0; i < elements->length; ++i)
+  {
+    values[i] = ws_number(elements->data.doubles[i]);
+    wval_retain(values[i]);
+  }
+
+  ws_free(elements->data.doubles);
+  elements->data.values = values;
+  elements->kind = WS_ELEMENTS_PACKED;
+}
+
+/**
+ * Returns the storage that the context can write to, the first write of a
+ * context copies the storage that it sees.
+ */
+ws_elements *array_writable(ws_context *ctx, ws_obj *array)
+{
+  ws_elements *elements, *copy, *head;
+
+  elements = array_elements(ctx, array);
+  if (elements->owner == ctx->id)
+    return elements;
+
+  copy = elements_alloc(ctx->id, elements->kind, elements->length);
+  copy->length = elements->length;
+  if (elements->length > 0)
+    memcpy(copy->data.values,
+           elements->data.values,
+           elements->length * elements_slot_size(elements->kind));
+
+  if (copy->kind != WS_ELEMENTS_PACKED_DOUBLES)
+    for (size_t i = 0; i < copy->length; ++i)
+      wval_retain(copy->data.values[i]);
+
+  table_set(ctx, &array->copies, &WS_ELEMENTS_KEY, copy);
+
+  // Siblings in other threads may copy the same array.
+  head = atomic_load(&array->elements->next);
+  do
+    copy->next = head;
+  while (!atomic_compare_exchange_weak(&array->elements->next, &head, copy));
+
+  return copy;
+}
+
+ws_val *ws_array(ws_context *ctx)
+{
+  ws_val *value;
+  ws_obj *array;
+
+  value = ws_object(ctx, NULL);
+  array = value->data.object;
+  array->elements = elements_alloc(ctx->id, WS_ELEMENTS_PACKED_DOUBLES, 0);
+  table_init(ctx, &array->copies);
+  return value;
+}
+
+ws_elements *array_elements(ws_context *ctx, ws_obj *array)
+{
+  ws_elements *copy;
+
+  // An array that is used by the context it was created in.
+  if (array->elements->owner == ctx->id)
+    return array->elements;
+
+  copy = (ws_elements *)table_get(ctx, &array->copies, &WS_ELEMENTS_KEY);
+  return copy == NULL ? array->elements : copy;
+}
+
+int array_index(ws_val *key, size_t *index)
+{
+  char16_t *data;
+  size_t length, result;
+  double number;
+
+  if (key->type == WVAL_TYPE_NUMBER)
+  {
+    number = key->data.number;
+    // 2^32 - 1 is the largest length, so it's not an index.
+    if (!(number >= 0 && number < 4294967295.0) || number != floor(number))
+      return 0;
+    *index = (size_t)number;
+    return 1;
+  }
+
+  if (key->type != WVAL_TYPE_STRING)
+    return 0;
+
+  // The size counts the terminating zero.
+  length = key->data.string.size / sizeof(char16_t) - 1;
+  if (length == 0 || length > 10)
+    return 0;
+
+  data = ws_string_flatten(key);
+  if (data[0] == '0' && length > 1)
+    return 0;
+
+  result = 0;
+  for (size_t i = 0; i < length; ++i)
+  {
+    if (data[i] < '0' || data[i] > '9')
+      return 0;
+    result = result * 10 + (data[i] - '0');
+  }
+
+  if (result >= 4294967295u)
+    return 0;
+
+  *index = result;
+  return 1;
+}
+
+/**
+ * Returns a new string of the index, if `shared` is set the string is made
+ * outside of the GC heap like the constants of the code.
+ */
+ws_val *array_index_string(size_t index, int shared)
+{
+  char16_t digits[20], *data;
+  size_t length = 0;
+  ws_val *value;
+
+  do
+  {
+    digits[length++] = '0' + index % 10;
+    index /= 10;
+  } while (index > 0);
+
+  data = (char16_t *)ws_alloc_as(WS_MEMORY_VALUES, (length + 1) * sizeof(char16_t));
+  for (size_t i = 0; i < length; ++i)
+    data[i] = digits[length - 1 - i];
+  data[length] = 0;
+
+  if (!shared)
+    return ws_string(data, (length + 1) * sizeof(char16_t));
+
+  value = (ws_val *)ws_alloc_as(WS_MEMORY_VALUES, sizeof(ws_val));
+  value->type = WVAL_TYPE_STRING;
+  value->ref_count = 1;
+#ifdef WS_TRACING_GC
+  value->marked = 0;
+#endif
+  value->data.string.data = data;
+  value->data.string.size = (length + 1) * sizeof(char16_t);
+  value->data.string.left = NULL;
+  value->data.string.right = NULL;
+  value->data.string.owns_data = 0;
+  return value;
+}
+
+ws_val *array_index_key(size_t index)
+{
+  ws_val *key, *expected = NULL;
+
+  if (index >= WS_INDEX_KEYS)
+    return array_index_string(index, 0);
+
+  key = atomic_load_explicit(&array_index_keys[index], memory_order_acquire);
+  if (key != NULL)
+    return key;
+
+  // Another thread may make the same key, the first one is kept.
+  key = array_index_string(index, 1);
+  if (!atomic_compare_exchange_strong_explicit(&array_index_keys[index], &expected, key,
+                                               memory_order_acq_rel, memory_order_acquire))
+  {
+    ws_free(key->data.string.data);
+    ws_free(key);
+    key = expected;
+  }
+  return key;
+}
+
+ws_val *array_get(ws_context *ctx, ws_obj *array, size_t index)
+{
+  ws_elements *elements;
+
+  elements = array_elements(ctx, array);
+  if (index >= elements->length)
+    return NULL;
+
+  if (elements->kind == WS_ELEMENTS_PACKED_DOUBLES)
+    return ws_number(elements->data.doubles[index]);
+
+  return elements->data.values[index];
+}
+
+ws_val *array_get_own(ws_context *ctx, ws_obj *array, ws_val *key)
+{
+  static const char16_t length_key[] = u"length";
+  size_t index;
+
+  if (array_index(key, &index))
+    return array_get(ctx, array, index);
+
+  if (key->type == WVAL_TYPE_STRING &&
+      key->data.string.size == sizeof(length_key) &&
+      memcmp(ws_string_flatten(key), length_key, sizeof(length_key) - sizeof(char16_t)) == 0)
+    return ws_number(array_elements(ctx, array)->length);
+
+  return NULL;
+}
+
+void array_set(ws_context *ctx, ws_obj *array, size_t index, ws_val *value)
+{
+  ws_elements *elements;
+
+  elements = array_writable(ctx, array);
+
+  if (index > elements->length)
+  {
+    if (index - elements->length > WS_ELEMENTS_MAX_GAP)
+      die("array_set: Sparse arrays are not supported.");
+    elements_box(elements);
+    elements->kind = WS_ELEMENTS_HOLEY;
+  }
+
+  if (value->type != WVAL_TYPE_NUMBER)
+    elements_box(elements);
+
+  elements_reserve(elements, index + 1);
+
+  if (elements->kind == WS_ELEMENTS_PACKED_DOUBLES)
+  {
+    elements->data.doubles[index] = value->data.number;
+  }
+  else
+  {
+    wval_retain(value);
+    if (index < elements->length)
+      wval_release(elements->data.values[index]);
+    for (size_t i = elements->length; i < index; ++i)
+      elements->data.values[i] = NULL;
+    elements->data.values[index] = value;
+  }
+
+  if (index >= elements->length)
+    elements->length = index + 1;
+}
+
+void array_push(ws_context *ctx, ws_obj *array, ws_val *value)
+{
+  array_set(ctx, array, array_elements(ctx, array)->length, value);
+}
+
+void array_free(ws_obj *array)
+{
+  ws_elements *elements, *next;
+
+  for (elements = array->elements; elements != NULL; elements = next)
+  {
+    next = elements->next;
+    ws_free(elements->data.values);
+    ws_free(elements);
+  }
+
+  table_destroy_all(&array->copies);
+}
@@ -0,0 +1,403 @@
+#include <string.h>
+#include <math.h>
+#include "buffer.h"
+#include "array.h"
+#include "context.h"
+#include "alloc.h"
+#include "common.h"
+
+// For documentation and comments see buffer.h :)
+
+/**
+ * Key of the copies in `copies`, ws_symbol never uses the id 0.
+ */
+ws_val WS_BUFFER_KEY = {.type = WVAL_TYPE_SYMBOL, .data.symbol = {.description = NULL, .id = 0}, .ref_count = 2727};
+
+const unsigned char WS_TYPED_SHIFT[] = {0, 0, 0, 1, 1, 2, 2, 2, 3};
+
+/**
+ * Returns true if the key is the given string.
+ */
+int buffer_key_is(ws_val *key, const char16_t *name, size_t size)
+{
+  return key->type == WVAL_TYPE_STRING && key->data.string.size == size &&
+         memcmp(ws_string_flatten(key), name, size - sizeof(char16_t)) == 0;
+}
+
+#define BUFFER_KEY_IS(key, name) buffer_key_is(key, name, sizeof(name))
+
+size_t buffer_pages_count(size_t byte_length)
+{
+  return (byte_length + WS_BUFFER_PAGE_MASK) >> WS_BUFFER_PAGE_BITS;
+}
+
+ws_buffer *buffer_alloc(unsigned int owner, size_t byte_length)
+{
+  ws_buffer *buffer;
+  size_t count;
+
+  count = buffer_pages_count(byte_length);
+  buffer = (ws_buffer *)ws_alloc_as(WS_MEMORY_VALUES, sizeof(ws_buffer));
+  buffer->owner = owner;
+  buffer->byte_length = byte_length;
+  buffer->pages = count == 0 ? NULL
+                             : (ws_buffer_page **)ws_alloc_as(WS_MEMORY_VALUES,
+                                                              count * sizeof(ws_buffer_page *));
+  buffer->next = NULL;
+  buffer->page_list = NULL;
+  if (count > 0)
+    memset(buffer->pages, 0, count * sizeof(ws_buffer_page *));
+  return buffer;
+}
+
+/**
+ * Returns the page table that the context can write to, the first write of
+ * a context copies the table that it sees but not the pages.
+ */
+ws_buffer *buffer_writable(ws_context *ctx, ws_obj *object)
+{
+  ws_buffer *buffer, *copy, *head;
+
+  buffer = buffer_view(ctx, object);
+  if (buffer->owner == ctx->id)
+    return buffer;
+
+  copy = buffer_alloc(ctx->id, buffer->byte_length);
+  if (buffer->byte_length > 0)
+    memcpy(copy->pages,
+           buffer->pages,
+           buffer_pages_count(buffer->byte_length) * sizeof(ws_buffer_page *));
+
+  table_set(ctx, &object->copies, &WS_BUFFER_KEY, copy);
+
+  // Siblings in other threads may copy the same buffer.
+  head = atomic_load(&object->buffer->next);
+  do
+    copy->next = head;
+  while (!atomic_compare_exchange_weak(&object->buffer->next, &head, copy));
+
+  return copy;
+}
+
+/**
+ * Returns the page that the context can write to, a page that the context
+ * doesn't own is copied (or allocated if it's still all zeros).
+ */
+ws_buffer_page *buffer_page_writable(ws_context *ctx, ws_obj *object, size_t index)
+{
+  ws_buffer *buffer;
+  ws_buffer_page *page, *copy, *head;
+
+  buffer = buffer_writable(ctx, object);
+  page = buffer->pages[index];
+  if (page != NULL && page->owner == ctx->id)
+    return page;
+
+  copy = (ws_buffer_page *)ws_alloc_as(WS_MEMORY_VALUES, sizeof(ws_buffer_page));
+  copy->owner = ctx->id;
+  if (page == NULL)
+    memset(copy->data, 0, WS_BUFFER_PAGE_SIZE);
+  else
+    memcpy(copy->data, page->data, WS_BUFFER_PAGE_SIZE);
+
+  head = atomic_load(&object->buffer->page_list);
+  do
+    copy->next = head;
+  while (!atomic_compare_exchange_weak(&object->buffer->page_list, &head, copy));
+
+  buffer->pages[index] = copy;
+  return copy;
+}
+
+ws_val *ws_array_buffer(ws_context *ctx, size_t byte_length)
+{
+  ws_val *value;
+  ws_obj *object;
+
+  if (byte_length > WS_BUFFER_MAX_LENGTH)
+    die("ArrayBuffer: Invalid array buffer length.");
+
+  value = ws_object(ctx, NULL);
+  object = value->data.object;
+  object->buffer = buffer_alloc(ctx->id, byte_length);
+  table_init(ctx, &object->copies);
+  return value;
+}
+
+ws_buffer *buffer_view(ws_context *ctx, ws_obj *object)
+{
+  ws_buffer *copy;
+
+  // A buffer that is used by the context it was created in.
+  if (object->buffer->owner == ctx->id)
+    return object->buffer;
+
+  copy = (ws_buffer *)table_get(ctx, &object->copies, &WS_BUFFER_KEY);
+  return copy == NULL ? object->buffer : copy;
+}
+
+void buffer_read(ws_context *ctx, ws_obj *object, size_t offset, void *data, size_t size)
+{
+  ws_buffer *buffer;
+  ws_buffer_page *page;
+  size_t n;
+
+  buffer = buffer_view(ctx, object);
+  while (size > 0)
+  {
+    page = buffer->pages[offset >> WS_BUFFER_PAGE_BITS];
+    n = WS_BUFFER_PAGE_SIZE - (offset & WS_BUFFER_PAGE_MASK);
+    if (n > size)
+      n = size;
+
+    if (page == NULL)
+      memset(data, 0, n);
+    else
+      memcpy(data, page->data + (offset & WS_BUFFER_PAGE_MASK), n);
+
+    data = (uint8_t *)data + n;
+    offset += n;
+    size -= n;
+  }
+}
+
+void buffer_write(ws_context *ctx, ws_obj *object, size_t offset, const void *data, size_t size)
+{
+  ws_buffer_page *page;
+  size_t n;
+
+  while (size > 0)
+  {
+    page = buffer_page_writable(ctx, object, offset >> WS_BUFFER_PAGE_BITS);
+    n = WS_BUFFER_PAGE_SIZE - (offset & WS_BUFFER_PAGE_MASK);
+    if (n > size)
+      n = size;
+
+    memcpy(page->data + (offset & WS_BUFFER_PAGE_MASK), data, n);
+
+    data = (const uint8_t *)data + n;
+    offset += n;
+    size -= n;
+  }
+}
+
+ws_val *buffer_get_own(ws_context *ctx, ws_obj *object, ws_val *key)
+{
+  (void)ctx;
+
+  if (BUFFER_KEY_IS(key, u"byteLength"))
+    return ws_number(object->buffer->byte_length);
+
+  return NULL;
+}
+
+void buffer_free(ws_obj *object)
+{
+  ws_buffer *buffer, *next;
+  ws_buffer_page *page, *next_page;
+
+  for (page = object->buffer->page_list; page != NULL; page = next_page)
+  {
+    next_page = page->next;
+    ws_free(page);
+  }
+
+  for (buffer = object->buffer; buffer != NULL; buffer = next)
+  {
+    next = buffer->next;
+    ws_free(buffer->pages);
+    ws_free(buffer);
+  }
+
+  table_destroy_all(&object->copies);
+}
+
+//==============================================================================
+// Typed arrays.
+
+/**
+ * ToUint32 of a number, the integer kinds keep the low bits of it.
+ */
+uint32_t typed_array_uint32(double number)
+{
+  if (!isfinite(number))
+    return 0;
+
+  number = fmod(trunc(number), 4294967296.0);
+  if (number < 0)
+    number += 4294967296.0;
+  return (uint32_t)number;
+}
+
+/**
+ * ToNumber for the values that don't need a call.
+ */
+double typed_array_number(ws_val *value)
+{
+  switch (value->type)
+  {
+  case WVAL_TYPE_NUMBER:
+    return value->data.number;
+  case WVAL_TYPE_BOOLEAN:
+    return value->data.boolean ? 1 : 0;
+  case WVAL_TYPE_NULL:
+    return 0;
+  case WVAL_TYPE_UNDEFINED:
+    return NAN;
+  default:
+    // TODO(qti3e) ToNumber for the other values.
+    die("typed_array: Only primitive numbers can be stored.");
+    return 0;
+  }
+}
+
+ws_val *ws_typed_array_object(ws_context *ctx,
+                              enum WS_TYPED_KIND kind,
+                              ws_val *buffer,
+                              size_t byte_offset,
+                              size_t length)
+{
+  ws_val *value;
+  ws_typed_array *typed;
+  unsigned char shift = WS_TYPED_SHIFT[kind];
+
+  if (buffer->type != WVAL_TYPE_OBJECT || buffer->data.object->buffer == NULL)
+    die("typed_array: Value is not an ArrayBuffer.");
+  if (byte_offset & ((1u << shift) - 1))
+    die("typed_array: Start offset should be a multiple of the element size.");
+  if (byte_offset > buffer->data.object->buffer->byte_length ||
+      length > (buffer->data.object->buffer->byte_length - byte_offset) >> shift)
+    die("typed_array: Invalid typed array length.");
+
+  typed = (ws_typed_array *)ws_alloc_as(WS_MEMORY_VALUES, sizeof(ws_typed_array));
+  typed->kind = kind;
+  typed->buffer = buffer;
+  typed->byte_offset = byte_offset;
+  typed->length = length;
+  wval_retain(buffer);
+
+  value = ws_object(ctx, NULL);
+  value->data.object->typed = typed;
+  return value;
+}
+
+ws_val *typed_array_get(ws_context *ctx, ws_obj *array, size_t index)
+{
+  ws_typed_array *typed = array->typed;
+  ws_buffer_page *page;
+  size_t offset;
+  uint8_t *data;
+  double number;
+
+  if (index >= typed->length)
+    return NULL;
+
+  offset = typed->byte_offset + (index << WS_TYPED_SHIFT[typed->kind]);
+  page = buffer_view(ctx, typed->buffer->data.object)->pages[offset >> WS_BUFFER_PAGE_BITS];
+  if (page == NULL)
+    return ws_number(0);
+
+  data = page->data + (offset & WS_BUFFER_PAGE_MASK);
+  switch (typed->kind)
+  {
+  case WS_TYPED_INT8:
+    number = *(int8_t *)data;
+    break;
+  case WS_TYPED_UINT8:
+  case WS_TYPED_UINT8_CLAMPED:
+    number = *data;
+    break;
+  case WS_TYPED_INT16:
+    number = *(int16_t *)data;
+    break;
+  case WS_TYPED_UINT16:
+    number = *(uint16_t *)data;
+    break;
+  case WS_TYPED_INT32:
+    number = *(int32_t *)data;
+    break;
+  case WS_TYPED_UINT32:
+    number = *(uint32_t *)data;
+    break;
+  case WS_TYPED_FLOAT32:
+    number = *(float *)data;
+    break;
+  default:
+    number = *(double *)data;
+    break;
+  }
+
+  return ws_number(number);
+}
+
+void typed_array_set(ws_context *ctx, ws_obj *array, size_t index, ws_val *value)
+{
+  ws_typed_array *typed = array->typed;
+  size_t offset;
+  uint8_t *data;
+  double number;
+
+  number = typed_array_number(value);
+  if (index >= typed->length)
+    return;
+
+  offset = typed->byte_offset + (index << WS_TYPED_SHIFT[typed->kind]);
+  data = buffer_page_writable(ctx, typed->buffer->data.object, offset >> WS_BUFFER_PAGE_BITS)->data +
+         (offset & WS_BUFFER_PAGE_MASK);
+
+  switch (typed->kind)
+  {
+  case WS_TYPED_INT8:
+  case WS_TYPED_UINT8:
+    *data = (uint8_t)typed_array_uint32(number);
+    break;
+  case WS_TYPED_UINT8_CLAMPED:
+    // Rounds half to even, the default rounding mode.
+    *data = !(number > 0) ? 0 : number >= 255 ? 255 : (uint8_t)nearbyint(number);
+    break;
+  case WS_TYPED_INT16:
+  case WS_TYPED_UINT16:
+    *(uint16_t *)data = (uint16_t)typed_array_uint32(number);
+    break;
+  case WS_TYPED_INT32:
+  case WS_TYPED_UINT32:
+    *(uint32_t *)data = typed_array_uint32(number);
+    break;
+  case WS_TYPED_FLOAT32:
+    *(float *)data = (float)number;
+    break;
+  default:
+    *(double *)data = number;
+    break;
+  }
+}
+
+ws_val *typed_array_get_own(ws_context *ctx, ws_obj *array, ws_val *key)
+{
+  ws_typed_array *typed = array->typed;
+  size_t index;
+
+  // An integer index never reaches the properties, even out of the bounds.
+  if (array_index(key, &index))
+  {
+    ws_val *value = typed_array_get(ctx, array, index);
+    return value == NULL ? (ws_val *)&WS_UNDEFINED : value;
+  }
+
+  if (BUFFER_KEY_IS(key, u"length"))
+    return ws_number(typed->length);
+  if (BUFFER_KEY_IS(key, u"byteLength"))
+    return ws_number(typed->length << WS_TYPED_SHIFT[typed->kind]);
+  if (BUFFER_KEY_IS(key, u"byteOffset"))
+    return ws_number(typed->byte_offset);
+  if (BUFFER_KEY_IS(key, u"buffer"))
+    return typed->buffer;
+
+  return NULL;
+}
+
+void typed_array_free(ws_obj *array)
+{
+  wval_release(array->typed->buffer);
+  ws_free(array->typed);
+}
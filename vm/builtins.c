@@ -0,0 +1,741 @@
+#include <string.h>
+#include <math.h>
+#include "builtins.h"
+#include "collection.h"
+#include "array.h"
+#include "buffer.h"
+#include "regexp.h"
+#include "json.h"
+#include "output.h"
+#include "object.h"
+#include "context.h"
+#include "common.h"
+#include "alloc.h"
+
+// For documentation and comments see builtins.h :)
+
+/**
+ * Returns true if the key is the given string.
+ */
+int builtins_key_is(ws_val *key, const char16_t *name, size_t size)
+{
+  return key->type == WVAL_TYPE_STRING && key->data.string.size == size &&
+         memcmp(ws_string_flatten(key), name, size - sizeof(char16_t)) == 0;
+}
+
+#define BUILTINS_KEY_IS(key, name) builtins_key_is(key, name, sizeof(name))
+
+ws_val *builtins_arg(ws_val **args, unsigned int argc, unsigned int i)
+{
+  return i < argc ? args[i] : (ws_val *)&WS_UNDEFINED;
+}
+
+//==============================================================================
+// Map and Set, see collection.h.
+
+ws_obj *builtins_collection(ws_val *self, int is_set)
+{
+  if (self == NULL || self->type != WVAL_TYPE_OBJECT ||
+      self->data.object->collection == NULL ||
+      self->data.object->collection->is_set != is_set)
+    die(is_set ? "Set: Method called on an incompatible receiver."
+               : "Map: Method called on an incompatible receiver.");
+  return self->data.object;
+}
+
+ws_val *builtins_map_get(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  ws_val *value = collection_get(ctx, builtins_collection(self, 0), builtins_arg(args, argc, 0));
+  return value == NULL ? (ws_val *)&WS_UNDEFINED : value;
+}
+
+ws_val *builtins_map_set(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  collection_set(ctx, builtins_collection(self, 0), builtins_arg(args, argc, 0), builtins_arg(args, argc, 1));
+  return self;
+}
+
+ws_val *builtins_map_has(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  return collection_get(ctx, builtins_collection(self, 0), builtins_arg(args, argc, 0)) != NULL
+             ? (ws_val *)&WS_TRUE
+             : (ws_val *)&WS_FALSE;
+}
+
+ws_val *builtins_map_delete(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  return collection_delete(ctx, builtins_collection(self, 0), builtins_arg(args, argc, 0))
+             ? (ws_val *)&WS_TRUE
+             : (ws_val *)&WS_FALSE;
+}
+
+ws_val *builtins_map_clear(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  (void)args;
+  (void)argc;
+  collection_clear(ctx, builtins_collection(self, 0));
+  return &WS_UNDEFINED;
+}
+
+ws_val *builtins_set_add(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  ws_val *value = builtins_arg(args, argc, 0);
+  collection_set(ctx, builtins_collection(self, 1), value, value);
+  return self;
+}
+
+ws_val *builtins_set_has(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  return collection_get(ctx, builtins_collection(self, 1), builtins_arg(args, argc, 0)) != NULL
+             ? (ws_val *)&WS_TRUE
+             : (ws_val *)&WS_FALSE;
+}
+
+ws_val *builtins_set_delete(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  return collection_delete(ctx, builtins_collection(self, 1), builtins_arg(args, argc, 0))
+             ? (ws_val *)&WS_TRUE
+             : (ws_val *)&WS_FALSE;
+}
+
+ws_val *builtins_set_clear(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  (void)args;
+  (void)argc;
+  collection_clear(ctx, builtins_collection(self, 1));
+  return &WS_UNDEFINED;
+}
+
+/**
+ * `new Map(entries)` and `new Set(values)`, only arrays are iterable for now.
+ */
+ws_val *builtins_collection_new(ws_context *ctx, int is_set, ws_val *iterable)
+{
+  ws_val *collection, *item, *key, *value;
+  ws_elements *elements;
+
+  collection = ws_collection_object(ctx, is_set);
+  if (iterable->type == WVAL_TYPE_UNDEFINED || iterable->type == WVAL_TYPE_NULL)
+    return collection;
+
+  if (iterable->type != WVAL_TYPE_OBJECT || iterable->data.object->elements == NULL)
+    die("collection: Only an array can be used as the initial entries.");
+
+  elements = array_elements(ctx, iterable->data.object);
+  for (size_t i = 0; i < elements->length; ++i)
+  {
+    item = array_get(ctx, iterable->data.object, i);
+    if (item == NULL)
+      item = &WS_UNDEFINED;
+
+    if (is_set)
+    {
+      collection_set(ctx, collection->data.object, item, item);
+      continue;
+    }
+
+    if (item->type != WVAL_TYPE_OBJECT)
+      die("Map: An entry is not an object.");
+    key = object_get(ctx, item, &WS_ZERO);
+    value = object_get(ctx, item, &WS_ONE);
+    collection_set(ctx, collection->data.object,
+                   key == NULL ? (ws_val *)&WS_UNDEFINED : key,
+                   value == NULL ? (ws_val *)&WS_UNDEFINED : value);
+  }
+
+  return collection;
+}
+
+ws_val *builtins_map(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  (void)self;
+  return builtins_collection_new(ctx, 0, builtins_arg(args, argc, 0));
+}
+
+ws_val *builtins_set(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  (void)self;
+  return builtins_collection_new(ctx, 1, builtins_arg(args, argc, 0));
+}
+
+ws_val *builtins_collection_get(ws_context *ctx, ws_val *collection, ws_val *key)
+{
+  ws_native native = NULL;
+  int is_set = collection->data.object->collection->is_set;
+
+  if (BUILTINS_KEY_IS(key, u"size"))
+    return ws_number(collection_view(ctx, collection->data.object)->size);
+
+  if (BUILTINS_KEY_IS(key, u"has"))
+    native = is_set ? builtins_set_has : builtins_map_has;
+  else if (BUILTINS_KEY_IS(key, u"delete"))
+    native = is_set ? builtins_set_delete : builtins_map_delete;
+  else if (BUILTINS_KEY_IS(key, u"clear"))
+    native = is_set ? builtins_set_clear : builtins_map_clear;
+  else if (is_set && BUILTINS_KEY_IS(key, u"add"))
+    native = builtins_set_add;
+  else if (!is_set && BUILTINS_KEY_IS(key, u"get"))
+    native = builtins_map_get;
+  else if (!is_set && BUILTINS_KEY_IS(key, u"set"))
+    native = builtins_map_set;
+
+  return native == NULL ? NULL : ws_native_object(ctx, native, collection);
+}
+
+//==============================================================================
+// ArrayBuffer and the typed arrays, see buffer.h.
+
+/**
+ * ToIndex: a length or an offset, undefined is zero.
+ */
+size_t builtins_index(ws_val *value)
+{
+  double number;
+
+  if (value->type == WVAL_TYPE_UNDEFINED)
+    return 0;
+  if (value->type != WVAL_TYPE_NUMBER)
+    die("builtins: Expected a number.");
+
+  number = value->data.number != value->data.number ? 0 : trunc(value->data.number);
+  if (number < 0 || number > WS_BUFFER_MAX_LENGTH)
+    die("builtins: Invalid length.");
+  return (size_t)number;
+}
+
+/**
+ * A relative index of `slice` and the alike: negative ones count from the
+ * end, the result is clamped to the length.
+ */
+size_t builtins_relative(ws_val *value, size_t length, size_t fallback)
+{
+  double number;
+
+  if (value->type == WVAL_TYPE_UNDEFINED)
+    return fallback;
+  if (value->type != WVAL_TYPE_NUMBER)
+    die("builtins: Expected a number.");
+
+  number = value->data.number != value->data.number ? 0 : trunc(value->data.number);
+  if (number < 0)
+    number = number + length < 0 ? 0 : number + length;
+  return number > length ? length : (size_t)number;
+}
+
+ws_obj *builtins_typed(ws_val *self)
+{
+  if (self == NULL || self->type != WVAL_TYPE_OBJECT || self->data.object->typed == NULL)
+    die("TypedArray: Method called on an incompatible receiver.");
+  return self->data.object;
+}
+
+ws_val *builtins_typed_array_fill(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  ws_obj *array = builtins_typed(self);
+  size_t start, end;
+
+  start = builtins_relative(builtins_arg(args, argc, 1), array->typed->length, 0);
+  end = builtins_relative(builtins_arg(args, argc, 2), array->typed->length, array->typed->length);
+  for (; start < end; ++start)
+    typed_array_set(ctx, array, start, builtins_arg(args, argc, 0));
+
+  return self;
+}
+
+ws_val *builtins_typed_array_subarray(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  ws_typed_array *typed = builtins_typed(self)->typed;
+  size_t begin, end;
+
+  begin = builtins_relative(builtins_arg(args, argc, 0), typed->length, 0);
+  end = builtins_relative(builtins_arg(args, argc, 1), typed->length, typed->length);
+  return ws_typed_array_object(ctx,
+                               typed->kind,
+                               typed->buffer,
+                               typed->byte_offset + (begin << WS_TYPED_SHIFT[typed->kind]),
+                               end > begin ? end - begin : 0);
+}
+
+ws_val *builtins_array_buffer_slice(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  uint8_t data[WS_BUFFER_PAGE_SIZE];
+  ws_val *result;
+  size_t length, begin, end, size;
+
+  if (self == NULL || self->type != WVAL_TYPE_OBJECT || self->data.object->buffer == NULL)
+    die("ArrayBuffer: Method called on an incompatible receiver.");
+
+  length = self->data.object->buffer->byte_length;
+  begin = builtins_relative(builtins_arg(args, argc, 0), length, 0);
+  end = builtins_relative(builtins_arg(args, argc, 1), length, length);
+  result = ws_array_buffer(ctx, end > begin ? end - begin : 0);
+
+  for (size_t offset = begin; offset < end; offset += size)
+  {
+    size = end - offset < WS_BUFFER_PAGE_SIZE ? end - offset : WS_BUFFER_PAGE_SIZE;
+    buffer_read(ctx, self->data.object, offset, data, size);
+    buffer_write(ctx, result->data.object, offset - begin, data, size);
+  }
+
+  return result;
+}
+
+ws_val *builtins_typed_array_get(ws_context *ctx, ws_val *array, ws_val *key)
+{
+  if (BUILTINS_KEY_IS(key, u"fill"))
+    return ws_native_object(ctx, builtins_typed_array_fill, array);
+  if (BUILTINS_KEY_IS(key, u"subarray"))
+    return ws_native_object(ctx, builtins_typed_array_subarray, array);
+  return NULL;
+}
+
+ws_val *builtins_buffer_get(ws_context *ctx, ws_val *buffer, ws_val *key)
+{
+  if (BUILTINS_KEY_IS(key, u"slice"))
+    return ws_native_object(ctx, builtins_array_buffer_slice, buffer);
+  return NULL;
+}
+
+ws_val *builtins_array_buffer(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  (void)self;
+  return ws_array_buffer(ctx, builtins_index(builtins_arg(args, argc, 0)));
+}
+
+/**
+ * `new Uint8Array(length)`, `new Uint8Array(buffer, byteOffset, length)` or
+ * `new Uint8Array(array)` which copies an array or a typed array.
+ */
+ws_val *builtins_typed_array_new(ws_context *ctx,
+                                 enum WS_TYPED_KIND kind,
+                                 ws_val **args,
+                                 unsigned int argc)
+{
+  unsigned char shift = WS_TYPED_SHIFT[kind];
+  ws_val *first, *array, *item;
+  ws_obj *source;
+  size_t offset, length;
+
+  first = builtins_arg(args, argc, 0);
+  if (first->type != WVAL_TYPE_OBJECT)
+  {
+    length = builtins_index(first);
+    if (length > WS_BUFFER_MAX_LENGTH >> shift)
+      die("TypedArray: Invalid typed array length.");
+    return ws_typed_array_object(ctx, kind, ws_array_buffer(ctx, length << shift), 0, length);
+  }
+
+  source = first->data.object;
+  if (source->buffer != NULL)
+  {
+    offset = builtins_index(builtins_arg(args, argc, 1));
+    if (builtins_arg(args, argc, 2)->type != WVAL_TYPE_UNDEFINED)
+      length = builtins_index(args[2]);
+    else if (offset > source->buffer->byte_length ||
+             ((source->buffer->byte_length - offset) & ((1u << shift) - 1)))
+      die("TypedArray: Byte length should be a multiple of the element size.");
+    else
+      length = (source->buffer->byte_length - offset) >> shift;
+    return ws_typed_array_object(ctx, kind, first, offset, length);
+  }
+
+  if (source->elements != NULL)
+    length = array_elements(ctx, source)->length;
+  else if (source->typed != NULL)
+    length = source->typed->length;
+  else
+    die("TypedArray: Only an array or a typed array can be copied.");
+
+  if (length > WS_BUFFER_MAX_LENGTH >> shift)
+    die("TypedArray: Invalid typed array length.");
+
+  array = ws_typed_array_object(ctx, kind, ws_array_buffer(ctx, length << shift), 0, length);
+  for (size_t i = 0; i < length; ++i)
+  {
+    item = source->elements != NULL ? array_get(ctx, source, i) : typed_array_get(ctx, source, i);
+    typed_array_set(ctx, array->data.object, i, item == NULL ? (ws_val *)&WS_UNDEFINED : item);
+  }
+
+  return array;
+}
+
+#define BUILTINS_TYPED_ARRAY(name, kind)                                          \
+  ws_val *name(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc) \
+  {                                                                               \
+    (void)self;                                                                   \
+    return builtins_typed_array_new(ctx, kind, args, argc);                       \
+  }
+
+BUILTINS_TYPED_ARRAY(builtins_int8_array, WS_TYPED_INT8)
+BUILTINS_TYPED_ARRAY(builtins_uint8_array, WS_TYPED_UINT8)
+BUILTINS_TYPED_ARRAY(builtins_uint8_clamped_array, WS_TYPED_UINT8_CLAMPED)
+BUILTINS_TYPED_ARRAY(builtins_int16_array, WS_TYPED_INT16)
+BUILTINS_TYPED_ARRAY(builtins_uint16_array, WS_TYPED_UINT16)
+BUILTINS_TYPED_ARRAY(builtins_int32_array, WS_TYPED_INT32)
+BUILTINS_TYPED_ARRAY(builtins_uint32_array, WS_TYPED_UINT32)
+BUILTINS_TYPED_ARRAY(builtins_float32_array, WS_TYPED_FLOAT32)
+BUILTINS_TYPED_ARRAY(builtins_float64_array, WS_TYPED_FLOAT64)
+
+//==============================================================================
+// RegExp, see regexp.h.
+
+ws_regexp *builtins_regexp(ws_val *self)
+{
+  if (self == NULL || self->type != WVAL_TYPE_OBJECT || self->data.object->regexp == NULL)
+    die("RegExp: Method called on an incompatible receiver.");
+  return self->data.object->regexp;
+}
+
+/**
+ * Returns a new string of the code units from `from` to `to`.
+ */
+ws_val *builtins_substring(const char16_t *data, size_t from, size_t to)
+{
+  char16_t *copy;
+
+  copy = (char16_t *)ws_alloc_as(WS_MEMORY_VALUES, (to - from + 1) * sizeof(char16_t));
+  memcpy(copy, data + from, (to - from) * sizeof(char16_t));
+  copy[to - from] = 0;
+  return ws_string(copy, (to - from + 1) * sizeof(char16_t));
+}
+
+/**
+ * Match the input from `lastIndex` for a global or a sticky RegExp (and
+ * update it), from the start for the others.
+ */
+int builtins_regexp_match(ws_context *ctx, ws_val *self, ws_val *input, long *captures)
+{
+  ws_regexp *regexp = builtins_regexp(self);
+  ws_val *last_index;
+  size_t length, start = 0;
+  int matched;
+
+  // TODO(qti3e) ToString for the other values.
+  if (input->type != WVAL_TYPE_STRING)
+    die("RegExp: Only strings can be matched.");
+  length = input->data.string.size / sizeof(char16_t) - 1;
+
+  if (!(regexp->flags & (WS_REGEXP_GLOBAL | WS_REGEXP_STICKY)))
+    return captures == NULL ? regexp_test(regexp, ws_string_flatten(input), length, 0)
+                            : regexp_exec(regexp, ws_string_flatten(input), length, 0, captures);
+
+  last_index = object_get(ctx, self, &WS_REGEXP_LAST_INDEX);
+  if (last_index != NULL && last_index->type == WVAL_TYPE_NUMBER && last_index->data.number > 0)
+    start = last_index->data.number > length ? length + 1 : (size_t)last_index->data.number;
+
+  matched = regexp_exec(regexp, ws_string_flatten(input), length, start, captures);
+  object_set(ctx, self, &WS_REGEXP_LAST_INDEX, matched ? ws_number(captures[1]) : &WS_ZERO);
+  return matched;
+}
+
+ws_val *builtins_regexp_test(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  ws_regexp *regexp = builtins_regexp(self);
+  long *captures = NULL;
+  int matched;
+
+  // Only `lastIndex` needs the bounds of the match.
+  if (regexp->flags & (WS_REGEXP_GLOBAL | WS_REGEXP_STICKY))
+    captures = (long *)ws_alloc_as(WS_MEMORY_OTHER, regexp->groups * 2 * sizeof(long));
+
+  matched = builtins_regexp_match(ctx, self, builtins_arg(args, argc, 0), captures);
+  ws_free(captures);
+  return matched ? (ws_val *)&WS_TRUE : (ws_val *)&WS_FALSE;
+}
+
+ws_val *builtins_regexp_exec(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  static char16_t index_key[] = u"index";
+  static char16_t input_key[] = u"input";
+  ws_regexp *regexp = builtins_regexp(self);
+  ws_val *input, *result;
+  char16_t *data;
+  long *captures;
+
+  input = builtins_arg(args, argc, 0);
+  captures = (long *)ws_alloc_as(WS_MEMORY_OTHER, regexp->groups * 2 * sizeof(long));
+  if (!builtins_regexp_match(ctx, self, input, captures))
+  {
+    ws_free(captures);
+    return &WS_NULL;
+  }
+
+  // [match, ...groups] with the `index` and the `input`.
+  data = ws_string_flatten(input);
+  result = ws_array(ctx);
+  for (unsigned int i = 0; i < regexp->groups; ++i)
+    array_push(ctx,
+               result->data.object,
+               captures[i * 2] < 0 || captures[i * 2 + 1] < 0
+                   ? (ws_val *)&WS_UNDEFINED
+                   : builtins_substring(data, captures[i * 2], captures[i * 2 + 1]));
+  object_set(ctx, result, ws_string(index_key, sizeof(index_key)), ws_number(captures[0]));
+  object_set(ctx, result, ws_string(input_key, sizeof(input_key)), input);
+
+  ws_free(captures);
+  return result;
+}
+
+ws_val *builtins_regexp_get(ws_context *ctx, ws_val *object, ws_val *key)
+{
+  static const char16_t names[] = u"gimsuy";
+  static const struct
+  {
+    const char16_t *name;
+    size_t size;
+    int flag;
+  } flags[] = {
+#define BUILTINS_FLAG(name, flag) {name, sizeof(name), flag}
+      BUILTINS_FLAG(u"global", WS_REGEXP_GLOBAL),
+      BUILTINS_FLAG(u"ignoreCase", WS_REGEXP_IGNORE_CASE),
+      BUILTINS_FLAG(u"multiline", WS_REGEXP_MULTILINE),
+      BUILTINS_FLAG(u"dotAll", WS_REGEXP_DOT_ALL),
+      BUILTINS_FLAG(u"unicode", WS_REGEXP_UNICODE),
+      BUILTINS_FLAG(u"sticky", WS_REGEXP_STICKY),
+#undef BUILTINS_FLAG
+  };
+  ws_regexp *regexp = object->data.object->regexp;
+  char16_t *data;
+  size_t size = 0;
+
+  if (BUILTINS_KEY_IS(key, u"test"))
+    return ws_native_object(ctx, builtins_regexp_test, object);
+  if (BUILTINS_KEY_IS(key, u"exec"))
+    return ws_native_object(ctx, builtins_regexp_exec, object);
+  if (BUILTINS_KEY_IS(key, u"source"))
+    return ws_string(regexp->pattern, (regexp->length + 1) * sizeof(char16_t));
+
+  if (BUILTINS_KEY_IS(key, u"flags"))
+  {
+    data = (char16_t *)ws_alloc_as(WS_MEMORY_VALUES, sizeof(names));
+    for (int i = 0; names[i] != 0; ++i)
+      if (regexp->flags & (1 << i))
+        data[size++] = names[i];
+    data[size] = 0;
+    return ws_string(data, (size + 1) * sizeof(char16_t));
+  }
+
+  for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); ++i)
+    if (builtins_key_is(key, flags[i].name, flags[i].size))
+      return regexp->flags & flags[i].flag ? (ws_val *)&WS_TRUE : (ws_val *)&WS_FALSE;
+
+  return NULL;
+}
+
+/**
+ * `new RegExp(pattern, flags)`, the pattern is a string or a RegExp.
+ */
+ws_val *builtins_regexp_new(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  ws_val *pattern, *flags_value;
+  ws_regexp *source;
+  int flags = 0;
+
+  (void)self;
+  pattern = builtins_arg(args, argc, 0);
+  flags_value = builtins_arg(args, argc, 1);
+
+  if (flags_value->type == WVAL_TYPE_STRING)
+  {
+    flags = regexp_flags(ws_string_flatten(flags_value),
+                         flags_value->data.string.size / sizeof(char16_t) - 1);
+    if (flags < 0)
+      die("RegExp: Invalid flags.");
+  }
+  else if (flags_value->type != WVAL_TYPE_UNDEFINED)
+  {
+    die("RegExp: Flags should be a string.");
+  }
+
+  if (pattern->type == WVAL_TYPE_OBJECT && pattern->data.object->regexp != NULL)
+  {
+    source = pattern->data.object->regexp;
+    return ws_regexp_object(ctx,
+                            regexp_compile(source->pattern,
+                                           source->length,
+                                           flags_value->type == WVAL_TYPE_UNDEFINED ? source->flags : flags));
+  }
+
+  if (pattern->type == WVAL_TYPE_UNDEFINED)
+    return ws_regexp_object(ctx, regexp_compile(u"(?:)", 4, flags));
+
+  if (pattern->type != WVAL_TYPE_STRING)
+    die("RegExp: The pattern should be a string.");
+
+  return ws_regexp_object(ctx,
+                          regexp_compile(ws_string_flatten(pattern),
+                                         pattern->data.string.size / sizeof(char16_t) - 1,
+                                         flags));
+}
+
+//==============================================================================
+// ws, see output.h.
+
+ws_val *builtins_ws_write(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  ws_val *value = builtins_arg(args, argc, 0);
+
+  (void)self;
+  // TODO(qti3e) ToString for the other values.
+  if (value->type != WVAL_TYPE_STRING)
+    die("ws.write: Only strings can be written.");
+  output_write_value(ctx, value);
+  return &WS_UNDEFINED;
+}
+
+//==============================================================================
+// q, the abstract values, see domain.h.
+
+ws_val *builtins_q_float_range(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  ws_val *min = builtins_arg(args, argc, 0), *max = builtins_arg(args, argc, 1);
+
+  (void)ctx;
+  (void)self;
+  if (min->type != WVAL_TYPE_NUMBER || max->type != WVAL_TYPE_NUMBER ||
+      isnan(min->data.number) || isnan(max->data.number) ||
+      min->data.number > max->data.number)
+    die("q.FloatRange: The bounds should be two numbers, min <= max.");
+  return ws_range(min->data.number, max->data.number);
+}
+
+ws_val *builtins_q_union(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  ws_val *value;
+
+  (void)ctx;
+  (void)self;
+  if (argc == 0)
+    die("q.Union: A union must have at least one member.");
+  value = ws_union(args, argc);
+  if (value == NULL)
+    die("q.Union: Too many members.");
+  return value;
+}
+
+ws_val *builtins_q_string(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  (void)ctx;
+  (void)self;
+  (void)args;
+  (void)argc;
+  return &WS_ANY_STRING;
+}
+
+/**
+ * A function made by `q.Callable`, `self` is its return value.
+ */
+ws_val *builtins_q_callable_call(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  (void)ctx;
+  (void)args;
+  (void)argc;
+  return self;
+}
+
+ws_val *builtins_q_callable(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  static char16_t return_type[] = u"returnType";
+  ws_val *options = builtins_arg(args, argc, 0), *value = NULL;
+
+  (void)self;
+  if (options->type == WVAL_TYPE_OBJECT)
+    value = object_get(ctx, options, ws_string(return_type, sizeof(return_type)));
+  return ws_native_object(ctx, builtins_q_callable_call, value == NULL ? (ws_val *)&WS_UNDEFINED : value);
+}
+
+//==============================================================================
+// JSON, see json.h.
+
+ws_val *builtins_json_parse(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  (void)self;
+  // TODO(qti3e) A native can't call a script function yet.
+  if (builtins_arg(args, argc, 1)->type != WVAL_TYPE_UNDEFINED)
+    die("JSON: A reviver is not supported.");
+  return json_parse(ctx, builtins_arg(args, argc, 0));
+}
+
+ws_val *builtins_json_stringify(ws_context *ctx, ws_val *self, ws_val **args, unsigned int argc)
+{
+  ws_val *replacer = builtins_arg(args, argc, 1);
+
+  (void)self;
+  if (replacer->type != WVAL_TYPE_UNDEFINED && replacer->type != WVAL_TYPE_NULL)
+    die("JSON: A replacer is not supported.");
+  return json_stringify(ctx, builtins_arg(args, argc, 0), builtins_arg(args, argc, 2));
+}
+
+//==============================================================================
+
+void builtins_define(ws_context *ctx)
+{
+  static char16_t json_name[] = u"JSON";
+  static char16_t parse[] = u"parse";
+  static char16_t stringify[] = u"stringify";
+  static char16_t ws_name[] = u"ws";
+  static char16_t write_name[] = u"write";
+  static char16_t q_name[] = u"q";
+  ws_val *json, *ws, *q;
+  static struct
+  {
+    char16_t *name;
+    size_t size;
+    ws_native native;
+  } q_methods[] = {
+#define BUILTINS_METHOD(name, native) {name, sizeof(name), native}
+      BUILTINS_METHOD(u"FloatRange", builtins_q_float_range),
+      BUILTINS_METHOD(u"Union", builtins_q_union),
+      BUILTINS_METHOD(u"String", builtins_q_string),
+      BUILTINS_METHOD(u"Callable", builtins_q_callable),
+#undef BUILTINS_METHOD
+  };
+  static struct
+  {
+    char16_t *name;
+    size_t size;
+    ws_native native;
+  } globals[] = {
+#define BUILTINS_GLOBAL(name, native) {name, sizeof(name), native}
+      BUILTINS_GLOBAL(u"Map", builtins_map),
+      BUILTINS_GLOBAL(u"Set", builtins_set),
+      BUILTINS_GLOBAL(u"ArrayBuffer", builtins_array_buffer),
+      BUILTINS_GLOBAL(u"Int8Array", builtins_int8_array),
+      BUILTINS_GLOBAL(u"Uint8Array", builtins_uint8_array),
+      BUILTINS_GLOBAL(u"Uint8ClampedArray", builtins_uint8_clamped_array),
+      BUILTINS_GLOBAL(u"Int16Array", builtins_int16_array),
+      BUILTINS_GLOBAL(u"Uint16Array", builtins_uint16_array),
+      BUILTINS_GLOBAL(u"Int32Array", builtins_int32_array),
+      BUILTINS_GLOBAL(u"Uint32Array", builtins_uint32_array),
+      BUILTINS_GLOBAL(u"Float32Array", builtins_float32_array),
+      BUILTINS_GLOBAL(u"Float64Array", builtins_float64_array),
+      BUILTINS_GLOBAL(u"RegExp", builtins_regexp_new),
+#undef BUILTINS_GLOBAL
+  };
+
+  for (size_t i = 0; i < sizeof(globals) / sizeof(globals[0]); ++i)
+    context_define(ctx,
+                   ws_string(globals[i].name, globals[i].size),
+                   ws_native_object(ctx, globals[i].native, NULL),
+                   1);
+
+  // JSON is not a function, only a namespace of two.
+  json = ws_object(ctx, NULL);
+  object_set(ctx, json, ws_string(parse, sizeof(parse)), ws_native_object(ctx, builtins_json_parse, NULL));
+  object_set(ctx, json, ws_string(stringify, sizeof(stringify)), ws_native_object(ctx, builtins_json_stringify, NULL));
+  context_define(ctx, ws_string(json_name, sizeof(json_name)), json, 1);
+
+  // `ws.write` appends to the output of the branch, see output.h.
+  ws = ws_object(ctx, NULL);
+  object_set(ctx, ws, ws_string(write_name, sizeof(write_name)), ws_native_object(ctx, builtins_ws_write, NULL));
+  context_define(ctx, ws_string(ws_name, sizeof(ws_name)), ws, 1);
+
+  // `q` makes the abstract values of the README, see domain.h.
+  q = ws_object(ctx, NULL);
+  for (size_t i = 0; i < sizeof(q_methods) / sizeof(q_methods[0]); ++i)
+    object_set(ctx,
+               q,
+               ws_string(q_methods[i].name, q_methods[i].size),
+               ws_native_object(ctx, q_methods[i].native, NULL));
+  context_define(ctx, ws_string(q_name, sizeof(q_name)), q, 1);
+}
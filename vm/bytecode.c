@@ -10,7 +10,7 @@ const int WS_BYTECODE_SIZE[] = {
   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x02, 0x02, 0x02,
-  0x02, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x02, 0x02, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
   0x00, 0x00, 0x00, 0x00, 0x02, 0x04, 0x08, 0x04, 0x04, 0x00, 0x00, 0x00, 0x00,
@@ -32,10 +32,10 @@ const char *WS_BYTECODE_NAME[] = {
   "Const", "NamedRef", "PropRef", "RegExp", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, "Jmp",
   "JmpTruePop", "JmpFalsePop", "JmpTruePeek", "JmpFalsePeek", "JmpTrueThenPop",
-  "JmpFalseThenPop", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, "LdScope", "Ret", "FunctionIn", "BlockOut", "BlockIn", 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, "LdFunction", "LdFloat32", "LdFloat64", "LdInt32",
-  "LdUint32", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, "Call0", "Call1", "Call2", "Call3", "Call", "NewArg", "PushArg", 0,
-  0, 0, 0, 0, 0, 0, 0, 0, "New0", "New1", "New2", "New3"
+  "JmpFalseThenPop", "Switch", "Diamond", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, "LdScope", "Ret", "FunctionIn", "BlockOut",
+  "BlockIn", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, "LdFunction", "LdFloat32",
+  "LdFloat64", "LdInt32", "LdUint32", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, "Call0", "Call1", "Call2", "Call3", "Call",
+  "NewArg", "PushArg", 0, 0, 0, 0, 0, 0, 0, 0, 0, "New0", "New1", "New2", "New3"
 };
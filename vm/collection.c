@@ -0,0 +1,273 @@
+#include <string.h>
+#include "collection.h"
+#include "context.h"
+#include "alloc.h"
+#include "common.h"
+
+// For documentation and comments see collection.h :)
+
+/**
+ * Key of the copies in `copies`, ws_symbol never uses the id 0.
+ */
+ws_val WS_COLLECTION_KEY = {.type = WVAL_TYPE_SYMBOL, .data.symbol = {.description = NULL, .id = 0}, .ref_count = 2727};
+
+/**
+ * SameValueZero: like strict equality but NaN is equal to itself.
+ */
+int collection_key_equal(ws_val *a, ws_val *b)
+{
+  if (a->type == WVAL_TYPE_NUMBER && b->type == WVAL_TYPE_NUMBER &&
+      a->data.number != a->data.number)
+    return b->data.number != b->data.number;
+
+  return wval_strict_equal(a, b);
+}
+
+unsigned long collection_hash(ws_val *key)
+{
+  if (wval_is_abstract(key))
+    die("collection: An abstract value can not be a key.");
+  return ws_hash(key);
+}
+
+ws_collection *collection_alloc(unsigned int owner, int is_set)
+{
+  ws_collection *collection;
+
+  collection = (ws_collection *)ws_alloc_as(WS_MEMORY_VALUES, sizeof(ws_collection));
+  collection->is_set = is_set;
+  collection->owner = owner;
+  collection->size = 0;
+  collection->used = 0;
+  collection->capacity = 0;
+  collection->entries = NULL;
+  collection->index = NULL;
+  collection->next = NULL;
+  return collection;
+}
+
+/**
+ * Returns the index of the entry that has the key or -1.
+ */
+long collection_find(ws_collection *collection, ws_val *key, unsigned long hash)
+{
+  ws_collection_entry *entry;
+  size_t mask, i;
+
+  if (collection->capacity == 0)
+    return -1;
+
+  mask = collection->capacity * 2 - 1;
+  for (i = hash & mask; collection->index[i] != 0; i = (i + 1) & mask)
+  {
+    entry = &collection->entries[collection->index[i] - 1];
+    if (entry->key != NULL && entry->hash == hash && collection_key_equal(entry->key, key))
+      return collection->index[i] - 1;
+  }
+
+  return -1;
+}
+
+/**
+ * Give the collection new arrays of `capacity` entries that have the live
+ * entries of `entries`, and build the index.  The old arrays are not freed.
+ */
+void collection_fill(ws_collection *collection,
+                     ws_collection_entry *entries,
+                     size_t used,
+                     size_t capacity)
+{
+  size_t mask, i, j;
+
+  collection->entries = (ws_collection_entry *)ws_alloc_as(WS_MEMORY_VALUES, capacity * sizeof(ws_collection_entry));
+  collection->index = (size_t *)ws_alloc_as(WS_MEMORY_VALUES, capacity * 2 * sizeof(size_t));
+  collection->capacity = capacity;
+  memset(collection->index, 0, capacity * 2 * sizeof(size_t));
+
+  collection->used = 0;
+  for (i = 0; i < used; ++i)
+    if (entries[i].key != NULL)
+      collection->entries[collection->used++] = entries[i];
+
+  mask = capacity * 2 - 1;
+  for (i = 0; i < collection->used; ++i)
+  {
+    for (j = collection->entries[i].hash & mask; collection->index[j] != 0; j = (j + 1) & mask)
+      ;
+    collection->index[j] = i + 1;
+  }
+}
+
+/**
+ * Returns the storage that the context can write to, the first write of a
+ * context copies the storage that it sees.
+ */
+ws_collection *collection_writable(ws_context *ctx, ws_obj *object)
+{
+  ws_collection *collection, *copy, *head;
+
+  collection = collection_view(ctx, object);
+  if (collection->owner == ctx->id)
+    return collection;
+
+  copy = collection_alloc(ctx->id, collection->is_set);
+  copy->size = collection->size;
+  if (collection->capacity > 0)
+    collection_fill(copy, collection->entries, collection->used, collection->capacity);
+
+  for (size_t i = 0; i < copy->used; ++i)
+  {
+    wval_retain(copy->entries[i].key);
+    wval_retain(copy->entries[i].value);
+  }
+
+  table_set(ctx, &object->copies, &WS_COLLECTION_KEY, copy);
+
+  // Siblings in other threads may copy the same collection.
+  head = atomic_load(&object->collection->next);
+  do
+    copy->next = head;
+  while (!atomic_compare_exchange_weak(&object->collection->next, &head, copy));
+
+  return copy;
+}
+
+ws_val *ws_collection_object(ws_context *ctx, int is_set)
+{
+  ws_val *value;
+  ws_obj *object;
+
+  value = ws_object(ctx, NULL);
+  object = value->data.object;
+  object->collection = collection_alloc(ctx->id, is_set);
+  table_init(ctx, &object->copies);
+  return value;
+}
+
+ws_collection *collection_view(ws_context *ctx, ws_obj *object)
+{
+  ws_collection *copy;
+
+  // A collection that is used by the context it was created in.
+  if (object->collection->owner == ctx->id)
+    return object->collection;
+
+  copy = (ws_collection *)table_get(ctx, &object->copies, &WS_COLLECTION_KEY);
+  return copy == NULL ? object->collection : copy;
+}
+
+ws_val *collection_get(ws_context *ctx, ws_obj *object, ws_val *key)
+{
+  ws_collection *collection;
+  long i;
+
+  collection = collection_view(ctx, object);
+  i = collection_find(collection, key, collection_hash(key));
+  return i < 0 ? NULL : collection->entries[i].value;
+}
+
+void collection_set(ws_context *ctx, ws_obj *object, ws_val *key, ws_val *value)
+{
+  ws_collection *collection;
+  ws_collection_entry *entry, *entries;
+  unsigned long hash;
+  size_t mask, j, *index;
+  long i;
+
+  // -0 is stored as +0, so it's what the keys of the collection show.
+  if (key->type == WVAL_TYPE_NUMBER && key->data.number == 0)
+    key = &WS_ZERO;
+
+  hash = collection_hash(key);
+  collection = collection_writable(ctx, object);
+  wval_retain(value);
+
+  i = collection_find(collection, key, hash);
+  if (i >= 0)
+  {
+    wval_release(collection->entries[i].value);
+    collection->entries[i].value = value;
+    return;
+  }
+
+  // Drop the deleted entries when there are enough of them, grow otherwise.
+  if (collection->used == collection->capacity)
+  {
+    entries = collection->entries;
+    index = collection->index;
+    collection_fill(collection,
+                    entries,
+                    collection->used,
+                    collection->size * 2 < collection->capacity
+                        ? collection->capacity
+                        : collection->capacity == 0 ? 4 : collection->capacity * 2);
+    ws_free(entries);
+    ws_free(index);
+  }
+
+  entry = &collection->entries[collection->used];
+  entry->key = key;
+  entry->value = value;
+  entry->hash = hash;
+  wval_retain(key);
+
+  mask = collection->capacity * 2 - 1;
+  for (j = hash & mask; collection->index[j] != 0; j = (j + 1) & mask)
+    ;
+  collection->index[j] = ++collection->used;
+  ++collection->size;
+}
+
+int collection_delete(ws_context *ctx, ws_obj *object, ws_val *key)
+{
+  ws_collection *collection;
+  unsigned long hash;
+  long i;
+
+  hash = collection_hash(key);
+  if (collection_find(collection_view(ctx, object), key, hash) < 0)
+    return 0;
+
+  collection = collection_writable(ctx, object);
+  i = collection_find(collection, key, hash);
+  wval_release(collection->entries[i].key);
+  wval_release(collection->entries[i].value);
+  collection->entries[i].key = NULL;
+  collection->entries[i].value = NULL;
+  --collection->size;
+  return 1;
+}
+
+void collection_clear(ws_context *ctx, ws_obj *object)
+{
+  ws_collection *collection;
+
+  if (collection_view(ctx, object)->size == 0)
+    return;
+
+  collection = collection_writable(ctx, object);
+  for (size_t i = 0; i < collection->used; ++i)
+  {
+    wval_release(collection->entries[i].key);
+    wval_release(collection->entries[i].value);
+  }
+
+  collection->size = 0;
+  collection->used = 0;
+  memset(collection->index, 0, collection->capacity * 2 * sizeof(size_t));
+}
+
+void collection_free(ws_obj *object)
+{
+  ws_collection *collection, *next;
+
+  for (collection = object->collection; collection != NULL; collection = next)
+  {
+    next = collection->next;
+    ws_free(collection->entries);
+    ws_free(collection->index);
+    ws_free(collection);
+  }
+
+  table_destroy_all(&object->copies);
+}
@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include "wval.h"
 #include "compiler.h"
 #include "common.h"
@@ -18,12 +20,13 @@ unsigned long ws_hash(ws_val *value)
   unsigned long hash = 0;
   int n;
   char *data;
+  double number;
 
   switch (value->type)
   {
   case WVAL_TYPE_STRING:
     n = value->data.string.size - 1;
-    data = (char *)value->data.string.data;
+    data = (char *)ws_string_flatten(value);
     for (; n >= 0; --n)
       hash = ((hash << 5) - hash) + data[n];
     return hash;
@@ -32,11 +35,38 @@ unsigned long ws_hash(ws_val *value)
     hash = value->data.symbol.id;
     return (hash << 5) - hash;
 
+  // The other keys are only used by Map and Set, which compare them with
+  // SameValueZero: -0 is the same as 0 and all of the NaNs are the same.
+  case WVAL_TYPE_NUMBER:
+    number = value->data.number;
+    if (number == 0)
+      return 0;
+    if (number != number)
+      return 1;
+    memcpy(&hash, &number, sizeof(number));
+    break;
+
+  case WVAL_TYPE_BOOLEAN:
+    return value->data.boolean ? 2 : 3;
+
+  case WVAL_TYPE_UNDEFINED:
+    return 4;
+
+  case WVAL_TYPE_NULL:
+    return 5;
+
+  case WVAL_TYPE_OBJECT:
+    hash = (unsigned long)value->data.object;
+    break;
+
   default:
-    die("ws_hash: Cannot hash a value that isn't either string or symbol.");
+    die("ws_hash: Cannot hash an abstract value.");
   }
 
-  return -1;
+  // The low bits of the doubles and the pointers are mostly the same, the
+  // tables use the low bits.
+  hash *= 0x9e3779b97f4a7c15ul;
+  return hash ^ (hash >> 32);
 }
 
 void dump_code(ws_function_compiled_data *data)
@@ -56,46 +86,139 @@ void dump_code(ws_function_compiled_data *data)
   }
 }
 
-ws_val *escape_string(ws_val *value)
+/**
+ * Returns true if the code unit can't be written as it is in a literal, a
+ * surrogate is only checked for JSON (where it needs its pair).
+ */
+int escape_needed(char16_t c, int json)
+{
+  if (c < 0x20 || c == '"' || c == '\\')
+    return 1;
+  if (json)
+    return (c & 0xF800) == 0xD800;
+  return c == '\'';
+}
+
+size_t escape_span(const char16_t *data, size_t length, int json)
+{
+  // Four code units at a time: a lane of `x - ones * n` borrows into its top
+  // bit if the lane is smaller than `n`, so a word that has a control, a
+  // quote or a backslash (or a surrogate for JSON) is left to the loop
+  // below which finds the exact unit.
+  const uint64_t ones = 0x0001000100010001ull;
+  const uint64_t highs = 0x8000800080008000ull;
+  uint64_t word, hit;
+  size_t i = 0;
+
+#define ESCAPE_ZERO_LANE(x) (((x) - ones) & ~(x) & highs)
+  for (; i + 4 <= length; i += 4)
+  {
+    memcpy(&word, data + i, sizeof(word));
+    hit = ((word - ones * 0x20) & ~word & highs) |
+          ESCAPE_ZERO_LANE(word ^ (ones * '"')) |
+          ESCAPE_ZERO_LANE(word ^ (ones * '\\'));
+    if (json)
+      hit |= ESCAPE_ZERO_LANE((word & (ones * 0xF800)) ^ (ones * 0xD800));
+    else
+      hit |= ESCAPE_ZERO_LANE(word ^ (ones * '\''));
+    if (hit)
+      break;
+  }
+#undef ESCAPE_ZERO_LANE
+
+  for (; i < length; ++i)
+    if (escape_needed(data[i], json))
+      break;
+
+  return i;
+}
+
+size_t escape_chars(const char16_t *data, size_t length, char16_t *out, int json)
 {
-  size_t size, cursor, cursor2;
-  char16_t *ret;
+  static const char16_t hex[] = u"0123456789abcdef";
   char16_t escapes[] = u"\0\b\t\n\v\f\r\"\'\\";
   char16_t escaped[] = u"0btnvfr\"\'\\";
   size_t num_escapes = sizeof(escaped) / 2 - 1;
+  size_t cursor = 0, size = 0, span, i;
+  char16_t c;
 
-  size = value->data.string.size;
-  for (cursor = 0; cursor < value->data.string.size / 2 - 1; ++cursor)
+  while (cursor < length)
   {
-    for (size_t i = 0; i < num_escapes; ++i)
+    span = escape_span(data + cursor, length - cursor, json);
+    if (out != NULL)
+      memcpy(out + size, data + cursor, span * sizeof(char16_t));
+    cursor += span;
+    size += span;
+    if (cursor == length)
+      break;
+
+    c = data[cursor++];
+
+    // A pair of surrogates is a valid code point, only the lone ones are
+    // escaped.
+    if (json && c >= 0xD800 && c < 0xDC00 && cursor < length &&
+        (data[cursor] & 0xFC00) == 0xDC00)
     {
-      if (escapes[i] == value->data.string.data[cursor])
+      if (out != NULL)
       {
-        size += 2;
-        break;
+        out[size] = c;
+        out[size + 1] = data[cursor];
       }
+      cursor += 1;
+      size += 2;
+      continue;
     }
-  }
 
-  ret = (char16_t *)ws_alloc(size);
-  for (cursor = 0, cursor2 = 0; cursor < value->data.string.size / 2 - 1; ++cursor, ++cursor2)
-  {
-    ret[cursor2] = value->data.string.data[cursor];
-    for (size_t i = 0; i < num_escapes; ++i)
+    // JSON has no `\0`, `\v` and `\'`.
+    for (i = 0; i < num_escapes; ++i)
+      if (escapes[i] == c && (!json || (c != 0 && c != '\v' && c != '\'')))
+        break;
+
+    if (i < num_escapes)
     {
-      if (escapes[i] == value->data.string.data[cursor])
+      if (out != NULL)
       {
-        ret[cursor2] = *u"\\";
-        ret[cursor2 + 1] = escaped[i];
-        cursor2 += 1;
-        break;
+        out[size] = '\\';
+        out[size + 1] = escaped[i];
+      }
+      size += 2;
+    }
+    else if (json)
+    {
+      if (out != NULL)
+      {
+        out[size] = '\\';
+        out[size + 1] = 'u';
+        for (int j = 0; j < 4; ++j)
+          out[size + 2 + j] = hex[(c >> (12 - j * 4)) & 15];
       }
+      size += 6;
+    }
+    else
+    {
+      if (out != NULL)
+        out[size] = c;
+      size += 1;
     }
   }
 
-  ret[cursor2] = 0;
+  return size;
+}
+
+ws_val *escape_string(ws_val *value)
+{
+  size_t length, size;
+  char16_t *ret, *data;
+
+  data = ws_string_flatten(value);
+  length = value->data.string.size / 2 - 1;
+  size = escape_chars(data, length, NULL, 0);
+
+  ret = (char16_t *)ws_alloc_as(WS_MEMORY_VALUES, (size + 1) * sizeof(char16_t));
+  escape_chars(data, length, ret, 0);
+  ret[size] = 0;
 
-  return ws_string(ret, size);
+  return ws_string(ret, (size + 1) * sizeof(char16_t));
 }
 
 void dump_value(ws_val *value)
@@ -142,5 +265,63 @@ void dump_value(ws_val *value)
   case WVAL_TYPE_NUMBER:
     printf("%f\n", value->data.number);
     return;
+  case WVAL_TYPE_RANGE:
+    printf("Range [%f, %f]\n", value->data.range.min, value->data.range.max);
+    return;
+  case WVAL_TYPE_ANY_STRING:
+    printf("String {...}\n");
+    return;
+  case WVAL_TYPE_ITERATOR:
+    printf("Iterator {...}\n");
+    return;
+  case WVAL_TYPE_UNION:
+    printf("Union {\n");
+    for (unsigned int i = 0; i < value->data.set.size; ++i)
+    {
+      printf("  ");
+      dump_value(value->data.set.values[i]);
+    }
+    printf("}\n");
+    return;
+  }
+}
+
+void dump_histogram(char *name, atomic_ulong *histogram)
+{
+  unsigned long count, max = 0;
+
+  for (int i = 0; i < WS_HISTOGRAM_BUCKETS; ++i)
+    if (histogram[i] > max)
+      max = histogram[i];
+
+  printf("%s:\n", name);
+  for (int i = 0; i < WS_HISTOGRAM_BUCKETS; ++i)
+  {
+    count = histogram[i];
+    if (count == 0)
+      continue;
+    if (i == 0)
+      printf("  %10s ", "0");
+    else if (i == WS_HISTOGRAM_BUCKETS - 1)
+      printf("  %10lu+", 1ul << (i - 1));
+    else
+      printf("  %4lu-%-5lu ", 1ul << (i - 1), (1ul << i) - 1);
+    printf("%10lu ", count);
+    for (unsigned long j = 0; j < count * 40 / max; ++j)
+      printf("#");
+    printf("\n");
   }
-}
\ No newline at end of file
+}
+
+void dump_table_stats(ws_table_stats *stats)
+{
+  long slots = stats->slots, tombstones = stats->tombstones;
+
+  dump_histogram("Overlay probe length", stats->probes);
+  dump_histogram("Chain length", stats->chains);
+  dump_histogram("Ancestors visited", stats->ancestors);
+  printf("Overlay misses: %lu\n", (unsigned long)stats->find_misses);
+  printf("Grows: %lu\n", (unsigned long)stats->grows);
+  printf("Tombstones: %ld / %ld slots (%.1f%%)\n", tombstones, slots,
+         slots == 0 ? 0.0 : 100.0 * tombstones / slots);
+}
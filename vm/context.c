@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include "context.h"
 #include "wval.h"
 #include "common.h"
@@ -21,6 +22,36 @@ ws_context *context_create()
   ctx->ds_head = NULL;
   ctx->scope = NULL;
 
+  ctx->function = NULL;
+  ctx->cursor = 0;
+  ctx->frame = NULL;
+  ctx->frame_pool = NULL;
+  ctx->fuel = WS_FUEL_UNLIMITED;
+  ctx->depth = 0;
+  ctx->replay = NULL;
+  ctx->replay_branch = 0;
+  ctx->output = NULL;
+  ctx->diamonds_size = 0;
+  ctx->loops = NULL;
+  ctx->loops_size = 0;
+  ctx->widen_after = WS_WIDEN_AFTER;
+  ctx->loop_limit = WS_LOOP_LIMIT;
+  ctx->subsumed = 0;
+  ctx->gc_reachable = 0;
+  ctx->error = NULL;
+  ctx->handler = NULL;
+  ctx->proto_version = 0;
+  ctx->instructions = 0;
+
+  for (int i = 0; i < WS_MEMORY_CATEGORIES; ++i)
+    ctx->memory.live[i] = 0;
+  ctx->memory.total = 0;
+  ctx->memory.peak = 0;
+
+#ifdef WS_TABLE_STATS
+  memset(&ctx->table_stats, 0, sizeof(ctx->table_stats));
+#endif
+
   ctx->tables.capacity = 0;
   ctx->tables.size = 0;
   ctx->tables.tables = NULL;
@@ -55,6 +86,33 @@ void context_release(ws_context *ctx)
     context_destroy(ctx);
 }
 
+void context_memory_stats(ws_context *ctx, ws_memory_stats *stats)
+{
+  for (int i = 0; i < WS_MEMORY_CATEGORIES; ++i)
+    stats->live[i] = ctx->memory.live[i];
+  stats->total = ctx->memory.total;
+  stats->peak = ctx->memory.peak;
+  stats->overlays = ctx->tables.size;
+}
+
+void context_memory_stats_tree(ws_context *ctx, ws_memory_stats *stats)
+{
+  ws_memory_stats child_stats;
+  ws_context_list *child;
+
+  context_memory_stats(ctx, stats);
+
+  for (child = ctx->childs; child != NULL; child = child->next)
+  {
+    context_memory_stats_tree(child->ctx, &child_stats);
+    for (int i = 0; i < WS_MEMORY_CATEGORIES; ++i)
+      stats->live[i] += child_stats.live[i];
+    stats->total += child_stats.total;
+    stats->peak += child_stats.peak;
+    stats->overlays += child_stats.overlays;
+  }
+}
+
 int context_is_parent_of(ws_context *base, ws_context *ctx)
 {
   ws_context *current = ctx->parent;
@@ -66,6 +124,40 @@ int context_is_parent_of(ws_context *base, ws_context *ctx)
   return 0;
 }
 
+/**
+ * Copy the loop states of a context to its new child.
+ */
+void context_copy_loops(ws_context *child, ws_context *ctx)
+{
+  ws_loop *loop;
+
+  if (ctx->loops == NULL)
+    return;
+
+  child->loops = (ws_loop *)ws_alloc(sizeof(ws_loop) * ctx->loops_size);
+  child->loops_size = ctx->loops_size;
+
+  for (unsigned int i = 0; i < ctx->loops_size; ++i)
+  {
+    loop = &child->loops[i];
+    *loop = ctx->loops[i];
+    for (unsigned int j = 0; j < loop->size; ++j)
+    {
+      wval_retain(loop->state[j]);
+      if (j >= loop->stack)
+        wval_retain(loop->keys[j]);
+    }
+  }
+}
+
+void context_throw(ws_context *ctx, char *message)
+{
+  if (ctx->handler == NULL)
+    die(message);
+  ctx->error = message;
+  longjmp(*ctx->handler, 1);
+}
+
 void context_fork(ws_context *ctx, unsigned int n)
 {
   if (n <= 1)
@@ -81,11 +173,28 @@ void context_fork(ws_context *ctx, unsigned int n)
 
   for (unsigned int i = 0; i < n; ++i)
   {
-    tmp = (ws_context_list *)ws_alloc(sizeof(*tmp));
+    tmp = ws_alloc_context_list();
     tmp->ctx = context_create();
     tmp->ctx->parent = ctx;
     tmp->ctx->ds_head = ctx->ds_head;
     tmp->ctx->scope = ctx->scope;
+    tmp->ctx->function = ctx->function;
+    tmp->ctx->cursor = ctx->cursor;
+    tmp->ctx->frame = ctx->frame;
+    tmp->ctx->fuel = ctx->fuel;
+    tmp->ctx->diamonds_size = ctx->diamonds_size;
+    for (unsigned int j = 0; j < ctx->diamonds_size; ++j)
+    {
+      tmp->ctx->diamonds[j] = ctx->diamonds[j];
+      if (ctx->diamonds[j].value != NULL)
+        wval_retain(ctx->diamonds[j].value);
+    }
+    tmp->ctx->depth = ctx->depth + 1;
+    tmp->ctx->output = ctx->output;
+    tmp->ctx->widen_after = ctx->widen_after;
+    tmp->ctx->loop_limit = ctx->loop_limit;
+    tmp->ctx->proto_version = ctx->proto_version;
+    context_copy_loops(tmp->ctx, ctx);
 
     if (tail == NULL)
     {
@@ -105,6 +214,8 @@ void context_fork(ws_context *ctx, unsigned int n)
     ctx->ds_head->ref_count += n;
   if (ctx->scope != NULL)
     ctx->scope->ref_count += n;
+  if (ctx->frame != NULL)
+    ctx->frame->ref_count += n;
 
   tail->next = NULL;
 }
@@ -115,7 +226,7 @@ void context_list_free(ws_context_list *list)
   while (list != NULL)
   {
     tmp = list->next;
-    ws_free(list);
+    ws_free_context_list(list);
     list = tmp;
   }
 }
@@ -131,7 +242,7 @@ void context_list_del(ws_context_list **list, ws_context *ctx)
   {
     tmp = *list;
     *list = (*list)->next;
-    ws_free(tmp);
+    ws_free_context_list(tmp);
     return;
   }
 
@@ -142,7 +253,7 @@ void context_list_del(ws_context_list **list, ws_context *ctx)
     {
       tmp = cursor->next;
       cursor->next = tmp->next;
-      ws_free(tmp);
+      ws_free_context_list(tmp);
       return;
     }
   }
@@ -152,7 +263,7 @@ void context_new_scope(ws_context *ctx, int is_block)
 {
   if (ctx->forked)
     die("context: Cannot create a new scope on a forked context.");
-  ws_scope *s = (ws_scope *)ws_alloc(sizeof(*s));
+  ws_scope *s = ws_alloc_scope();
   s->parent = ctx->scope;
   s->is_block = is_block;
   s->ref_count = 1;
@@ -245,7 +356,7 @@ void context_ds_push(ws_context *ctx, ws_val *value)
     die("context: Cannot push a new value to the data stack on forked context.");
 
   ws_ds_entity *e;
-  e = (ws_ds_entity *)ws_alloc(sizeof(*e));
+  e = ws_alloc_ds_entity();
   e->value = value;
   e->ref_count = 1;
   e->next = ctx->ds_head;
@@ -279,4 +390,26 @@ ws_val *context_ds_pop(ws_context *ctx)
   ctx->ds_head = tmp;
 
   return value;
-}
\ No newline at end of file
+}
+
+void context_ds_push_unchecked(ws_context *ctx, ws_val *value)
+{
+  ws_ds_entity *e = ws_alloc_ds_entity();
+  e->value = value;
+  e->ref_count = 1;
+  e->next = ctx->ds_head;
+  ctx->ds_head = e;
+
+  wval_retain(value);
+}
+
+ws_val *context_ds_pop_unchecked(ws_context *ctx)
+{
+  ws_ds_entity *head = ctx->ds_head;
+  ws_val *value = head->value;
+
+  wval_retain(value);
+  ctx->ds_head = head->next;
+  ds_entity_release(head);
+  return value;
+}
@@ -0,0 +1,445 @@
+#include <math.h>
+#include "domain.h"
+#include "wval.h"
+#include "common.h"
+
+//==============================================================================
+// Private helpers.
+
+typedef ws_val *(*domain_binary)(ws_val *a, ws_val *b);
+typedef ws_val *(*domain_unary)(ws_val *a);
+
+/**
+ * Apply a binary operation on every pair of members and join the results.
+ */
+ws_val *domain_map2(domain_binary fn, ws_val *a, ws_val *b)
+{
+  ws_val *results[WS_UNION_MAX_SIZE * WS_UNION_MAX_SIZE];
+  ws_val *x, *y;
+  unsigned int n, m, i, j, count;
+
+  if (a->type != WVAL_TYPE_UNION && b->type != WVAL_TYPE_UNION)
+    return fn(a, b);
+
+  n = a->type == WVAL_TYPE_UNION ? a->data.set.size : 1;
+  m = b->type == WVAL_TYPE_UNION ? b->data.set.size : 1;
+  count = 0;
+
+  for (i = 0; i < n; ++i)
+  {
+    x = a->type == WVAL_TYPE_UNION ? a->data.set.values[i] : a;
+    for (j = 0; j < m; ++j)
+    {
+      y = b->type == WVAL_TYPE_UNION ? b->data.set.values[j] : b;
+      results[count] = fn(x, y);
+      if (results[count] == NULL)
+        return NULL;
+      ++count;
+    }
+  }
+
+  return ws_union(results, count);
+}
+
+/**
+ * Apply an unary operation on every member and join the results.
+ */
+ws_val *domain_map(domain_unary fn, ws_val *a)
+{
+  ws_val *results[WS_UNION_MAX_SIZE];
+  unsigned int i;
+
+  if (a->type != WVAL_TYPE_UNION)
+    return fn(a);
+
+  for (i = 0; i < a->data.set.size; ++i)
+  {
+    results[i] = fn(a->data.set.values[i]);
+    if (results[i] == NULL)
+      return NULL;
+  }
+
+  return ws_union(results, a->data.set.size);
+}
+
+/**
+ * Get the bounds of a number or a range, returns false for other values.
+ */
+int domain_bounds(ws_val *value, double *min, double *max)
+{
+  switch (value->type)
+  {
+  case WVAL_TYPE_NUMBER:
+    *min = *max = value->data.number;
+    return 1;
+  case WVAL_TYPE_RANGE:
+    *min = value->data.range.min;
+    *max = value->data.range.max;
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/**
+ * Any number, NaN included.
+ */
+ws_val *domain_any_number()
+{
+  ws_val *members[2] = {ws_range(-INFINITY, INFINITY), ws_number(NAN)};
+  return ws_union(members, 2);
+}
+
+/**
+ * Create a number or a range from the result of an interval operation.  When
+ * both bounds are NaN the result is NaN (an operand is NaN, or the operation
+ * is Infinity - Infinity on both ends), when only one of them is NaN some of
+ * the results are NaN, so it's widened to any number.
+ */
+ws_val *domain_interval(double min, double max)
+{
+  if (isnan(min) && isnan(max))
+    return ws_number(NAN);
+  if (isnan(min) || isnan(max))
+    return domain_any_number();
+  return ws_range(min, max);
+}
+
+int domain_is_string(ws_val *value)
+{
+  return value->type == WVAL_TYPE_STRING || value->type == WVAL_TYPE_ANY_STRING;
+}
+
+/**
+ * Like domain_bounds but it also accepts unions of numeric values, NaN is
+ * not a part of the bounds, `nan` is set if it's a member.  The bounds are
+ * empty (min > max) if NaN is the only member.
+ */
+int domain_union_bounds(ws_val *value, double *min, double *max, int *nan)
+{
+  unsigned int n = value->type == WVAL_TYPE_UNION ? value->data.set.size : 1;
+  ws_val *member;
+  double a, b;
+
+  *min = INFINITY;
+  *max = -INFINITY;
+  *nan = 0;
+  for (unsigned int i = 0; i < n; ++i)
+  {
+    member = value->type == WVAL_TYPE_UNION ? value->data.set.values[i] : value;
+    if (!domain_bounds(member, &a, &b))
+      return 0;
+    if (isnan(a))
+    {
+      *nan = 1;
+      continue;
+    }
+    *min = fmin(*min, a);
+    *max = fmax(*max, b);
+  }
+
+  return 1;
+}
+
+//==============================================================================
+// Operations on non-union values.
+
+ws_val *domain_add_1(ws_val *a, ws_val *b)
+{
+  double a0, a1, b0, b1;
+
+  if (a->type == WVAL_TYPE_NUMBER && b->type == WVAL_TYPE_NUMBER)
+    return ws_number(a->data.number + b->data.number);
+
+  if (domain_bounds(a, &a0, &a1) && domain_bounds(b, &b0, &b1))
+    return domain_interval(a0 + b0, a1 + b1);
+
+  if (a->type == WVAL_TYPE_STRING && b->type == WVAL_TYPE_STRING)
+    return ws_string_concat(a, b);
+
+  // TODO(qti3e) ToString on the concrete side.
+  if (a->type == WVAL_TYPE_ANY_STRING || b->type == WVAL_TYPE_ANY_STRING)
+    return &WS_ANY_STRING;
+
+  return NULL;
+}
+
+ws_val *domain_sub_1(ws_val *a, ws_val *b)
+{
+  double a0, a1, b0, b1;
+
+  if (a->type == WVAL_TYPE_NUMBER && b->type == WVAL_TYPE_NUMBER)
+    return ws_number(a->data.number - b->data.number);
+
+  if (domain_bounds(a, &a0, &a1) && domain_bounds(b, &b0, &b1))
+    return domain_interval(a0 - b1, a1 - b0);
+
+  return NULL;
+}
+
+ws_val *domain_mul_1(ws_val *a, ws_val *b)
+{
+  double a0, a1, b0, b1, p[4], min, max;
+  int nan = 0;
+
+  if (a->type == WVAL_TYPE_NUMBER && b->type == WVAL_TYPE_NUMBER)
+    return ws_number(a->data.number * b->data.number);
+
+  if (!domain_bounds(a, &a0, &a1) || !domain_bounds(b, &b0, &b1))
+    return NULL;
+
+  p[0] = a0 * b0;
+  p[1] = a0 * b1;
+  p[2] = a1 * b0;
+  p[3] = a1 * b1;
+  min = INFINITY;
+  max = -INFINITY;
+
+  for (int i = 0; i < 4; ++i)
+  {
+    // A NaN operand or 0 * Infinity.
+    if (isnan(p[i]))
+    {
+      ++nan;
+      continue;
+    }
+    min = fmin(min, p[i]);
+    max = fmax(max, p[i]);
+  }
+
+  if (nan == 4)
+    return ws_number(NAN);
+  if (nan > 0)
+    return domain_any_number();
+  return domain_interval(min, max);
+}
+
+ws_val *domain_neg_1(ws_val *a)
+{
+  switch (a->type)
+  {
+  case WVAL_TYPE_NUMBER:
+    return ws_number(-a->data.number);
+  case WVAL_TYPE_RANGE:
+    return ws_range(-a->data.range.max, -a->data.range.min);
+  default:
+    return NULL;
+  }
+}
+
+// Operation of the current `domain_compare` call, contexts may run on
+// different threads.
+_Thread_local enum DOMAIN_COMPARE domain_compare_op;
+
+ws_val *domain_compare_1(ws_val *a, ws_val *b)
+{
+  double a0, a1, b0, b1;
+  int always, never;
+
+  if (!domain_bounds(a, &a0, &a1) || !domain_bounds(b, &b0, &b1))
+    return NULL;
+
+  // NaN is never a part of a range, so it only shows up for concrete numbers.
+  if (isnan(a0) || isnan(b0))
+    return &WS_FALSE;
+
+  switch (domain_compare_op)
+  {
+  case DOMAIN_LT:
+    always = a1 < b0;
+    never = a0 >= b1;
+    break;
+  case DOMAIN_LTE:
+    always = a1 <= b0;
+    never = a0 > b1;
+    break;
+  case DOMAIN_GT:
+    always = a0 > b1;
+    never = a1 <= b0;
+    break;
+  case DOMAIN_GTE:
+    always = a0 >= b1;
+    never = a1 < b0;
+    break;
+  default:
+    die("domain_compare: Unknown operation.");
+    return NULL;
+  }
+
+  if (always)
+    return &WS_TRUE;
+  if (never)
+    return &WS_FALSE;
+  return &WS_ANY_BOOLEAN;
+}
+
+ws_val *domain_strict_equal_1(ws_val *a, ws_val *b)
+{
+  double a0, a1, b0, b1;
+
+  if (!wval_is_abstract(a) && !wval_is_abstract(b))
+  {
+    if (a->type != b->type)
+      return &WS_FALSE;
+    if (a->type == WVAL_TYPE_NUMBER)
+      return a->data.number == b->data.number ? &WS_TRUE : &WS_FALSE;
+    return wval_strict_equal(a, b) ? &WS_TRUE : &WS_FALSE;
+  }
+
+  if (domain_bounds(a, &a0, &a1))
+  {
+    if (!domain_bounds(b, &b0, &b1))
+      return &WS_FALSE;
+    if (a1 < b0 || b1 < a0 || isnan(a0) || isnan(b0))
+      return &WS_FALSE;
+    return &WS_ANY_BOOLEAN;
+  }
+
+  if (domain_is_string(a))
+    return domain_is_string(b) ? &WS_ANY_BOOLEAN : &WS_FALSE;
+
+  return &WS_FALSE;
+}
+
+//==============================================================================
+
+ws_val *domain_add(ws_val *a, ws_val *b)
+{
+  return domain_map2(domain_add_1, a, b);
+}
+
+ws_val *domain_sub(ws_val *a, ws_val *b)
+{
+  return domain_map2(domain_sub_1, a, b);
+}
+
+ws_val *domain_mul(ws_val *a, ws_val *b)
+{
+  return domain_map2(domain_mul_1, a, b);
+}
+
+ws_val *domain_neg(ws_val *a)
+{
+  return domain_map(domain_neg_1, a);
+}
+
+ws_val *domain_not(ws_context *ctx, ws_val *a)
+{
+  ws_val *boolean = ws_to_boolean(ctx, a);
+  if (boolean->type != WVAL_TYPE_BOOLEAN)
+    return &WS_ANY_BOOLEAN;
+  return boolean->data.boolean ? &WS_FALSE : &WS_TRUE;
+}
+
+ws_val *domain_compare(enum DOMAIN_COMPARE op, ws_val *a, ws_val *b)
+{
+  domain_compare_op = op;
+  return domain_map2(domain_compare_1, a, b);
+}
+
+ws_val *domain_strict_equal(ws_val *a, ws_val *b)
+{
+  return domain_map2(domain_strict_equal_1, a, b);
+}
+
+ws_val *domain_refine(ws_context *ctx, ws_val *value, int truthy)
+{
+  ws_val *members[WS_UNION_MAX_SIZE];
+  ws_val *boolean;
+  unsigned int i, count;
+
+  if (value->type != WVAL_TYPE_UNION)
+    return value;
+
+  count = 0;
+  for (i = 0; i < value->data.set.size; ++i)
+  {
+    boolean = ws_to_boolean(ctx, value->data.set.values[i]);
+    if (boolean->type == WVAL_TYPE_BOOLEAN && boolean->data.boolean != truthy)
+      continue;
+    members[count++] = value->data.set.values[i];
+  }
+
+  if (count == 0)
+    return value;
+
+  return ws_union(members, count);
+}
+
+//==============================================================================
+// Loop widening.
+
+/**
+ * domain_includes for a non-union `a` and `b`.
+ */
+int domain_includes_1(ws_val *a, ws_val *b)
+{
+  double b0, b1;
+
+  switch (a->type)
+  {
+  case WVAL_TYPE_RANGE:
+    return domain_bounds(b, &b0, &b1) && !isnan(b0) &&
+           a->data.range.min <= b0 && b1 <= a->data.range.max;
+  case WVAL_TYPE_ANY_STRING:
+    return domain_is_string(b);
+  case WVAL_TYPE_NUMBER:
+    if (b->type != WVAL_TYPE_NUMBER)
+      return 0;
+    // Unlike ===, a NaN is the same state as another NaN.
+    if (isnan(a->data.number))
+      return isnan(b->data.number);
+    return a->data.number == b->data.number;
+  default:
+    return !wval_is_abstract(b) && wval_strict_equal(a, b);
+  }
+}
+
+int domain_includes(ws_val *a, ws_val *b)
+{
+  unsigned int n, m, i, j;
+  ws_val *x, *y;
+
+  n = a->type == WVAL_TYPE_UNION ? a->data.set.size : 1;
+  m = b->type == WVAL_TYPE_UNION ? b->data.set.size : 1;
+
+  for (j = 0; j < m; ++j)
+  {
+    y = b->type == WVAL_TYPE_UNION ? b->data.set.values[j] : b;
+    for (i = 0; i < n; ++i)
+    {
+      x = a->type == WVAL_TYPE_UNION ? a->data.set.values[i] : a;
+      if (domain_includes_1(x, y))
+        break;
+    }
+    if (i == n)
+      return 0;
+  }
+
+  return 1;
+}
+
+ws_val *domain_widen(ws_val *previous, ws_val *next)
+{
+  ws_val *values[2] = {previous, next};
+  double a0, a1, b0, b1;
+  int a_nan, b_nan;
+
+  if (domain_includes(previous, next))
+    return previous;
+
+  if (domain_union_bounds(previous, &a0, &a1, &a_nan) &&
+      domain_union_bounds(next, &b0, &b1, &b_nan) && a0 <= a1 && b0 <= b1)
+  {
+    values[0] = ws_range(b0 < a0 ? -INFINITY : a0, b1 > a1 ? INFINITY : a1);
+    if (!a_nan && !b_nan)
+      return values[0];
+    values[1] = ws_number(NAN);
+    return ws_union(values, 2);
+  }
+
+  if (domain_is_string(previous) && domain_is_string(next))
+    return &WS_ANY_STRING;
+
+  return ws_union(values, 2);
+}
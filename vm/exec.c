@@ -1,84 +1,1049 @@
 #include <stdio.h>
+#include <stdint.h>
+#include <math.h>
 #include <unistd.h>
 #include "exec.h"
+#include "domain.h"
 #include "wval.h"
 #include "context.h"
 #include "compiler.h"
 #include "bytecode.h"
+#include "alloc.h"
+#include "trace.h"
+#include "compiled.h"
+#include "object.h"
+#include "array.h"
+#include "buffer.h"
+#include "regexp.h"
+#include "output.h"
+#include "common.h"
+
+//==============================================================================
+// Helpers to read the compiled data, all the numbers are little-endian.
+
+uint16_t read_uint16(uint8_t *data)
+{
+  return (uint16_t)data[0] | ((uint16_t)data[1] << 8);
+}
+
+uint32_t read_uint32(uint8_t *data)
+{
+  return (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+         ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+//==============================================================================
+// Switch tables, see `Switch` in VM.md for the layout.
+
+#define SWITCH_TABLE_DENSE 0
+#define SWITCH_SLOT_EMPTY 0
+#define SWITCH_SLOT_NUMBER 1
+#define SWITCH_SLOT_STRING 2
+#define SWITCH_SLOT_SIZE 7
+
+uint32_t switch_hash_string(char16_t *data, size_t length)
+{
+  uint32_t hash = 0;
+  for (size_t i = 0; i < length; ++i)
+    hash = (hash << 5) - hash + data[i];
+  return hash;
+}
+
+int switch_netstring_equal(uint8_t *netstr, char16_t *data, size_t length)
+{
+  if (read_uint16(netstr) != length)
+    return 0;
+  for (size_t i = 0; i < length; ++i)
+    if (read_uint16(netstr + 2 + i * 2) != data[i])
+      return 0;
+  return 1;
+}
+
+unsigned long switch_lookup(ws_function_compiled_data *function,
+                            uint32_t offset,
+                            ws_val *value)
+{
+  uint8_t *pool = function->constant_pool;
+  uint8_t *table = pool + offset;
+  uint8_t *slot;
+  unsigned long fallback = read_uint16(table + 1);
+  uint32_t capacity, mask, index, hash;
+  int32_t key;
+  double number, min;
+  size_t length;
+
+  if (table[0] == SWITCH_TABLE_DENSE)
+  {
+    if (value->type != WVAL_TYPE_NUMBER)
+      return fallback;
+    min = (int32_t)read_uint32(table + 3);
+    number = value->data.number - min;
+    if (number != floor(number) || number < 0 || number >= read_uint16(table + 7))
+      return fallback;
+    return read_uint16(table + 9 + (size_t)number * 2);
+  }
+
+  switch (value->type)
+  {
+  case WVAL_TYPE_NUMBER:
+    number = value->data.number;
+    if (!(number >= INT32_MIN && number <= INT32_MAX) || number != (int32_t)number)
+      return fallback;
+    key = (int32_t)number;
+    hash = (uint32_t)key;
+    length = 0;
+    break;
+
+  case WVAL_TYPE_STRING:
+    key = 0;
+    length = value->data.string.size / 2 - 1;
+    hash = switch_hash_string(ws_string_flatten(value), length);
+    break;
+
+  default:
+    return fallback;
+  }
+
+  capacity = read_uint16(table + 3);
+  mask = capacity - 1;
+  index = hash & mask;
+
+  for (uint32_t i = 0; i < capacity; ++i, index = (index + 1) & mask)
+  {
+    slot = table + 5 + index * SWITCH_SLOT_SIZE;
+    if (slot[0] == SWITCH_SLOT_EMPTY)
+      break;
+    if (slot[0] == SWITCH_SLOT_NUMBER && value->type == WVAL_TYPE_NUMBER &&
+        (int32_t)read_uint32(slot + 1) == key)
+      return read_uint16(slot + 5);
+    if (slot[0] == SWITCH_SLOT_STRING && value->type == WVAL_TYPE_STRING &&
+        switch_netstring_equal(pool + read_uint32(slot + 1),
+                               ws_string_flatten(value), length))
+      return read_uint16(slot + 5);
+  }
+
+  return fallback;
+}
+
+//==============================================================================
+
+// Calls, see "Calling Convention" in VM.md.
+
+/**
+ * Enter `function`, the `argc` arguments are the top of the data stack and
+ * `base` is the data stack that the return value is pushed to, `cursor` is
+ * where the caller continues.
+ */
+void exec_enter(ws_context *ctx,
+                ws_function *function,
+                unsigned int argc,
+                ws_ds_entity *base,
+                unsigned long cursor)
+{
+  ws_function_compiled_data *data = function->data;
+  ws_ds_entity *entity = ctx->ds_head;
+  ws_val *args[3];
+  ws_frame *frame;
+  unsigned int i;
+
+  for (i = argc; i > 0; --i, entity = entity->next)
+    args[i - 1] = entity->value;
+
+  frame = ctx->frame_pool;
+  if (frame != NULL)
+    ctx->frame_pool = frame->prev;
+  else
+    frame = (ws_frame *)ws_alloc_as(WS_MEMORY_STACK, sizeof(*frame));
+
+  frame->prev = ctx->frame;
+  frame->ref_count = 1;
+  frame->function = ctx->function;
+  frame->cursor = cursor;
+  frame->scope = ctx->scope;
+  frame->base = base;
+  ctx->frame = frame;
+
+  ctx->function = data;
+  ctx->scope = function->scope;
+  scope_retain(function->scope);
+  context_new_scope(ctx, 0);
+
+  // The arguments are bound right from their slots, the missing ones are
+  // undefined and the extra ones are dropped with the frame.
+  for (i = 0; i < data->params_size; ++i)
+    context_define(ctx, data->params[i], i < argc ? args[i] : (ws_val *)&WS_UNDEFINED, 1);
+}
+
+/**
+ * `Call0`-`Call3`, the callee is under the arguments.
+ */
+void exec_call(ws_context *ctx, unsigned int argc, unsigned long cursor)
+{
+  ws_ds_entity *callee = ctx->ds_head;
+  ws_val *value;
+
+  for (unsigned int i = 0; i < argc && callee != NULL; ++i)
+    callee = callee->next;
+  if (callee == NULL)
+    die("context: Run out of data stack.");
+
+  // TODO(qti3e) Fork on a union of functions.
+  value = callee->value;
+  if (value->type != WVAL_TYPE_OBJECT || value->data.object->call == NULL)
+    die("exec: Value is not a function.");
+
+  exec_enter(ctx, value->data.object->call, argc, callee->next, cursor);
+}
+
+/**
+ * Call a native function (see builtins.h) right away, the callee is under
+ * the `argc` arguments. Returns false if the callee is not native.
+ */
+int exec_call_native(ws_context *ctx, unsigned int argc)
+{
+  ws_ds_entity *entity = ctx->ds_head;
+  ws_val *args[3], *callee, *result;
+  unsigned int i;
+
+  for (i = argc; i > 0 && entity != NULL; --i, entity = entity->next)
+    args[i - 1] = entity->value;
+  if (entity == NULL)
+    die("context: Run out of data stack.");
+
+  callee = entity->value;
+  if (callee->type != WVAL_TYPE_OBJECT || callee->data.object->native == NULL)
+    return 0;
+
+  result = callee->data.object->native(ctx, callee->data.object->self, args, argc);
+  wval_retain(result);
+  for (i = 0; i <= argc; ++i)
+    wval_release(context_ds_pop(ctx));
+  context_ds_push(ctx, result);
+  wval_release(result);
+  return 1;
+}
+
+/**
+ * Return from the current call with the value on the top of the stack,
+ * returns the cursor of the caller.
+ */
+unsigned long exec_return(ws_context *ctx)
+{
+  ws_frame *frame = ctx->frame;
+  unsigned long cursor = frame->cursor;
+  ws_ds_entity *entity;
+  ws_scope *scope;
+  ws_val *value;
+  unsigned int i, j;
+
+  value = context_ds_pop(ctx);
+  while (ctx->ds_head != frame->base)
+  {
+    entity = ctx->ds_head->next;
+    ds_entity_release(ctx->ds_head);
+    ctx->ds_head = entity;
+  }
+  context_ds_push(ctx, value);
+  wval_release(value);
+
+  scope = ctx->scope;
+  ctx->scope = frame->scope;
+  scope_release(scope);
+  ctx->function = frame->function;
+
+  // The loops of this call can not be reached again.
+  for (i = 0, j = 0; i < ctx->loops_size; ++i)
+  {
+    if (ctx->loops[i].frame != frame)
+      ctx->loops[j++] = ctx->loops[i];
+    else
+      for (unsigned int k = 0; k < ctx->loops[i].size; ++k)
+      {
+        wval_release(ctx->loops[i].state[k]);
+        if (k >= ctx->loops[i].stack)
+          wval_release(ctx->loops[i].keys[k]);
+      }
+  }
+  ctx->loops_size = j;
+
+  // The reference of the frame to its caller is passed to the context when
+  // the frame is not shared with another branch.
+  ctx->frame = frame->prev;
+  if (--frame->ref_count == 0)
+  {
+    frame->prev = ctx->frame_pool;
+    ctx->frame_pool = frame;
+  }
+  else if (ctx->frame != NULL)
+  {
+    ++ctx->frame->ref_count;
+  }
+
+  return cursor;
+}
 
 ws_val *call(ws_context *ctx, ws_function *function)
 {
-  return NULL;
+  ws_function_compiled_data *caller = ctx->function;
+  unsigned long cursor = ctx->cursor;
+  ws_val *result;
+
+  // A frame without a caller function makes `Ret` give the value back here.
+  ctx->function = NULL;
+  exec_enter(ctx, function, 0, ctx->ds_head, 0);
+  ctx->cursor = 0;
+
+  result = exec_resume(ctx);
+  if (result != NULL)
+  {
+    ctx->function = caller;
+    ctx->cursor = cursor;
+  }
+
+  return result;
+}
+
+//==============================================================================
+// Abstract values, the context is only forked when there is no other way.
+
+/**
+ * Fork the context into `n` branches, when a trace is being replayed the
+ * context is not forked, it takes the recorded branch instead.
+ */
+void exec_fork(ws_context *ctx, unsigned int n)
+{
+  unsigned long cursor;
+  unsigned int index;
+
+  if (ctx->replay == NULL)
+  {
+    context_fork(ctx, n);
+    return;
+  }
+
+  // The branch forked again after the end of its trace.
+  if (!trace_next(ctx->replay, &cursor, &index))
+  {
+    ctx->replay = NULL;
+    context_fork(ctx, n);
+    return;
+  }
+
+  if (cursor != ctx->cursor || index >= n)
+    die("exec_replay: The trace does not match the execution.");
+
+  ctx->replay_branch = index;
+  ++ctx->depth;
+}
+
+/**
+ * Returns the context that takes the i-th branch of the last exec_fork, NULL
+ * if the branch is not taken in replay mode.
+ */
+ws_context *exec_branch(ws_context *ctx, unsigned int i)
+{
+  ws_context_list *child;
+
+  if (!ctx->forked)
+    return i == ctx->replay_branch ? ctx : NULL;
+
+  for (child = ctx->childs; i > 0; --i)
+    child = child->next;
+  return child->ctx;
 }
 
-ws_val *exec(ws_context *ctx, ws_function_compiled_data *function)
+/**
+ * Fork the context into one child per member of the first union operand, the
+ * operands are already popped and each child gets them back with the union
+ * replaced by one of its members, then it re-executes the instruction at
+ * `cursor`.  `b` is NULL for unary operations.
+ */
+void exec_split(ws_context *ctx, unsigned long cursor, ws_val *a, ws_val *b)
+{
+  ws_context *child;
+  ws_val *set = a->type == WVAL_TYPE_UNION ? a : b;
+  unsigned int i;
+
+  ctx->cursor = cursor;
+  exec_fork(ctx, set->data.set.size);
+
+  for (i = 0; i < set->data.set.size; ++i)
+  {
+    child = exec_branch(ctx, i);
+    if (child == NULL)
+      continue;
+    context_ds_push(child, set == a ? set->data.set.values[i] : a);
+    if (b != NULL)
+      context_ds_push(child, set == b ? set->data.set.values[i] : b);
+  }
+}
+
+/**
+ * Push the result of an operation, if the result can not be described split
+ * the context on the first union operand, returns false if it forked.  Dies
+ * if there is no union to split, the operands are already popped so there
+ * is no way to go on with a correct stack.
+ */
+int exec_push_result(ws_context *ctx,
+                     unsigned long cursor,
+                     ws_val *result,
+                     ws_val *a,
+                     ws_val *b)
+{
+  char message[128];
+
+  if (result != NULL)
+  {
+    context_ds_push(ctx, result);
+    return 1;
+  }
+
+  if (a->type == WVAL_TYPE_UNION || (b != NULL && b->type == WVAL_TYPE_UNION))
+  {
+    exec_split(ctx, cursor, a, b);
+    return 0;
+  }
+
+  // TODO(qti3e) ToPrimitive and the mixed cases.
+  snprintf(message, sizeof(message), "exec: %s is not supported on these operands yet.",
+           WS_BYTECODE_NAME[ctx->function->data[cursor]]);
+  die(message);
+  return 0;
+}
+
+/**
+ * Evaluate a binary operation on possibly abstract values.
+ */
+ws_val *exec_binary(ws_context *ctx, unsigned int bytecode, ws_val *a, ws_val *b)
 {
-  unsigned long cursor = 0, next_cursor = 0;
+  ws_val *result;
+
+  switch (bytecode)
+  {
+  case WB_ADD:
+    return domain_add(a, b);
+  case WB_SUB:
+    return domain_sub(a, b);
+  case WB_MUL:
+    return domain_mul(a, b);
+  case WB_LT:
+    return domain_compare(DOMAIN_LT, a, b);
+  case WB_LTE:
+    return domain_compare(DOMAIN_LTE, a, b);
+  case WB_GT:
+    return domain_compare(DOMAIN_GT, a, b);
+  case WB_GTE:
+    return domain_compare(DOMAIN_GTE, a, b);
+  case WB_EQS:
+    return domain_strict_equal(a, b);
+  case WB_IEQS:
+    result = domain_strict_equal(a, b);
+    return result == NULL ? NULL : domain_not(ctx, result);
+  default:
+    return NULL;
+  }
+}
+
+/**
+ * Evaluate an unary operation on possibly abstract values.
+ */
+ws_val *exec_unary(ws_context *ctx, unsigned int bytecode, ws_val *a)
+{
+  switch (bytecode)
+  {
+  case WB_NOT:
+    return domain_not(ctx, a);
+  case WB_NEG:
+    return domain_neg(a);
+  case WB_POS:
+    // For numbers `+x` is the same as `x - 0`, even for -0 and NaN.
+    return domain_sub(a, &WS_ZERO);
+  default:
+    return NULL;
+  }
+}
+
+/**
+ * Conditional jumps, see VM.md for the semantics of each one.  If the value
+ * is ambiguous the context is forked into two children, the first one takes
+ * the jump and the second one falls through.  Returns false if it forked.
+ */
+int exec_jump(ws_context *ctx,
+              unsigned long *next_cursor,
+              unsigned long target,
+              int when,
+              int pop,
+              int then_pop)
+{
+  ws_context *taken, *skipped;
+  ws_val *value, *boolean;
+
+  value = pop ? context_ds_pop(ctx) : context_ds_peek(ctx);
+  boolean = ws_to_boolean(ctx, value);
+
+  if (boolean->type == WVAL_TYPE_BOOLEAN)
+  {
+    if (boolean->data.boolean == when)
+    {
+      *next_cursor = target;
+      if (then_pop)
+        wval_release(context_ds_pop(ctx));
+    }
+    wval_release(value);
+    return 1;
+  }
+
+  ctx->cursor = *next_cursor;
+  exec_fork(ctx, 2);
+  taken = exec_branch(ctx, 0);
+  skipped = exec_branch(ctx, 1);
+
+  if (taken != NULL)
+    taken->cursor = target;
+
+  // Each branch knows more about a value it keeps on the stack.
+  if (!pop && taken != NULL)
+  {
+    wval_release(context_ds_pop(taken));
+    if (!then_pop)
+      context_ds_push(taken, domain_refine(ctx, value, when));
+  }
+
+  if (!pop && skipped != NULL)
+  {
+    wval_release(context_ds_pop(skipped));
+    context_ds_push(skipped, domain_refine(ctx, value, !when));
+  }
+
+  wval_release(value);
+  return 0;
+}
+
+/**
+ * `Diamond` marks a branch whose arms have no effect but the value they leave
+ * on the stack, when the condition (on the top of the stack) is ambiguous
+ * the context is not forked, instead both arms are evaluated in place and
+ * the values they leave are joined into a union.  Returns false if the branch has to
+ * be taken by the conditional jump that follows the instruction.
+ */
+int exec_diamond(ws_context *ctx, unsigned long *next_cursor, unsigned long join)
+{
+  uint8_t *data = ctx->function->data;
+  ws_diamond *diamond;
+  ws_val *value, *boolean;
+
+  if (ctx->diamonds_size == WS_DIAMOND_MAX_DEPTH)
+    return 0;
+
+  value = context_ds_peek(ctx);
+  boolean = ws_to_boolean(ctx, value);
+  wval_release(value);
+
+  if (boolean->type == WVAL_TYPE_BOOLEAN)
+    return 0;
+
+  // The next instruction is the JmpFalsePop to the second arm.
+  wval_release(context_ds_pop(ctx));
+  diamond = &ctx->diamonds[ctx->diamonds_size++];
+  diamond->join = join;
+  diamond->alternate = read_uint16(data + *next_cursor + 1);
+  diamond->second = 0;
+  diamond->ds_head = ctx->ds_head;
+  diamond->value = NULL;
+
+  *next_cursor += 1 + WS_BYTECODE_SIZE[WB_JMP_FALSE_POP];
+  return 1;
+}
+
+/**
+ * Called before every instruction, when the cursor is at the join point of
+ * the innermost diamond it either starts the second arm or joins the values
+ * of both arms.  Returns the cursor of the next instruction.
+ */
+unsigned long exec_diamond_join(ws_context *ctx, unsigned long cursor)
+{
+  ws_diamond *diamond;
+  ws_val *values[2];
+
+  while (ctx->diamonds_size > 0)
+  {
+    diamond = &ctx->diamonds[ctx->diamonds_size - 1];
+    if (cursor != diamond->join)
+      break;
+
+    if (!diamond->second)
+    {
+      if (ctx->ds_head != diamond->ds_head)
+        diamond->value = context_ds_pop(ctx);
+      diamond->second = 1;
+      cursor = diamond->alternate;
+      continue;
+    }
+
+    if (diamond->value != NULL)
+    {
+      values[0] = diamond->value;
+      values[1] = context_ds_pop(ctx);
+      context_ds_push(ctx, ws_union(values, 2));
+      wval_release(values[0]);
+      wval_release(values[1]);
+    }
+
+    --ctx->diamonds_size;
+  }
+
+  return cursor;
+}
+
+//==============================================================================
+// Loop widening, see VM.md.
+
+/**
+ * Argument of exec_loop_collect_var.
+ */
+struct _loop_collect
+{
+  ws_context *ctx;
+  ws_table *table;
+  ws_loop *loop;
+};
+
+void exec_loop_collect_var(ws_val *key, void *value, void *data)
+{
+  struct _loop_collect *collect = (struct _loop_collect *)data;
+  ws_loop *loop = collect->loop;
+
+  if (value == NULL || loop->size == WS_LOOP_MAX_STATE)
+    return;
+
+  // Shadowed slots and the variables of the outer scopes.
+  for (unsigned int i = loop->stack; i < loop->size; ++i)
+    if (wval_strict_equal(loop->keys[i], key))
+      return;
+
+  value = table_get(collect->ctx, collect->table, key);
+  if (value == NULL)
+    return;
+
+  loop->keys[loop->size] = key;
+  loop->state[loop->size++] = (ws_val *)value;
+}
+
+/**
+ * Read the loop state of the context, the top of the data stack, the
+ * variables up to the function scope and the digest of its output.  Nothing
+ * is retained.
+ */
+void exec_loop_state(ws_context *ctx, ws_loop *loop)
+{
+  struct _loop_collect collect = {ctx, NULL, loop};
+  ws_ds_entity *entity;
+  ws_scope *scope;
+
+  loop->size = 0;
+  loop->output_total = ctx->output == NULL ? 0 : ctx->output->total;
+  loop->output_hash = ctx->output == NULL ? 0 : ctx->output->hash;
+  for (entity = ctx->ds_head; entity != NULL; entity = entity->next)
+  {
+    if (loop->size == WS_LOOP_MAX_STATE)
+      break;
+    loop->state[loop->size++] = entity->value;
+  }
+
+  loop->stack = loop->size;
+  for (scope = ctx->scope; scope != NULL; scope = scope->parent)
+  {
+    collect.table = &scope->table;
+    table_each(ctx, &scope->table, exec_loop_collect_var, &collect);
+    if (!scope->is_block)
+      break;
+  }
+}
+
+/**
+ * Returns the index of the variable in the loop state or -1.
+ */
+int exec_loop_find(ws_loop *loop, ws_val *key)
+{
+  for (unsigned int i = loop->stack; i < loop->size; ++i)
+    if (wval_strict_equal(loop->keys[i], key))
+      return i;
+  return -1;
+}
+
+/**
+ * Replace the recorded state of a loop.
+ */
+void exec_loop_store(ws_loop *loop, ws_loop *state)
+{
+  for (unsigned int i = 0; i < state->size; ++i)
+  {
+    wval_retain(state->state[i]);
+    if (i >= state->stack)
+      wval_retain(state->keys[i]);
+  }
+
+  for (unsigned int i = 0; i < loop->size; ++i)
+  {
+    wval_release(loop->state[i]);
+    if (i >= loop->stack)
+      wval_release(loop->keys[i]);
+  }
+
+  loop->size = state->size;
+  loop->stack = state->stack;
+  loop->output_total = state->output_total;
+  loop->output_hash = state->output_hash;
+  for (unsigned int i = 0; i < state->size; ++i)
+  {
+    loop->keys[i] = state->keys[i];
+    loop->state[i] = state->state[i];
+  }
+}
+
+/**
+ * Write a (widened) state back to the data stack and the variables.
+ */
+void exec_loop_restore(ws_context *ctx, ws_loop *state)
+{
+  ws_scope *scope;
+  unsigned int i;
+
+  for (i = 0; i < state->stack; ++i)
+    wval_release(context_ds_pop(ctx));
+  for (i = state->stack; i > 0; --i)
+    context_ds_push(ctx, state->state[i - 1]);
+
+  for (i = state->stack; i < state->size; ++i)
+  {
+    for (scope = ctx->scope; scope != NULL; scope = scope->parent)
+    {
+      if (table_get(ctx, &scope->table, state->keys[i]) != NULL)
+      {
+        table_set(ctx, &scope->table, state->keys[i], state->state[i]);
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * Add a new loop to the context, returns NULL if there is no room.
+ */
+ws_loop *exec_loop_add(ws_context *ctx, unsigned long header)
+{
+  ws_loop *loops, *loop;
+
+  if (ctx->loops_size == WS_LOOP_MAX)
+    return NULL;
+
+  loops = (ws_loop *)ws_alloc(sizeof(ws_loop) * (ctx->loops_size + 1));
+  for (unsigned int i = 0; i < ctx->loops_size; ++i)
+    loops[i] = ctx->loops[i];
+  ws_free(ctx->loops);
+  ctx->loops = loops;
+
+  loop = &ctx->loops[ctx->loops_size++];
+  loop->header = header;
+  loop->frame = ctx->frame;
+  loop->depth = ctx->depth;
+  loop->iterations = 0;
+  loop->size = 0;
+  loop->stack = 0;
+  loop->output_total = 0;
+  loop->output_hash = 0;
+  return loop;
+}
+
+/**
+ * Called on every backward jump to `header`.  The first time a context that
+ * was forked reaches the header with an abstract state the state is
+ * recorded, and on the next iterations:
+ *
+ * 1. If the recorded state includes the current one and the branch wrote
+ *    the same output, it can not do anything that the branch which recorded
+ *    the state didn't, so it's marked as subsumed and false is returned.
+ * 2. If the loop forked more than `widen_after` times the current state is
+ *    widened with the recorded one, so the loop reaches a fixed point after
+ *    a few more iterations.
+ */
+int exec_loop(ws_context *ctx, unsigned long header)
+{
+  ws_loop current, *loop = NULL;
+  ws_val *widened;
+  unsigned int i;
+  int j, abstract;
+
+  // A context that never forked only runs concrete loops.
+  if (ctx->depth == 0)
+    return 1;
+
+  for (i = 0; i < ctx->loops_size; ++i)
+    if (ctx->loops[i].header == header && ctx->loops[i].frame == ctx->frame)
+      loop = &ctx->loops[i];
+
+  exec_loop_state(ctx, &current);
+
+  if (loop == NULL)
+  {
+    for (i = 0, abstract = 0; i < current.size; ++i)
+      abstract |= wval_is_abstract(current.state[i]);
+    if (abstract && (loop = exec_loop_add(ctx, header)) != NULL)
+      exec_loop_store(loop, &current);
+    return 1;
+  }
+
+  // The loop state changed its shape, start over.
+  if (loop->size != current.size || loop->stack != current.stack)
+  {
+    loop->depth = ctx->depth;
+    loop->iterations = 0;
+    exec_loop_store(loop, &current);
+    return 1;
+  }
+
+  // Put the variables in the same order as the recorded state.
+  for (i = current.stack; i < current.size; ++i)
+  {
+    j = exec_loop_find(&current, loop->keys[i]);
+    if (j < 0)
+    {
+      loop->iterations = 0;
+      exec_loop_store(loop, &current);
+      return 1;
+    }
+    widened = current.state[i];
+    current.state[i] = current.state[j];
+    current.state[j] = widened;
+    current.keys[j] = current.keys[i];
+    current.keys[i] = loop->keys[i];
+  }
+
+  for (i = 0; i < current.size; ++i)
+    if (!domain_includes(loop->state[i], current.state[i]))
+      break;
+
+  // A branch that wrote something else would lose its output.
+  if (i == current.size && loop->output_total == current.output_total &&
+      loop->output_hash == current.output_hash)
+  {
+    ctx->subsumed = 1;
+    return 0;
+  }
+
+  // This iteration did not fork, it's a concrete loop so far.
+  if (loop->depth == ctx->depth)
+  {
+    exec_loop_store(loop, &current);
+    return 1;
+  }
+
+  loop->depth = ctx->depth;
+  if (++loop->iterations > ctx->loop_limit)
+  {
+    ctx->subsumed = 1;
+    return 0;
+  }
+
+  if (loop->iterations <= ctx->widen_after)
+  {
+    exec_loop_store(loop, &current);
+    return 1;
+  }
+
+  // The widened values are only held by `current` until they are stored, a
+  // reference is taken for that time and dropped once the loop has its own.
+  for (i = 0; i < current.size; ++i)
+  {
+    widened = domain_widen(loop->state[i], current.state[i]);
+    if (widened != NULL)
+      current.state[i] = widened;
+    wval_retain(current.state[i]);
+  }
+
+  exec_loop_restore(ctx, &current);
+  exec_loop_store(loop, &current);
+
+  for (i = 0; i < current.size; ++i)
+    wval_release(current.state[i]);
+  return 1;
+}
+
+//==============================================================================
+
+/**
+ * Charge one unit of fuel, returns true if the context ran out of fuel.
+ */
+int exec_burn(ws_context *ctx)
+{
+  if (ctx->fuel == WS_FUEL_UNLIMITED)
+    return 0;
+  if (ctx->fuel > 0)
+    --ctx->fuel;
+  return ctx->fuel == 0;
+}
+
+int exec_implemented(unsigned int bytecode)
+{
+  // Keep it in sync with the switch of exec_run.
+  switch (bytecode)
+  {
+  case WB_LD_UNDEF:
+  case WB_LD_NULL:
+  case WB_LD_FALSE:
+  case WB_LD_TRUE:
+  case WB_LD_ZERO:
+  case WB_LD_ONE:
+  case WB_LD_TWO:
+  case WB_POP:
+  case WB_DUP:
+  case WB_SWAP:
+  case WB_ADD:
+  case WB_SUB:
+  case WB_MUL:
+  case WB_LT:
+  case WB_LTE:
+  case WB_GT:
+  case WB_GTE:
+  case WB_EQS:
+  case WB_IEQS:
+  case WB_NOT:
+  case WB_NEG:
+  case WB_POS:
+  case WB_JMP:
+  case WB_JMP_TRUE_POP:
+  case WB_JMP_FALSE_POP:
+  case WB_JMP_TRUE_PEEK:
+  case WB_JMP_FALSE_PEEK:
+  case WB_JMP_TRUE_THEN_POP:
+  case WB_JMP_FALSE_THEN_POP:
+  case WB_CALL_0:
+  case WB_CALL_1:
+  case WB_CALL_2:
+  case WB_CALL_3:
+  case WB_RET:
+  case WB_LD_STR:
+  case WB_REG_EXP:
+  case WB_NAMED:
+  case WB_NAMED_PROP:
+  case WB_LD_ARR:
+  case WB_AR_PUSH:
+  case WB_PROP:
+  case WB_NEXT:
+  case WB_LET:
+  case WB_LD_FUNCTION:
+  // Only the native constructors, the others leave more values on the stack
+  // than the verifier expects, which is safe.
+  case WB_NEW_0:
+  case WB_NEW_1:
+  case WB_NEW_2:
+  case WB_NEW_3:
+  case WB_DIAMOND:
+  case WB_SWITCH:
+  case WB_LD_SCOPE:
+    return 1;
+
+  default:
+    return 0;
+  }
+}
+
+//==============================================================================
+
+#define EXEC_PUSH(ctx, value) \
+  (verified ? context_ds_push_unchecked(ctx, value) : context_ds_push(ctx, value))
+#define EXEC_POP(ctx) \
+  (verified ? context_ds_pop_unchecked(ctx) : context_ds_pop(ctx))
+
+/**
+ * The interpreter loop, see exec_resume.
+ */
+ws_val *exec_run(ws_context *ctx)
+{
+  ws_function_compiled_data *function = ctx->function;
+  unsigned long cursor = ctx->cursor, next_cursor = 0;
   unsigned int bytecode;
   uint8_t *data = function->data;
+  int running, preempt = 0, verified = function->verified;
 
+  ws_function *callee;
   ws_val *a;
   ws_val *b;
+  ws_val *c;
+  size_t index;
+
+  if (ctx->forked)
+    die("exec: Cannot run a forked context.");
+
+  // The stack of a verified function can not underflow and its depth is
+  // known, so the entities are taken from the pool up front and the stack
+  // operations skip their checks.
+  if (verified)
+    ws_reserve_ds_entities(function->max_stack);
+
+  // A forked child may start at the join point of a diamond.
+  cursor = exec_diamond_join(ctx, cursor);
 
   while (cursor < function->constant_pool_offset)
   {
     bytecode = data[cursor];
     next_cursor = cursor + 1 + WS_BYTECODE_SIZE[bytecode];
+    ++ctx->instructions;
 
     switch (bytecode)
     {
     case WB_LD_UNDEF:
     {
-      context_ds_push(ctx, (ws_val *)&WS_UNDEFINED);
+      EXEC_PUSH(ctx, (ws_val *)&WS_UNDEFINED);
       break;
     }
 
     case WB_LD_NULL:
     {
-      context_ds_push(ctx, (ws_val *)&WS_NULL);
+      EXEC_PUSH(ctx, (ws_val *)&WS_NULL);
       break;
     }
 
     case WB_LD_FALSE:
     {
-      context_ds_push(ctx, (ws_val *)&WS_FALSE);
+      EXEC_PUSH(ctx, (ws_val *)&WS_FALSE);
       break;
     }
 
     case WB_LD_TRUE:
     {
-      context_ds_push(ctx, (ws_val *)&WS_TRUE);
+      EXEC_PUSH(ctx, (ws_val *)&WS_TRUE);
       break;
     }
 
     case WB_LD_ZERO:
     {
-      context_ds_push(ctx, (ws_val *)&WS_ZERO);
+      EXEC_PUSH(ctx, (ws_val *)&WS_ZERO);
       break;
     }
 
     case WB_LD_ONE:
     {
-      context_ds_push(ctx, (ws_val *)&WS_ONE);
+      EXEC_PUSH(ctx, (ws_val *)&WS_ONE);
       break;
     }
 
     case WB_LD_TWO:
     {
-      context_ds_push(ctx, (ws_val *)&WS_TWO);
+      EXEC_PUSH(ctx, (ws_val *)&WS_TWO);
       break;
     }
 
     case WB_POP:
     {
-      wval_release(context_ds_pop(ctx));
+      wval_release(EXEC_POP(ctx));
       break;
     }
 
     case WB_DUP:
     {
       a = context_ds_peek(ctx);
-      context_ds_push(ctx, a);
+      EXEC_PUSH(ctx, a);
       wval_release(a);
       a = NULL;
       break;
@@ -86,13 +1051,286 @@ ws_val *exec(ws_context *ctx, ws_function_compiled_data *function)
 
     case WB_SWAP:
     {
-      a = context_ds_pop(ctx);
-      b = context_ds_pop(ctx);
-      context_ds_push(ctx, a);
-      context_ds_push(ctx, b);
+      a = EXEC_POP(ctx);
+      b = EXEC_POP(ctx);
+      EXEC_PUSH(ctx, a);
+      EXEC_PUSH(ctx, b);
+      wval_release(a);
+      wval_release(b);
+      a = b = NULL;
+      break;
+    }
+
+    case WB_ADD:
+    case WB_SUB:
+    case WB_MUL:
+    case WB_LT:
+    case WB_LTE:
+    case WB_GT:
+    case WB_GTE:
+    case WB_EQS:
+    case WB_IEQS:
+    {
+      b = EXEC_POP(ctx);
+      a = EXEC_POP(ctx);
+      running = exec_push_result(ctx, cursor, exec_binary(ctx, bytecode, a, b), a, b);
       wval_release(a);
       wval_release(b);
       a = b = NULL;
+      if (!running)
+        return NULL;
+      break;
+    }
+
+    case WB_NOT:
+    case WB_NEG:
+    case WB_POS:
+    {
+      a = EXEC_POP(ctx);
+      running = exec_push_result(ctx, cursor, exec_unary(ctx, bytecode, a), a, NULL);
+      wval_release(a);
+      a = NULL;
+      if (!running)
+        return NULL;
+      break;
+    }
+
+    case WB_JMP:
+    {
+      next_cursor = read_uint16(data + cursor + 1);
+      if (next_cursor <= cursor)
+      {
+        preempt = exec_burn(ctx);
+        if (!exec_loop(ctx, next_cursor))
+          return NULL;
+      }
+      break;
+    }
+
+    case WB_JMP_TRUE_POP:
+    case WB_JMP_FALSE_POP:
+    case WB_JMP_TRUE_PEEK:
+    case WB_JMP_FALSE_PEEK:
+    case WB_JMP_TRUE_THEN_POP:
+    case WB_JMP_FALSE_THEN_POP:
+    {
+      running = exec_jump(ctx,
+                          &next_cursor,
+                          read_uint16(data + cursor + 1),
+                          bytecode == WB_JMP_TRUE_POP ||
+                              bytecode == WB_JMP_TRUE_PEEK ||
+                              bytecode == WB_JMP_TRUE_THEN_POP,
+                          bytecode == WB_JMP_TRUE_POP ||
+                              bytecode == WB_JMP_FALSE_POP,
+                          bytecode == WB_JMP_TRUE_THEN_POP ||
+                              bytecode == WB_JMP_FALSE_THEN_POP);
+      if (!running)
+        return NULL;
+      if (next_cursor <= cursor)
+      {
+        preempt = exec_burn(ctx);
+        if (!exec_loop(ctx, next_cursor))
+          return NULL;
+      }
+      break;
+    }
+
+    case WB_CALL_0:
+    case WB_CALL_1:
+    case WB_CALL_2:
+    case WB_CALL_3:
+    {
+      preempt = exec_burn(ctx);
+      if (exec_call_native(ctx, bytecode - WB_CALL_0))
+        break;
+      exec_call(ctx, bytecode - WB_CALL_0, next_cursor);
+      function = ctx->function;
+      data = function->data;
+      verified = function->verified;
+      if (verified)
+        ws_reserve_ds_entities(function->max_stack);
+      next_cursor = 0;
+      break;
+    }
+
+    case WB_RET:
+    {
+      if (ctx->frame == NULL)
+      {
+        ctx->cursor = function->constant_pool_offset;
+        return EXEC_POP(ctx);
+      }
+
+      next_cursor = exec_return(ctx);
+      // Back to a native caller, see `call`.
+      if (ctx->function == NULL)
+        return EXEC_POP(ctx);
+
+      function = ctx->function;
+      data = function->data;
+      verified = function->verified;
+      break;
+    }
+
+    case WB_LD_STR:
+    {
+      EXEC_PUSH(ctx, function->constants[read_uint32(data + cursor + 1)]);
+      break;
+    }
+
+    case WB_REG_EXP:
+    {
+      EXEC_PUSH(ctx, ws_regexp_literal(ctx, function->constants[read_uint32(data + cursor + 1)]));
+      break;
+    }
+
+    case WB_NAMED:
+    {
+      a = context_resolve(ctx, function->constants[read_uint32(data + cursor + 1)]);
+      if (a == NULL)
+        die("exec: Name is not defined.");
+      EXEC_PUSH(ctx, a);
+      break;
+    }
+
+    case WB_NAMED_PROP:
+    {
+      a = EXEC_POP(ctx);
+      if (a->type == WVAL_TYPE_UNDEFINED || a->type == WVAL_TYPE_NULL)
+        die("exec: Cannot read a property of null or undefined.");
+      // TODO(qti3e) Properties of the primitives.
+      b = a->type == WVAL_TYPE_OBJECT
+              ? object_get(ctx, a, function->constants[read_uint32(data + cursor + 1)])
+              : NULL;
+      EXEC_PUSH(ctx, b == NULL ? (ws_val *)&WS_UNDEFINED : b);
+      wval_release(a);
+      break;
+    }
+
+    case WB_LD_ARR:
+    {
+      EXEC_PUSH(ctx, ws_array(ctx));
+      break;
+    }
+
+    case WB_AR_PUSH:
+    {
+      a = EXEC_POP(ctx);
+      b = EXEC_POP(ctx);
+      if (b->type != WVAL_TYPE_OBJECT || b->data.object->elements == NULL)
+        die("exec: ArPush on a value that is not an array.");
+      array_push(ctx, b->data.object, a);
+      EXEC_PUSH(ctx, b);
+      wval_release(a);
+      wval_release(b);
+      break;
+    }
+
+    case WB_PROP:
+    {
+      b = EXEC_POP(ctx);
+      a = EXEC_POP(ctx);
+      if (a->type == WVAL_TYPE_UNDEFINED || a->type == WVAL_TYPE_NULL)
+        die("exec: Cannot read a property of null or undefined.");
+
+      c = NULL;
+      if (a->type != WVAL_TYPE_OBJECT)
+      {
+        // TODO(qti3e) Properties of the primitives.
+      }
+      else if (a->data.object->elements != NULL && array_index(b, &index))
+      {
+        // Integer indices of an array don't go through the tables.
+        c = array_get(ctx, a->data.object, index);
+      }
+      else if (a->data.object->typed != NULL && array_index(b, &index))
+      {
+        // Out of the bounds is undefined, it doesn't look at the prototype.
+        c = typed_array_get(ctx, a->data.object, index);
+      }
+      else if (b->type == WVAL_TYPE_STRING || b->type == WVAL_TYPE_SYMBOL)
+      {
+        c = object_get(ctx, a, b);
+      }
+      // TODO(qti3e) ToPropertyKey for the other keys.
+
+      EXEC_PUSH(ctx, c == NULL ? (ws_val *)&WS_UNDEFINED : c);
+      wval_release(a);
+      wval_release(b);
+      break;
+    }
+
+    case WB_NEXT:
+    {
+      a = EXEC_POP(ctx);
+      b = a->type == WVAL_TYPE_ITERATOR ? object_iterator_own(ctx, a)
+                                        : object_iterator(ctx, a);
+      c = object_next(ctx, b->data.iterator);
+      EXEC_PUSH(ctx, b);
+      EXEC_PUSH(ctx, c == NULL ? (ws_val *)&WS_UNDEFINED : c);
+      EXEC_PUSH(ctx, c == NULL ? (ws_val *)&WS_FALSE : (ws_val *)&WS_TRUE);
+      wval_release(a);
+      break;
+    }
+
+    case WB_LET:
+    {
+      a = EXEC_POP(ctx);
+      context_define(ctx, function->constants[read_uint32(data + cursor + 1)], a, 1);
+      wval_release(a);
+      break;
+    }
+
+    case WB_LD_FUNCTION:
+    {
+      callee = get_function(read_uint16(data + cursor + 1), ctx->scope);
+      if (callee == NULL)
+        die("exec: Unknown function.");
+      EXEC_PUSH(ctx, ws_function_object(ctx, callee));
+      break;
+    }
+
+    case WB_NEW_0:
+    case WB_NEW_1:
+    case WB_NEW_2:
+    case WB_NEW_3:
+    {
+      preempt = exec_burn(ctx);
+      if (exec_call_native(ctx, bytecode - WB_NEW_0))
+        break;
+      // TODO(qti3e) Constructors.
+      fprintf(stderr, "TODO: %s\n", WS_BYTECODE_NAME[bytecode]);
+      break;
+    }
+
+    case WB_CALL:
+    {
+      preempt = exec_burn(ctx);
+      // TODO(qti3e) Calls.
+      fprintf(stderr, "TODO: %s\n", WS_BYTECODE_NAME[bytecode]);
+      break;
+    }
+
+    case WB_DIAMOND:
+    {
+      exec_diamond(ctx, &next_cursor, read_uint16(data + cursor + 1));
+      break;
+    }
+
+    case WB_LD_SCOPE:
+    {
+      // Every function starts with it, the scope of the call is already made
+      // by exec_enter (and by the runner for the main function).
+      break;
+    }
+
+    case WB_SWITCH:
+    {
+      a = EXEC_POP(ctx);
+      next_cursor = switch_lookup(function, read_uint32(data + cursor + 1), a);
+      wval_release(a);
+      a = NULL;
+      break;
     }
 
     default:
@@ -100,7 +1338,64 @@ ws_val *exec(ws_context *ctx, ws_function_compiled_data *function)
     }
 
     cursor = next_cursor;
+    if (ctx->diamonds_size > 0)
+      cursor = exec_diamond_join(ctx, cursor);
+
+    // Give the control back to the scheduler, it can resume us later.
+    if (preempt)
+    {
+      ctx->cursor = cursor;
+      return NULL;
+    }
   }
 
+  ctx->cursor = cursor;
   return context_ds_pop(ctx);
-}
\ No newline at end of file
+}
+
+ws_val *exec(ws_context *ctx, ws_function_compiled_data *function)
+{
+  ctx->function = function;
+  ctx->cursor = 0;
+  return exec_resume(ctx);
+}
+
+ws_val *exec_replay(ws_context *ctx,
+                    ws_function_compiled_data *function,
+                    ws_trace *trace)
+{
+  ws_val *result;
+
+  trace->position = 0;
+  ctx->replay = trace;
+  ctx->function = function;
+  ctx->cursor = 0;
+
+  // A replayed fork returns without forking the context, just continue.
+  do
+    result = exec_resume(ctx);
+  while (result == NULL && !ctx->forked && !ctx->subsumed && ctx->error == NULL);
+
+  ctx->replay = NULL;
+  return result;
+}
+
+ws_val *exec_resume(ws_context *ctx)
+{
+  ws_context *previous;
+  ws_val *result = NULL;
+  jmp_buf handler;
+
+  // A call from a builtin, an error goes to the outermost run.
+  if (ctx->handler != NULL)
+    return exec_run(ctx);
+
+  // Everything that is allocated in this run belongs to this context.
+  previous = ws_set_current_context(ctx);
+  ctx->handler = &handler;
+  if (setjmp(handler) == 0)
+    result = exec_run(ctx);
+  ctx->handler = NULL;
+  ws_set_current_context(previous);
+  return result;
+}
@@ -0,0 +1,332 @@
+#ifdef WS_TRACING_GC
+
+#include <stdatomic.h>
+#include "gc.h"
+#include "wval.h"
+#include "context.h"
+#include "alloc.h"
+#include "compiler.h"
+#include "object.h"
+#include "array.h"
+#include "collection.h"
+#include "buffer.h"
+
+// For documentation and comments see gc.h :)
+
+/**
+ * List of all the values, linked by ws_val.gc_next.
+ */
+ws_val *_Atomic gc_heap = NULL;
+
+/**
+ * Number of allocations since the last collection.
+ */
+atomic_ulong gc_allocated = 0;
+
+//==============================================================================
+// Mark phase, it uses an explicit stack so deep structures (like a long
+// rope) can not overflow the C stack.
+
+typedef struct
+{
+  ws_val **values;
+  unsigned long size;
+  unsigned long capacity;
+} gc_worklist;
+
+void gc_mark(gc_worklist *list, ws_val *value)
+{
+  ws_val **tmp;
+
+  if (value == NULL || value->marked)
+    return;
+
+  value->marked = 1;
+
+  if (list->size == list->capacity)
+  {
+    tmp = list->values;
+    list->capacity = list->capacity == 0 ? 64 : list->capacity * 2;
+    list->values = (ws_val **)ws_alloc(sizeof(ws_val *) * list->capacity);
+    for (unsigned long i = 0; i < list->size; ++i)
+      list->values[i] = tmp[i];
+    ws_free(tmp);
+  }
+
+  list->values[list->size++] = value;
+}
+
+/**
+ * Used with table_each_reachable, the tables store values.
+ */
+void gc_mark_slot(ws_val *key, void *value, void *data)
+{
+  gc_mark((gc_worklist *)data, key);
+  gc_mark((gc_worklist *)data, (ws_val *)value);
+}
+
+/**
+ * Mark the variables of the scope chain, see table_each_reachable.
+ */
+void gc_mark_scope(gc_worklist *list, ws_scope *scope)
+{
+  for (; scope != NULL; scope = scope->parent)
+    table_each_reachable(&scope->table, gc_mark_slot, list);
+}
+
+/**
+ * Mark the values of an element storage.
+ */
+void gc_mark_elements(gc_worklist *list, ws_elements *elements)
+{
+  if (elements->kind == WS_ELEMENTS_PACKED_DOUBLES)
+    return;
+  for (size_t i = 0; i < elements->length; ++i)
+    gc_mark(list, elements->data.values[i]);
+}
+
+/**
+ * Used with table_each_reachable on `copies` of an array.
+ */
+void gc_mark_elements_slot(ws_val *key, void *value, void *data)
+{
+  (void)key;
+  if (value != NULL)
+    gc_mark_elements((gc_worklist *)data, (ws_elements *)value);
+}
+
+/**
+ * Mark the keys and the values of a collection storage.
+ */
+void gc_mark_collection(gc_worklist *list, ws_collection *collection)
+{
+  for (size_t i = 0; i < collection->used; ++i)
+  {
+    gc_mark(list, collection->entries[i].key);
+    gc_mark(list, collection->entries[i].value);
+  }
+}
+
+/**
+ * Used with table_each_reachable on `copies` of a Map or a Set.
+ */
+void gc_mark_collection_slot(ws_val *key, void *value, void *data)
+{
+  (void)key;
+  if (value != NULL)
+    gc_mark_collection((gc_worklist *)data, (ws_collection *)value);
+}
+
+/**
+ * Mark everything that is reachable from the values on the worklist.
+ *
+ * The mark bit is shared by all of the contexts, so a value is only traced
+ * once even if many contexts reach it.  So what it holds is traced through
+ * the overlays and the storage copies of every reachable context, not only
+ * the ones that the context which reached it first can see.
+ */
+void gc_drain(gc_worklist *list)
+{
+  ws_val *value;
+  ws_obj *object;
+
+  while (list->size > 0)
+  {
+    value = list->values[--list->size];
+
+    switch (value->type)
+    {
+    case WVAL_TYPE_STRING:
+      gc_mark(list, value->data.string.left);
+      gc_mark(list, value->data.string.right);
+      break;
+
+    case WVAL_TYPE_SYMBOL:
+      gc_mark(list, value->data.symbol.description);
+      break;
+
+    case WVAL_TYPE_ITERATOR:
+      gc_mark(list, value->data.iterator->target);
+      break;
+
+    case WVAL_TYPE_UNION:
+      for (unsigned int i = 0; i < value->data.set.size; ++i)
+        gc_mark(list, value->data.set.values[i]);
+      break;
+
+    case WVAL_TYPE_OBJECT:
+      // The prototype chain is made of objects that have their own values,
+      // the properties are stored in the per-context overlays.
+      for (object = value->data.object; object != NULL; object = object->proto)
+      {
+        table_each_reachable(&object->properties, gc_mark_slot, list);
+        // The copies of the storage are kept in the overlays of `copies`.
+        if (object->elements != NULL)
+        {
+          gc_mark_elements(list, object->elements);
+          table_each_reachable(&object->copies, gc_mark_elements_slot, list);
+        }
+        if (object->collection != NULL)
+        {
+          gc_mark_collection(list, object->collection);
+          table_each_reachable(&object->copies, gc_mark_collection_slot, list);
+        }
+        if (object->typed != NULL)
+          gc_mark(list, object->typed->buffer);
+        gc_mark(list, object->self);
+        // A function keeps the scope it was created in alive.
+        if (object->call != NULL)
+          gc_mark_scope(list, object->call->scope);
+      }
+      break;
+
+    default:
+      break;
+    }
+  }
+}
+
+void gc_mark_context(gc_worklist *list, ws_context *ctx)
+{
+  ws_ds_entity *entity;
+  ws_frame *frame;
+
+  for (entity = ctx->ds_head; entity != NULL; entity = entity->next)
+    gc_mark(list, entity->value);
+
+  gc_mark_scope(list, ctx->scope);
+
+  // The scopes of the callers, their stacks are below the current one.
+  for (frame = ctx->frame; frame != NULL; frame = frame->prev)
+    gc_mark_scope(list, frame->scope);
+
+  for (unsigned int i = 0; i < ctx->diamonds_size; ++i)
+    gc_mark(list, ctx->diamonds[i].value);
+
+  for (unsigned int i = 0; i < ctx->loops_size; ++i)
+  {
+    for (unsigned int j = 0; j < ctx->loops[i].size; ++j)
+    {
+      gc_mark(list, ctx->loops[i].state[j]);
+      if (j >= ctx->loops[i].stack)
+        gc_mark(list, ctx->loops[i].keys[j]);
+    }
+  }
+
+  gc_drain(list);
+}
+
+//==============================================================================
+// Sweep phase.
+
+void gc_free_value(ws_val *value)
+{
+  switch (value->type)
+  {
+  case WVAL_TYPE_STRING:
+    // Only the buffer of a rope is owned by the value, see ws_string_flatten.
+    if (value->data.string.owns_data)
+      ws_free(value->data.string.data);
+    break;
+
+  case WVAL_TYPE_UNION:
+    ws_free(value->data.set.values);
+    break;
+
+  case WVAL_TYPE_ITERATOR:
+    ws_free(value->data.iterator);
+    break;
+
+  case WVAL_TYPE_OBJECT:
+    table_destroy_all(&value->data.object->properties);
+    if (value->data.object->elements != NULL)
+      array_free(value->data.object);
+    if (value->data.object->collection != NULL)
+      collection_free(value->data.object);
+    if (value->data.object->buffer != NULL)
+      buffer_free(value->data.object);
+    if (value->data.object->typed != NULL)
+      typed_array_free(value->data.object);
+    ws_free_obj(value->data.object);
+    break;
+
+  default:
+    break;
+  }
+
+  ws_free_val(value);
+}
+
+unsigned long gc_sweep()
+{
+  ws_val **link, *value;
+  unsigned long freed = 0;
+
+  link = (ws_val **)&gc_heap;
+  while ((value = *link) != NULL)
+  {
+    if (value->marked)
+    {
+      value->marked = 0;
+      link = &value->gc_next;
+      continue;
+    }
+
+    *link = value->gc_next;
+    gc_free_value(value);
+    ++freed;
+  }
+
+  return freed;
+}
+
+//==============================================================================
+
+void gc_register(ws_val *value)
+{
+  ws_val *head;
+
+  value->marked = 0;
+  head = atomic_load(&gc_heap);
+  do
+    value->gc_next = head;
+  while (!atomic_compare_exchange_weak(&gc_heap, &head, value));
+
+  ++gc_allocated;
+}
+
+int gc_should_collect()
+{
+  return gc_allocated >= WS_GC_THRESHOLD;
+}
+
+/**
+ * Set (or clear) `gc_reachable` on the live contexts and their ancestors.
+ */
+void gc_set_reachable(ws_context_list *live, int reachable)
+{
+  ws_context *ctx;
+
+  for (; live != NULL; live = live->next)
+    for (ctx = live->ctx; ctx != NULL && ctx->gc_reachable != reachable; ctx = ctx->parent)
+      ctx->gc_reachable = reachable;
+}
+
+unsigned long gc_collect(ws_context_list *live)
+{
+  gc_worklist list = {.values = NULL, .size = 0, .capacity = 0};
+  ws_context_list *item;
+
+  gc_set_reachable(live, 1);
+  for (item = live; item != NULL; item = item->next)
+    gc_mark_context(&list, item->ctx);
+  gc_set_reachable(live, 0);
+
+  ws_free(list.values);
+  gc_allocated = 0;
+  // The caches may point to the values that are swept.
+  object_cache_clear();
+  return gc_sweep();
+}
+
+#endif
@@ -0,0 +1,893 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "json.h"
+#include "array.h"
+#include "buffer.h"
+#include "regexp.h"
+#include "object.h"
+#include "context.h"
+#include "common.h"
+#include "alloc.h"
+
+// For documentation and comments see json.h :)
+
+//==============================================================================
+// Output buffer.
+
+/**
+ * Make room for `size` more code units (and the NUL).
+ */
+void json_reserve(ws_json_writer *writer, size_t size)
+{
+  char16_t *data;
+  size_t capacity;
+
+  if (writer->length + size < writer->capacity)
+    return;
+
+  capacity = writer->capacity < 64 ? 64 : writer->capacity;
+  while (writer->length + size >= capacity)
+    capacity *= 2;
+
+  data = (char16_t *)ws_alloc_as(WS_MEMORY_VALUES, capacity * sizeof(char16_t));
+  if (writer->length > 0)
+    memcpy(data, writer->data, writer->length * sizeof(char16_t));
+  ws_free(writer->data);
+  writer->data = data;
+  writer->capacity = capacity;
+}
+
+void json_write(ws_json_writer *writer, const char16_t *data, size_t length)
+{
+  json_reserve(writer, length);
+  memcpy(writer->data + writer->length, data, length * sizeof(char16_t));
+  writer->length += length;
+}
+
+#define JSON_WRITE(writer, literal) \
+  json_write(writer, literal, sizeof(literal) / sizeof(char16_t) - 1)
+
+/**
+ * Returns a new string of the code units.
+ */
+ws_val *json_string(const char16_t *data, size_t length)
+{
+  char16_t *copy;
+
+  copy = (char16_t *)ws_alloc_as(WS_MEMORY_VALUES, (length + 1) * sizeof(char16_t));
+  memcpy(copy, data, length * sizeof(char16_t));
+  copy[length] = 0;
+  return ws_string(copy, (length + 1) * sizeof(char16_t));
+}
+
+//==============================================================================
+// JSON.parse
+
+/**
+ * Throw the syntax error on the branch, see context_throw.
+ */
+void json_error(ws_json_parser *parser, char *message)
+{
+  context_throw(parser->ctx, message);
+}
+
+/**
+ * Skip the white spaces, JSON only has these four.
+ */
+void json_skip(ws_json_parser *parser)
+{
+  const char16_t *data = parser->data;
+  size_t cursor = parser->cursor;
+
+  while (cursor < parser->length &&
+         (data[cursor] == ' ' || data[cursor] == '\n' ||
+          data[cursor] == '\r' || data[cursor] == '\t'))
+    ++cursor;
+
+  parser->cursor = cursor;
+}
+
+/**
+ * Skip the white spaces and the expected code unit.
+ */
+void json_expect(ws_json_parser *parser, char16_t c)
+{
+  json_skip(parser);
+  if (parser->cursor >= parser->length)
+    json_error(parser, "JSON: Unexpected end of input.");
+  if (parser->data[parser->cursor] != c)
+    json_error(parser, "JSON: Unexpected token.");
+  parser->cursor += 1;
+}
+
+/**
+ * Returns the value of a hex digit or -1.
+ */
+int json_hex(char16_t c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+/**
+ * Read an escape, the cursor is after the backslash.
+ */
+char16_t json_parse_escape(ws_json_parser *parser)
+{
+  char16_t c;
+  int unit = 0, digit;
+
+  if (parser->cursor >= parser->length)
+    json_error(parser, "JSON: Unterminated string.");
+
+  c = parser->data[parser->cursor++];
+  switch (c)
+  {
+  case '"':
+  case '\\':
+  case '/':
+    return c;
+  case 'b':
+    return '\b';
+  case 'f':
+    return '\f';
+  case 'n':
+    return '\n';
+  case 'r':
+    return '\r';
+  case 't':
+    return '\t';
+  case 'u':
+    if (parser->length - parser->cursor < 4)
+      json_error(parser, "JSON: Bad Unicode escape.");
+    for (int i = 0; i < 4; ++i)
+    {
+      digit = json_hex(parser->data[parser->cursor++]);
+      if (digit < 0)
+        json_error(parser, "JSON: Bad Unicode escape.");
+      unit = unit * 16 + digit;
+    }
+    return unit;
+  default:
+    json_error(parser, "JSON: Bad escaped character.");
+  }
+}
+
+/**
+ * Read a string, the cursor is at the opening quote.
+ */
+ws_val *json_parse_string(ws_json_parser *parser)
+{
+  const char16_t *data = parser->data;
+  size_t start, cursor;
+  ws_json_writer *scratch = &parser->scratch;
+  char16_t c;
+
+  start = cursor = parser->cursor + 1;
+  cursor += escape_span(data + cursor, parser->length - cursor, 1);
+
+  // Most strings have no escapes, they are copied once.
+  if (cursor < parser->length && data[cursor] == '"')
+  {
+    parser->cursor = cursor + 1;
+    return json_string(data + start, cursor - start);
+  }
+
+  scratch->length = 0;
+  for (;;)
+  {
+    json_write(scratch, data + start, cursor - start);
+    if (cursor >= parser->length)
+      json_error(parser, "JSON: Unterminated string.");
+
+    c = data[cursor++];
+    if (c == '"')
+      break;
+    if (c < 0x20)
+      json_error(parser, "JSON: Bad control character in string literal.");
+
+    if (c == '\\')
+    {
+      parser->cursor = cursor;
+      c = json_parse_escape(parser);
+      cursor = parser->cursor;
+    }
+
+    // The surrogates stop the scan too, but they are fine as they are.
+    json_write(scratch, &c, 1);
+
+    start = cursor;
+    cursor += escape_span(data + cursor, parser->length - cursor, 1);
+  }
+
+  parser->cursor = cursor;
+  return json_string(scratch->data, scratch->length);
+}
+
+/**
+ * Read a number, the cursor is at its first code unit.
+ */
+ws_val *json_parse_number(ws_json_parser *parser)
+{
+  const char16_t *data = parser->data;
+  size_t start, cursor, length = parser->length;
+  char small[64], *text;
+  double number = 0;
+  int integral = 1;
+
+  start = cursor = parser->cursor;
+  if (data[cursor] == '-')
+    ++cursor;
+
+  if (cursor < length && data[cursor] == '0')
+    ++cursor;
+  else if (cursor < length && data[cursor] >= '1' && data[cursor] <= '9')
+    while (cursor < length && data[cursor] >= '0' && data[cursor] <= '9')
+      ++cursor;
+  else
+    json_error(parser, "JSON: No number after minus sign.");
+
+  if (cursor < length && data[cursor] == '.')
+  {
+    integral = 0;
+    if (++cursor >= length || data[cursor] < '0' || data[cursor] > '9')
+      json_error(parser, "JSON: Unterminated fractional number.");
+    while (cursor < length && data[cursor] >= '0' && data[cursor] <= '9')
+      ++cursor;
+  }
+
+  if (cursor < length && (data[cursor] == 'e' || data[cursor] == 'E'))
+  {
+    integral = 0;
+    if (++cursor < length && (data[cursor] == '+' || data[cursor] == '-'))
+      ++cursor;
+    if (cursor >= length || data[cursor] < '0' || data[cursor] > '9')
+      json_error(parser, "JSON: Exponent part is missing a number.");
+    while (cursor < length && data[cursor] >= '0' && data[cursor] <= '9')
+      ++cursor;
+  }
+
+  parser->cursor = cursor;
+
+  // Up to 15 digits are exact in a double, no need to round.
+  if (integral && cursor - start <= 15)
+  {
+    for (size_t i = data[start] == '-' ? start + 1 : start; i < cursor; ++i)
+      number = number * 10 + (data[i] - '0');
+    return ws_number(data[start] == '-' ? -number : number);
+  }
+
+  text = cursor - start < sizeof(small) ? small : (char *)ws_alloc(cursor - start + 1);
+  for (size_t i = start; i < cursor; ++i)
+    text[i - start] = (char)data[i];
+  text[cursor - start] = 0;
+  number = strtod(text, NULL);
+  if (text != small)
+    ws_free(text);
+
+  return ws_number(number);
+}
+
+/**
+ * Read `true`, `false` or `null`.
+ */
+ws_val *json_parse_literal(ws_json_parser *parser)
+{
+  static const struct
+  {
+    const char16_t *name;
+    size_t length;
+    ws_val *value;
+  } literals[] = {
+      {u"true", 4, &WS_TRUE},
+      {u"false", 5, &WS_FALSE},
+      {u"null", 4, &WS_NULL},
+  };
+
+  for (size_t i = 0; i < sizeof(literals) / sizeof(literals[0]); ++i)
+  {
+    if (parser->length - parser->cursor >= literals[i].length &&
+        memcmp(parser->data + parser->cursor,
+               literals[i].name,
+               literals[i].length * sizeof(char16_t)) == 0)
+    {
+      parser->cursor += literals[i].length;
+      return literals[i].value;
+    }
+  }
+
+  json_error(parser, "JSON: Unexpected token.");
+}
+
+/**
+ * Push an open array or object on the stack of the parser.
+ */
+void json_open(ws_json_parser *parser, ws_val *container)
+{
+  ws_json_frame *frames;
+  size_t capacity;
+
+  if (parser->depth == parser->capacity)
+  {
+    capacity = parser->capacity < 16 ? 16 : parser->capacity * 2;
+    frames = (ws_json_frame *)ws_alloc(capacity * sizeof(ws_json_frame));
+    if (parser->depth > 0)
+      memcpy(frames, parser->frames, parser->depth * sizeof(ws_json_frame));
+    ws_free(parser->frames);
+    parser->frames = frames;
+    parser->capacity = capacity;
+  }
+
+  parser->frames[parser->depth].container = container;
+  parser->frames[parser->depth].key = NULL;
+  parser->depth += 1;
+}
+
+/**
+ * Read the name of the next member of an object and the colon after it.
+ */
+ws_val *json_parse_key(ws_json_parser *parser)
+{
+  ws_val *key;
+
+  json_skip(parser);
+  if (parser->cursor >= parser->length || parser->data[parser->cursor] != '"')
+    json_error(parser, "JSON: Expected a property name.");
+  key = json_parse_string(parser);
+  json_expect(parser, ':');
+  return key;
+}
+
+/**
+ * Read a value, the arrays and objects that are open are kept on the stack
+ * of the parser instead of the C stack, so there is no limit on the nesting.
+ */
+ws_val *json_parse_value(ws_json_parser *parser)
+{
+  ws_json_frame *frame;
+  ws_val *value;
+  char16_t c;
+
+  for (;;)
+  {
+    json_skip(parser);
+    if (parser->cursor >= parser->length)
+      json_error(parser, "JSON: Unexpected end of input.");
+
+    c = parser->data[parser->cursor];
+    if (c == '[' || c == '{')
+    {
+      value = c == '[' ? ws_array(parser->ctx) : ws_object(parser->ctx, NULL);
+      parser->cursor += 1;
+      json_skip(parser);
+      if (parser->cursor < parser->length && parser->data[parser->cursor] == c + 2)
+      {
+        // `[]` and `{}`, `]` and `}` are two code units after the openers.
+        parser->cursor += 1;
+      }
+      else
+      {
+        json_open(parser, value);
+        if (c == '{')
+          parser->frames[parser->depth - 1].key = json_parse_key(parser);
+        continue;
+      }
+    }
+    else if (c == '"')
+      value = json_parse_string(parser);
+    else if (c == '-' || (c >= '0' && c <= '9'))
+      value = json_parse_number(parser);
+    else
+      value = json_parse_literal(parser);
+
+    // Add the value to the innermost container, and every container that it
+    // closes to the one that contains it.
+    for (;;)
+    {
+      if (parser->depth == 0)
+        return value;
+
+      frame = &parser->frames[parser->depth - 1];
+      if (frame->key == NULL)
+        array_push(parser->ctx, frame->container->data.object, value);
+      else
+        object_set(parser->ctx, frame->container, frame->key, value);
+
+      json_skip(parser);
+      if (parser->cursor >= parser->length)
+        json_error(parser, "JSON: Unexpected end of input.");
+
+      c = parser->data[parser->cursor];
+      parser->cursor += 1;
+      if (c == ',')
+      {
+        if (frame->key != NULL)
+          frame->key = json_parse_key(parser);
+        break;
+      }
+      if (c != (frame->key == NULL ? ']' : '}'))
+        json_error(parser, "JSON: Unexpected token.");
+
+      value = frame->container;
+      parser->depth -= 1;
+    }
+  }
+}
+
+ws_val *json_parse(ws_context *ctx, ws_val *text)
+{
+  ws_json_parser parser;
+  ws_val *value;
+
+  // TODO(qti3e) ToString for the other values.
+  if (text->type != WVAL_TYPE_STRING)
+    die("JSON: Only strings can be parsed.");
+
+  parser.ctx = ctx;
+  parser.data = ws_string_flatten(text);
+  parser.length = text->data.string.size / sizeof(char16_t) - 1;
+  parser.cursor = 0;
+  parser.frames = NULL;
+  parser.depth = 0;
+  parser.capacity = 0;
+  parser.scratch.data = NULL;
+  parser.scratch.length = 0;
+  parser.scratch.capacity = 0;
+
+  value = json_parse_value(&parser);
+  json_skip(&parser);
+  if (parser.cursor != parser.length)
+    json_error(&parser, "JSON: Unexpected non-whitespace character after JSON.");
+
+  ws_free(parser.frames);
+  ws_free(parser.scratch.data);
+  return value;
+}
+
+//==============================================================================
+// JSON.stringify
+
+size_t json_number(double number, char16_t *out)
+{
+  char buffer[32], digits[20];
+  int precision, exponent, k = 0, n;
+  size_t size = 0;
+  unsigned long long integer;
+  char *cursor;
+
+  if (number != number)
+  {
+    memcpy(out, u"NaN", 3 * sizeof(char16_t));
+    return 3;
+  }
+
+  if (number == 0)
+  {
+    out[0] = '0';
+    return 1;
+  }
+
+  if (number < 0)
+  {
+    out[size++] = '-';
+    number = -number;
+  }
+
+  if (isinf(number))
+  {
+    memcpy(out + size, u"Infinity", 8 * sizeof(char16_t));
+    return size + 8;
+  }
+
+  // The integers are exact, they don't need a search for the precision.
+  if (number < 9007199254740992.0 && number == floor(number))
+  {
+    integer = (unsigned long long)number;
+    do
+      digits[k++] = '0' + integer % 10;
+    while ((integer /= 10) > 0);
+    while (k > 0)
+      out[size++] = digits[--k];
+    return size;
+  }
+
+  // The shortest precision that reads back to the same number.
+  for (precision = 1; precision < 17; ++precision)
+  {
+    snprintf(buffer, sizeof(buffer), "%.*e", precision - 1, number);
+    if (strtod(buffer, NULL) == number)
+      break;
+  }
+  if (precision == 17)
+    snprintf(buffer, sizeof(buffer), "%.*e", precision - 1, number);
+
+  for (cursor = buffer; *cursor != 'e'; ++cursor)
+    if (*cursor != '.')
+      digits[k++] = *cursor;
+  exponent = atoi(cursor + 1);
+  while (k > 1 && digits[k - 1] == '0')
+    --k;
+
+  // The digits are `0.d1d2...dk * 10^n`, see Number::toString in the spec.
+  n = exponent + 1;
+  if (k <= n && n <= 21)
+  {
+    for (int i = 0; i < k; ++i)
+      out[size++] = digits[i];
+    for (int i = k; i < n; ++i)
+      out[size++] = '0';
+  }
+  else if (0 < n && n <= 21)
+  {
+    for (int i = 0; i < k; ++i)
+    {
+      if (i == n)
+        out[size++] = '.';
+      out[size++] = digits[i];
+    }
+  }
+  else if (-6 < n && n <= 0)
+  {
+    out[size++] = '0';
+    out[size++] = '.';
+    for (int i = n; i < 0; ++i)
+      out[size++] = '0';
+    for (int i = 0; i < k; ++i)
+      out[size++] = digits[i];
+  }
+  else
+  {
+    out[size++] = digits[0];
+    if (k > 1)
+    {
+      out[size++] = '.';
+      for (int i = 1; i < k; ++i)
+        out[size++] = digits[i];
+    }
+    out[size++] = 'e';
+    out[size++] = n - 1 < 0 ? '-' : '+';
+    n = abs(n - 1);
+    k = 0;
+    do
+      digits[k++] = '0' + n % 10;
+    while ((n /= 10) > 0);
+    while (k > 0)
+      out[size++] = digits[--k];
+  }
+
+  return size;
+}
+
+/**
+ * Returns true if the value has a text: not undefined, a function or a
+ * symbol.
+ */
+int json_has_text(ws_val *value)
+{
+  switch (value->type)
+  {
+  case WVAL_TYPE_UNDEFINED:
+  case WVAL_TYPE_SYMBOL:
+    return 0;
+  case WVAL_TYPE_OBJECT:
+    return value->data.object->call == NULL && value->data.object->native == NULL;
+  default:
+    return 1;
+  }
+}
+
+/**
+ * Write the string in quotes, the escapes are counted first so the text is
+ * written to the buffer once.
+ */
+void json_write_string(ws_json_writer *writer, const char16_t *data, size_t length)
+{
+  size_t size;
+
+  size = escape_chars(data, length, NULL, 1);
+  json_reserve(writer, size + 2);
+  writer->data[writer->length++] = '"';
+  escape_chars(data, length, writer->data + writer->length, 1);
+  writer->length += size;
+  writer->data[writer->length++] = '"';
+}
+
+void json_write_number(ws_json_writer *writer, double number)
+{
+  if (isnan(number) || isinf(number))
+  {
+    JSON_WRITE(writer, u"null");
+    return;
+  }
+
+  json_reserve(writer, 25);
+  writer->length += json_number(number, writer->data + writer->length);
+}
+
+/**
+ * Start a new line at the depth, when there is an indent.
+ */
+void json_write_line(ws_json_stringifier *state)
+{
+  if (state->gap_length == 0)
+    return;
+
+  json_reserve(&state->out, 1 + state->depth * state->gap_length);
+  state->out.data[state->out.length++] = '\n';
+  for (unsigned int i = 0; i < state->depth; ++i)
+  {
+    memcpy(state->out.data + state->out.length, state->gap, state->gap_length * sizeof(char16_t));
+    state->out.length += state->gap_length;
+  }
+}
+
+void json_write_value(ws_json_stringifier *state, ws_val *value);
+
+/**
+ * Write the elements of an array, the holes and the values without a text
+ * are `null`.
+ */
+void json_write_array(ws_json_stringifier *state, ws_obj *array)
+{
+  ws_elements *elements;
+  ws_val *value;
+
+  elements = array_elements(state->ctx, array);
+  if (elements->length == 0)
+  {
+    JSON_WRITE(&state->out, u"[]");
+    return;
+  }
+
+  JSON_WRITE(&state->out, u"[");
+  for (size_t i = 0; i < elements->length; ++i)
+  {
+    if (i > 0)
+      JSON_WRITE(&state->out, u",");
+    json_write_line(state);
+
+    if (elements->kind == WS_ELEMENTS_PACKED_DOUBLES)
+    {
+      json_write_number(&state->out, elements->data.doubles[i]);
+      continue;
+    }
+
+    value = elements->data.values[i];
+    if (value == NULL || !json_has_text(value))
+      JSON_WRITE(&state->out, u"null");
+    else
+      json_write_value(state, value);
+  }
+
+  state->depth -= 1;
+  json_write_line(state);
+  state->depth += 1;
+  JSON_WRITE(&state->out, u"]");
+}
+
+/**
+ * Write a member of an object, unless the value has no text.  Returns true
+ * if it's written.
+ */
+int json_write_member(ws_json_stringifier *state, ws_val *key, ws_val *value, int first)
+{
+  if (value == NULL || !json_has_text(value))
+    return 0;
+
+  if (!first)
+    JSON_WRITE(&state->out, u",");
+  json_write_line(state);
+  json_write_string(&state->out,
+                    ws_string_flatten(key),
+                    key->data.string.size / sizeof(char16_t) - 1);
+  if (state->gap_length > 0)
+    JSON_WRITE(&state->out, u": ");
+  else
+    JSON_WRITE(&state->out, u":");
+  json_write_value(state, value);
+  return 1;
+}
+
+/**
+ * Write the own enumerable string keys of an object in their order, the
+ * indices of a typed array come first.
+ */
+void json_write_object(ws_json_stringifier *state, ws_obj *object)
+{
+  ws_table_iter iter;
+  ws_val *key;
+  int empty = 1;
+
+  JSON_WRITE(&state->out, u"{");
+
+  if (object->typed != NULL)
+  {
+    for (size_t i = 0; i < object->typed->length; ++i)
+    {
+      key = array_index_key(i);
+      if (json_write_member(state, key, typed_array_get(state->ctx, object, i), empty))
+        empty = 0;
+    }
+  }
+
+  table_iter_init(&iter, &object->properties);
+  while ((key = table_next(state->ctx, &iter)) != NULL)
+  {
+    if (key->type != WVAL_TYPE_STRING)
+      continue;
+    // `lastIndex` of a RegExp is not enumerable.
+    if (object->regexp != NULL && key == &WS_REGEXP_LAST_INDEX)
+      continue;
+    if (json_write_member(state,
+                          key,
+                          (ws_val *)table_get(state->ctx, &object->properties, key),
+                          empty))
+      empty = 0;
+  }
+
+  if (!empty)
+  {
+    state->depth -= 1;
+    json_write_line(state);
+    state->depth += 1;
+  }
+  JSON_WRITE(&state->out, u"}");
+}
+
+/**
+ * Push an object that is being written on the stack of the stringifier.
+ */
+void json_push(ws_json_stringifier *state, ws_obj *object)
+{
+  ws_obj **stack;
+  size_t capacity;
+
+  if (state->depth == state->capacity)
+  {
+    capacity = state->capacity < 16 ? 16 : state->capacity * 2;
+    stack = (ws_obj **)ws_alloc(capacity * sizeof(ws_obj *));
+    if (state->depth > 0)
+      memcpy(stack, state->stack, state->depth * sizeof(ws_obj *));
+    ws_free(state->stack);
+    state->stack = stack;
+    state->capacity = capacity;
+  }
+
+  state->stack[state->depth++] = object;
+}
+
+void json_write_value(ws_json_stringifier *state, ws_val *value)
+{
+  ws_obj *object;
+
+  switch (value->type)
+  {
+  case WVAL_TYPE_NULL:
+    JSON_WRITE(&state->out, u"null");
+    return;
+
+  case WVAL_TYPE_BOOLEAN:
+    if (value->data.boolean)
+      JSON_WRITE(&state->out, u"true");
+    else
+      JSON_WRITE(&state->out, u"false");
+    return;
+
+  case WVAL_TYPE_NUMBER:
+    json_write_number(&state->out, value->data.number);
+    return;
+
+  case WVAL_TYPE_STRING:
+    json_write_string(&state->out,
+                      ws_string_flatten(value),
+                      value->data.string.size / sizeof(char16_t) - 1);
+    return;
+
+  case WVAL_TYPE_OBJECT:
+    object = value->data.object;
+    for (unsigned int i = 0; i < state->depth; ++i)
+    {
+      if (state->stack[i] != object)
+        continue;
+      if (!state->describe)
+        context_throw(state->ctx, "JSON: Converting circular structure to JSON.");
+      JSON_WRITE(&state->out, u"\"<cycle>\"");
+      return;
+    }
+    if (state->depth == WS_JSON_MAX_DEPTH)
+    {
+      if (!state->describe)
+        context_throw(state->ctx, "JSON: Too deeply nested.");
+      JSON_WRITE(&state->out, u"\"<deep>\"");
+      return;
+    }
+
+    json_push(state, object);
+    if (object->elements != NULL)
+      json_write_array(state, object);
+    else
+      json_write_object(state, object);
+    state->depth -= 1;
+    return;
+
+  default:
+    if (!state->describe)
+      die("JSON: Cannot stringify an abstract value.");
+    JSON_WRITE(&state->out, u"\"<abstract>\"");
+  }
+}
+
+/**
+ * Write the value with the state that is set up and make the string.
+ */
+ws_val *json_text(ws_json_stringifier *state, ws_val *value)
+{
+  char16_t *data;
+  size_t size;
+
+  state->out.data = NULL;
+  state->out.length = 0;
+  state->out.capacity = 0;
+  state->depth = 0;
+  state->stack = NULL;
+  state->capacity = 0;
+  json_write_value(state, value);
+  ws_free(state->stack);
+
+  // The buffer becomes the string.
+  json_reserve(&state->out, 0);
+  data = state->out.data;
+  size = state->out.length;
+  data[size] = 0;
+  return ws_string(data, (size + 1) * sizeof(char16_t));
+}
+
+ws_val *json_stringify(ws_context *ctx, ws_val *value, ws_val *space)
+{
+  ws_json_stringifier stringifier, *state = &stringifier;
+  size_t size;
+
+  if (wval_is_abstract(value))
+    die("JSON: Cannot stringify an abstract value.");
+  if (!json_has_text(value))
+    return &WS_UNDEFINED;
+
+  state->ctx = ctx;
+  state->gap_length = 0;
+  state->describe = 0;
+
+  if (space->type == WVAL_TYPE_NUMBER && space->data.number >= 1)
+  {
+    state->gap_length = space->data.number < 10 ? (size_t)space->data.number : 10;
+    for (size_t i = 0; i < state->gap_length; ++i)
+      state->gap[i] = ' ';
+  }
+  else if (space->type == WVAL_TYPE_STRING)
+  {
+    size = space->data.string.size / sizeof(char16_t) - 1;
+    state->gap_length = size < 10 ? size : 10;
+    memcpy(state->gap, ws_string_flatten(space), state->gap_length * sizeof(char16_t));
+  }
+
+  return json_text(state, value);
+}
+
+ws_val *json_describe(ws_context *ctx, ws_val *value)
+{
+  ws_json_stringifier stringifier, *state = &stringifier;
+
+  if (!json_has_text(value))
+    return &WS_UNDEFINED;
+
+  state->ctx = ctx;
+  state->gap_length = 0;
+  state->describe = 1;
+  return json_text(state, value);
+}
@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <stdint.h>
+#include "loader.h"
+#include "compiled.h"
+#include "wval.h"
+#include "verifier.h"
+#include "common.h"
+#include "alloc.h"
+#include "bytecode.h"
+
+uint32_t loader_read_uint32(FILE *file)
+{
+  uint8_t data[4];
+  if (fread(data, 1, 4, file) != 4)
+    die("load_bundle: Unexpected end of file.");
+  return (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+         ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/**
+ * The last loaded bundle, get_function reads its functions.
+ */
+ws_bundle *loader_bundle = NULL;
+
+/**
+ * Create a string from `length` UTF-16 code units at `data`, it lives as long
+ * as the code and it's not on the GC heap.
+ */
+ws_val *loader_string(uint8_t *data, unsigned int length)
+{
+  char16_t *chars;
+  ws_val *value;
+
+  chars = (char16_t *)ws_alloc_as(WS_MEMORY_CODE, (length + 1) * 2);
+  for (unsigned int i = 0; i < length; ++i)
+    chars[i] = data[i * 2] | (data[i * 2 + 1] << 8);
+  chars[length] = 0;
+
+  value = (ws_val *)ws_alloc_as(WS_MEMORY_CODE, sizeof(ws_val));
+  value->type = WVAL_TYPE_STRING;
+  value->ref_count = 1;
+#ifdef WS_TRACING_GC
+  value->marked = 0;
+#endif
+  value->data.string.data = chars;
+  value->data.string.size = (length + 1) * 2;
+  value->data.string.left = NULL;
+  value->data.string.right = NULL;
+  value->data.string.owns_data = 0;
+  return value;
+}
+
+/**
+ * Create the keys of the parameters, they are the entries of kind 2 in the
+ * scope section (see `jsc/src/scope.ts`):
+ *
+ *   u16            Number of entries.
+ *   For each entry:
+ *     u8           Kind, 0 variable, 1 function and 2 parameter.
+ *     u16          Length of the name in UTF-16 code units.
+ *     ...          The name.
+ *     u16          Id of the function, only for functions.
+ */
+void loader_read_params(ws_function_compiled_data *function)
+{
+  uint8_t *scope = function->data + function->scope_offset;
+  size_t size = function->map_offset - function->scope_offset, cursor = 2;
+  unsigned int count, length, kind;
+  ws_val **params;
+
+  function->params = NULL;
+  function->params_size = 0;
+
+  if (size < 2)
+    die("load_bundle: Invalid scope section.");
+
+  count = scope[0] | (scope[1] << 8);
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    if (cursor + 3 > size)
+      die("load_bundle: Invalid scope section.");
+
+    kind = scope[cursor];
+    length = scope[cursor + 1] | (scope[cursor + 2] << 8);
+    cursor += 3;
+
+    if (cursor + length * 2 + (kind == 1 ? 2 : 0) > size)
+      die("load_bundle: Invalid scope section.");
+
+    if (kind == 2)
+    {
+      // There are only a few parameters, grow one by one.
+      params = (ws_val **)ws_alloc_as(
+          WS_MEMORY_CODE, sizeof(ws_val *) * (function->params_size + 1));
+      for (unsigned int j = 0; j < function->params_size; ++j)
+        params[j] = function->params[j];
+      params[function->params_size++] = loader_string(scope + cursor, length);
+      ws_free(function->params);
+      function->params = params;
+    }
+
+    cursor += length * 2 + (kind == 1 ? 2 : 0);
+  }
+}
+
+/**
+ * Decode the netstrings that the bytecodes of the function use into
+ * `function->constants` and replace the operands with their index, must run
+ * after verify_function as it checks the operands.
+ *
+ * `cache` has a slot for each byte of the constant pool, so a netstring that
+ * is used more than once (also by other functions that share the pool) is
+ * decoded once.
+ */
+void loader_materialize(ws_function_compiled_data *function, ws_val **cache)
+{
+  uint8_t *data = function->data, *netstring;
+  size_t end = function->constant_pool_offset, cursor;
+  unsigned int count = 0, bytecode;
+  uint32_t offset;
+
+  for (cursor = 0; cursor < end; cursor += 1 + WS_BYTECODE_SIZE[data[cursor]])
+    if (data[cursor] >= WB_LD_STR && data[cursor] <= WB_REG_EXP)
+      ++count;
+
+  function->constants = (ws_val **)ws_alloc_as(
+      WS_MEMORY_CODE, sizeof(ws_val *) * (count > 0 ? count : 1));
+  function->constants_size = 0;
+
+  for (cursor = 0; cursor < end; cursor += 1 + WS_BYTECODE_SIZE[bytecode])
+  {
+    bytecode = data[cursor];
+    if (bytecode < WB_LD_STR || bytecode > WB_REG_EXP)
+      continue;
+
+    offset = (uint32_t)data[cursor + 1] | ((uint32_t)data[cursor + 2] << 8) |
+             ((uint32_t)data[cursor + 3] << 16) | ((uint32_t)data[cursor + 4] << 24);
+    if (cache[offset] == NULL)
+    {
+      netstring = function->constant_pool + offset;
+      cache[offset] = loader_string(netstring + 2, netstring[0] | (netstring[1] << 8));
+    }
+
+    function->constants[function->constants_size] = cache[offset];
+    data[cursor + 1] = function->constants_size & 0xff;
+    data[cursor + 2] = (function->constants_size >> 8) & 0xff;
+    data[cursor + 3] = (function->constants_size >> 16) & 0xff;
+    data[cursor + 4] = (function->constants_size >> 24) & 0xff;
+    ++function->constants_size;
+  }
+}
+
+/**
+ * Read a function of the bundle, functions of a version 2 bundle don't have a
+ * constant pool section, they use the one of the bundle.
+ */
+ws_function_compiled_data *loader_read_function(FILE *file, ws_bundle *bundle)
+{
+  ws_function_compiled_data *function;
+  uint32_t code, pool, scope, map;
+  size_t size;
+
+  code = loader_read_uint32(file);
+  pool = bundle->constant_pool == NULL ? loader_read_uint32(file) : 0;
+  scope = loader_read_uint32(file);
+  map = loader_read_uint32(file);
+  size = (size_t)code + pool + scope + map;
+
+  function = (ws_function_compiled_data *)ws_alloc_as(
+      WS_MEMORY_CODE, sizeof(*function) + size);
+  function->constant_pool_offset = code;
+  function->scope_offset = code + pool;
+  function->map_offset = code + pool + scope;
+
+  if (bundle->constant_pool == NULL)
+  {
+    function->constant_pool = function->data + code;
+    function->constant_pool_size = pool;
+  }
+  else
+  {
+    function->constant_pool = bundle->constant_pool;
+    function->constant_pool_size = bundle->constant_pool_size;
+  }
+
+  if (fread(function->data, 1, size, file) != size)
+    die("load_bundle: Unexpected end of file.");
+
+  loader_read_params(function);
+  return function;
+}
+
+/**
+ * An empty cache for loader_materialize.
+ */
+ws_val **loader_cache(size_t size)
+{
+  ws_val **cache = (ws_val **)ws_alloc(sizeof(ws_val *) * (size + 1));
+  for (size_t i = 0; i <= size; ++i)
+    cache[i] = NULL;
+  return cache;
+}
+
+/**
+ * Functions are verified once here, so the interpreter can trust them.
+ */
+void loader_verify_function(ws_function_compiled_data *function, unsigned int index)
+{
+  ws_verify_result result;
+  char message[256];
+
+  if (verify_function(function, &result))
+    return;
+
+  snprintf(message, sizeof(message), "load_bundle: Function %u at %zu: %s",
+           index, result.offset, result.error);
+  die(message);
+}
+
+ws_bundle *load_bundle(char *path)
+{
+  ws_val **cache = NULL;
+  ws_bundle *bundle;
+  char magic[4];
+  FILE *file;
+
+  file = fopen(path, "rb");
+  if (file == NULL)
+    die("load_bundle: Cannot open the file.");
+
+  if (fread(magic, 1, 4, file) != 4 || magic[0] != 'W' || magic[1] != 'S' ||
+      magic[2] != 'C' || (magic[3] != '1' && magic[3] != '2'))
+    die("load_bundle: Not a bundle.");
+
+  bundle = (ws_bundle *)ws_alloc_as(WS_MEMORY_CODE, sizeof(*bundle));
+  bundle->size = loader_read_uint32(file);
+  bundle->scripts = magic[3] == '1' ? 1 : loader_read_uint32(file);
+  bundle->base_id = loader_read_uint32(file);
+  bundle->constant_pool = NULL;
+  bundle->constant_pool_size = 0;
+
+  if (magic[3] == '2')
+  {
+    bundle->constant_pool_size = loader_read_uint32(file);
+    // Never NULL, even for an empty pool, it marks the version.
+    bundle->constant_pool = (uint8_t *)ws_alloc_as(
+        WS_MEMORY_CODE, bundle->constant_pool_size + 1);
+    if (fread(bundle->constant_pool, 1, bundle->constant_pool_size, file) !=
+        bundle->constant_pool_size)
+      die("load_bundle: Unexpected end of file.");
+  }
+
+  if (bundle->scripts == 0 || bundle->scripts > bundle->size)
+    die("load_bundle: A bundle must have a main function.");
+
+  bundle->functions = (ws_function_compiled_data **)ws_alloc_as(
+      WS_MEMORY_CODE, sizeof(ws_function_compiled_data *) * bundle->size);
+
+  for (unsigned int i = 0; i < bundle->size; ++i)
+  {
+    bundle->functions[i] = loader_read_function(file, bundle);
+    loader_verify_function(bundle->functions[i], i);
+  }
+
+  // The functions of a version 2 bundle share the pool and so the cache.
+  if (bundle->constant_pool != NULL)
+    cache = loader_cache(bundle->constant_pool_size);
+
+  for (unsigned int i = 0; i < bundle->size; ++i)
+  {
+    if (bundle->constant_pool == NULL)
+      cache = loader_cache(bundle->functions[i]->constant_pool_size);
+    loader_materialize(bundle->functions[i], cache);
+    if (bundle->constant_pool == NULL)
+      ws_free(cache);
+  }
+
+  if (bundle->constant_pool != NULL)
+    ws_free(cache);
+
+  fclose(file);
+  loader_bundle = bundle;
+  return bundle;
+}
+
+ws_function *get_function(int id, ws_scope *scope)
+{
+  ws_function *function;
+  long index;
+
+  if (loader_bundle == NULL)
+    return NULL;
+
+  // Main functions come first, the rest have consecutive ids.
+  index = (long)id - loader_bundle->base_id + loader_bundle->scripts;
+  if (index < loader_bundle->scripts || index >= loader_bundle->size)
+    return NULL;
+
+  function = (ws_function *)ws_alloc_as(WS_MEMORY_VALUES, sizeof(*function));
+  function->scope = scope;
+  function->ref_count = 1;
+  function->id = id;
+  function->data = loader_bundle->functions[index];
+  scope_retain(scope);
+  return function;
+}
@@ -1,4 +1,7 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <locale.h>
 #include "context.h"
@@ -7,11 +10,272 @@
 #include "compiled.h"
 #include "common.h"
 #include "exec.h"
+#include "loader.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "output.h"
+#include "builtins.h"
+#include "json.h"
 
-int main()
+//==============================================================================
+// Bundle runner, used by `jsc/diff.ts` to compare this VM with the reference
+// VM. Each line of the output is either `branch <id> <value>` for a finished
+// branch or `error <id> <message>` for one that threw, followed by
+// `trace <id> <hex>`, a `<stat> <number>` line or `timeout`. The merged
+// output of the branches comes last, after an `output <bytes>` line, so
+// nothing a script writes is read as one of these lines.
+
+/**
+ * Number of instructions each branch runs before giving the control back.
+ */
+#define RUN_SLICE 1024
+
+/**
+ * Print a value as JSON, `undefined` is printed as is.  Objects are printed
+ * like JSON.stringify does, the same text the harness (`jsc/diff.ts`) gets
+ * from the reference VM.
+ */
+void run_print_value(ws_context *ctx, ws_val *value)
+{
+  char16_t *data;
+  size_t length;
+  ws_utf8 *utf8;
+
+  switch (value->type)
+  {
+  case WVAL_TYPE_UNDEFINED:
+    printf("undefined");
+    return;
+  case WVAL_TYPE_NULL:
+    printf("null");
+    return;
+  case WVAL_TYPE_BOOLEAN:
+    printf(value->data.boolean ? "true" : "false");
+    return;
+  case WVAL_TYPE_NUMBER:
+    // JSON can not represent these.
+    if (value->data.number != value->data.number)
+      printf("\"<NaN>\"");
+    else if (value->data.number == 1.0 / 0.0)
+      printf("\"<Infinity>\"");
+    else if (value->data.number == -1.0 / 0.0)
+      printf("\"<-Infinity>\"");
+    else
+      printf("%.17g", value->data.number);
+    return;
+  case WVAL_TYPE_STRING:
+    data = ws_string_flatten(value);
+    length = value->data.string.size / 2 - 1;
+    printf("\"");
+    for (size_t i = 0; i < length; ++i)
+    {
+      if (data[i] == '"' || data[i] == '\\')
+        printf("\\%c", (char)data[i]);
+      else if (data[i] < 0x20 || data[i] > 0x7e)
+        printf("\\u%04x", (unsigned int)data[i]);
+      else
+        printf("%c", (char)data[i]);
+    }
+    printf("\"");
+    return;
+  case WVAL_TYPE_OBJECT:
+    value = json_describe(ctx, value);
+    // A function has no text.
+    if (value->type != WVAL_TYPE_STRING)
+    {
+      printf("undefined");
+      return;
+    }
+    utf8 = ws_string_to_utf8(value);
+    length = utf8->size;
+    // The terminating NUL of the string.
+    if (length > 0 && utf8->data[length - 1] == 0)
+      --length;
+    fwrite(utf8->data, 1, length, stdout);
+    free(utf8);
+    return;
+  default:
+    printf("\"<abstract>\"");
+    return;
+  }
+}
+
+unsigned long run_branches = 0;
+
+/**
+ * The finished branches, their output is merged at the end of the run.
+ */
+ws_context_list *run_finished = NULL;
+ws_context_list *run_finished_tail = NULL;
+
+void run_on_result(ws_context *ctx, ws_val *value)
+{
+  ws_context_list *item;
+  ws_trace *trace;
+
+  ++run_branches;
+  item = ws_alloc_context_list();
+  item->ctx = ctx;
+  item->next = NULL;
+  if (run_finished_tail == NULL)
+    run_finished = item;
+  else
+    run_finished_tail->next = item;
+  run_finished_tail = item;
+
+  if (ctx->error != NULL)
+  {
+    printf("error %u %s\n", ctx->id, ctx->error);
+  }
+  else
+  {
+    printf("branch %u ", ctx->id);
+    run_print_value(ctx, value);
+    printf("\n");
+  }
+
+  // The hex of the trace can be passed back to replay this branch alone.
+  trace = trace_create(ctx);
+  printf("trace %u ", ctx->id);
+  for (size_t i = 0; i < trace->size; ++i)
+    printf("%02x", trace->data[i]);
+  printf("\n");
+  trace_destroy(trace);
+}
+
+/**
+ * Replay one branch of the bundle, `hex` is printed by run_on_result.
+ */
+int run_replay(char *path, char *hex)
+{
+  size_t size = strlen(hex) / 2;
+  uint8_t *data;
+  unsigned int byte;
+  ws_bundle *bundle;
+  ws_context *ctx;
+  ws_trace *trace;
+  ws_val *value;
+
+  data = (uint8_t *)ws_alloc(size + 1);
+  for (size_t i = 0; i < size; ++i)
+  {
+    if (sscanf(hex + i * 2, "%2x", &byte) != 1)
+      die("ws: Invalid trace.");
+    data[i] = byte;
+  }
+
+  trace = trace_from_data(data, size);
+  ws_free(data);
+
+  bundle = load_bundle(path);
+  ctx = context_create();
+  context_new_scope(ctx, 0);
+  builtins_define(ctx);
+
+  value = exec_replay(ctx, bundle->functions[0], trace);
+  if (value == NULL && ctx->error == NULL)
+    printf("forked\n");
+  else
+    run_on_result(ctx, value);
+
+  trace_destroy(trace);
+  return 0;
+}
+
+unsigned long run_instructions(ws_context *ctx)
+{
+  unsigned long instructions = ctx->instructions;
+  ws_context_list *child;
+  for (child = ctx->childs; child != NULL; child = child->next)
+    instructions += run_instructions(child->ctx);
+  return instructions;
+}
+
+long run_elapsed_ns(struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000000000l + (now.tv_nsec - start->tv_nsec);
+}
+
+/**
+ * Run the main functions of the scripts in the bundle, each one in a context
+ * of its own, the run stops after `timeout_ms`.
+ */
+int run_bundle(char *path, long timeout_ms)
+{
+  ws_memory_stats memory, script, global;
+  ws_scheduler *scheduler;
+  struct timespec start;
+  unsigned long instructions;
+  ws_bundle *bundle;
+  ws_context **roots;
+  int timeout;
+  long time;
+
+  bundle = load_bundle(path);
+  scheduler = scheduler_create(RUN_SLICE);
+  roots = (ws_context **)ws_alloc(sizeof(ws_context *) * bundle->scripts);
+
+  for (unsigned int i = 0; i < bundle->scripts; ++i)
+  {
+    roots[i] = context_create();
+    context_new_scope(roots[i], 0);
+    builtins_define(roots[i]);
+    roots[i]->function = bundle->functions[i];
+    roots[i]->cursor = 0;
+    scheduler_add(scheduler, roots[i]);
+  }
+
+  timeout = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while (scheduler_step(scheduler, run_on_result))
+  {
+    if (run_elapsed_ns(&start) > timeout_ms * 1000000l)
+    {
+      timeout = 1;
+      break;
+    }
+  }
+  time = run_elapsed_ns(&start);
+
+  instructions = 0;
+  memory.peak = 0;
+  for (unsigned int i = 0; i < bundle->scripts; ++i)
+  {
+    instructions += run_instructions(roots[i]);
+    context_memory_stats_tree(roots[i], &script);
+    memory.peak += script.peak;
+  }
+  memory_global_stats(&global);
+
+  if (timeout)
+    printf("timeout\n");
+  printf("branches %lu\n", run_branches);
+  printf("instructions %lu\n", instructions);
+  printf("time_ns %ld\n", time);
+  printf("peak_bytes %ld\n", memory.peak + global.peak);
+  printf("output %zu\n", output_merged_size(run_finished));
+  fflush(stdout);
+
+  output_merge(run_finished, STDOUT_FILENO);
+  ws_free(roots);
+  return 0;
+}
+
+//==============================================================================
+
+int main(int argc, char **argv)
 {
   setlocale(LC_ALL, "en_US.UTF-8");
 
+  // ws <bundle> [timeout in ms]
+  // ws <bundle> --replay <trace>
+  if (argc > 3 && strcmp(argv[2], "--replay") == 0)
+    return run_replay(argv[1], argv[3]);
+  if (argc > 1)
+    return run_bundle(argv[1], argc > 2 ? atol(argv[2]) : 5000);
+
   ws_context *ctx = context_create();
   context_new_scope(ctx, 0);
 
@@ -29,4 +293,4 @@ int main()
   dump_value(context_resolve(ctx, key));
 
   ws_function *fn = get_function(0, ctx->scope);
-}
\ No newline at end of file
+}
@@ -0,0 +1,229 @@
+#include <stdint.h>
+#include "object.h"
+#include "array.h"
+#include "buffer.h"
+#include "builtins.h"
+#include "context.h"
+#include "common.h"
+#include "alloc.h"
+
+// For documentation and comments see object.h :)
+
+atomic_ulong proto_cache_epoch = 1;
+
+/**
+ * Entries are zero initialized, epoch 0 is never valid.
+ */
+_Thread_local ws_proto_cache_entry proto_cache[WS_PROTO_CACHE_SIZE];
+
+ws_proto_cache_entry *object_cache_entry(ws_obj *proto, ws_val *key)
+{
+  uintptr_t hash = ((uintptr_t)key >> 4) ^ (proto->properties.id * 2654435761u);
+  return &proto_cache[hash & (WS_PROTO_CACHE_SIZE - 1)];
+}
+
+/**
+ * Returns true if the entry was filled by the context or one of its
+ * ancestors and no prototype was changed since then.
+ */
+int object_cache_valid(ws_context *ctx,
+                       ws_proto_cache_entry *entry,
+                       ws_obj *proto,
+                       ws_val *key)
+{
+  if (entry->epoch != proto_cache_epoch || entry->key != key ||
+      entry->table != proto->properties.id ||
+      entry->version != ctx->proto_version)
+    return 0;
+
+  for (; ctx != NULL; ctx = ctx->parent)
+    if (ctx->id == entry->ctx)
+      return 1;
+
+  return 0;
+}
+
+ws_val *object_get(ws_context *ctx, ws_val *object, ws_val *key)
+{
+  ws_proto_cache_entry *entry;
+  ws_obj *proto, *holder;
+  ws_val *value;
+
+  if (object->type != WVAL_TYPE_OBJECT)
+    die("object_get: Value is not an object.");
+
+  // The elements and the length of an array are not in its properties.
+  if (object->data.object->elements != NULL &&
+      (value = array_get_own(ctx, object->data.object, key)) != NULL)
+    return value;
+
+  if (object->data.object->collection != NULL &&
+      (value = builtins_collection_get(ctx, object, key)) != NULL)
+    return value;
+
+  if (object->data.object->typed != NULL &&
+      ((value = typed_array_get_own(ctx, object->data.object, key)) != NULL ||
+       (value = builtins_typed_array_get(ctx, object, key)) != NULL))
+    return value;
+
+  if (object->data.object->regexp != NULL &&
+      (value = builtins_regexp_get(ctx, object, key)) != NULL)
+    return value;
+
+  if (object->data.object->buffer != NULL &&
+      ((value = buffer_get_own(ctx, object->data.object, key)) != NULL ||
+       (value = builtins_buffer_get(ctx, object, key)) != NULL))
+    return value;
+
+  value = (ws_val *)table_get(ctx, &object->data.object->properties, key);
+  proto = object->data.object->proto;
+  if (value != NULL || proto == NULL)
+    return value;
+
+  entry = object_cache_entry(proto, key);
+  if (object_cache_valid(ctx, entry, proto, key))
+    return entry->value;
+
+  for (holder = proto; holder != NULL; holder = holder->proto)
+  {
+    value = (ws_val *)table_get(ctx, &holder->properties, key);
+    if (value != NULL)
+      break;
+  }
+
+  entry->table = proto->properties.id;
+  entry->key = key;
+  entry->holder = holder;
+  entry->value = value;
+  entry->ctx = ctx->id;
+  entry->version = ctx->proto_version;
+  entry->epoch = proto_cache_epoch;
+  return value;
+}
+
+void object_set(ws_context *ctx, ws_val *object, ws_val *key, ws_val *value)
+{
+  ws_obj *obj;
+
+  if (object->type != WVAL_TYPE_OBJECT)
+    die("object_set: Value is not an object.");
+
+  obj = object->data.object;
+  table_set(ctx, &obj->properties, key, value);
+
+  // The entries of this context and its descendants are not valid anymore,
+  // an ancestor can't use a version that it never had.
+  if (obj->is_proto)
+    ++ctx->proto_version;
+}
+
+ws_val *object_iterator(ws_context *ctx, ws_val *value)
+{
+  ws_obj_iter *iter;
+  ws_val *iterator;
+
+  iter = (ws_obj_iter *)ws_alloc_as(WS_MEMORY_VALUES, sizeof(ws_obj_iter));
+  iter->owner = ctx->id;
+  iter->target = value;
+  iter->object = NULL;
+  iter->index = 0;
+  wval_retain(value);
+
+  if (value->type == WVAL_TYPE_OBJECT)
+  {
+    iter->object = value->data.object;
+    table_iter_init(&iter->keys, &iter->object->properties);
+  }
+
+  iterator = wval_alloc();
+  iterator->type = WVAL_TYPE_ITERATOR;
+  iterator->ref_count = 0;
+  iterator->data.iterator = iter;
+  return iterator;
+}
+
+ws_val *object_iterator_own(ws_context *ctx, ws_val *iterator)
+{
+  ws_obj_iter *iter;
+  ws_val *copy;
+
+  if (iterator->data.iterator->owner == ctx->id)
+    return iterator;
+
+  copy = object_iterator(ctx, iterator->data.iterator->target);
+  iter = copy->data.iterator;
+  *iter = *iterator->data.iterator;
+  iter->owner = ctx->id;
+  return copy;
+}
+
+/**
+ * Returns true if an object before the one that is walked, on the prototype
+ * chain of the target, has the key.
+ */
+int object_shadowed(ws_context *ctx, ws_obj_iter *iter, ws_val *key)
+{
+  ws_obj *object;
+
+  for (object = iter->target->data.object; object != iter->object; object = object->proto)
+  {
+    if (object->elements != NULL && array_get_own(ctx, object, key) != NULL)
+      return 1;
+    if (object->typed != NULL && typed_array_get_own(ctx, object, key) != NULL)
+      return 1;
+    if (table_get(ctx, &object->properties, key) != NULL)
+      return 1;
+  }
+
+  return 0;
+}
+
+ws_val *object_next(ws_context *ctx, ws_obj_iter *iter)
+{
+  ws_elements *elements;
+  ws_val *key;
+
+  while (iter->object != NULL)
+  {
+    if (iter->object->elements != NULL)
+    {
+      elements = array_elements(ctx, iter->object);
+      for (; iter->index < elements->length; ++iter->index)
+      {
+        if (elements->kind == WS_ELEMENTS_HOLEY &&
+            elements->data.values[iter->index] == NULL)
+          continue;
+        key = array_index_key(iter->index++);
+        if (!object_shadowed(ctx, iter, key))
+          return key;
+      }
+    }
+
+    // A typed array has no holes and its length never changes.
+    if (iter->object->typed != NULL)
+    {
+      while (iter->index < iter->object->typed->length)
+      {
+        key = array_index_key(iter->index++);
+        if (!object_shadowed(ctx, iter, key))
+          return key;
+      }
+    }
+
+    while ((key = table_next(ctx, &iter->keys)) != NULL)
+      if (!object_shadowed(ctx, iter, key))
+        return key;
+
+    iter->object = iter->object->proto;
+    iter->index = 0;
+    if (iter->object != NULL)
+      table_iter_init(&iter->keys, &iter->object->properties);
+  }
+
+  return NULL;
+}
+
+void object_cache_clear()
+{
+  ++proto_cache_epoch;
+}
@@ -0,0 +1,264 @@
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "output.h"
+#include "context.h"
+#include "wval.h"
+#include "utf8.h"
+#include "common.h"
+#include "alloc.h"
+
+// For documentation and comments see output.h :)
+
+#define OUTPUT_FNV_OFFSET 14695981039346656037ul
+#define OUTPUT_FNV_PRIME 1099511628211ul
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+unsigned long output_hash(unsigned long hash, const char *data, size_t size)
+{
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= (unsigned char)data[i];
+    hash *= OUTPUT_FNV_PRIME;
+  }
+  return hash;
+}
+
+void output_write(ws_context *ctx, const char *data, size_t size)
+{
+  ws_output_chunk *chunk = ctx->output;
+  size_t capacity, n;
+
+  if (ctx->forked)
+    die("output_write: Cannot write to a forked context.");
+
+  // Fill the room in the last chunk first.
+  if (chunk != NULL && chunk->owner == ctx && chunk->size < chunk->capacity)
+  {
+    n = chunk->capacity - chunk->size;
+    n = n < size ? n : size;
+    memcpy(chunk->data + chunk->size, data, n);
+    chunk->size += n;
+    chunk->total += n;
+    chunk->hash = output_hash(chunk->hash, data, n);
+    data += n;
+    size -= n;
+  }
+
+  if (size == 0)
+    return;
+
+  capacity = size < WS_OUTPUT_CHUNK_SIZE ? WS_OUTPUT_CHUNK_SIZE : size;
+  chunk = (ws_output_chunk *)ws_alloc_as(WS_MEMORY_OTHER, sizeof(*chunk) + capacity);
+  chunk->prev = ctx->output;
+  chunk->owner = ctx;
+  chunk->count = chunk->prev == NULL ? 1 : chunk->prev->count + 1;
+  chunk->size = size;
+  chunk->capacity = capacity;
+  chunk->total = (chunk->prev == NULL ? 0 : chunk->prev->total) + size;
+  chunk->hash = output_hash(chunk->prev == NULL ? OUTPUT_FNV_OFFSET : chunk->prev->hash, data, size);
+  memcpy(chunk->data, data, size);
+  ctx->output = chunk;
+}
+
+void output_write_value(ws_context *ctx, ws_val *value)
+{
+  ws_utf8 *utf8 = ws_string_to_utf8(value);
+  size_t size = utf8->size;
+
+  // The terminating NUL of the string.
+  if (size > 0 && utf8->data[size - 1] == 0)
+    --size;
+
+  output_write(ctx, (const char *)utf8->data, size);
+  free(utf8);
+}
+
+/**
+ * Fill `iov` with the chunks of the output in order, `iov` must have room
+ * for `output->count` items.
+ */
+void output_iovec(ws_output_chunk *output, struct iovec *iov)
+{
+  for (; output != NULL; output = output->prev)
+  {
+    iov[output->count - 1].iov_base = output->data;
+    iov[output->count - 1].iov_len = output->size;
+  }
+}
+
+/**
+ * Compare two outputs of the same size chunk by chunk.
+ */
+int output_equal_chunks(ws_output_chunk *a, ws_output_chunk *b)
+{
+  struct iovec *x, *y;
+  size_t i = 0, j = 0, offset_x = 0, offset_y = 0, n;
+  int equal = 1;
+
+  x = (struct iovec *)ws_alloc(sizeof(struct iovec) * a->count);
+  y = (struct iovec *)ws_alloc(sizeof(struct iovec) * b->count);
+  output_iovec(a, x);
+  output_iovec(b, y);
+
+  while (equal && i < a->count && j < b->count)
+  {
+    // The chunks that were written before the fork are the same.
+    if (x[i].iov_base == y[j].iov_base && offset_x == offset_y &&
+        x[i].iov_len == y[j].iov_len)
+    {
+      ++i;
+      ++j;
+      continue;
+    }
+
+    n = x[i].iov_len - offset_x;
+    if (y[j].iov_len - offset_y < n)
+      n = y[j].iov_len - offset_y;
+
+    equal = memcmp((char *)x[i].iov_base + offset_x, (char *)y[j].iov_base + offset_y, n) == 0;
+    offset_x += n;
+    offset_y += n;
+
+    if (offset_x == x[i].iov_len)
+    {
+      ++i;
+      offset_x = 0;
+    }
+    if (offset_y == y[j].iov_len)
+    {
+      ++j;
+      offset_y = 0;
+    }
+  }
+
+  ws_free(x);
+  ws_free(y);
+  return equal;
+}
+
+int output_equal(ws_context *a, ws_context *b)
+{
+  if (a->output == b->output)
+    return 1;
+  if (a->output == NULL || b->output == NULL)
+    return 0;
+  if (a->output->total != b->output->total || a->output->hash != b->output->hash)
+    return 0;
+  return output_equal_chunks(a->output, b->output);
+}
+
+/**
+ * Write all the chunks, retrying on partial writes.
+ */
+void output_writev(int fd, struct iovec *iov, unsigned int count)
+{
+  ssize_t written;
+  unsigned int n;
+
+  while (count > 0)
+  {
+    n = count < IOV_MAX ? count : IOV_MAX;
+    written = writev(fd, iov, n);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      die("output_merge: Write failed.");
+    }
+
+    while (n > 0 && (size_t)written >= iov->iov_len)
+    {
+      written -= iov->iov_len;
+      ++iov;
+      --count;
+      --n;
+    }
+
+    if (written > 0)
+    {
+      iov->iov_base = (char *)iov->iov_base + written;
+      iov->iov_len -= written;
+    }
+  }
+}
+
+ws_output_chunk **output_distinct(ws_context_list *contexts, unsigned int *count)
+{
+  ws_context_list *item;
+  ws_output_chunk **table, **result, *output, *other;
+  size_t capacity = 16, slot;
+
+  // The distinct outputs are kept in an open addressing table by their size
+  // and hash, the contents are only compared when both of them are the same.
+  for (item = contexts; item != NULL; item = item->next)
+    if (item->ctx->output != NULL)
+      capacity += 2;
+  while (capacity & (capacity - 1))
+    capacity &= capacity - 1;
+  capacity *= 2;
+
+  table = (ws_output_chunk **)ws_alloc(sizeof(ws_output_chunk *) * capacity);
+  memset(table, 0, sizeof(ws_output_chunk *) * capacity);
+  result = (ws_output_chunk **)ws_alloc(sizeof(ws_output_chunk *) * capacity);
+  *count = 0;
+
+  for (item = contexts; item != NULL; item = item->next)
+  {
+    output = item->ctx->output;
+    if (output == NULL)
+      continue;
+
+    slot = (output->hash ^ (output->total * OUTPUT_FNV_PRIME)) & (capacity - 1);
+    for (; (other = table[slot]) != NULL; slot = (slot + 1) & (capacity - 1))
+      if (other->total == output->total && other->hash == output->hash &&
+          (other == output || output_equal_chunks(other, output)))
+        break;
+
+    if (other != NULL)
+      continue;
+
+    table[slot] = output;
+    result[(*count)++] = output;
+  }
+
+  ws_free(table);
+  return result;
+}
+
+size_t output_merged_size(ws_context_list *contexts)
+{
+  ws_output_chunk **outputs;
+  unsigned int count;
+  size_t size = 0;
+
+  outputs = output_distinct(contexts, &count);
+  for (unsigned int i = 0; i < count; ++i)
+    size += outputs[i]->total;
+  ws_free(outputs);
+  return size;
+}
+
+unsigned int output_merge(ws_context_list *contexts, int fd)
+{
+  ws_output_chunk **outputs;
+  struct iovec *iov;
+  unsigned int count;
+
+  outputs = output_distinct(contexts, &count);
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    iov = (struct iovec *)ws_alloc(sizeof(struct iovec) * outputs[i]->count);
+    output_iovec(outputs[i], iov);
+    output_writev(fd, iov, outputs[i]->count);
+    ws_free(iov);
+  }
+
+  ws_free(outputs);
+  return count;
+}
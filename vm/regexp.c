@@ -0,0 +1,1545 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+#include "regexp.h"
+#include "object.h"
+#include "alloc.h"
+#include "common.h"
+
+// For documentation and comments see regexp.h :)
+
+ws_val WS_REGEXP_LAST_INDEX = {.type = WVAL_TYPE_STRING, .data.string = {.data = (char16_t *)u"lastIndex", .size = sizeof(u"lastIndex")}, .ref_count = 2727};
+
+/**
+ * A jump that is not patched yet.
+ */
+#define REGEXP_PENDING 0xffffffffu
+
+/**
+ * Upper bound of the instructions of a pattern, a counted repetition copies
+ * its body so `a{1000}{1000}` would be huge otherwise.
+ */
+#define WS_REGEXP_MAX_CODE 65536
+
+/**
+ * Upper bound of the DFA states of a pattern, once it's reached the pattern
+ * only uses the backtracking matcher.
+ */
+#define WS_REGEXP_DFA_MAX_STATES 1024
+#define WS_REGEXP_DFA_BUCKETS 256
+
+#define WS_REGEXP_CACHE_SIZE 256
+
+int regexp_is_line_terminator(int c)
+{
+  return c == '\n' || c == '\r' || c == 0x2028 || c == 0x2029;
+}
+
+int regexp_is_word(int c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+/**
+ * Canonicalize of the spec for the `i` flag: simple upper case mapping, but
+ * a non-ASCII code unit is never mapped to an ASCII one.
+ */
+int regexp_fold(int flags, int c)
+{
+  wint_t upper;
+
+  if (!(flags & WS_REGEXP_IGNORE_CASE))
+    return c;
+
+  upper = towupper(c);
+  if (upper > 0xffff || (c >= 128 && upper < 128))
+    return c;
+  return upper;
+}
+
+int regexp_class_has(ws_regexp_class *class, int c)
+{
+  size_t low = 0, high = class->size;
+
+  while (low < high)
+  {
+    size_t mid = (low + high) / 2;
+    if (c < class->ranges[mid][0])
+      high = mid;
+    else if (c > class->ranges[mid][1])
+      low = mid + 1;
+    else
+      return 1;
+  }
+
+  return 0;
+}
+
+int regexp_class_match(ws_regexp *regexp, ws_regexp_class *class, int c)
+{
+  int found = regexp_class_has(class, c);
+
+  if (!found && (regexp->flags & WS_REGEXP_IGNORE_CASE))
+    found = regexp_class_has(class, regexp_fold(regexp->flags, c)) ||
+            regexp_class_has(class, towlower(c));
+
+  return found != class->negated;
+}
+
+/**
+ * Returns true if the instruction at `pc` (a CHAR, ANY or CLASS) consumes
+ * the code unit.
+ */
+int regexp_consumes(ws_regexp *regexp, ws_regexp_inst *inst, int c)
+{
+  switch (inst->op)
+  {
+  case WS_REGEXP_CHAR:
+    return (unsigned int)regexp_fold(regexp->flags, c) == inst->x;
+  case WS_REGEXP_ANY:
+    return (regexp->flags & WS_REGEXP_DOT_ALL) || !regexp_is_line_terminator(c);
+  case WS_REGEXP_CLASS:
+    return regexp_class_match(regexp, &regexp->classes[inst->x], c);
+  default:
+    return 0;
+  }
+}
+
+//==============================================================================
+// Compiler, a recursive descent parser that emits the instructions right
+// away.  A quantifier or an alternation takes the code of what it applies to
+// out and emits it again, relocated, where it's needed.
+
+typedef struct
+{
+  const char16_t *pattern;
+  size_t length;
+  size_t cursor;
+  int flags;
+
+  ws_regexp_inst *code;
+  size_t size;
+  size_t capacity;
+
+  ws_regexp_class *classes;
+  size_t classes_size;
+  size_t classes_capacity;
+
+  unsigned int groups;
+  unsigned int total_groups;
+  unsigned int registers;
+  int has_backref;
+  int has_look;
+} regexp_compiler;
+
+/**
+ * A list of ranges that a class is built in.
+ */
+typedef struct
+{
+  char16_t (*ranges)[2];
+  size_t size;
+  size_t capacity;
+} regexp_ranges;
+
+void regexp_error(const char *message)
+{
+  static char buffer[128];
+
+  snprintf(buffer, sizeof(buffer), "RegExp: Invalid regular expression: %s.", message);
+  die(buffer);
+}
+
+int regexp_peek(regexp_compiler *c)
+{
+  return c->cursor < c->length ? c->pattern[c->cursor] : -1;
+}
+
+int regexp_eat(regexp_compiler *c, int ch)
+{
+  if (regexp_peek(c) != ch)
+    return 0;
+  ++c->cursor;
+  return 1;
+}
+
+unsigned int regexp_emit(regexp_compiler *c, enum WS_REGEXP_OP op, unsigned int x, unsigned int y)
+{
+  ws_regexp_inst *code;
+
+  if (c->size == c->capacity)
+  {
+    if (c->capacity >= WS_REGEXP_MAX_CODE)
+      die("RegExp: Regular expression is too large.");
+    code = (ws_regexp_inst *)ws_alloc_as(WS_MEMORY_CODE, c->capacity * 2 * sizeof(ws_regexp_inst));
+    memcpy(code, c->code, c->size * sizeof(ws_regexp_inst));
+    ws_free(c->code);
+    c->code = code;
+    c->capacity *= 2;
+  }
+
+  c->code[c->size].op = op;
+  c->code[c->size].x = x;
+  c->code[c->size].y = y;
+  return c->size++;
+}
+
+/**
+ * Take the code from `start` to the end out of the program.
+ */
+ws_regexp_inst *regexp_take(regexp_compiler *c, size_t start, size_t *size)
+{
+  ws_regexp_inst *body;
+
+  *size = c->size - start;
+  body = (ws_regexp_inst *)ws_alloc_as(WS_MEMORY_CODE, (*size + 1) * sizeof(ws_regexp_inst));
+  memcpy(body, c->code + start, *size * sizeof(ws_regexp_inst));
+  c->size = start;
+  return body;
+}
+
+/**
+ * Emit code that was taken out from `start`, its jumps only go inside of it
+ * (or right after it) so they are moved by the same amount.
+ */
+void regexp_put(regexp_compiler *c, ws_regexp_inst *body, size_t size, size_t start)
+{
+  unsigned int at = c->size, pc;
+  ws_regexp_inst *inst;
+
+  for (size_t i = 0; i < size; ++i)
+  {
+    // regexp_emit may move the code, so it's read after the call.
+    pc = regexp_emit(c, body[i].op, body[i].x, body[i].y);
+    inst = &c->code[pc];
+    if (inst->op == WS_REGEXP_JMP || inst->op == WS_REGEXP_SPLIT)
+      inst->x = inst->x - start + at;
+    if (inst->op == WS_REGEXP_SPLIT || inst->op == WS_REGEXP_LOOK)
+      inst->y = inst->y - start + at;
+  }
+}
+
+void regexp_ranges_add(regexp_ranges *ranges, int from, int to)
+{
+  char16_t (*data)[2];
+
+  if (ranges->size == ranges->capacity)
+  {
+    ranges->capacity = ranges->capacity == 0 ? 8 : ranges->capacity * 2;
+    data = ws_alloc_as(WS_MEMORY_CODE, ranges->capacity * sizeof(*data));
+    if (ranges->size > 0)
+      memcpy(data, ranges->ranges, ranges->size * sizeof(*data));
+    ws_free(ranges->ranges);
+    ranges->ranges = data;
+  }
+
+  ranges->ranges[ranges->size][0] = from;
+  ranges->ranges[ranges->size][1] = to;
+  ++ranges->size;
+}
+
+int regexp_range_compare(const void *a, const void *b)
+{
+  return (int)((const char16_t *)a)[0] - (int)((const char16_t *)b)[0];
+}
+
+/**
+ * Sort the ranges and join the ones that touch.
+ */
+void regexp_ranges_normalize(regexp_ranges *ranges)
+{
+  size_t size = 0;
+
+  if (ranges->size == 0)
+    return;
+
+  qsort(ranges->ranges, ranges->size, sizeof(*ranges->ranges), regexp_range_compare);
+  for (size_t i = 1; i < ranges->size; ++i)
+  {
+    if (ranges->ranges[i][0] <= ranges->ranges[size][1] + 1)
+    {
+      if (ranges->ranges[i][1] > ranges->ranges[size][1])
+        ranges->ranges[size][1] = ranges->ranges[i][1];
+    }
+    else
+    {
+      ++size;
+      ranges->ranges[size][0] = ranges->ranges[i][0];
+      ranges->ranges[size][1] = ranges->ranges[i][1];
+    }
+  }
+  ranges->size = size + 1;
+}
+
+/**
+ * Add the ranges of `\d`, `\w` or `\s` (or of `\D`, `\W` and `\S`).
+ */
+void regexp_ranges_escape(regexp_ranges *ranges, int escape)
+{
+  static const char16_t digits[][2] = {{'0', '9'}};
+  static const char16_t words[][2] = {{'0', '9'}, {'A', 'Z'}, {'_', '_'}, {'a', 'z'}};
+  static const char16_t spaces[][2] = {
+      {0x09, 0x0d}, {0x20, 0x20}, {0xa0, 0xa0}, {0x1680, 0x1680}, {0x2000, 0x200a}, {0x2028, 0x2029}, {0x202f, 0x202f}, {0x205f, 0x205f}, {0x3000, 0x3000}, {0xfeff, 0xfeff}};
+  const char16_t(*set)[2];
+  size_t size;
+  int next = 0;
+
+  switch (escape | 0x20)
+  {
+  case 'd':
+    set = digits;
+    size = sizeof(digits) / sizeof(digits[0]);
+    break;
+  case 'w':
+    set = words;
+    size = sizeof(words) / sizeof(words[0]);
+    break;
+  default:
+    set = spaces;
+    size = sizeof(spaces) / sizeof(spaces[0]);
+    break;
+  }
+
+  // An upper case escape is the complement.
+  if (escape >= 'a')
+  {
+    for (size_t i = 0; i < size; ++i)
+      regexp_ranges_add(ranges, set[i][0], set[i][1]);
+    return;
+  }
+
+  for (size_t i = 0; i < size; ++i)
+  {
+    if (set[i][0] > next)
+      regexp_ranges_add(ranges, next, set[i][0] - 1);
+    next = set[i][1] + 1;
+  }
+  if (next <= 0xffff)
+    regexp_ranges_add(ranges, next, 0xffff);
+}
+
+unsigned int regexp_add_class(regexp_compiler *c, regexp_ranges *ranges, int negated)
+{
+  ws_regexp_class *classes;
+
+  if (c->classes_size == c->classes_capacity)
+  {
+    c->classes_capacity = c->classes_capacity == 0 ? 4 : c->classes_capacity * 2;
+    classes = (ws_regexp_class *)ws_alloc_as(WS_MEMORY_CODE, c->classes_capacity * sizeof(ws_regexp_class));
+    if (c->classes_size > 0)
+      memcpy(classes, c->classes, c->classes_size * sizeof(ws_regexp_class));
+    ws_free(c->classes);
+    c->classes = classes;
+  }
+
+  regexp_ranges_normalize(ranges);
+  c->classes[c->classes_size].negated = negated;
+  c->classes[c->classes_size].size = ranges->size;
+  c->classes[c->classes_size].ranges = ranges->ranges;
+  return c->classes_size++;
+}
+
+int regexp_hex(int ch)
+{
+  if (ch >= '0' && ch <= '9')
+    return ch - '0';
+  if ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'f')
+    return (ch | 0x20) - 'a' + 10;
+  return -1;
+}
+
+/**
+ * Read `count` hex digits, returns -1 and doesn't move if there are not
+ * enough of them.
+ */
+int regexp_read_hex(regexp_compiler *c, int count)
+{
+  int value = 0, digit;
+
+  if (c->cursor + count > c->length)
+    return -1;
+
+  for (int i = 0; i < count; ++i)
+  {
+    if ((digit = regexp_hex(c->pattern[c->cursor + i])) < 0)
+      return -1;
+    value = value * 16 + digit;
+  }
+
+  c->cursor += count;
+  return value;
+}
+
+/**
+ * The code unit of a character escape, the backslash and the letter are
+ * already read.
+ */
+int regexp_char_escape(regexp_compiler *c, int ch)
+{
+  int value;
+
+  switch (ch)
+  {
+  case 'n':
+    return '\n';
+  case 't':
+    return '\t';
+  case 'r':
+    return '\r';
+  case 'f':
+    return '\f';
+  case 'v':
+    return '\v';
+  case '0':
+    // A legacy octal escape when more digits follow.
+    value = 0;
+    while (regexp_peek(c) >= '0' && regexp_peek(c) <= '7' && value < 32)
+      value = value * 8 + (c->pattern[c->cursor++] - '0');
+    return value;
+  case 'c':
+    value = regexp_peek(c) | 0x20;
+    if (value >= 'a' && value <= 'z')
+      return c->pattern[c->cursor++] % 32;
+    // `\c` without a letter is a backslash and a `c`.
+    --c->cursor;
+    return '\\';
+  case 'x':
+    value = regexp_read_hex(c, 2);
+    return value < 0 ? 'x' : value;
+  case 'u':
+    value = regexp_read_hex(c, 4);
+    return value < 0 ? 'u' : value;
+  default:
+    return ch;
+  }
+}
+
+/**
+ * An escape in a class: returns the code unit, or -1 if it added the ranges
+ * of a class escape.
+ */
+int regexp_class_escape(regexp_compiler *c, regexp_ranges *ranges)
+{
+  int ch;
+
+  if (c->cursor >= c->length)
+    regexp_error("\\ at end of pattern");
+
+  ch = c->pattern[c->cursor++];
+  switch (ch)
+  {
+  case 'd':
+  case 'D':
+  case 'w':
+  case 'W':
+  case 's':
+  case 'S':
+    regexp_ranges_escape(ranges, ch);
+    return -1;
+  case 'b':
+    return '\b';
+  case '-':
+    return '-';
+  default:
+    if (ch >= '1' && ch <= '9')
+      return ch;
+    return regexp_char_escape(c, ch);
+  }
+}
+
+void regexp_parse_class(regexp_compiler *c)
+{
+  regexp_ranges ranges = {NULL, 0, 0};
+  int negated, from, to;
+
+  negated = regexp_eat(c, '^');
+  while (!regexp_eat(c, ']'))
+  {
+    if (c->cursor >= c->length)
+      regexp_error("Unterminated character class");
+
+    from = c->pattern[c->cursor++];
+    if (from == '\\')
+      from = regexp_class_escape(c, &ranges);
+
+    if (regexp_peek(c) == '-' && c->cursor + 1 < c->length && c->pattern[c->cursor + 1] != ']')
+    {
+      ++c->cursor;
+      to = c->pattern[c->cursor++];
+      if (to == '\\')
+        to = regexp_class_escape(c, &ranges);
+
+      // A class escape on either side makes the dash a literal.
+      if (from < 0 || to < 0)
+      {
+        if (from >= 0)
+          regexp_ranges_add(&ranges, from, from);
+        if (to >= 0)
+          regexp_ranges_add(&ranges, to, to);
+        regexp_ranges_add(&ranges, '-', '-');
+        continue;
+      }
+
+      if (from > to)
+        regexp_error("Range out of order in character class");
+      regexp_ranges_add(&ranges, from, to);
+      continue;
+    }
+
+    if (from >= 0)
+      regexp_ranges_add(&ranges, from, from);
+  }
+
+  regexp_emit(c, WS_REGEXP_CLASS, regexp_add_class(c, &ranges, negated), 0);
+}
+
+/**
+ * Read a decimal number, returns -1 if there is none.
+ */
+long regexp_read_decimal(regexp_compiler *c)
+{
+  long value = -1;
+
+  while (regexp_peek(c) >= '0' && regexp_peek(c) <= '9')
+  {
+    value = (value < 0 ? 0 : value * 10) + (c->pattern[c->cursor++] - '0');
+    if (value > 100000)
+      value = 100000;
+  }
+
+  return value;
+}
+
+/**
+ * Read `{n}`, `{n,}` or `{n,m}`, a brace that doesn't start one of them is
+ * a literal (Annex B).
+ */
+int regexp_read_braces(regexp_compiler *c, long *min, long *max)
+{
+  size_t cursor = c->cursor;
+
+  if (!regexp_eat(c, '{') || (*min = regexp_read_decimal(c)) < 0)
+  {
+    c->cursor = cursor;
+    return 0;
+  }
+
+  *max = *min;
+  if (regexp_eat(c, ','))
+    *max = regexp_read_decimal(c);
+
+  if (!regexp_eat(c, '}'))
+  {
+    c->cursor = cursor;
+    return 0;
+  }
+
+  if (*max >= 0 && *max < *min)
+    regexp_error("numbers out of order in {} quantifier");
+  return 1;
+}
+
+int regexp_parse_disjunction(regexp_compiler *c);
+
+/**
+ * Parse an atom, returns whatever it can match the empty string.
+ */
+int regexp_parse_atom(regexp_compiler *c)
+{
+  regexp_ranges ranges = {NULL, 0, 0};
+  unsigned int group, look;
+  int ch, nullable;
+  long number;
+  size_t cursor;
+
+  ch = c->pattern[c->cursor++];
+  switch (ch)
+  {
+  case '^':
+    regexp_emit(c, WS_REGEXP_BOL, 0, 0);
+    return 1;
+
+  case '$':
+    regexp_emit(c, WS_REGEXP_EOL, 0, 0);
+    return 1;
+
+  case '.':
+    regexp_emit(c, WS_REGEXP_ANY, 0, 0);
+    return 0;
+
+  case '[':
+    regexp_parse_class(c);
+    return 0;
+
+  case '*':
+  case '+':
+  case '?':
+    regexp_error("Nothing to repeat");
+    return 0;
+
+  case ')':
+    regexp_error("Unmatched ')'");
+    return 0;
+
+  case '(':
+    if (regexp_eat(c, '?'))
+    {
+      if (regexp_eat(c, ':'))
+      {
+        nullable = regexp_parse_disjunction(c);
+      }
+      else if (regexp_peek(c) == '=' || regexp_peek(c) == '!')
+      {
+        c->has_look = 1;
+        look = regexp_emit(c, WS_REGEXP_LOOK, c->pattern[c->cursor++] == '!', REGEXP_PENDING);
+        regexp_parse_disjunction(c);
+        regexp_emit(c, WS_REGEXP_MATCH, 0, 0);
+        c->code[look].y = c->size;
+        nullable = 1;
+      }
+      else if (regexp_eat(c, '<') && regexp_peek(c) != '=' && regexp_peek(c) != '!')
+      {
+        // A named group, the names are not kept.
+        while (c->cursor < c->length && c->pattern[c->cursor] != '>')
+          ++c->cursor;
+        if (!regexp_eat(c, '>'))
+          regexp_error("Invalid capture group name");
+        group = c->groups++;
+        regexp_emit(c, WS_REGEXP_SAVE, group * 2, 0);
+        nullable = regexp_parse_disjunction(c);
+        regexp_emit(c, WS_REGEXP_SAVE, group * 2 + 1, 0);
+      }
+      else
+      {
+        // TODO(qti3e) Lookbehind.
+        regexp_error("Invalid group");
+        return 0;
+      }
+    }
+    else
+    {
+      group = c->groups++;
+      regexp_emit(c, WS_REGEXP_SAVE, group * 2, 0);
+      nullable = regexp_parse_disjunction(c);
+      regexp_emit(c, WS_REGEXP_SAVE, group * 2 + 1, 0);
+    }
+
+    if (!regexp_eat(c, ')'))
+      regexp_error("Unterminated group");
+    return nullable;
+
+  case '\\':
+    if (c->cursor >= c->length)
+      regexp_error("\\ at end of pattern");
+
+    ch = c->pattern[c->cursor++];
+    switch (ch)
+    {
+    case 'b':
+      regexp_emit(c, WS_REGEXP_WORD, 0, 0);
+      return 1;
+    case 'B':
+      regexp_emit(c, WS_REGEXP_NOT_WORD, 0, 0);
+      return 1;
+    case 'd':
+    case 'D':
+    case 'w':
+    case 'W':
+    case 's':
+    case 'S':
+      regexp_ranges_escape(&ranges, ch);
+      regexp_emit(c, WS_REGEXP_CLASS, regexp_add_class(c, &ranges, 0), 0);
+      return 0;
+    default:
+      break;
+    }
+
+    if (ch >= '1' && ch <= '9')
+    {
+      cursor = --c->cursor;
+      number = regexp_read_decimal(c);
+      if (number < c->total_groups)
+      {
+        c->has_backref = 1;
+        regexp_emit(c, WS_REGEXP_BACKREF, number, 0);
+        return 1;
+      }
+
+      // Not a group, a legacy octal escape or the digit itself.
+      c->cursor = cursor;
+      ch = c->pattern[c->cursor++];
+      if (ch <= '7')
+        for (number = ch - '0'; regexp_peek(c) >= '0' && regexp_peek(c) <= '7' && number < 32;)
+          number = number * 8 + (c->pattern[c->cursor++] - '0');
+      else
+        number = ch;
+      regexp_emit(c, WS_REGEXP_CHAR, regexp_fold(c->flags, number), 0);
+      return 0;
+    }
+
+    regexp_emit(c, WS_REGEXP_CHAR, regexp_fold(c->flags, regexp_char_escape(c, ch)), 0);
+    return 0;
+
+  default:
+    regexp_emit(c, WS_REGEXP_CHAR, regexp_fold(c->flags, ch), 0);
+    return 0;
+  }
+}
+
+/**
+ * Parse an atom and its quantifier.
+ */
+/**
+ * Emit an iteration of a quantified atom, the groups from `group` on are in
+ * the atom and are cleared first.
+ */
+void regexp_put_iteration(regexp_compiler *c, ws_regexp_inst *body, size_t size, size_t start, unsigned int group)
+{
+  if (group < c->groups)
+    regexp_emit(c, WS_REGEXP_RESET, group * 2, c->groups * 2);
+  regexp_put(c, body, size, start);
+}
+
+int regexp_parse_term(regexp_compiler *c)
+{
+  ws_regexp_inst *body;
+  size_t start, size;
+  unsigned int loop, split, pending, next, group;
+  long min, max;
+  int nullable, lazy;
+
+  start = c->size;
+  group = c->groups;
+  nullable = regexp_parse_atom(c);
+
+  switch (regexp_peek(c))
+  {
+  case '*':
+    min = 0, max = -1;
+    ++c->cursor;
+    break;
+  case '+':
+    min = 1, max = -1;
+    ++c->cursor;
+    break;
+  case '?':
+    min = 0, max = 1;
+    ++c->cursor;
+    break;
+  case '{':
+    if (regexp_read_braces(c, &min, &max))
+      break;
+    return nullable;
+  default:
+    return nullable;
+  }
+
+  lazy = regexp_eat(c, '?');
+  body = regexp_take(c, start, &size);
+
+  for (long i = 0; i < min; ++i)
+    regexp_put_iteration(c, body, size, start, group);
+
+  if (max < 0)
+  {
+    // L: Split body, out; [Mark r]; body; [Check r]; Jmp L
+    loop = regexp_emit(c, WS_REGEXP_SPLIT, 0, 0);
+    if (nullable)
+      regexp_emit(c, WS_REGEXP_MARK, c->registers, 0);
+    regexp_put_iteration(c, body, size, start, group);
+    if (nullable)
+      regexp_emit(c, WS_REGEXP_CHECK, c->registers++, 0);
+    regexp_emit(c, WS_REGEXP_JMP, loop, 0);
+    c->code[loop].x = lazy ? c->size : loop + 1;
+    c->code[loop].y = lazy ? loop + 1 : c->size;
+  }
+  else
+  {
+    // Split body, out; body; Split body, out; body; ... out:
+    pending = REGEXP_PENDING;
+    for (long i = min; i < max; ++i)
+    {
+      split = regexp_emit(c, WS_REGEXP_SPLIT, 0, pending);
+      pending = split;
+      regexp_put_iteration(c, body, size, start, group);
+    }
+
+    for (; pending != REGEXP_PENDING; pending = next)
+    {
+      next = c->code[pending].y;
+      c->code[pending].x = lazy ? c->size : pending + 1;
+      c->code[pending].y = lazy ? pending + 1 : c->size;
+    }
+  }
+
+  ws_free(body);
+  return nullable || min == 0;
+}
+
+int regexp_parse_alternative(regexp_compiler *c)
+{
+  int nullable = 1;
+
+  while (c->cursor < c->length && regexp_peek(c) != '|' && regexp_peek(c) != ')')
+    nullable &= regexp_parse_term(c);
+
+  return nullable;
+}
+
+int regexp_parse_disjunction(regexp_compiler *c)
+{
+  ws_regexp_inst *body;
+  size_t start, size;
+  unsigned int split, pending, next;
+  int nullable;
+
+  start = c->size;
+  nullable = regexp_parse_alternative(c);
+  pending = REGEXP_PENDING;
+
+  // Split alt, next; alt; Jmp out; next: ...
+  while (regexp_eat(c, '|'))
+  {
+    body = regexp_take(c, start, &size);
+    split = regexp_emit(c, WS_REGEXP_SPLIT, start + 1, 0);
+    regexp_put(c, body, size, start);
+    pending = regexp_emit(c, WS_REGEXP_JMP, pending, 0);
+    c->code[split].y = c->size;
+    ws_free(body);
+
+    start = c->size;
+    nullable |= regexp_parse_alternative(c);
+  }
+
+  for (; pending != REGEXP_PENDING; pending = next)
+  {
+    next = c->code[pending].x;
+    c->code[pending].x = c->size;
+  }
+
+  return nullable;
+}
+
+/**
+ * Count the capturing groups, a backreference may come before its group.
+ */
+unsigned int regexp_count_groups(const char16_t *pattern, size_t length)
+{
+  unsigned int groups = 1;
+  int in_class = 0;
+
+  for (size_t i = 0; i < length; ++i)
+  {
+    if (pattern[i] == '\\')
+      ++i;
+    else if (pattern[i] == '[')
+      in_class = 1;
+    else if (pattern[i] == ']')
+      in_class = 0;
+    else if (pattern[i] == '(' && !in_class)
+      if (i + 1 >= length || pattern[i + 1] != '?' ||
+          (i + 3 < length && pattern[i + 2] == '<' && pattern[i + 3] != '=' && pattern[i + 3] != '!'))
+        ++groups;
+  }
+
+  return groups;
+}
+
+ws_regexp *regexp_build(const char16_t *pattern, size_t length, int flags)
+{
+  regexp_compiler c;
+  ws_regexp *regexp;
+
+  c.pattern = pattern;
+  c.length = length;
+  c.cursor = 0;
+  c.flags = flags;
+  c.capacity = 16;
+  c.size = 0;
+  c.code = (ws_regexp_inst *)ws_alloc_as(WS_MEMORY_CODE, c.capacity * sizeof(ws_regexp_inst));
+  c.classes = NULL;
+  c.classes_size = 0;
+  c.classes_capacity = 0;
+  c.groups = 1;
+  c.total_groups = regexp_count_groups(pattern, length);
+  c.registers = 0;
+  c.has_backref = 0;
+  c.has_look = 0;
+
+  // Save 0; <pattern>; Save 1; Match
+  regexp_emit(&c, WS_REGEXP_SAVE, 0, 0);
+  regexp_parse_disjunction(&c);
+  if (c.cursor < c.length)
+    regexp_error("Unmatched ')'");
+  regexp_emit(&c, WS_REGEXP_SAVE, 1, 0);
+  regexp_emit(&c, WS_REGEXP_MATCH, 0, 0);
+
+  regexp = (ws_regexp *)ws_alloc_as(WS_MEMORY_CODE, sizeof(ws_regexp));
+  regexp->pattern = (char16_t *)ws_alloc_as(WS_MEMORY_CODE, (length + 1) * sizeof(char16_t));
+  memcpy(regexp->pattern, pattern, length * sizeof(char16_t));
+  regexp->pattern[length] = 0;
+  regexp->length = length;
+  regexp->flags = flags;
+  regexp->groups = c.groups;
+  regexp->registers = c.registers;
+  regexp->code = c.code;
+  regexp->code_size = c.size;
+  regexp->classes = c.classes;
+  regexp->classes_size = c.classes_size;
+  atomic_init(&regexp->dfa, !c.has_backref && !c.has_look);
+  atomic_flag_clear(&regexp->dfa_lock);
+  regexp->dfa_buckets = NULL;
+  regexp->dfa_size = 0;
+  for (int i = 0; i < 8; ++i)
+    atomic_init(&regexp->dfa_start[i], NULL);
+  regexp->next = NULL;
+  return regexp;
+}
+
+//==============================================================================
+// Backtracking matcher.
+
+enum REGEXP_FRAME
+{
+  REGEXP_FRAME_BRANCH,
+  REGEXP_FRAME_CAPTURE,
+  REGEXP_FRAME_REGISTER
+};
+
+/**
+ * A choice point (a position to continue from) or an undo entry of a
+ * capture or a register.
+ */
+typedef struct
+{
+  enum REGEXP_FRAME kind;
+  unsigned int index;
+  long value;
+} regexp_frame;
+
+typedef struct
+{
+  ws_regexp *regexp;
+  const char16_t *input;
+  size_t length;
+  long *captures;
+  long *registers;
+
+  regexp_frame *stack;
+  size_t size;
+  size_t capacity;
+} regexp_matcher;
+
+void regexp_push(regexp_matcher *m, enum REGEXP_FRAME kind, unsigned int index, long value)
+{
+  regexp_frame *stack;
+
+  if (m->size == m->capacity)
+  {
+    m->capacity *= 2;
+    stack = (regexp_frame *)ws_alloc_as(WS_MEMORY_OTHER, m->capacity * sizeof(regexp_frame));
+    memcpy(stack, m->stack, m->size * sizeof(regexp_frame));
+    ws_free(m->stack);
+    m->stack = stack;
+  }
+
+  m->stack[m->size].kind = kind;
+  m->stack[m->size].index = index;
+  m->stack[m->size].value = value;
+  ++m->size;
+}
+
+/**
+ * Run the program from `pc` at `sp` until a MATCH, returns true and sets
+ * `end` if it's reached.  The undo entries of a match are left on the stack,
+ * a failure takes the stack back to where it was.
+ */
+int regexp_run(regexp_matcher *m, unsigned int pc, size_t sp, size_t *end)
+{
+  ws_regexp *regexp = m->regexp;
+  ws_regexp_inst *inst;
+  size_t base = m->size, mark, keep, end_of_look;
+  long from, to;
+  int a, b, matched;
+
+  for (;;)
+  {
+    inst = &regexp->code[pc];
+    switch (inst->op)
+    {
+    case WS_REGEXP_CHAR:
+    case WS_REGEXP_ANY:
+    case WS_REGEXP_CLASS:
+      if (sp < m->length && regexp_consumes(regexp, inst, m->input[sp]))
+      {
+        ++sp;
+        ++pc;
+        continue;
+      }
+      goto fail;
+
+    case WS_REGEXP_SPLIT:
+      regexp_push(m, REGEXP_FRAME_BRANCH, inst->y, sp);
+      pc = inst->x;
+      continue;
+
+    case WS_REGEXP_JMP:
+      pc = inst->x;
+      continue;
+
+    case WS_REGEXP_SAVE:
+      regexp_push(m, REGEXP_FRAME_CAPTURE, inst->x, m->captures[inst->x]);
+      m->captures[inst->x] = sp;
+      ++pc;
+      continue;
+
+    case WS_REGEXP_RESET:
+      // Restored one by one when the iteration backtracks.
+      for (unsigned int i = inst->x; i < inst->y; ++i)
+      {
+        if (m->captures[i] < 0)
+          continue;
+        regexp_push(m, REGEXP_FRAME_CAPTURE, i, m->captures[i]);
+        m->captures[i] = -1;
+      }
+      ++pc;
+      continue;
+
+    case WS_REGEXP_BOL:
+      if (sp == 0 || ((regexp->flags & WS_REGEXP_MULTILINE) &&
+                      regexp_is_line_terminator(m->input[sp - 1])))
+      {
+        ++pc;
+        continue;
+      }
+      goto fail;
+
+    case WS_REGEXP_EOL:
+      if (sp == m->length || ((regexp->flags & WS_REGEXP_MULTILINE) &&
+                              regexp_is_line_terminator(m->input[sp])))
+      {
+        ++pc;
+        continue;
+      }
+      goto fail;
+
+    case WS_REGEXP_WORD:
+    case WS_REGEXP_NOT_WORD:
+      a = sp > 0 && regexp_is_word(m->input[sp - 1]);
+      b = sp < m->length && regexp_is_word(m->input[sp]);
+      if ((a != b) == (inst->op == WS_REGEXP_WORD))
+      {
+        ++pc;
+        continue;
+      }
+      goto fail;
+
+    case WS_REGEXP_BACKREF:
+      from = m->captures[inst->x * 2];
+      to = m->captures[inst->x * 2 + 1];
+      // A group that didn't match matches the empty string.
+      if (from < 0 || to < 0)
+      {
+        ++pc;
+        continue;
+      }
+      if (sp + (to - from) > m->length)
+        goto fail;
+      for (long i = 0; i < to - from; ++i)
+        if (regexp_fold(regexp->flags, m->input[from + i]) !=
+            regexp_fold(regexp->flags, m->input[sp + i]))
+          goto fail;
+      sp += to - from;
+      ++pc;
+      continue;
+
+    case WS_REGEXP_LOOK:
+      mark = m->size;
+      matched = regexp_run(m, pc + 1, sp, &end_of_look);
+      // A lookahead is atomic: drop its choice points but keep the undo
+      // entries of the captures it made.
+      if (matched)
+      {
+        keep = mark;
+        for (size_t i = mark; i < m->size; ++i)
+          if (m->stack[i].kind != REGEXP_FRAME_BRANCH)
+            m->stack[keep++] = m->stack[i];
+        m->size = keep;
+      }
+      if (matched != (int)inst->x)
+      {
+        pc = inst->y;
+        continue;
+      }
+      goto fail;
+
+    case WS_REGEXP_MARK:
+      regexp_push(m, REGEXP_FRAME_REGISTER, inst->x, m->registers[inst->x]);
+      m->registers[inst->x] = sp;
+      ++pc;
+      continue;
+
+    case WS_REGEXP_CHECK:
+      if (m->registers[inst->x] == (long)sp)
+        goto fail;
+      ++pc;
+      continue;
+
+    case WS_REGEXP_MATCH:
+      *end = sp;
+      return 1;
+    }
+
+  fail:
+    for (;;)
+    {
+      if (m->size == base)
+        return 0;
+
+      regexp_frame *frame = &m->stack[--m->size];
+      if (frame->kind == REGEXP_FRAME_CAPTURE)
+      {
+        m->captures[frame->index] = frame->value;
+      }
+      else if (frame->kind == REGEXP_FRAME_REGISTER)
+      {
+        m->registers[frame->index] = frame->value;
+      }
+      else
+      {
+        pc = frame->index;
+        sp = frame->value;
+        break;
+      }
+    }
+  }
+}
+
+int regexp_backtrack(ws_regexp *regexp,
+                     const char16_t *input,
+                     size_t length,
+                     size_t start,
+                     long *captures)
+{
+  regexp_matcher m;
+  size_t end, last;
+  int matched = 0;
+
+  m.regexp = regexp;
+  m.input = input;
+  m.length = length;
+  m.captures = captures;
+  m.registers = (long *)ws_alloc_as(WS_MEMORY_OTHER, (regexp->registers + 1) * sizeof(long));
+  m.capacity = 64;
+  m.stack = (regexp_frame *)ws_alloc_as(WS_MEMORY_OTHER, m.capacity * sizeof(regexp_frame));
+
+  last = regexp->flags & WS_REGEXP_STICKY ? start : length;
+  for (size_t i = start; i <= last && !matched; ++i)
+  {
+    for (unsigned int j = 0; j < regexp->groups * 2; ++j)
+      captures[j] = -1;
+    for (unsigned int j = 0; j < regexp->registers; ++j)
+      m.registers[j] = -1;
+    m.size = 0;
+    matched = regexp_run(&m, 0, i, &end);
+  }
+
+  ws_free(m.stack);
+  ws_free(m.registers);
+  return matched;
+}
+
+//==============================================================================
+// DFA, the states are sets of the consuming instructions (and MATCH) that
+// the threads of the NFA wait at, the epsilon closure is taken when the next
+// code unit is known so the assertions can look at it.
+
+/**
+ * What there was before the position.
+ */
+#define REGEXP_CONTEXT_START 1
+#define REGEXP_CONTEXT_LINE 2
+#define REGEXP_CONTEXT_WORD 4
+
+/**
+ * The code unit after the end of the input.
+ */
+#define REGEXP_END -1
+
+ws_regexp_dfa_state REGEXP_DFA_MATCH;
+
+int regexp_context(int c)
+{
+  return (regexp_is_line_terminator(c) ? REGEXP_CONTEXT_LINE : 0) |
+         (regexp_is_word(c) ? REGEXP_CONTEXT_WORD : 0);
+}
+
+/**
+ * Follow the epsilon transitions from the pcs of the state before the code
+ * unit `c`, the consuming instructions that are reached are stored in `out`.
+ * Returns true if a MATCH is reached.
+ */
+int regexp_closure(ws_regexp *regexp,
+                   ws_regexp_dfa_state *state,
+                   int c,
+                   unsigned char *visited,
+                   unsigned int *stack,
+                   unsigned int *out,
+                   size_t *out_size)
+{
+  ws_regexp_inst *inst;
+  size_t size = 0;
+  unsigned int pc;
+  int matched = 0, multiline, a, b;
+
+  multiline = regexp->flags & WS_REGEXP_MULTILINE;
+  memset(visited, 0, regexp->code_size);
+  *out_size = 0;
+
+  for (size_t i = state->size; i > 0; --i)
+    stack[size++] = state->pcs[i - 1];
+
+  while (size > 0)
+  {
+    pc = stack[--size];
+    if (visited[pc])
+      continue;
+    visited[pc] = 1;
+
+    inst = &regexp->code[pc];
+    switch (inst->op)
+    {
+    case WS_REGEXP_CHAR:
+    case WS_REGEXP_ANY:
+    case WS_REGEXP_CLASS:
+      out[(*out_size)++] = pc;
+      break;
+    case WS_REGEXP_SPLIT:
+      stack[size++] = inst->y;
+      stack[size++] = inst->x;
+      break;
+    case WS_REGEXP_JMP:
+      stack[size++] = inst->x;
+      break;
+    case WS_REGEXP_BOL:
+      if ((state->context & REGEXP_CONTEXT_START) ||
+          (multiline && (state->context & REGEXP_CONTEXT_LINE)))
+        stack[size++] = pc + 1;
+      break;
+    case WS_REGEXP_EOL:
+      if (c == REGEXP_END || (multiline && regexp_is_line_terminator(c)))
+        stack[size++] = pc + 1;
+      break;
+    case WS_REGEXP_WORD:
+    case WS_REGEXP_NOT_WORD:
+      a = (state->context & REGEXP_CONTEXT_WORD) != 0;
+      b = c != REGEXP_END && regexp_is_word(c);
+      if ((a != b) == (inst->op == WS_REGEXP_WORD))
+        stack[size++] = pc + 1;
+      break;
+    case WS_REGEXP_MATCH:
+      matched = 1;
+      break;
+    default:
+      // Captures and the loop registers don't matter for a DFA.
+      stack[size++] = pc + 1;
+      break;
+    }
+  }
+
+  return matched;
+}
+
+unsigned long regexp_dfa_hash(unsigned int *pcs, size_t size, int context)
+{
+  unsigned long hash = context;
+
+  for (size_t i = 0; i < size; ++i)
+    hash = hash * 31 + pcs[i];
+  return hash;
+}
+
+/**
+ * Returns the state of the pcs (they are sorted), or NULL if there are too
+ * many states.  Must be called with the lock.
+ */
+ws_regexp_dfa_state *regexp_dfa_state(ws_regexp *regexp, unsigned int *pcs, size_t size, int context)
+{
+  ws_regexp_dfa_state *state;
+  unsigned long hash;
+
+  if (regexp->dfa_buckets == NULL)
+  {
+    regexp->dfa_buckets = (ws_regexp_dfa_state **)ws_alloc_as(WS_MEMORY_CODE, WS_REGEXP_DFA_BUCKETS * sizeof(ws_regexp_dfa_state *));
+    memset(regexp->dfa_buckets, 0, WS_REGEXP_DFA_BUCKETS * sizeof(ws_regexp_dfa_state *));
+  }
+
+  hash = regexp_dfa_hash(pcs, size, context);
+  for (state = regexp->dfa_buckets[hash % WS_REGEXP_DFA_BUCKETS]; state != NULL; state = state->chain)
+    if (state->hash == hash && state->context == context && state->size == size &&
+        memcmp(state->pcs, pcs, size * sizeof(unsigned int)) == 0)
+      return state;
+
+  if (regexp->dfa_size == WS_REGEXP_DFA_MAX_STATES)
+  {
+    atomic_store(&regexp->dfa, 0);
+    return NULL;
+  }
+
+  state = (ws_regexp_dfa_state *)ws_alloc_as(WS_MEMORY_CODE, sizeof(ws_regexp_dfa_state));
+  state->pcs = (unsigned int *)ws_alloc_as(WS_MEMORY_CODE, (size + 1) * sizeof(unsigned int));
+  memcpy(state->pcs, pcs, size * sizeof(unsigned int));
+  state->size = size;
+  state->context = context;
+  state->hash = hash;
+  for (int i = 0; i < WS_REGEXP_DFA_ALPHABET; ++i)
+    atomic_init(&state->next[i], NULL);
+  state->chain = regexp->dfa_buckets[hash % WS_REGEXP_DFA_BUCKETS];
+  regexp->dfa_buckets[hash % WS_REGEXP_DFA_BUCKETS] = state;
+  ++regexp->dfa_size;
+  return state;
+}
+
+int regexp_pc_compare(const void *a, const void *b)
+{
+  unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * The transition on `c` (REGEXP_END for the end of the input), it's
+ * REGEXP_DFA_MATCH if there is a match before `c`, and NULL if the DFA has
+ * too many states.  Must be called with the lock.
+ */
+ws_regexp_dfa_state *regexp_dfa_step(ws_regexp *regexp, ws_regexp_dfa_state *state, int c)
+{
+  ws_regexp_dfa_state *next;
+  unsigned char *visited;
+  unsigned int *stack, *out, *pcs;
+  size_t out_size, size = 0;
+
+  // The scratch memory: a pc is pushed to the stack of the closure by the
+  // state and by at most two instructions.
+  visited = (unsigned char *)ws_alloc_as(WS_MEMORY_OTHER, regexp->code_size);
+  stack = (unsigned int *)ws_alloc_as(WS_MEMORY_OTHER, (regexp->code_size * 5 + 1) * sizeof(unsigned int));
+  out = stack + regexp->code_size * 3;
+  pcs = out + regexp->code_size;
+
+  if (regexp_closure(regexp, state, c, visited, stack, out, &out_size))
+  {
+    next = &REGEXP_DFA_MATCH;
+  }
+  else if (c == REGEXP_END)
+  {
+    next = state;
+  }
+  else
+  {
+    for (size_t i = 0; i < out_size; ++i)
+      if (regexp_consumes(regexp, &regexp->code[out[i]], c))
+        pcs[size++] = out[i] + 1;
+
+    // A new match may start at every position, but a sticky one.
+    if (!(regexp->flags & WS_REGEXP_STICKY))
+      pcs[size++] = 0;
+
+    qsort(pcs, size, sizeof(unsigned int), regexp_pc_compare);
+    out_size = 0;
+    for (size_t i = 0; i < size; ++i)
+      if (i == 0 || pcs[i] != pcs[i - 1])
+        pcs[out_size++] = pcs[i];
+
+    next = regexp_dfa_state(regexp, pcs, out_size, regexp_context(c));
+  }
+
+  ws_free(visited);
+  ws_free(stack);
+  return next;
+}
+
+void regexp_dfa_lock(ws_regexp *regexp)
+{
+  while (atomic_flag_test_and_set_explicit(&regexp->dfa_lock, memory_order_acquire))
+    ;
+}
+
+void regexp_dfa_unlock(ws_regexp *regexp)
+{
+  atomic_flag_clear_explicit(&regexp->dfa_lock, memory_order_release);
+}
+
+/**
+ * Returns true if there is a match at or after `start`, or -1 if the DFA
+ * can't be used for the pattern.
+ */
+int regexp_dfa_test(ws_regexp *regexp, const char16_t *input, size_t length, size_t start)
+{
+  ws_regexp_dfa_state *state, *next;
+  unsigned int pc = 0;
+  int context, c;
+
+  context = start == 0 ? REGEXP_CONTEXT_START : regexp_context(input[start - 1]);
+  state = atomic_load_explicit(&regexp->dfa_start[context], memory_order_acquire);
+  if (state == NULL)
+  {
+    regexp_dfa_lock(regexp);
+    state = regexp_dfa_state(regexp, &pc, 1, context);
+    atomic_store_explicit(&regexp->dfa_start[context], state, memory_order_release);
+    regexp_dfa_unlock(regexp);
+    if (state == NULL)
+      return -1;
+  }
+
+  for (size_t i = start; i <= length; ++i)
+  {
+    c = i == length ? REGEXP_END : input[i];
+
+    // No thread is left, only happens to a sticky pattern.
+    if (state->size == 0)
+      return 0;
+
+    next = c >= 0 && c < WS_REGEXP_DFA_ALPHABET
+               ? atomic_load_explicit(&state->next[c], memory_order_acquire)
+               : NULL;
+    if (next == NULL)
+    {
+      regexp_dfa_lock(regexp);
+      next = regexp_dfa_step(regexp, state, c);
+      if (next != NULL && c >= 0 && c < WS_REGEXP_DFA_ALPHABET)
+        atomic_store_explicit(&state->next[c], next, memory_order_release);
+      regexp_dfa_unlock(regexp);
+      if (next == NULL)
+        return -1;
+    }
+
+    if (next == &REGEXP_DFA_MATCH)
+      return 1;
+    state = next;
+  }
+
+  return 0;
+}
+
+//==============================================================================
+// The cache of the compiled patterns, shared by all of the threads.
+
+ws_regexp *regexp_cache[WS_REGEXP_CACHE_SIZE];
+atomic_flag regexp_cache_lock = ATOMIC_FLAG_INIT;
+
+int regexp_flags(const char16_t *flags, size_t length)
+{
+  static const char16_t names[] = u"gimsuy";
+  int result = 0, flag;
+
+  for (size_t i = 0; i < length; ++i)
+  {
+    flag = 0;
+    for (int j = 0; names[j] != 0; ++j)
+      if (names[j] == flags[i])
+        flag = 1 << j;
+    if (flag == 0 || (result & flag))
+      return -1;
+    result |= flag;
+  }
+
+  return result;
+}
+
+ws_regexp *regexp_compile(const char16_t *pattern, size_t length, int flags)
+{
+  ws_regexp *regexp;
+  unsigned long hash = flags;
+
+  for (size_t i = 0; i < length; ++i)
+    hash = hash * 31 + pattern[i];
+
+  while (atomic_flag_test_and_set_explicit(&regexp_cache_lock, memory_order_acquire))
+    ;
+
+  for (regexp = regexp_cache[hash % WS_REGEXP_CACHE_SIZE]; regexp != NULL; regexp = regexp->next)
+    if (regexp->flags == flags && regexp->length == length &&
+        memcmp(regexp->pattern, pattern, length * sizeof(char16_t)) == 0)
+      break;
+
+  if (regexp == NULL)
+  {
+    regexp = regexp_build(pattern, length, flags);
+    regexp->next = regexp_cache[hash % WS_REGEXP_CACHE_SIZE];
+    regexp_cache[hash % WS_REGEXP_CACHE_SIZE] = regexp;
+  }
+
+  atomic_flag_clear_explicit(&regexp_cache_lock, memory_order_release);
+  return regexp;
+}
+
+int regexp_test(ws_regexp *regexp, const char16_t *input, size_t length, size_t start)
+{
+  long *captures;
+  int matched;
+
+  if (start > length)
+    return 0;
+
+  if (atomic_load_explicit(&regexp->dfa, memory_order_relaxed) &&
+      (matched = regexp_dfa_test(regexp, input, length, start)) >= 0)
+    return matched;
+
+  captures = (long *)ws_alloc_as(WS_MEMORY_OTHER, regexp->groups * 2 * sizeof(long));
+  matched = regexp_backtrack(regexp, input, length, start, captures);
+  ws_free(captures);
+  return matched;
+}
+
+int regexp_exec(ws_regexp *regexp,
+                const char16_t *input,
+                size_t length,
+                size_t start,
+                long *captures)
+{
+  if (start > length)
+    return 0;
+
+  // Most of the texts don't match, so they never reach the backtracking.
+  if (atomic_load_explicit(&regexp->dfa, memory_order_relaxed) &&
+      regexp_dfa_test(regexp, input, length, start) == 0)
+    return 0;
+
+  return regexp_backtrack(regexp, input, length, start, captures);
+}
+
+//==============================================================================
+
+ws_val *ws_regexp_object(ws_context *ctx, ws_regexp *regexp)
+{
+  ws_val *value;
+
+  value = ws_object(ctx, NULL);
+  value->data.object->regexp = regexp;
+  object_set(ctx, value, &WS_REGEXP_LAST_INDEX, &WS_ZERO);
+  return value;
+}
+
+ws_val *ws_regexp_literal(ws_context *ctx, ws_val *literal)
+{
+  char16_t *data;
+  size_t length, slash;
+  int flags;
+
+  if (literal->type != WVAL_TYPE_STRING)
+    die("RegExp: The operand is not a string.");
+
+  data = ws_string_flatten(literal);
+  length = literal->data.string.size / sizeof(char16_t) - 1;
+  for (slash = length; slash > 1 && data[slash - 1] != '/'; --slash)
+    ;
+  if (length < 2 || data[0] != '/' || slash < 2)
+    die("RegExp: The operand is not a regular expression literal.");
+
+  flags = regexp_flags(data + slash, length - slash);
+  if (flags < 0)
+    die("RegExp: Invalid flags.");
+
+  return ws_regexp_object(ctx, regexp_compile(data + 1, slash - 2, flags));
+}
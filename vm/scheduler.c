@@ -0,0 +1,79 @@
+#include "scheduler.h"
+#include "context.h"
+#include "exec.h"
+#include "alloc.h"
+#include "gc.h"
+
+// For documentation and comments see scheduler.h :)
+
+ws_scheduler *scheduler_create(long slice)
+{
+  ws_scheduler *scheduler = (ws_scheduler *)ws_alloc(sizeof(*scheduler));
+  scheduler->slice = slice;
+  scheduler->head = NULL;
+  scheduler->tail = NULL;
+  return scheduler;
+}
+
+void scheduler_destroy(ws_scheduler *scheduler)
+{
+  context_list_free(scheduler->head);
+  ws_free(scheduler);
+}
+
+void scheduler_add(ws_scheduler *scheduler, ws_context *ctx)
+{
+  ws_context_list *item = ws_alloc_context_list();
+  item->ctx = ctx;
+  item->next = NULL;
+
+  if (scheduler->tail == NULL)
+    scheduler->head = item;
+  else
+    scheduler->tail->next = item;
+
+  scheduler->tail = item;
+}
+
+int scheduler_step(ws_scheduler *scheduler, ws_scheduler_callback callback)
+{
+  ws_context_list *item, *child;
+  ws_context *ctx;
+  ws_val *value;
+
+  item = scheduler->head;
+  if (item == NULL)
+    return 0;
+
+  scheduler->head = item->next;
+  if (scheduler->head == NULL)
+    scheduler->tail = NULL;
+
+  ctx = item->ctx;
+  ws_free_context_list(item);
+
+  ctx->fuel = scheduler->slice;
+  value = exec_resume(ctx);
+
+  if (value != NULL || ctx->error != NULL)
+    callback(ctx, value);
+  else if (ctx->forked)
+    for (child = ctx->childs; child != NULL; child = child->next)
+      scheduler_add(scheduler, child->ctx);
+  else if (!ctx->subsumed)
+    scheduler_add(scheduler, ctx);
+
+#ifdef WS_TRACING_GC
+  // Every branch is parked in the queue, it's a safepoint.
+  if (gc_should_collect())
+    gc_collect(scheduler->head);
+#endif
+
+  return 1;
+}
+
+void scheduler_run(ws_scheduler *scheduler, ws_scheduler_callback callback)
+{
+  while (scheduler_step(scheduler, callback))
+    ;
+}
@@ -3,6 +3,44 @@
 #include "common.h"
 #include "alloc.h"
 
+//==============================================================================
+// Statistics, see ws_table_stats.
+
+#ifdef WS_TABLE_STATS
+ws_table_stats table_stats_global;
+
+ws_table_stats *table_stats(ws_context *ctx)
+{
+  return &ctx->table_stats;
+}
+
+unsigned int table_stats_bucket(unsigned long value)
+{
+  unsigned int bucket = 0;
+  while (value != 0 && bucket < WS_HISTOGRAM_BUCKETS - 1)
+  {
+    value >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+#define TABLE_STATS_ADD(ctx, field, n)                                       \
+  do                                                                         \
+  {                                                                          \
+    atomic_fetch_add_explicit(&(ctx)->table_stats.field, n,                  \
+                              memory_order_relaxed);                         \
+    atomic_fetch_add_explicit(&table_stats_global.field, n,                  \
+                              memory_order_relaxed);                         \
+  } while (0)
+
+#define TABLE_STATS_RECORD(ctx, histogram, value) \
+  TABLE_STATS_ADD(ctx, histogram[table_stats_bucket(value)], 1)
+#else
+#define TABLE_STATS_ADD(ctx, field, n) ((void)(ctx))
+#define TABLE_STATS_RECORD(ctx, histogram, value) ((void)(ctx), (void)(value))
+#endif
+
 //==============================================================================
 // Some private functions to work with ctx.tables
 void ctx_tables_insert(ws_context *ctx, struct _table_ctx *w);
@@ -12,13 +50,15 @@ void ctx_tables_grow(ws_context *ctx)
   struct _table_ctx **tables;
   unsigned int i, old_cap;
 
+  TABLE_STATS_ADD(ctx, grows, 1);
+
   old_cap = ctx->tables.capacity;
   ctx->tables.capacity *= 2;
   if (ctx->tables.capacity == 0)
     ctx->tables.capacity = 4;
 
   tables = ctx->tables.tables;
-  ctx->tables.tables = (struct _table_ctx **)ws_alloc(
+  ctx->tables.tables = (struct _table_ctx **)ws_alloc_as(WS_MEMORY_TABLES,
       sizeof(struct _table_ctx *) * ctx->tables.capacity);
 
   for (i = 0; i < ctx->tables.capacity; ++i)
@@ -36,9 +76,9 @@ void ctx_tables_insert(ws_context *ctx, struct _table_ctx *w)
 {
   unsigned int i, h;
 
-  ++ctx->tables.size;
-  if (ctx->tables.size > ctx->tables.capacity)
+  if (ctx->tables.size + 1 > ctx->tables.capacity)
     ctx_tables_grow(ctx);
+  ++ctx->tables.size;
 
   i = 0;
   do
@@ -58,24 +98,32 @@ struct _table_ctx *ctx_tables_find(ws_context *ctx, ws_table *table)
   i = 0;
 
   if (ctx->tables.capacity == 0)
+  {
+    TABLE_STATS_ADD(ctx, find_misses, 1);
     return NULL;
+  }
 
   do
   {
     h = (table->id + i++) % ctx->tables.capacity;
     if (ctx->tables.tables[h] == NULL)
-      return NULL;
+      break;
     if (ctx->tables.tables[h]->id == table->id)
+    {
+      TABLE_STATS_RECORD(ctx, probes, i);
       return ctx->tables.tables[h];
+    }
   } while (i != ctx->tables.capacity);
 
+  TABLE_STATS_RECORD(ctx, probes, i);
+  TABLE_STATS_ADD(ctx, find_misses, 1);
   return NULL;
 }
 
 //==============================================================================
 // Private function to work with _table_ctx
 
-void tbl_grow(struct _table_ctx *table)
+void tbl_grow(ws_context *ctx, struct _table_ctx *table)
 {
   struct _table_slot **buckets;
   struct _table_slot *current, *tmp;
@@ -85,13 +133,15 @@ void tbl_grow(struct _table_ctx *table)
   if (2 * table->capacity >= table->size)
     return;
 
+  TABLE_STATS_ADD(ctx, grows, 1);
+
   old_cap = table->capacity;
   table->capacity *= 2;
   if (table->capacity == 0)
     table->capacity = 4;
 
   buckets = table->buckets;
-  table->buckets = (struct _table_slot **)ws_alloc(sizeof(struct _table_slot *) * table->capacity);
+  table->buckets = (struct _table_slot **)ws_alloc_as(WS_MEMORY_TABLES, sizeof(struct _table_slot *) * table->capacity);
 
   for (i = 0; i < table->capacity; ++i)
     table->buckets[i] = NULL;
@@ -112,54 +162,93 @@ void tbl_grow(struct _table_ctx *table)
   ws_free(buckets);
 }
 
-struct _table_slot *tbl_get(struct _table_ctx *table, ws_val *key)
+struct _table_slot *tbl_get(ws_context *ctx, struct _table_ctx *table, ws_val *key)
 {
   struct _table_slot *slot;
-  unsigned int hash;
+  unsigned int hash, length;
 
   hash = ws_hash(key) % table->capacity;
   slot = table->buckets[hash];
+  length = 0;
   for (; slot != NULL; slot = slot->next)
   {
+    ++length;
     if (slot->key == key || wval_strict_equal(slot->key, key))
-      return slot;
+      break;
   }
-  return NULL;
+
+  TABLE_STATS_RECORD(ctx, chains, length);
+  return slot;
+}
+
+/**
+ * Add the slot to the end of the insertion order.
+ */
+void tbl_append(struct _table_ctx *table, struct _table_slot *slot)
+{
+  slot->order = NULL;
+  if (table->last == NULL)
+    table->first = slot;
+  else
+    table->last->order = slot;
+  table->last = slot;
 }
 
-void tbl_set(struct _table_ctx *table, ws_val *key, void *data)
+/**
+ * Take the slot out of its bucket, it stays in the insertion order.
+ */
+void tbl_unlink(struct _table_ctx *table, unsigned int hash, struct _table_slot *slot)
 {
-  tbl_grow(table);
+  struct _table_slot **link = &table->buckets[hash];
 
-  struct _table_slot *slot;
+  while (*link != slot)
+    link = &(*link)->next;
+  *link = slot->next;
+  slot->next = NULL;
+}
+
+void tbl_set(ws_context *ctx, struct _table_ctx *table, ws_val *key, void *data)
+{
+  tbl_grow(ctx, table);
+
+  struct _table_slot *slot, *deleted;
   unsigned int hash;
 
-  slot = tbl_get(table, key);
+  deleted = tbl_get(ctx, table, key);
 
-  if (slot != NULL)
+  if (deleted != NULL && !deleted->is_delete)
   {
-    slot->is_delete = 0;
-    slot->value = data;
+    deleted->value = data;
     return;
   }
 
-  slot = (struct _table_slot *)ws_alloc(sizeof(*slot));
+  // A key that was deleted from this overlay is added again after all the
+  // other keys, the old slot stays in the order list as a tombstone that no
+  // lookup finds, an iterator may still point to it.
+  hash = ws_hash(key) % table->capacity;
+  if (deleted != NULL)
+    tbl_unlink(table, hash, deleted);
+  else
+    ++table->size;
+
+  slot = ws_alloc_table_slot();
   slot->key = key;
   slot->value = data;
   slot->is_delete = 0;
-  hash = ws_hash(slot->key) % table->capacity;
+  slot->readded = deleted != NULL;
   slot->next = table->buckets[hash];
   table->buckets[hash] = slot;
-  ++table->size;
+  tbl_append(table, slot);
   wval_retain(key);
+  TABLE_STATS_ADD(ctx, slots, 1);
 }
 
-void tbl_del(struct _table_ctx *table, ws_val *key)
+void tbl_del(ws_context *ctx, struct _table_ctx *table, ws_val *key)
 {
   struct _table_slot *slot;
   unsigned int hash;
 
-  slot = tbl_get(table, key);
+  slot = tbl_get(ctx, table, key);
 
   if (slot != NULL)
   {
@@ -167,20 +256,25 @@ void tbl_del(struct _table_ctx *table, ws_val *key)
     {
       slot->value = NULL;
       slot->is_delete = 1;
+      TABLE_STATS_ADD(ctx, tombstones, 1);
     }
   }
   else
   {
-    tbl_grow(table);
-    slot = (struct _table_slot *)ws_alloc(sizeof(*slot));
+    tbl_grow(ctx, table);
+    slot = ws_alloc_table_slot();
     slot->key = key;
     slot->is_delete = 1;
+    slot->readded = 0;
     slot->value = NULL;
     hash = ws_hash(slot->key) % table->capacity;
     slot->next = table->buckets[hash];
     table->buckets[hash] = slot;
+    tbl_append(table, slot);
     ++table->size;
     wval_retain(key);
+    TABLE_STATS_ADD(ctx, slots, 1);
+    TABLE_STATS_ADD(ctx, tombstones, 1);
   }
 }
 
@@ -201,10 +295,13 @@ void table_destroy(ws_context *ctx, ws_table *t)
 {
   struct _table_ctx *table;
   struct _table_slot *slot, *tmp;
-  unsigned int i, j, h;
+  unsigned int j, h;
 
   table = NULL;
 
+  if (ctx->tables.capacity == 0)
+    return;
+
   j = 0;
   do
   {
@@ -222,20 +319,19 @@ void table_destroy(ws_context *ctx, ws_table *t)
   if (table == NULL)
     return;
 
-  for (i = 0; i < table->capacity; ++i)
+  // The order list also has the slots of the keys that were added again.
+  for (slot = table->first; slot != NULL; slot = tmp)
   {
-    slot = table->buckets[i];
-    while (slot != NULL)
-    {
-      tmp = slot->next;
-      wval_release(slot->key);
-      free(slot);
-      slot = tmp;
-    }
+    tmp = slot->order;
+    TABLE_STATS_ADD(ctx, slots, -1);
+    if (slot->is_delete)
+      TABLE_STATS_ADD(ctx, tombstones, -1);
+    wval_release(slot->key);
+    ws_free_table_slot(slot);
   }
 
-  free(table->buckets);
-  free(table);
+  ws_free(table->buckets);
+  ws_free(table);
 }
 
 void table_destroy_all_i(ws_context *c, ws_table *t)
@@ -267,15 +363,19 @@ void table_set(ws_context *ctx, ws_table *t, ws_val *key, void *data)
   table = ctx_tables_find(ctx, t);
   if (table == NULL)
   {
-    table = (struct _table_ctx *)ws_alloc(sizeof(*table));
+    table = (struct _table_ctx *)ws_alloc_as(WS_MEMORY_TABLES, sizeof(*table));
     table->id = t->id;
     table->size = 0;
     table->capacity = 4;
-    table->buckets = (struct _table_slot **)ws_alloc(sizeof(struct _table_slot *) * 4);
+    table->buckets = (struct _table_slot **)ws_alloc_as(WS_MEMORY_TABLES, sizeof(struct _table_slot *) * 4);
+    for (unsigned int i = 0; i < 4; ++i)
+      table->buckets[i] = NULL;
+    table->first = NULL;
+    table->last = NULL;
     ctx_tables_insert(ctx, table);
   }
   // Now insert (key, data) to the table.
-  tbl_set(table, key, data);
+  tbl_set(ctx, table, key, data);
 }
 
 void table_del(ws_context *ctx, ws_table *t, ws_val *key)
@@ -288,14 +388,18 @@ void table_del(ws_context *ctx, ws_table *t, ws_val *key)
   table = ctx_tables_find(ctx, t);
   if (table == NULL)
   {
-    table = (struct _table_ctx *)ws_alloc(sizeof(*table));
+    table = (struct _table_ctx *)ws_alloc_as(WS_MEMORY_TABLES, sizeof(*table));
     table->id = t->id;
     table->size = 0;
     table->capacity = 4;
-    table->buckets = (struct _table_slot **)ws_alloc(sizeof(struct _table_slot *) * 4);
+    table->buckets = (struct _table_slot **)ws_alloc_as(WS_MEMORY_TABLES, sizeof(struct _table_slot *) * 4);
+    for (unsigned int i = 0; i < 4; ++i)
+      table->buckets[i] = NULL;
+    table->first = NULL;
+    table->last = NULL;
     ctx_tables_insert(ctx, table);
   }
-  tbl_del(table, key);
+  tbl_del(ctx, table, key);
 }
 
 void *table_get(ws_context *ctx, ws_table *t, ws_val *key)
@@ -303,21 +407,168 @@ void *table_get(ws_context *ctx, ws_table *t, ws_val *key)
   struct _table_ctx *table;
   struct _table_slot *slot;
   ws_context *current_ctx;
+  unsigned long visited;
 
   current_ctx = ctx;
+  slot = NULL;
+  visited = 0;
 
   for (; current_ctx != NULL; current_ctx = current_ctx->parent)
   {
+    ++visited;
     table = ctx_tables_find(current_ctx, t);
     if (table == NULL)
       continue;
-    slot = tbl_get(table, key);
-    if (slot == NULL)
+    slot = tbl_get(current_ctx, table, key);
+    if (slot != NULL)
+      break;
+  }
+
+  TABLE_STATS_RECORD(ctx, ancestors, visited);
+
+  if (slot == NULL || slot->is_delete)
+    return NULL;
+  return slot->value;
+}
+
+void table_iter_init(ws_table_iter *iter, ws_table *table)
+{
+  iter->table = table;
+  iter->layer = -1;
+  iter->slot = NULL;
+}
+
+/**
+ * Returns the context at the given distance from the root.
+ */
+ws_context *table_layer(ws_context *ctx, int layer)
+{
+  ws_context *root;
+  int depth = 0;
+
+  for (root = ctx; root->parent != NULL; root = root->parent)
+    ++depth;
+
+  for (; depth > layer; --depth)
+    ctx = ctx->parent;
+
+  return ctx;
+}
+
+/**
+ * Returns true if the slot of the `layer` context is where the key that the
+ * context sees was added.
+ */
+int table_is_origin(ws_context *ctx,
+                    ws_table *t,
+                    ws_context *layer,
+                    struct _table_slot *slot)
+{
+  struct _table_ctx *table;
+  struct _table_slot *found;
+
+  if (slot->is_delete)
+    return 0;
+
+  // Deleted (and maybe added again) on the way down to the context.
+  for (; ctx != layer; ctx = ctx->parent)
+  {
+    table = ctx_tables_find(ctx, t);
+    found = table == NULL ? NULL : tbl_get(ctx, table, slot->key);
+    if (found != NULL && (found->is_delete || found->readded))
+      return 0;
+  }
+
+  if (slot->readded)
+    return 1;
+
+  // Or it already existed above the layer.
+  for (ctx = layer->parent; ctx != NULL; ctx = ctx->parent)
+  {
+    table = ctx_tables_find(ctx, t);
+    found = table == NULL ? NULL : tbl_get(ctx, table, slot->key);
+    if (found != NULL)
+      return found->is_delete;
+  }
+
+  return 1;
+}
+
+ws_val *table_next(ws_context *ctx, ws_table_iter *iter)
+{
+  struct _table_ctx *table;
+  struct _table_slot *slot;
+  ws_context *layer, *root;
+  int depth = 0;
+
+  for (root = ctx; root->parent != NULL; root = root->parent)
+    ++depth;
+
+  layer = iter->layer < 0 ? NULL : table_layer(ctx, iter->layer);
+
+  for (;;)
+  {
+    while (iter->slot == NULL)
+    {
+      if (iter->layer >= depth)
+        return NULL;
+      layer = table_layer(ctx, ++iter->layer);
+      table = ctx_tables_find(layer, iter->table);
+      iter->slot = table == NULL ? NULL : table->first;
+    }
+
+    slot = iter->slot;
+    iter->slot = slot->order;
+    if (table_is_origin(ctx, iter->table, layer, slot))
+      return slot->key;
+  }
+}
+
+void table_each(ws_context *ctx,
+                ws_table *t,
+                void (*fn)(ws_val *key, void *value, void *data),
+                void *data)
+{
+  struct _table_ctx *table;
+  struct _table_slot *slot;
+  unsigned int i;
+
+  for (; ctx != NULL; ctx = ctx->parent)
+  {
+    table = ctx_tables_find(ctx, t);
+    if (table == NULL)
       continue;
-    if (slot->is_delete)
-      return NULL;
-    return slot->value;
+    for (i = 0; i < table->capacity; ++i)
+      for (slot = table->buckets[i]; slot != NULL; slot = slot->next)
+        fn(slot->key, slot->value, data);
   }
+}
 
-  return NULL;
+void table_each_reachable_i(ws_context *ctx,
+                            ws_table *t,
+                            void (*fn)(ws_val *key, void *value, void *data),
+                            void *data)
+{
+  struct _table_ctx *table;
+  struct _table_slot *slot;
+  ws_context_list *child;
+
+  if (!ctx->gc_reachable)
+    return;
+
+  table = ctx_tables_find(ctx, t);
+  if (table != NULL)
+    for (unsigned int i = 0; i < table->capacity; ++i)
+      for (slot = table->buckets[i]; slot != NULL; slot = slot->next)
+        fn(slot->key, slot->value, data);
+
+  for (child = ctx->childs; child != NULL; child = child->next)
+    table_each_reachable_i(child->ctx, t, fn, data);
+}
+
+void table_each_reachable(ws_table *t,
+                          void (*fn)(ws_val *key, void *value, void *data),
+                          void *data)
+{
+  table_each_reachable_i(t->ctx, t, fn, data);
 }
@@ -0,0 +1,145 @@
+#include "trace.h"
+#include "context.h"
+#include "common.h"
+#include "alloc.h"
+
+// For documentation and comments see trace.h :)
+
+//==============================================================================
+// Varints.
+
+/**
+ * Maximum size of an encoded decision.
+ */
+#define TRACE_MAX_DECISION_SIZE 20
+
+size_t trace_write_varint(uint8_t *data, unsigned long value)
+{
+  size_t size = 0;
+
+  while (value >= 0x80)
+  {
+    data[size++] = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+
+  data[size++] = value;
+  return size;
+}
+
+int trace_read_varint(ws_trace *trace, unsigned long *value)
+{
+  unsigned int shift = 0;
+  uint8_t byte;
+
+  *value = 0;
+  do
+  {
+    if (trace->position == trace->size)
+      return 0;
+    byte = trace->data[trace->position++];
+    *value |= (unsigned long)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+
+  return 1;
+}
+
+//==============================================================================
+
+/**
+ * Index of the context in the children of its parent.
+ */
+unsigned int trace_child_index(ws_context *ctx)
+{
+  ws_context_list *child;
+  unsigned int index = 0;
+
+  for (child = ctx->parent->childs; child->ctx != ctx; child = child->next)
+    ++index;
+
+  return index;
+}
+
+ws_trace *trace_create(ws_context *ctx)
+{
+  ws_trace *trace;
+  ws_context **path;
+  unsigned int length, i;
+  size_t size;
+
+  length = 0;
+  for (ws_context *current = ctx; current->parent != NULL; current = current->parent)
+    ++length;
+
+  path = (ws_context **)ws_alloc(sizeof(ws_context *) * (length + 1));
+  for (i = length; ctx->parent != NULL; ctx = ctx->parent)
+    path[--i] = ctx;
+
+  trace = (ws_trace *)ws_alloc(sizeof(*trace));
+  trace->length = length;
+  trace->position = 0;
+  trace->data = (uint8_t *)ws_alloc(TRACE_MAX_DECISION_SIZE * length + 1);
+
+  size = 0;
+  for (i = 0; i < length; ++i)
+  {
+    unsigned int index = trace_child_index(path[i]);
+    unsigned long cursor = path[i]->parent->cursor;
+    size += trace_write_varint(trace->data + size, cursor << 2 | (index < 3 ? index : 3));
+    if (index >= 3)
+      size += trace_write_varint(trace->data + size, index - 3);
+  }
+
+  trace->size = size;
+  ws_free(path);
+  return trace;
+}
+
+ws_trace *trace_from_data(uint8_t *data, size_t size)
+{
+  ws_trace *trace = (ws_trace *)ws_alloc(sizeof(*trace));
+  unsigned long cursor;
+  unsigned int index;
+
+  trace->size = size;
+  trace->position = 0;
+  trace->data = (uint8_t *)ws_alloc(size + 1);
+  for (size_t i = 0; i < size; ++i)
+    trace->data[i] = data[i];
+
+  trace->length = 0;
+  while (trace_next(trace, &cursor, &index))
+    ++trace->length;
+  if (trace->position != size)
+    die("trace_from_data: Invalid trace.");
+
+  trace->position = 0;
+  return trace;
+}
+
+void trace_destroy(ws_trace *trace)
+{
+  ws_free(trace->data);
+  ws_free(trace);
+}
+
+int trace_next(ws_trace *trace, unsigned long *cursor, unsigned int *index)
+{
+  unsigned long value, extra;
+
+  if (!trace_read_varint(trace, &value))
+    return 0;
+
+  *cursor = value >> 2;
+  *index = value & 3;
+
+  if (*index == 3)
+  {
+    if (!trace_read_varint(trace, &extra))
+      return 0;
+    *index += extra;
+  }
+
+  return 1;
+}
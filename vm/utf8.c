@@ -126,14 +126,16 @@ ws_utf8 *ws_string_to_utf8(ws_val *string)
     die("ws_string_to_utf8: Only String is a valid parameter.");
 
   int input_size = string->data.string.size;
-  int output_size = input_size;
+  // Each UTF-16 unit is at most 3 bytes of UTF-8, the converter also wants
+  // 5 bytes of headroom before it writes a character.
+  int output_size = input_size / 2 * 3 + 6;
 
-  ws_utf8 *utf8 = (ws_utf8 *)malloc(output_size);
+  ws_utf8 *utf8 = (ws_utf8 *)malloc(offsetof(ws_utf8, data) + output_size);
   if (utf8 == NULL)
     die("ws_string_to_utf8: Memory allocation failed.");
 
   UTF16LEToUTF8((unsigned char *)(&utf8->data), &output_size,
-                (unsigned char *)string->data.string.data, &input_size);
+                (unsigned char *)ws_string_flatten(string), &input_size);
 
   utf8->size = output_size;
 
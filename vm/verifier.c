@@ -0,0 +1,491 @@
+#include <stdint.h>
+#include "verifier.h"
+#include "compiler.h"
+#include "bytecode.h"
+#include "alloc.h"
+#include "exec.h"
+
+// For documentation and comments see verifier.h :)
+
+/**
+ * Depth of an instruction that is not reached yet.
+ */
+#define VERIFY_UNREACHED -1
+
+/**
+ * An instruction boundary that is not reached yet.
+ */
+#define VERIFY_BOUNDARY -2
+
+uint16_t verify_read_uint16(uint8_t *data)
+{
+  return data[0] | (data[1] << 8);
+}
+
+uint32_t verify_read_uint32(uint8_t *data)
+{
+  return (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+         ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/**
+ * Number of values that the instruction pops from and pushes to the data
+ * stack, a value that is only read counts as both.  Returns false for an
+ * unknown opcode or one that has no defined stack effect (`TODO`).
+ */
+int verify_stack_effect(unsigned int bytecode, int *pops, int *pushes)
+{
+  switch (bytecode)
+  {
+  case WB_LD_UNDEF:
+  case WB_LD_NULL:
+  case WB_LD_TRUE:
+  case WB_LD_FALSE:
+  case WB_LD_ZERO:
+  case WB_LD_ONE:
+  case WB_LD_TWO:
+  case WB_LD_NA_N:
+  case WB_LD_INFINITY:
+  case WB_LD_ARR:
+  case WB_LD_OBJ:
+  case WB_LD_THIS:
+  case WB_LD_STR:
+  case WB_NAMED:
+  case WB_NAMED_REF:
+  case WB_REG_EXP:
+  case WB_LD_FUNCTION:
+  case WB_LD_FLOAT_3_2:
+  case WB_LD_FLOAT_6_4:
+  case WB_LD_INT_3_2:
+  case WB_LD_UINT_3_2:
+  case WB_NEW_ARG:
+    *pops = 0;
+    *pushes = 1;
+    return 1;
+
+  // `New` shares its opcode with `Div`, both pop two values.
+  case WB_ADD:
+  case WB_MUL:
+  case WB_SUB:
+  case WB_NEW:
+  case WB_MOD:
+  case WB_POW:
+  case WB_BLS:
+  case WB_BRS:
+  case WB_BURS:
+  case WB_LT:
+  case WB_LTE:
+  case WB_GT:
+  case WB_GTE:
+  case WB_EQ:
+  case WB_IEQ:
+  case WB_EQS:
+  case WB_IEQS:
+  case WB_BIT_OR:
+  case WB_BIT_AND:
+  case WB_BIT_XOR:
+  case WB_AND:
+  case WB_OR:
+  case WB_INSTANCE_OF:
+  case WB_IN:
+  case WB_PROP:
+  case WB_AR_PUSH:
+  case WB_ASGN:
+  case WB_PUSH_ARG:
+  case WB_CALL:
+    *pops = 2;
+    *pushes = 1;
+    return 1;
+
+  // The callee and 0-3 arguments, the count is the low nibble of the opcode.
+  case WB_CALL_0:
+  case WB_CALL_1:
+  case WB_CALL_2:
+  case WB_CALL_3:
+  case WB_NEW_0:
+  case WB_NEW_1:
+  case WB_NEW_2:
+  case WB_NEW_3:
+    *pops = 1 + (bytecode & 0x0f);
+    *pushes = 1;
+    return 1;
+
+  case WB_BIT_NOT:
+  case WB_NOT:
+  case WB_NEG:
+  case WB_POS:
+  case WB_TYPE:
+  case WB_VOID:
+  case WB_DEL:
+  case WB_NAMED_PROP:
+  case WB_POSTFIX_UPDATE_ADD:
+  case WB_POSTFIX_UPDATE_SUB:
+  case WB_PREFIX_UPDATE_ADD:
+  case WB_PREFIX_UPDATE_SUB:
+  case WB_JMP_TRUE_PEEK:
+  case WB_JMP_FALSE_PEEK:
+  case WB_JMP_TRUE_THEN_POP:
+  case WB_JMP_FALSE_THEN_POP:
+    *pops = 1;
+    *pushes = 1;
+    return 1;
+
+  // The iterator, the key and whatever there was a key.
+  case WB_NEXT:
+    *pops = 1;
+    *pushes = 3;
+    return 1;
+
+  case WB_DUP:
+  case WB_PROP_REF:
+  case WB_UN_REF_DUP:
+    *pops = 1;
+    *pushes = 2;
+    return 1;
+
+  case WB_SWAP:
+  case WB_COMPUTED_REF:
+    *pops = 2;
+    *pushes = 2;
+    return 1;
+
+  case WB_POP:
+  case WB_STORE:
+  case WB_LET:
+  case WB_CONST:
+  case WB_JMP_TRUE_POP:
+  case WB_JMP_FALSE_POP:
+  case WB_SWITCH:
+  case WB_RET:
+    *pops = 1;
+    *pushes = 0;
+    return 1;
+
+  case WB_VAR:
+  case WB_SET_IS_CONST:
+  case WB_JMP:
+  case WB_DIAMOND:
+  case WB_LD_SCOPE:
+  case WB_FUNCTION_IN:
+  case WB_BLOCK_OUT:
+  case WB_BLOCK_IN:
+    *pops = 0;
+    *pushes = 0;
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ * Returns true if the netstring at `offset` is in the constant pool.
+ */
+int verify_netstring(ws_function_compiled_data *function, uint32_t offset)
+{
+  size_t size = function->constant_pool_size;
+  uint8_t *pool = function->constant_pool;
+
+  if ((size_t)offset + 2 > size)
+    return 0;
+  return (size_t)offset + 2 + (size_t)verify_read_uint16(pool + offset) * 2 <= size;
+}
+
+/**
+ * Visit every jump target of the switch table at `offset`, returns false if
+ * the table is not in the constant pool.
+ */
+int verify_switch_table(ws_function_compiled_data *function,
+                        uint32_t offset,
+                        int (*visit)(size_t target, void *data),
+                        void *data)
+{
+  size_t size = function->constant_pool_size;
+  uint8_t *pool = function->constant_pool;
+  uint8_t *table = pool + offset, *slot;
+  size_t count;
+
+  if ((size_t)offset + 3 > size)
+    return 0;
+  if (!visit(verify_read_uint16(table + 1), data))
+    return 0;
+
+  // Dense table.
+  if (table[0] == 0)
+  {
+    if ((size_t)offset + 9 > size)
+      return 0;
+    count = verify_read_uint16(table + 7);
+    if ((size_t)offset + 9 + count * 2 > size)
+      return 0;
+    for (size_t i = 0; i < count; ++i)
+      if (!visit(verify_read_uint16(table + 9 + i * 2), data))
+        return 0;
+    return 1;
+  }
+
+  if (table[0] != 1 || (size_t)offset + 5 > size)
+    return 0;
+
+  // The lookup masks the hash, the capacity must be a power of two.
+  count = verify_read_uint16(table + 3);
+  if (count == 0 || (count & (count - 1)) != 0)
+    return 0;
+  if ((size_t)offset + 5 + count * 7 > size)
+    return 0;
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    slot = table + 5 + i * 7;
+    if (slot[0] > 2)
+      return 0;
+    if (slot[0] == 0)
+      continue;
+    if (slot[0] == 2 && !verify_netstring(function, verify_read_uint32(slot + 1)))
+      return 0;
+    if (!visit(verify_read_uint16(slot + 5), data))
+      return 0;
+  }
+
+  return 1;
+}
+
+//==============================================================================
+
+/**
+ * State of the data flow pass, `depth[i]` is the stack depth before the
+ * instruction at `i` (the end of the code is a boundary too).
+ */
+struct _verify_state
+{
+  ws_function_compiled_data *function;
+  int *depth;
+  size_t *worklist;
+  size_t worklist_size;
+  int current;
+  const char *error;
+};
+
+/**
+ * Record that `target` is reached with `state->current` values on the stack.
+ */
+int verify_reach(size_t target, void *data)
+{
+  struct _verify_state *state = (struct _verify_state *)data;
+
+  if (target > state->function->constant_pool_offset ||
+      state->depth[target] == VERIFY_UNREACHED)
+  {
+    state->error = "Jump target is not an instruction.";
+    return 0;
+  }
+
+  if (state->depth[target] == VERIFY_BOUNDARY)
+  {
+    state->depth[target] = state->current;
+    state->worklist[state->worklist_size++] = target;
+    return 1;
+  }
+
+  if (state->depth[target] != state->current)
+  {
+    state->error = "Stack depth differs between the paths to an instruction.";
+    return 0;
+  }
+
+  return 1;
+}
+
+/**
+ * Decode the code once, mark the instruction boundaries and check the
+ * arguments that do not depend on the control flow.
+ */
+int verify_decode(struct _verify_state *state, ws_verify_result *result)
+{
+  ws_function_compiled_data *function = state->function;
+  size_t end = function->constant_pool_offset;
+  uint8_t *data = function->data;
+  unsigned int bytecode;
+  int pops, pushes;
+
+  for (size_t cursor = 0; cursor < end; cursor += 1 + WS_BYTECODE_SIZE[bytecode])
+  {
+    bytecode = data[cursor];
+    result->offset = cursor;
+    state->depth[cursor] = VERIFY_BOUNDARY;
+
+    if (!verify_stack_effect(bytecode, &pops, &pushes))
+    {
+      result->error = "Unknown instruction.";
+      return 0;
+    }
+
+    if (cursor + 1 + WS_BYTECODE_SIZE[bytecode] > end)
+    {
+      result->error = "Argument of the instruction is out of the code.";
+      return 0;
+    }
+
+    switch (bytecode)
+    {
+    case WB_LD_STR:
+    case WB_NAMED_PROP:
+    case WB_NAMED:
+    case WB_STORE:
+    case WB_VAR:
+    case WB_LET:
+    case WB_SET_IS_CONST:
+    case WB_CONST:
+    case WB_NAMED_REF:
+    case WB_PROP_REF:
+    case WB_REG_EXP:
+      if (!verify_netstring(function, verify_read_uint32(data + cursor + 1)))
+      {
+        result->error = "String is out of the constant pool.";
+        return 0;
+      }
+      break;
+
+    case WB_DIAMOND:
+      // exec_diamond skips the conditional jump that follows it.
+      if (cursor + 3 >= end || data[cursor + 3] != WB_JMP_FALSE_POP)
+      {
+        result->error = "Diamond must be followed by JmpFalsePop.";
+        return 0;
+      }
+      break;
+    }
+  }
+
+  state->depth[end] = VERIFY_BOUNDARY;
+  return 1;
+}
+
+int verify_function(ws_function_compiled_data *function, ws_verify_result *result)
+{
+  struct _verify_state state;
+  size_t end = function->constant_pool_offset, cursor, next, next_target;
+  unsigned int bytecode;
+  int pops, pushes, max = 0, checked = 0;
+
+  result->error = NULL;
+  result->offset = 0;
+  result->max_stack = 0;
+  function->verified = 0;
+  function->max_stack = 0;
+
+  if (end > function->scope_offset || function->scope_offset > function->map_offset)
+  {
+    result->error = "Sections of the function are out of order.";
+    return 0;
+  }
+
+  state.function = function;
+  state.depth = (int *)ws_alloc_as(WS_MEMORY_CODE, sizeof(int) * (end + 1));
+  state.worklist = (size_t *)ws_alloc_as(WS_MEMORY_CODE, sizeof(size_t) * (end + 1));
+  state.worklist_size = 0;
+  state.error = NULL;
+
+  for (size_t i = 0; i <= end; ++i)
+    state.depth[i] = VERIFY_UNREACHED;
+
+  if (!verify_decode(&state, result))
+    goto done;
+
+  // Each instruction is added to the worklist once, when it's first reached,
+  // after that the other paths to it only have to agree on the depth.
+  state.current = 0;
+  verify_reach(0, &state);
+
+  while (state.worklist_size > 0 && state.error == NULL)
+  {
+    cursor = state.worklist[--state.worklist_size];
+    result->offset = cursor;
+
+    // Falling off the end returns the top of the stack, or dies if there is
+    // none, it's checked at runtime.
+    if (cursor == end)
+      continue;
+
+    bytecode = function->data[cursor];
+    next = cursor + 1 + WS_BYTECODE_SIZE[bytecode];
+    verify_stack_effect(bytecode, &pops, &pushes);
+    if (!exec_implemented(bytecode))
+      checked = 1;
+
+    if (state.depth[cursor] < pops)
+    {
+      state.error = "Data stack underflow.";
+      break;
+    }
+
+    state.current = state.depth[cursor] - pops + pushes;
+    if (state.current > max)
+      max = state.current;
+
+    switch (bytecode)
+    {
+    case WB_RET:
+      break;
+
+    case WB_JMP:
+      verify_reach(verify_read_uint16(function->data + cursor + 1), &state);
+      break;
+
+    case WB_JMP_TRUE_POP:
+    case WB_JMP_FALSE_POP:
+    case WB_JMP_TRUE_PEEK:
+    case WB_JMP_FALSE_PEEK:
+      if (verify_reach(next, &state))
+        verify_reach(verify_read_uint16(function->data + cursor + 1), &state);
+      break;
+
+    case WB_JMP_TRUE_THEN_POP:
+    case WB_JMP_FALSE_THEN_POP:
+      if (!verify_reach(next, &state))
+        break;
+      // Only the jump pops the value.
+      state.current -= 1;
+      verify_reach(verify_read_uint16(function->data + cursor + 1), &state);
+      break;
+
+    case WB_DIAMOND:
+      // The join is reached through the code of the arms, so only check that
+      // it's an instruction, exec_diamond_join compares the cursor with it.
+      next_target = verify_read_uint16(function->data + cursor + 1);
+      if (next_target > end || state.depth[next_target] == VERIFY_UNREACHED)
+        state.error = "Jump target is not an instruction.";
+      else
+        verify_reach(next, &state);
+      break;
+
+    case WB_SWITCH:
+      if (!verify_switch_table(function,
+                               verify_read_uint32(function->data + cursor + 1),
+                               verify_reach,
+                               &state) &&
+          state.error == NULL)
+        state.error = "Switch table is out of the constant pool.";
+      break;
+
+    default:
+      verify_reach(next, &state);
+    }
+  }
+
+  if (state.error != NULL)
+  {
+    result->error = state.error;
+    goto done;
+  }
+
+  result->max_stack = max;
+  function->max_stack = max;
+  // The interpreter doesn't follow the stack effect of the opcodes that it
+  // doesn't implement yet, keep the checks for them.
+  function->verified = !checked;
+
+done:
+  ws_free(state.depth);
+  ws_free(state.worklist);
+  return result->error == NULL;
+}
@@ -1,8 +1,10 @@
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include "wval.h"
 #include "alloc.h"
 #include "common.h"
+#include "gc.h"
 
 ws_val WS_UNDEFINED = {.type = WVAL_TYPE_UNDEFINED, .ref_count = 2727};
 ws_val WS_NULL = {.type = WVAL_TYPE_NULL, .ref_count = 2727};
@@ -11,7 +13,21 @@ ws_val WS_FALSE = {.type = WVAL_TYPE_BOOLEAN, .data.boolean = 0, .ref_count = 27
 ws_val WS_ZERO = {.type = WVAL_TYPE_NUMBER, .data.number = 0.0, .ref_count = 2727};
 ws_val WS_ONE = {.type = WVAL_TYPE_NUMBER, .data.number = 1.0, .ref_count = 2727};
 ws_val WS_TWO = {.type = WVAL_TYPE_NUMBER, .data.number = 2.0, .ref_count = 2727};
+ws_val WS_ANY_STRING = {.type = WVAL_TYPE_ANY_STRING, .ref_count = 2727};
 
+static ws_val *any_boolean_values[] = {&WS_TRUE, &WS_FALSE};
+ws_val WS_ANY_BOOLEAN = {.type = WVAL_TYPE_UNION, .data.set = {.size = 2, .values = any_boolean_values}, .ref_count = 2727};
+
+ws_val *wval_alloc()
+{
+  ws_val *value = ws_alloc_val();
+#ifdef WS_TRACING_GC
+  gc_register(value);
+#endif
+  return value;
+}
+
+#ifndef WS_TRACING_GC
 void wval_retain(ws_val *value)
 {
   if (value == NULL)
@@ -30,12 +46,10 @@ void wval_release(ws_val *value)
     // TODO(qti3e) GC.
   }
 }
+#endif
 
 int wval_strict_equal(ws_val *v1, ws_val *v2)
 {
-  unsigned int n;
-  char16_t *str1, *str2;
-
   if (v1 == v2)
     return 1;
 
@@ -59,38 +73,184 @@ int wval_strict_equal(ws_val *v1, ws_val *v2)
   case WVAL_TYPE_OBJECT:
     return v1->data.object == v2->data.object;
 
+  case WVAL_TYPE_ITERATOR:
+    return v1->data.iterator == v2->data.iterator;
+
   case WVAL_TYPE_SYMBOL:
     return v1->data.symbol.id == v2->data.symbol.id;
 
-  case WVAL_TYPE_STRING:
-    if (v1->data.string.size != v2->data.string.size)
+  // For abstract values we check if they describe the same set of values.
+
+  case WVAL_TYPE_RANGE:
+    return v1->data.range.min == v2->data.range.min &&
+           v1->data.range.max == v2->data.range.max;
+
+  case WVAL_TYPE_UNION:
+    if (v1->data.set.size != v2->data.set.size)
       return 0;
-    n = v1->data.string.size - 1;
-    str1 = v1->data.string.data;
-    str2 = v2->data.string.data;
-    for (; n >= 0; --n)
-      if (str1[n] != str2[n])
+    for (unsigned int i = 0; i < v1->data.set.size; ++i)
+    {
+      unsigned int j = 0;
+      for (; j < v2->data.set.size; ++j)
+        if (wval_strict_equal(v1->data.set.values[i], v2->data.set.values[j]))
+          break;
+      if (j == v2->data.set.size)
         return 0;
+    }
+    return 1;
+
+  case WVAL_TYPE_ANY_STRING:
     return 1;
+
+  case WVAL_TYPE_STRING:
+    if (v1->data.string.size != v2->data.string.size)
+      return 0;
+    return memcmp(ws_string_flatten(v1), ws_string_flatten(v2),
+                  v1->data.string.size - sizeof(char16_t)) == 0;
   }
 }
 
 ws_val *ws_string(char16_t *data, size_t size)
 {
-  ws_val *string = (ws_val *)ws_alloc(sizeof(*string));
+  ws_val *string = wval_alloc();
   string->type = WVAL_TYPE_STRING;
   string->ref_count = 0;
   string->data.string.data = data;
   string->data.string.size = size;
+  string->data.string.left = NULL;
+  string->data.string.right = NULL;
+  string->data.string.owns_data = 0;
   return string;
 }
 
+/**
+ * Concatenations shorter than this (in UTF-16 code units) are copied right
+ * away, a rope node is not worth it for them.
+ */
+#define WS_ROPE_MIN_LENGTH 32
+
+ws_val *ws_string_concat(ws_val *left, ws_val *right)
+{
+  size_t left_length, right_length;
+  char16_t *data;
+  ws_val *string;
+
+  if (left->type != WVAL_TYPE_STRING || right->type != WVAL_TYPE_STRING)
+    die("ws_string_concat: Only strings can be concatenated.");
+
+  left_length = left->data.string.size / 2 - 1;
+  right_length = right->data.string.size / 2 - 1;
+
+  if (left_length == 0)
+    return right;
+  if (right_length == 0)
+    return left;
+
+  if (left_length + right_length < WS_ROPE_MIN_LENGTH)
+  {
+    data = (char16_t *)ws_alloc_as(WS_MEMORY_VALUES, (left_length + right_length + 1) * 2);
+    memcpy(data, ws_string_flatten(left), left_length * 2);
+    memcpy(data + left_length, ws_string_flatten(right), right_length * 2);
+    data[left_length + right_length] = 0;
+    return ws_string(data, (left_length + right_length + 1) * 2);
+  }
+
+  string = wval_alloc();
+  string->type = WVAL_TYPE_STRING;
+  string->ref_count = 0;
+  string->data.string.data = NULL;
+  string->data.string.size = (left_length + right_length + 1) * 2;
+  string->data.string.left = left;
+  string->data.string.right = right;
+  string->data.string.owns_data = 0;
+  wval_retain(left);
+  wval_retain(right);
+  return string;
+}
+
+char16_t *ws_string_flatten(ws_val *string)
+{
+  char16_t *data, *flat, *expected;
+  ws_val **stack, **tmp, *current, *left, *right;
+  size_t capacity, top, end, length;
+
+  data = string->data.string.data;
+  if (data != NULL)
+    return data;
+
+  end = string->data.string.size / 2 - 1;
+  data = (char16_t *)ws_alloc_as(WS_MEMORY_VALUES, string->data.string.size);
+  data[end] = 0;
+
+  capacity = 16;
+  top = 0;
+  stack = (ws_val **)ws_alloc(sizeof(ws_val *) * capacity);
+  stack[top++] = string;
+
+  // The buffer is filled backward, this way a left-deep rope (which is what
+  // `+=` in a loop produces) only needs a couple of stack entries.
+  while (top > 0)
+  {
+    current = stack[--top];
+    flat = current->data.string.data;
+    left = current->data.string.left;
+    right = current->data.string.right;
+
+    // Another thread flattened this node after we read its buffer and let
+    // go of the sides, the buffer is published before that.
+    if (flat == NULL && (left == NULL || right == NULL))
+      flat = current->data.string.data;
+
+    if (flat != NULL)
+    {
+      length = current->data.string.size / 2 - 1;
+      end -= length;
+      memcpy(data + end, flat, length * 2);
+      continue;
+    }
+
+    if (top + 2 > capacity)
+    {
+      tmp = stack;
+      stack = (ws_val **)ws_alloc(sizeof(ws_val *) * capacity * 2);
+      memcpy(stack, tmp, sizeof(ws_val *) * capacity);
+      capacity *= 2;
+      ws_free(tmp);
+    }
+
+    stack[top++] = left;
+    stack[top++] = right;
+  }
+
+  ws_free(stack);
+
+  // The rope might be shared with other threads, only one flat buffer wins.
+  expected = NULL;
+  if (!atomic_compare_exchange_strong(&string->data.string.data, &expected, data))
+  {
+    ws_free(data);
+    return expected;
+  }
+
+  // The sides are not needed anymore, so the text is not kept twice and a
+  // rope that is made on top of this one stops here when it's flattened.
+  string->data.string.owns_data = 1;
+  left = string->data.string.left;
+  right = string->data.string.right;
+  string->data.string.left = NULL;
+  string->data.string.right = NULL;
+  wval_release(left);
+  wval_release(right);
+
+  return data;
+}
+
 ws_val *ws_symbol(ws_val *description)
 {
   static atomic_uint last_symbol_id = 0;
 
-  ws_val *value = (ws_val *)ws_alloc(sizeof(*value));
-  value->type = WVAL_TYPE_STRING;
+  ws_val *value = wval_alloc();
+  value->type = WVAL_TYPE_SYMBOL;
   value->ref_count = 0;
   value->data.symbol.id = ++last_symbol_id;
   value->data.symbol.description = description;
@@ -100,32 +260,184 @@ ws_val *ws_symbol(ws_val *description)
 
 ws_val *ws_number(double number)
 {
-  ws_val *value = (ws_val *)ws_alloc(sizeof(*value));
-  value->type = WVAL_TYPE_STRING;
+  ws_val *value = wval_alloc();
+  value->type = WVAL_TYPE_NUMBER;
   value->ref_count = 0;
   value->data.number = number;
   return value;
 }
 
+ws_val *ws_range(double min, double max)
+{
+  if (isnan(min) || isnan(max) || min > max)
+    die("ws_range: Invalid bounds.");
+
+  if (min == max)
+    return ws_number(min);
+
+  ws_val *value = wval_alloc();
+  value->type = WVAL_TYPE_RANGE;
+  value->ref_count = 0;
+  value->data.range.min = min;
+  value->data.range.max = max;
+  return value;
+}
+
+ws_val *ws_union(ws_val **values, unsigned int size)
+{
+  ws_val *members[WS_UNION_MAX_SIZE];
+  ws_val *member;
+  unsigned int count, n, i, j, k;
+  int overflow, all_numeric, all_strings, nan;
+  double min, max;
+
+  count = 0;
+  overflow = 0;
+  nan = 0;
+  all_numeric = 1;
+  all_strings = 1;
+  min = INFINITY;
+  max = -INFINITY;
+
+  for (i = 0; i < size; ++i)
+  {
+    n = values[i]->type == WVAL_TYPE_UNION ? values[i]->data.set.size : 1;
+
+    for (j = 0; j < n; ++j)
+    {
+      member = values[i]->type == WVAL_TYPE_UNION ? values[i]->data.set.values[j]
+                                                  : values[i];
+
+      switch (member->type)
+      {
+      case WVAL_TYPE_NUMBER:
+        all_strings = 0;
+        // NaN is not a part of the bounds, it's kept as a member.
+        if (isnan(member->data.number))
+        {
+          if (nan++)
+            continue;
+          break;
+        }
+        min = fmin(min, member->data.number);
+        max = fmax(max, member->data.number);
+        break;
+      case WVAL_TYPE_RANGE:
+        all_strings = 0;
+        min = fmin(min, member->data.range.min);
+        max = fmax(max, member->data.range.max);
+        break;
+      case WVAL_TYPE_STRING:
+      case WVAL_TYPE_ANY_STRING:
+        all_numeric = 0;
+        break;
+      default:
+        all_numeric = 0;
+        all_strings = 0;
+      }
+
+      for (k = 0; k < count; ++k)
+        if (wval_strict_equal(members[k], member))
+          break;
+
+      if (k < count)
+        continue;
+
+      if (count == WS_UNION_MAX_SIZE)
+      {
+        overflow = 1;
+        continue;
+      }
+
+      members[count++] = member;
+    }
+  }
+
+  if (count == 0)
+    die("ws_union: A union must have at least one member.");
+
+  if (overflow)
+  {
+    if (all_numeric && nan)
+    {
+      members[0] = ws_range(min, max);
+      members[1] = ws_number(NAN);
+      return ws_union(members, 2);
+    }
+    if (all_numeric)
+      return ws_range(min, max);
+    if (all_strings)
+      return &WS_ANY_STRING;
+    return NULL;
+  }
+
+  if (count == 1)
+    return members[0];
+
+  ws_val *value = wval_alloc();
+  value->type = WVAL_TYPE_UNION;
+  value->ref_count = 0;
+  value->data.set.size = count;
+  value->data.set.values = (ws_val **)ws_alloc_as(WS_MEMORY_VALUES, sizeof(ws_val *) * count);
+  for (i = 0; i < count; ++i)
+  {
+    value->data.set.values[i] = members[i];
+    wval_retain(members[i]);
+  }
+  return value;
+}
+
+int wval_is_abstract(ws_val *value)
+{
+  return value->type == WVAL_TYPE_RANGE || value->type == WVAL_TYPE_UNION ||
+         value->type == WVAL_TYPE_ANY_STRING;
+}
+
 ws_val *ws_object(ws_context *ctx, ws_val *proto)
 {
   if (proto != NULL && proto->type != WVAL_TYPE_OBJECT)
     die("ws_object: Cannot use a non-object value as prototype.");
 
-  ws_obj *object = (ws_obj *)ws_alloc(sizeof(*object));
+  ws_obj *object = ws_alloc_obj();
   object->call = NULL;
   object->construct = NULL;
   object->proto = proto == NULL ? NULL : proto->data.object;
+  object->is_proto = 0;
+  object->elements = NULL;
+  object->collection = NULL;
+  object->buffer = NULL;
+  object->typed = NULL;
+  object->regexp = NULL;
+  object->native = NULL;
+  object->self = NULL;
+  if (proto != NULL)
+    object->proto->is_proto = 1;
   wval_retain(proto);
   table_init(ctx, &object->properties);
 
-  ws_val *value = (ws_val *)ws_alloc(sizeof(*value));
-  value->type = WVAL_TYPE_STRING;
+  ws_val *value = wval_alloc();
+  value->type = WVAL_TYPE_OBJECT;
   value->ref_count = 0;
   value->data.object = object;
   return value;
 }
 
+ws_val *ws_function_object(ws_context *ctx, ws_function *function)
+{
+  ws_val *value = ws_object(ctx, NULL);
+  value->data.object->call = function;
+  return value;
+}
+
+ws_val *ws_native_object(ws_context *ctx, ws_native native, ws_val *self)
+{
+  ws_val *value = ws_object(ctx, NULL);
+  value->data.object->native = native;
+  value->data.object->self = self;
+  wval_retain(self);
+  return value;
+}
+
 ws_val *ws_to_boolean(ws_context *ctx, ws_val *value)
 {
   switch (value->type)
@@ -137,11 +449,37 @@ ws_val *ws_to_boolean(ws_context *ctx, ws_val *value)
     return &WS_FALSE;
   case WVAL_TYPE_SYMBOL:
   case WVAL_TYPE_OBJECT:
+  case WVAL_TYPE_ITERATOR:
     return &WS_TRUE;
   case WVAL_TYPE_STRING:
-    return value->data.string.size == 0 ? &WS_FALSE : &WS_TRUE;
+    return value->data.string.size <= sizeof(char16_t) ? &WS_FALSE : &WS_TRUE;
   case WVAL_TYPE_NUMBER:
     return (isnan(value->data.number) || value->data.number == 0) ? &WS_FALSE
                                                                   : &WS_TRUE;
+  case WVAL_TYPE_RANGE:
+    if (value->data.range.min > 0 || value->data.range.max < 0)
+      return &WS_TRUE;
+    return &WS_ANY_BOOLEAN;
+  case WVAL_TYPE_ANY_STRING:
+    return &WS_ANY_BOOLEAN;
+  case WVAL_TYPE_UNION:
+  {
+    int truthy = 0, falsy = 0;
+    for (unsigned int i = 0; i < value->data.set.size; ++i)
+    {
+      ws_val *boolean = ws_to_boolean(ctx, value->data.set.values[i]);
+      if (boolean->type != WVAL_TYPE_BOOLEAN)
+        return &WS_ANY_BOOLEAN;
+      if (boolean->data.boolean)
+        truthy = 1;
+      else
+        falsy = 1;
+    }
+    if (truthy && falsy)
+      return &WS_ANY_BOOLEAN;
+    return truthy ? &WS_TRUE : &WS_FALSE;
   }
+  }
+
+  return &WS_ANY_BOOLEAN;
 }
\ No newline at end of file